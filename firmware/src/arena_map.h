@@ -0,0 +1,39 @@
+#ifndef ARENA_MAP_H
+#define ARENA_MAP_H
+
+// Stored classroom arena used by Monte Carlo localization. One character
+// per GRID_CELL_SIZE_CM cell: '#' is a wall or fixed obstacle, '.' is floor.
+// Row 0 is the -y edge and column 0 the -x edge; the map is centered in the
+// grid, so world (0, 0) is the middle of the arena. Replace it with a
+// drawing of your own arena (it must fit in GRID_MAP_WIDTH x GRID_MAP_HEIGHT).
+#define ARENA_MAP_WIDTH   30
+#define ARENA_MAP_HEIGHT  24
+
+static const char* const ARENA_MAP[ARENA_MAP_HEIGHT] = {
+  "##############################",
+  "#............................#",
+  "#............................#",
+  "#............................#",
+  "#.....####...................#",
+  "#.....####...................#",
+  "#............................#",
+  "#............................#",
+  "#....................#########",
+  "#............................#",
+  "#............................#",
+  "#............................#",
+  "#............................#",
+  "#..........###...............#",
+  "#..........###...............#",
+  "#............................#",
+  "#............................#",
+  "#######......................#",
+  "#............................#",
+  "#............................#",
+  "#.....................####...#",
+  "#.....................####...#",
+  "#............................#",
+  "##############################",
+};
+
+#endif // ARENA_MAP_H
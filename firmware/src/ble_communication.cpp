@@ -1,84 +1,201 @@
 #include "ble_communication.h"
-#include "motor_control.h"
+#include "link_manager.h"
+#include "navigation.h"
+#include "program_runner.h"
+#include "logger.h"
+#include "ota_update.h"
+#include "task_events.h"
+#include "static_alloc.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <esp_bt_device.h>
 
 // Global instance
 BLECommunication bleManager;
 
-BLECommunication::BLECommunication() 
+// Objects handed to the BLE library, which keeps them for good
+static ObjectStorage<MyServerCallbacks> serverCallbacksStorage;
+static ObjectStorage<CommandCharCallbacks> commandCallbacksStorage;
+static ObjectStorage<OtaCharCallbacks> otaCallbacksStorage;
+static ObjectStorage<BLE2902> sensorCccdStorage;
+static ObjectStorage<BLE2902> statusCccdStorage;
+#if LOG_BLE_ENABLED
+static ObjectStorage<BLE2902> logCccdStorage;
+#endif
+static ObjectStorage<BLE2902> otaCccdStorage;
+
+static const char* connModeName(ConnMode mode) {
+  switch (mode) {
+    case CONN_FAST: return "fast";
+    case CONN_IDLE: return "idle";
+    case CONN_AUTO: return "auto";
+  }
+  return "unknown";
+}
+
+static const char* roleName(BleRole role) {
+  return role == ROLE_CONTROLLER ? "controller" : "observer";
+}
+
+static void bleLogSink(const uint8_t* data, size_t length) {
+  bleManager.writeLog(data, length);
+}
+
+static void bleOtaSink(const uint8_t* data, size_t length) {
+  bleManager.writeOtaReply(data, length);
+}
+
+// Reports the parameters the central actually applied
+static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+  if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT && param->update_conn_params.status == 0) {
+    bleManager.onConnParamsUpdated(param->update_conn_params.bda,
+                                   param->update_conn_params.conn_int,
+                                   param->update_conn_params.latency,
+                                   param->update_conn_params.timeout);
+  }
+}
+
+// Per-connection events the Arduino BLE classes don't pass on
+static void gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf,
+                              esp_ble_gatts_cb_param_t* param) {
+  bleManager.onGattsEvent(event, gattsIf, param);
+}
+
+BLECommunication::BLECommunication()
   : pServer(nullptr),
     pCommandChar(nullptr),
     pSensorChar(nullptr),
+    pStatusChar(nullptr),
+    pLogChar(nullptr),
+    pOtaChar(nullptr),
     pService(nullptr),
-    deviceConnected(false),
-    oldDeviceConnected(false),
-    commandQueue(nullptr),
+    controllerConn(-1),
+    clientCount(0),
+    advertising(false),
+    connMode(CONN_AUTO),
+    connProfile(CONN_FAST),
+    connInterval(0),
+    connLatency(0),
+    connTimeout(0),
+    lastCommandTime(0),
     serverCallbacks(nullptr),
-    commandCallbacks(nullptr) {
+    commandCallbacks(nullptr),
+    otaCallbacks(nullptr) {
+  memset(peerAddress, 0, sizeof(peerAddress));
+  memset(deviceAddress, 0, sizeof(deviceAddress));
+  for (int i = 0; i < 2; i++) {
+    latencyCount[i] = 0;
+    latencySum[i] = 0;
+    latencyMax[i] = 0;
+  }
 }
 
 BLECommunication::~BLECommunication() {
-  if (commandQueue) {
-    vQueueDelete(commandQueue);
-  }
-  delete serverCallbacks;
-  delete commandCallbacks;
+  serverCallbacksStorage.destroy(serverCallbacks);
+  commandCallbacksStorage.destroy(commandCallbacks);
+  otaCallbacksStorage.destroy(otaCallbacks);
 }
 
 void BLECommunication::begin() {
   // Initialize BLE device
   BLEDevice::init(BLE_DEVICE_NAME);
   Serial.printf("BLE Device initialized: %s\n", BLE_DEVICE_NAME);
-  
-  // Create command queue
-  commandQueue = xQueueCreate(COMMAND_QUEUE_SIZE, sizeof(Command));
-  if (commandQueue == nullptr) {
-    Serial.println("Failed to create command queue");
-    return;
+
+  // Offer a large ATT MTU so binary telemetry can batch many samples into
+  // one notification; the client decides whether to accept it.
+  BLEDevice::setMTU(TELEMETRY_MTU);
+
+  // Learn the connection parameters the central settles on, and follow
+  // each client's subscriptions and congestion
+  BLEDevice::setCustomGapHandler(gapEventHandler);
+  BLEDevice::setCustomGattsHandler(gattsEventHandler);
+
+  if (!fanout.begin()) {
+    Serial.println("BLE notifications unavailable");
   }
-  
+
   // Initialize BLE service
   initializeService();
-  
+
   // Start advertising
   startAdvertising();
-  
+
   Serial.println("BLE communication ready");
 }
 
 void BLECommunication::initializeService() {
   // Create BLE server
   pServer = BLEDevice::createServer();
-  
+
   // Create and set callbacks
-  serverCallbacks = new MyServerCallbacks(this);
+  serverCallbacks = serverCallbacksStorage.create(this);
   pServer->setCallbacks(serverCallbacks);
-  
+
   // Create BLE service
   pService = pServer->createService(SERVICE_UUID);
-  
+
   // Create command characteristic (write only)
   pCommandChar = pService->createCharacteristic(
     COMMAND_CHAR_UUID,
     BLECharacteristic::PROPERTY_WRITE
   );
-  
-  commandCallbacks = new CommandCharCallbacks(this);
+
+  commandCallbacks = commandCallbacksStorage.create(this);
   pCommandChar->setCallbacks(commandCallbacks);
-  
+
   // Create sensor characteristic (notify only)
   pSensorChar = pService->createCharacteristic(
     SENSOR_CHAR_UUID,
     BLECharacteristic::PROPERTY_NOTIFY
   );
-  
+
   // Add descriptor for notifications
-  pSensorChar->addDescriptor(new BLE2902());
-  
+  BLE2902* sensorCccd = sensorCccdStorage.create();
+  pSensorChar->addDescriptor(sensorCccd);
+
+  // Create status characteristic for command acks (notify only)
+  pStatusChar = pService->createCharacteristic(
+    STATUS_CHAR_UUID,
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  BLE2902* statusCccd = statusCccdStorage.create();
+  pStatusChar->addDescriptor(statusCccd);
+
+#if LOG_BLE_ENABLED
+  // Create log characteristic (notify only, silent until LOG_ON)
+  pLogChar = pService->createCharacteristic(
+    LOG_CHAR_UUID,
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  BLE2902* logCccd = logCccdStorage.create();
+  pLogChar->addDescriptor(logCccd);
+#endif
+
+  // Create firmware update characteristic (chunks written without
+  // response, replies notified)
+  pOtaChar = pService->createCharacteristic(
+    OTA_CHAR_UUID,
+    BLECharacteristic::PROPERTY_WRITE |
+    BLECharacteristic::PROPERTY_WRITE_NR |
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  BLE2902* otaCccd = otaCccdStorage.create();
+  pOtaChar->addDescriptor(otaCccd);
+  otaCallbacks = otaCallbacksStorage.create();
+  pOtaChar->setCallbacks(otaCallbacks);
+  otaUpdater.setReplySink(bleOtaSink);
+
   // Start the service
   pService->start();
-  
+
+  // Handles exist once the service has started
+  fanout.setChannel(NOTIFY_SENSOR, pSensorChar->getHandle(), sensorCccd->getHandle());
+  fanout.setChannel(NOTIFY_STATUS, pStatusChar->getHandle(), statusCccd->getHandle());
+#if LOG_BLE_ENABLED
+  fanout.setChannel(NOTIFY_LOG, pLogChar->getHandle(), logCccd->getHandle());
+#endif
+  fanout.setChannel(NOTIFY_OTA, pOtaChar->getHandle(), otaCccd->getHandle());
+
   Serial.println("BLE service initialized");
 }
 
@@ -86,213 +203,465 @@ void BLECommunication::startAdvertising() {
   BLEAdvertising* pAdvertising = BLEDevice::getAdvertising();
   pAdvertising->addServiceUUID(SERVICE_UUID);
   pAdvertising->setScanResponse(true);
-  pAdvertising->setMinPreferred(0x06);
-  pAdvertising->setMinPreferred(0x12);
-  
+  pAdvertising->setMinPreferred(CONN_FAST_MIN_INTERVAL);
+  pAdvertising->setMaxPreferred(CONN_FAST_MAX_INTERVAL);
+
   BLEDevice::startAdvertising();
+  advertising = true;
   Serial.println("BLE advertising started");
 }
 
 bool BLECommunication::isConnected() const {
-  return deviceConnected;
+  return clientCount > 0;
 }
 
-void BLECommunication::handleConnection() {
-  // Handle disconnection
-  if (!deviceConnected && oldDeviceConnected) {
-    Serial.println("Device disconnected, restarting advertising");
-    delay(500); // Give time for client to process
-    pServer->startAdvertising();
-    oldDeviceConnected = deviceConnected;
-  }
-  
-  // Handle new connection
-  if (deviceConnected && !oldDeviceConnected) {
-    Serial.println("Device connected");
-    oldDeviceConnected = deviceConnected;
+bool BLECommunication::isController(uint16_t connId) const {
+  return controllerConn == (int32_t)connId;
+}
+
+const char* BLECommunication::getName() const {
+  return "BLE";
+}
+
+size_t BLECommunication::getMaxPayload() const {
+  // Notifications carry at most MTU - 3 bytes of payload, and one encoded
+  // message goes to every client
+  return fanout.getMinPayload();
+}
+
+void BLECommunication::writeTelemetry(const uint8_t* data, size_t length) {
+  fanout.send(NOTIFY_SENSOR, data, length, BLE_ALL_CLIENTS);
+}
+
+void BLECommunication::writeAck(const uint8_t* data, size_t length) {
+  // Already serialized by the link manager. Only the controller's commands
+  // are executed, so only the controller hears about them.
+  int32_t controller = controllerConn;
+  if (controller < 0) return;
+  fanout.send(NOTIFY_STATUS, data, length, controller);
+}
+
+uint16_t BLECommunication::getRequester() const {
+  // Only the controller's commands get as far as the link manager
+  return (uint16_t)controllerConn;
+}
+
+bool BLECommunication::writeReply(uint16_t requester, const uint8_t* data, size_t length) {
+  // To the connection that asked, even if control has moved on since
+  NotifyFanout::Client client;
+  if (!fanout.findClient(requester, client)) return false;
+  fanout.send(NOTIFY_SENSOR, data, length, requester);
+  return true;
+}
+
+bool BLECommunication::handleLinkCommand(const char* cmd) {
+  if (strcmp(cmd, "CONN_FAST") == 0) {
+    setConnMode(CONN_FAST);
+  } else if (strcmp(cmd, "CONN_IDLE") == 0) {
+    setConnMode(CONN_IDLE);
+  } else if (strcmp(cmd, "CONN_AUTO") == 0) {
+    setConnMode(CONN_AUTO);
+  } else if (strcmp(cmd, "LOG_ON") == 0 && pLogChar != nullptr) {
+    logger.setBinarySink(bleLogSink);
+  } else if (strcmp(cmd, "LOG_OFF") == 0) {
+    logger.setBinarySink(nullptr);
+  } else {
+    return false;
   }
+  return true;
 }
 
-void BLECommunication::disconnect() {
-  if (deviceConnected) {
-    pServer->disconnect(pServer->getConnId());
-    deviceConnected = false;
-    Serial.println("BLE disconnected");
+bool BLECommunication::handleLinkFrame(const Frame& frame, bool& ok) {
+  if (frame.opcode != OP_CONN_PROFILE) return false;
+
+  ok = frame.param >= CONN_FAST && frame.param <= CONN_AUTO;
+  if (ok) {
+    setConnMode((ConnMode)frame.param);
   }
+  return true;
 }
 
-Command BLECommunication::parseCommand(const String& cmd) {
-  Command command = {'S', 0}; // Default stop command
-  
-  if (cmd.length() == 0) {
-    return command;
+unsigned long BLECommunication::handleConnection() {
+  // The stack stops advertising when a central connects; keep offering
+  // the free slots
+  if (!advertising && clientCount < BLE_MAX_CLIENTS) {
+    BLEDevice::startAdvertising();
+    advertising = true;
+    LOG_INFO("Advertising (%d of %d clients connected)", (int)clientCount, BLE_MAX_CLIENTS);
   }
-  
-  String trimmed = cmd;
-  trimmed.trim();
-  
-  if (trimmed.startsWith("F")) {
-    command.type = 'F';
-    command.value = trimmed.substring(1).toInt();
+
+  // Auto mode: relax the link once the robot has been left alone
+  if (controllerConn < 0 || connMode != CONN_AUTO || connProfile != CONN_FAST) {
+    return CONN_CHECK_NEVER;
   }
-  else if (trimmed.startsWith("B")) {
-    command.type = 'B';
-    command.value = trimmed.substring(1).toInt();
+  unsigned long quiet = millis() - lastCommandTime;
+  if (quiet <= CONN_IDLE_AFTER_MS) {
+    return CONN_IDLE_AFTER_MS - quiet + 1;
   }
-  else if (trimmed.startsWith("L")) {
-    command.type = 'L';
-    command.value = trimmed.substring(1).toInt();
+  if (navigator.isAutonomous() || programRunner.isRunning()) {
+    return CONN_IDLE_AFTER_MS;          // look again once it's done
   }
-  else if (trimmed.startsWith("R")) {
-    command.type = 'R';
-    command.value = trimmed.substring(1).toInt();
+  requestConnProfile(CONN_IDLE);
+  return CONN_CHECK_NEVER;
+}
+
+void BLECommunication::clientConnected(uint16_t connId, const esp_bd_addr_t address) {
+  advertising = false;
+
+  BleRole role = controllerConn < 0 ? ROLE_CONTROLLER : ROLE_OBSERVER;
+  if (!fanout.addClient(connId, address, role)) {
+    LOG_WARN("No room for BLE client %u, disconnecting", connId);
+    pServer->disconnect(connId);
+    return;
   }
-  else if (trimmed == "STOP") {
-    command.type = 'S';
-    command.value = 0;
+  clientCount++;
+  LOG_INFO("Client %u connected as %s (%d connected)", connId, roleName(role), (int)clientCount);
+  taskEvents.signal(EVENT_CONNECTION | EVENT_SENSOR_PLAN);
+
+  if (role == ROLE_CONTROLLER) {
+    setController(connId);
+  } else {
+    // Observers only listen; a slow interval leaves airtime to the controller
+    requestConnParams(address, CONN_IDLE);
+    sendRole(connId);
   }
-  else if (trimmed == "AUTO_NAV") {
-    command.type = 'A';
-    command.value = 1;
+}
+
+void BLECommunication::clientDisconnected(uint16_t connId) {
+  NotifyFanout::Client client;
+  if (!fanout.findClient(connId, client)) return;
+
+  fanout.removeClient(connId);
+  clientCount--;
+  LOG_INFO("Client %u (%s) disconnected", connId, roleName(client.role));
+
+  if (isController(connId)) {
+    // The seat stays free until someone asks for it
+    otaUpdater.linkLost();
+    connMode = CONN_AUTO;
+    connInterval = 0;
+    setController(-1);
   }
-  else if (trimmed == "AUTO_OFF") {
-    command.type = 'A';
-    command.value = 0;
+  if (clientCount == 0) {
+    logger.setBinarySink(nullptr);
   }
-  else if (trimmed == "CALIBRATE") {
-    command.type = 'C';
-    command.value = 0;
+  linkManager.transportClosed(this);
+  taskEvents.signal(EVENT_CONNECTION | EVENT_SENSOR_PLAN);
+}
+
+void BLECommunication::setController(int32_t connId) {
+  int32_t previous = controllerConn;
+  NotifyFanout::Client client;
+
+  if (previous >= 0 && previous != connId && fanout.findClient(previous, client)) {
+    fanout.setRole(previous, ROLE_OBSERVER);
+    requestConnParams(client.address, CONN_IDLE);
   }
-  else if (trimmed == "CLOOP_ON") {
-    command.type = 'K';
-    command.value = 1;
+
+  controllerConn = connId;
+  if (connId >= 0 && fanout.findClient(connId, client)) {
+    fanout.setRole(connId, ROLE_CONTROLLER);
+    memcpy(peerAddress, client.address, sizeof(peerAddress));
+
+    // The central picks a slow interval on its own; ask for the session's
+    // profile straight away
+    lastCommandTime = millis();
+    requestConnProfile(connMode == CONN_IDLE ? CONN_IDLE : CONN_FAST);
   }
-  else if (trimmed == "CLOOP_OFF") {
-    command.type = 'K';
-    command.value = 0;
+
+  // Everyone learns who holds the seat
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (fanout.getClient(i, client)) {
+      sendRole(client.connId);
+    }
   }
-  else {
-    Serial.printf("Unknown command: %s\n", trimmed.c_str());
+
+  // The idle timer follows the controller
+  taskEvents.signal(EVENT_CONNECTION);
+}
+
+void BLECommunication::sendRole(uint16_t connId) {
+  StaticJsonDocument<96> doc;
+  doc["status"] = "role";
+  doc["role"] = isController(connId) ? "controller" : "observer";
+  doc["controller"] = controllerConn >= 0;    // seat taken
+  doc["clients"] = (int)clientCount;
+
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+  fanout.send(NOTIFY_SENSOR, (const uint8_t*)output, length, connId);
+}
+
+bool BLECommunication::handleRoleCommand(uint16_t connId, const char* cmd) {
+  if (strncmp(cmd, "ROLE", 4) != 0) return false;
+
+  if (strcmp(cmd, "ROLE:CONTROL") == 0) {
+    if (controllerConn < 0) {
+      LOG_INFO("Client %u took control", connId);
+      setController(connId);
+      return true;
+    }
+  } else if (strcmp(cmd, "ROLE:OBSERVE") == 0) {
+    if (isController(connId)) {
+      LOG_INFO("Client %u gave up control", connId);
+      otaUpdater.linkLost();
+      setController(-1);
+      return true;
+    }
+  } else if (strcmp(cmd, "ROLE") != 0) {
+    return false;
   }
 
-  // Clamp parameters to safe ranges so a bad value can't trigger a runaway
-  // (e.g. "F99999") or otherwise multi-minute blocking move.
-  if (command.type == 'F' || command.type == 'B') {
-    command.value = constrain(command.value, 0, MAX_MOVE_DISTANCE_CM);
-  } else if (command.type == 'L' || command.type == 'R') {
-    command.value = constrain(command.value, 0, MAX_TURN_ANGLE);
+  // A query, or a request that changes nothing: report the current role
+  sendRole(connId);
+  return true;
+}
+
+void BLECommunication::rejectWrite(uint16_t connId, const uint8_t* data, size_t length) {
+  // Answered like any rejected command, with no credit, so an observer's
+  // app sees why nothing happened
+  Command command = {0, 0, 0, 0, 0, 0};
+  command.receivedAt = millis();
+  if (data[0] == PROTOCOL_MAGIC) {
+    Frame frame;
+    Command decoded;
+    if (decodeFrame(data, length, frame) == FRAME_OK) {
+      command.seq = frame.seq;
+      if (frameToCommand(frame, decoded)) command.type = decoded.type;
+    }
+  } else {
+    command.type = (char)data[0];
   }
 
-  return command;
+  uint8_t ack[ACK_SIZE];
+  encodeAck(ACK_REJECTED, command, millis(), 0, ack);
+  fanout.send(NOTIFY_STATUS, ack, sizeof(ack), connId);
+  LOG_DEBUG("Command from observer %u rejected", connId);
 }
 
-void BLECommunication::processCommand(const String& cmd) {
-  Command command = parseCommand(cmd);
+void BLECommunication::onGattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf,
+                                    esp_ble_gatts_cb_param_t* param) {
+  fanout.setGattsIf(gattsIf);
 
-  // A stop must interrupt any in-progress blocking move immediately, before
-  // it even reaches the front of the queue.
-  if (command.type == 'S') {
-    motorController.requestStop();
+  if (event == ESP_GATTS_CONGEST_EVT) {
+    fanout.onCongest(param->congest.conn_id, param->congest.congested);
+  } else if (event == ESP_GATTS_WRITE_EVT) {
+    int channel = fanout.onWrite(param->write.conn_id, param->write.handle,
+                                 param->write.value, param->write.len);
+    if (channel == NOTIFY_SENSOR) {
+      // The first message a client can receive
+      sendRole(param->write.conn_id);
+    }
   }
+}
 
-  if (xQueueSend(commandQueue, &command, 0) != pdTRUE) {
-    Serial.println("Command queue full, dropping command");
+void BLECommunication::setConnMode(ConnMode mode) {
+  connMode = mode;
+  Serial.printf("Connection mode: %s\n", connModeName(mode));
+  if (controllerConn >= 0) {
+    requestConnProfile(mode == CONN_IDLE ? CONN_IDLE : CONN_FAST);
+  }
+  lastCommandTime = millis();
+  taskEvents.signal(EVENT_CONNECTION);
+}
+
+void BLECommunication::requestConnParams(const esp_bd_addr_t address, ConnMode profile) {
+  esp_bd_addr_t peer;
+  memcpy(peer, address, sizeof(peer));
+  if (profile == CONN_FAST) {
+    pServer->updateConnParams(peer, CONN_FAST_MIN_INTERVAL, CONN_FAST_MAX_INTERVAL,
+                              CONN_FAST_LATENCY, CONN_FAST_TIMEOUT);
   } else {
-    Serial.printf("Command queued: %c%d\n", command.type, command.value);
+    pServer->updateConnParams(peer, CONN_IDLE_MIN_INTERVAL, CONN_IDLE_MAX_INTERVAL,
+                              CONN_IDLE_LATENCY, CONN_IDLE_TIMEOUT);
   }
 }
 
-bool BLECommunication::hasCommand() {
-  return uxQueueMessagesWaiting(commandQueue) > 0;
+void BLECommunication::requestConnProfile(ConnMode profile) {
+  // The central has the final say; the result arrives in onConnParamsUpdated
+  connProfile = profile;
+  requestConnParams(peerAddress, profile);
+  Serial.printf("Requested %s connection profile\n", connModeName(profile));
 }
 
-Command BLECommunication::getNextCommand() {
-  Command command = {'S', 0}; // Default
-  
-  if (xQueueReceive(commandQueue, &command, 0) == pdTRUE) {
-    return command;
+uint8_t BLECommunication::noteActivity() {
+  ConnMode arrivedOn = connProfile;
+  lastCommandTime = millis();
+  // Wake the link before the robot starts moving
+  if (connMode == CONN_AUTO && arrivedOn == CONN_IDLE) {
+    requestConnProfile(CONN_FAST);
+    taskEvents.signal(EVENT_CONNECTION);    // re-arm the idle timer
   }
-  
-  return command;
+  return arrivedOn;
 }
 
-void BLECommunication::addCommand(const Command& cmd) {
-  if (xQueueSend(commandQueue, &cmd, 0) != pdTRUE) {
-    Serial.println("Failed to add command to queue");
-  }
+void BLECommunication::onConnParamsUpdated(const esp_bd_addr_t address, uint16_t interval,
+                                           uint16_t latency, uint16_t timeout) {
+  // Only the controller's link is tracked; observers stay on the idle profile
+  if (controllerConn < 0 || memcmp(address, peerAddress, sizeof(peerAddress)) != 0) return;
+
+  connInterval = interval;
+  connLatency = latency;
+  connTimeout = timeout;
+  printConnParams();
+  sendConnParams();
+}
+
+void BLECommunication::sendConnParams() {
+  int32_t controller = controllerConn;
+  if (controller < 0) return;
+
+  StaticJsonDocument<160> doc;
+  doc["status"] = "conn";
+  doc["mode"] = connModeName(connMode);
+  doc["profile"] = connModeName(connProfile);
+  doc["interval"] = connInterval * 1.25f;     // ms
+  doc["latency"] = connLatency;               // connection events
+  doc["timeout"] = connTimeout * 10;          // ms
+
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+
+  fanout.send(NOTIFY_SENSOR, (const uint8_t*)output, length, controller);
 }
 
-void BLECommunication::broadcastSensorData(const String& jsonData) {
-  if (deviceConnected && pSensorChar) {
-    pSensorChar->setValue(jsonData.c_str());
-    pSensorChar->notify();
+void BLECommunication::printConnParams() {
+  Serial.printf("Connection: %s mode, %s profile, interval %.2f ms, latency %u, timeout %u ms\n",
+                connModeName(connMode), connModeName(connProfile), connInterval * 1.25f,
+                connLatency, connTimeout * 10);
+  for (int p = CONN_FAST; p <= CONN_IDLE; p++) {
+    if (latencyCount[p] > 0) {
+      Serial.printf("  %s: %lu commands, receipt to start avg %lu ms, max %lu ms\n",
+                    connModeName((ConnMode)p), (unsigned long)latencyCount[p],
+                    (unsigned long)(latencySum[p] / latencyCount[p]), (unsigned long)latencyMax[p]);
+    }
   }
 }
 
-void BLECommunication::sendTelemetry(const SensorData& data) {
-  if (!deviceConnected) return;
-  
-  StaticJsonDocument<200> doc;
-  doc["distance"] = data.distance;
-  doc["battery"] = data.batteryLevel;
-  doc["temperature"] = data.temperature;
-  doc["heading"] = data.heading;
-  doc["timestamp"] = data.timestamp;
-  
-  String output;
-  serializeJson(doc, output);
-  
-  broadcastSensorData(output);
+void BLECommunication::commandStarted(const Command& command) {
+  // Binned by the profile the command came in on: in auto mode the link
+  // is already switching to fast by now
+  uint32_t latency = millis() - command.receivedAt;
+  int p = command.profile == CONN_IDLE ? CONN_IDLE : CONN_FAST;
+  latencyCount[p]++;
+  latencySum[p] += latency;
+  if (latency > latencyMax[p]) latencyMax[p] = latency;
 }
 
-void BLECommunication::sendStatus(const String& status) {
-  if (!deviceConnected) return;
-  
-  StaticJsonDocument<100> doc;
-  doc["status"] = status;
-  doc["timestamp"] = millis();
-  
-  String output;
-  serializeJson(doc, output);
-  
-  broadcastSensorData(output);
+void BLECommunication::writeLog(const uint8_t* data, size_t length) {
+  // One record per notification. A half record can't be decoded, so at
+  // the default MTU the longer ones are skipped; clients that stream logs
+  // should negotiate a larger MTU first.
+  if (length > getMaxPayload()) return;
+  fanout.send(NOTIFY_LOG, data, length, BLE_ALL_CLIENTS);
 }
 
-void BLECommunication::clearCommandQueue() {
-  xQueueReset(commandQueue);
-  Serial.println("Command queue cleared");
+void BLECommunication::writeOtaReply(const uint8_t* data, size_t length) {
+  int32_t controller = controllerConn;
+  if (controller < 0) return;
+  fanout.send(NOTIFY_OTA, data, length, controller);
 }
 
-int BLECommunication::getQueueSize() {
-  return uxQueueMessagesWaiting(commandQueue);
+void BLECommunication::disconnect() {
+  NotifyFanout::Client client;
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (fanout.getClient(i, client)) {
+      pServer->disconnect(client.connId);
+    }
+  }
+  Serial.println("BLE disconnected");
 }
 
 void BLECommunication::printConnectionStatus() {
-  Serial.printf("BLE Status - Connected: %s, Queue size: %d\n", 
-                deviceConnected ? "YES" : "NO", 
-                getQueueSize());
+  Serial.printf("BLE Status - Clients: %d of %d, advertising: %s\n",
+                (int)clientCount, BLE_MAX_CLIENTS, advertising ? "YES" : "NO");
+
+  NotifyFanout::Client client;
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (!fanout.getClient(i, client)) continue;
+    Serial.printf("  #%u %s, MTU %u, sent %lu, dropped %lu, queued %u%s\n",
+                  client.connId, roleName(client.role), client.mtu,
+                  (unsigned long)client.sent, (unsigned long)client.dropped,
+                  client.queueCount, client.congested ? ", congested" : "");
+  }
+  if (controllerConn >= 0) {
+    printConnParams();
+  }
 }
 
-String BLECommunication::getDeviceAddress() {
-  return BLEDevice::getAddress().toString().c_str();
+const char* BLECommunication::getDeviceAddress() {
+  // Formatted here rather than through BLEAddress::toString(), which
+  // allocates
+  const uint8_t* address = esp_bt_dev_get_address();
+  if (address != nullptr) {
+    snprintf(deviceAddress, sizeof(deviceAddress), "%02x:%02x:%02x:%02x:%02x:%02x",
+             address[0], address[1], address[2], address[3], address[4], address[5]);
+  }
+  return deviceAddress;
 }
 
 // Callback implementations
-void MyServerCallbacks::onConnect(BLEServer* pServer) {
-  bleComm->deviceConnected = true;
-  Serial.println("Client connected");
+void MyServerCallbacks::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+  bleComm->clientConnected(param->connect.conn_id, param->connect.remote_bda);
 }
 
-void MyServerCallbacks::onDisconnect(BLEServer* pServer) {
-  bleComm->deviceConnected = false;
-  Serial.println("Client disconnected");
+void MyServerCallbacks::onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+  bleComm->clientDisconnected(param->disconnect.conn_id);
 }
 
-void CommandCharCallbacks::onWrite(BLECharacteristic* pCharacteristic) {
-  String value = pCharacteristic->getValue().c_str();
-  
-  if (value.length() > 0) {
-    Serial.printf("Received command: %s\n", value.c_str());
-    bleComm->processCommand(value);
+void MyServerCallbacks::onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+  bleComm->fanout.setMtu(param->mtu.conn_id, param->mtu.mtu);
+  LOG_INFO("Client %u MTU negotiated: %u", param->mtu.conn_id, param->mtu.mtu);
+}
+
+void CommandCharCallbacks::onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) {
+  // The library has already copied the write into the characteristic's
+  // std::string (a heap allocation above 15 bytes, counted by HEAP_GUARD);
+  // from here on nothing is copied to the heap
+  const uint8_t* data = pCharacteristic->getData();
+  size_t length = pCharacteristic->getLength();
+  uint16_t connId = param->write.conn_id;
+  if (length == 0) {
+    return;
+  }
+
+  // Binary frames are decoded straight from the characteristic buffer
+  if (data[0] == PROTOCOL_MAGIC) {
+    if (!bleComm->isController(connId)) {
+      bleComm->rejectWrite(connId, data, length);
+      return;
+    }
+    linkManager.receiveFrame(bleComm, data, length);
+    return;
+  }
+
+  // Text commands (legacy protocol), copied into a fixed buffer so the
+  // command path never touches the heap. Writes arrive one at a time on
+  // the BLE thread, so a single buffer is enough.
+  if (length > COMMAND_MAX_LENGTH) {
+    Serial.printf("Command too long (%u bytes), ignored\n", (unsigned)length);
+    return;
   }
-}
\ No newline at end of file
+  memcpy(bleComm->textCommand, data, length);
+  while (length > 0 && isspace((unsigned char)bleComm->textCommand[length - 1])) {
+    length--;
+  }
+  bleComm->textCommand[length] = '\0';
+
+  // Role requests come from any client; everything else only counts from
+  // the controller
+  if (bleComm->handleRoleCommand(connId, bleComm->textCommand)) {
+    return;
+  }
+  if (!bleComm->isController(connId)) {
+    bleComm->rejectWrite(connId, data, length);
+    return;
+  }
+  linkManager.receiveText(bleComm, bleComm->textCommand);
+}
+
+void OtaCharCallbacks::onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) {
+  // Only the controller may replace the firmware
+  if (!bleManager.isController(param->write.conn_id)) return;
+  otaUpdater.receive(pCharacteristic->getData(), pCharacteristic->getLength());
+}
@@ -4,36 +4,89 @@
 #include <Arduino.h>
 #include "types.h"
 #include "config.h"
+#include "transport.h"
+#include "ble_fanout.h"
 #include <BLEDevice.h>
 #include <BLEUtils.h>
 #include <BLEServer.h>
 #include <BLE2902.h>
-#include <freertos/queue.h>
+
+// Connection parameter profiles. AUTO drives with FAST and drops to IDLE
+// after CONN_IDLE_AFTER_MS without commands.
+enum ConnMode {
+  CONN_FAST,
+  CONN_IDLE,
+  CONN_AUTO
+};
+
+#define CONN_CHECK_NEVER    0xFFFFFFFFUL  // handleConnection(): nothing timed pending
 
 // Forward declarations for callback classes
 class MyServerCallbacks;
 class CommandCharCallbacks;
+class OtaCharCallbacks;
 
-class BLECommunication {
+// The BLE transport: commands arrive on the command characteristic,
+// telemetry goes out on the sensor characteristic and acks on the status
+// characteristic. Parsing and queueing live in linkManager.
+//
+// Up to BLE_MAX_CLIENTS centrals can be connected. One of them is the
+// controller: its commands are executed and its acks come back to it.
+// The others are observers that get telemetry and logs but whose commands
+// are rejected. The first client to connect takes control; "ROLE:CONTROL"
+// takes a free seat and "ROLE:OBSERVE" gives it up.
+class BLECommunication : public Transport {
 private:
   BLEServer* pServer;
   BLECharacteristic* pCommandChar;
   BLECharacteristic* pSensorChar;
+  BLECharacteristic* pStatusChar;
+  BLECharacteristic* pLogChar;          // binary log records, after LOG_ON
+  BLECharacteristic* pOtaChar;          // firmware update, see ota_update.h
   BLEService* pService;
+
+  // Per-client queues and subscriptions; every notification goes through it
+  NotifyFanout fanout;
+  volatile int32_t controllerConn;      // connection id, -1 = seat free
+  volatile int clientCount;
+  volatile bool advertising;
+
+  // Connection parameters of the controller: the mode it asked for, the
+  // profile last requested from the central and what the link runs at.
+  // Observers are always asked for the idle profile.
+  esp_bd_addr_t peerAddress;
+  volatile ConnMode connMode;
+  volatile ConnMode connProfile;        // CONN_FAST or CONN_IDLE
+  volatile uint16_t connInterval;       // 1.25 ms units, 0 until reported
+  volatile uint16_t connLatency;
+  volatile uint16_t connTimeout;        // 10 ms units
+  volatile unsigned long lastCommandTime;
+
+  // Receipt-to-start latency per profile (motor task only)
+  uint32_t latencyCount[2];
+  uint32_t latencySum[2];
+  uint32_t latencyMax[2];
+
+  // Text commands are copied here and handed to the link manager, which
+  // trims and parses them in place (BLE thread only)
+  char textCommand[COMMAND_MAX_LENGTH + 1];
   
-  bool deviceConnected;
-  bool oldDeviceConnected;
-  
-  // Command processing
-  QueueHandle_t commandQueue;
-  
+  char deviceAddress[18];               // "aa:bb:cc:dd:ee:ff"
+
   // Callback instances
   MyServerCallbacks* serverCallbacks;
   CommandCharCallbacks* commandCallbacks;
+  OtaCharCallbacks* otaCallbacks;
   
   // Helper functions
-  Command parseCommand(const String& cmd);
-  void processCommand(const String& cmd);
+  void requestConnProfile(ConnMode profile);
+  void requestConnParams(const esp_bd_addr_t address, ConnMode profile);
+  void clientConnected(uint16_t connId, const esp_bd_addr_t address);
+  void clientDisconnected(uint16_t connId);
+  void setController(int32_t connId);
+  void sendRole(uint16_t connId);
+  bool handleRoleCommand(uint16_t connId, const char* cmd);
+  void rejectWrite(uint16_t connId, const uint8_t* data, size_t length);
 
 public:
   BLECommunication();
@@ -45,27 +98,45 @@ public:
   void startAdvertising();
   
   // Connection management
-  bool isConnected() const;
-  void handleConnection();
+  bool isConnected() const override;
+  // Restarts advertising and relaxes an idle link; returns how many ms it
+  // can wait before it needs calling again (or until EVENT_CONNECTION)
+  unsigned long handleConnection();
   void disconnect();
-  
-  // Command handling
-  bool hasCommand();
-  Command getNextCommand();
-  void addCommand(const Command& cmd);
-  
-  // Data transmission
-  void broadcastSensorData(const String& jsonData);
-  void sendTelemetry(const SensorData& data);
-  void sendStatus(const String& status);
-  
-  // Queue management
-  void clearCommandQueue();
-  int getQueueSize();
+
+  // Transport
+  const char* getName() const override;
+  size_t getMaxPayload() const override;
+  void writeTelemetry(const uint8_t* data, size_t length) override;
+  void writeAck(const uint8_t* data, size_t length) override;
+  uint16_t getRequester() const override;
+  bool writeReply(uint16_t requester, const uint8_t* data, size_t length) override;
+  bool handleLinkCommand(const char* cmd) override;
+  bool handleLinkFrame(const Frame& frame, bool& ok) override;
+  uint8_t noteActivity() override;
+  void commandStarted(const Command& command) override;
+
+  // Log streaming (drain task)
+  void writeLog(const uint8_t* data, size_t length);
+
+  // Firmware update replies (OTA task)
+  void writeOtaReply(const uint8_t* data, size_t length);
+
+  // Clients
+  bool isController(uint16_t connId) const;
+  void onGattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf,
+                    esp_ble_gatts_cb_param_t* param);
+
+  // Connection parameters
+  void setConnMode(ConnMode mode);
+  void onConnParamsUpdated(const esp_bd_addr_t address, uint16_t interval,
+                           uint16_t latency, uint16_t timeout);
+  void sendConnParams();
+  void printConnParams();
   
   // Utility functions
   void printConnectionStatus();
-  String getDeviceAddress();
+  const char* getDeviceAddress();
   
   // Friend classes for callbacks
   friend class MyServerCallbacks;
@@ -80,8 +151,9 @@ private:
 public:
   MyServerCallbacks(BLECommunication* comm) : bleComm(comm) {}
   
-  void onConnect(BLEServer* pServer) override;
-  void onDisconnect(BLEServer* pServer) override;
+  void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
+  void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
+  void onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
 };
 
 class CommandCharCallbacks : public BLECharacteristicCallbacks {
@@ -91,10 +163,15 @@ private:
 public:
   CommandCharCallbacks(BLECommunication* comm) : bleComm(comm) {}
   
-  void onWrite(BLECharacteristic* pCharacteristic) override;
+  void onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) override;
+};
+
+class OtaCharCallbacks : public BLECharacteristicCallbacks {
+public:
+  void onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) override;
 };
 
 // Global BLE communication instance
 extern BLECommunication bleManager;
 
-#endif // BLE_COMMUNICATION_H
\ No newline at end of file
+#endif // BLE_COMMUNICATION_H
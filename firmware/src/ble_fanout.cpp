@@ -0,0 +1,279 @@
+#include "ble_fanout.h"
+#include "trace.h"
+#include <Arduino.h>
+#include <string.h>
+
+static_assert(BLE_OBSERVER_QUEUE <= BLE_CONTROLLER_QUEUE, "observer queue must fit the client queue");
+static_assert(BLE_NOTIFY_POOL < 256, "pool slots are indexed by uint8_t");
+
+NotifyFanout::NotifyFanout()
+  : gattsIf(0),
+    mutex(nullptr) {
+  memset(clients, 0, sizeof(clients));
+  memset(pool, 0, sizeof(pool));
+  memset(valueHandle, 0, sizeof(valueHandle));
+  memset(cccdHandle, 0, sizeof(cccdHandle));
+}
+
+bool NotifyFanout::begin() {
+  // Telemetry (sensor task), acks (motor task), logs, OTA replies and the
+  // BLE thread's connection events all go through the client queues
+  mutex = mutexStorage.create();
+  if (mutex == nullptr) {
+    Serial.println("Failed to create notification mutex");
+    return false;
+  }
+  return true;
+}
+
+void NotifyFanout::setChannel(NotifyChannel channel, uint16_t valueHandleId, uint16_t cccdHandleId) {
+  valueHandle[channel] = valueHandleId;
+  cccdHandle[channel] = cccdHandleId;
+}
+
+void NotifyFanout::setGattsIf(esp_gatt_if_t gattsInterface) {
+  gattsIf = gattsInterface;
+}
+
+NotifyFanout::Client* NotifyFanout::find(uint16_t connId) {
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (clients[i].used && clients[i].connId == connId) {
+      return &clients[i];
+    }
+  }
+  return nullptr;
+}
+
+int NotifyFanout::queueDepth(const Client& client) {
+  return client.role == ROLE_CONTROLLER ? BLE_CONTROLLER_QUEUE : BLE_OBSERVER_QUEUE;
+}
+
+int NotifyFanout::allocateSlot() {
+  for (int i = 0; i < BLE_NOTIFY_POOL; i++) {
+    if (pool[i].refs == 0) return i;
+  }
+  return -1;
+}
+
+void NotifyFanout::release(uint8_t slot) {
+  if (pool[slot].refs > 0) pool[slot].refs--;
+}
+
+void NotifyFanout::enqueue(Client& client, uint8_t slot) {
+  if (client.queueCount >= queueDepth(client)) {
+    // Full: give up the oldest telemetry if there is any, else the oldest
+    // message of any kind
+    int victim = 0;
+    for (int i = 0; i < client.queueCount; i++) {
+      uint8_t queued = client.queue[(client.queueHead + i) % BLE_CONTROLLER_QUEUE];
+      if (pool[queued].channel == NOTIFY_SENSOR) {
+        victim = i;
+        break;
+      }
+    }
+    release(client.queue[(client.queueHead + victim) % BLE_CONTROLLER_QUEUE]);
+    for (int i = victim; i > 0; i--) {
+      client.queue[(client.queueHead + i) % BLE_CONTROLLER_QUEUE] =
+        client.queue[(client.queueHead + i - 1) % BLE_CONTROLLER_QUEUE];
+    }
+    client.queueHead = (client.queueHead + 1) % BLE_CONTROLLER_QUEUE;
+    client.queueCount--;
+    client.dropped++;
+  }
+
+  client.queue[(client.queueHead + client.queueCount) % BLE_CONTROLLER_QUEUE] = slot;
+  client.queueCount++;
+  pool[slot].refs++;
+}
+
+void NotifyFanout::flush(Client& client) {
+  while (client.queueCount > 0 && !client.congested) {
+    uint8_t slot = client.queue[client.queueHead];
+    size_t length = pool[slot].length;
+    if (length > (size_t)(client.mtu - 3)) length = client.mtu - 3;
+
+    // The stack copies the value, so the slot can go as soon as it's sent
+    esp_err_t err = esp_ble_gatts_send_indicate(gattsIf, client.connId,
+                                                valueHandle[pool[slot].channel],
+                                                length, pool[slot].data, false);
+    if (err != ESP_OK) {
+      break;                // out of stack buffers; retried on the next send
+    }
+    client.sent++;
+    client.queueHead = (client.queueHead + 1) % BLE_CONTROLLER_QUEUE;
+    client.queueCount--;
+    release(slot);
+  }
+}
+
+bool NotifyFanout::addClient(uint16_t connId, const esp_bd_addr_t address, BleRole role) {
+  if (mutex == nullptr) return false;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  Client* client = nullptr;
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (!clients[i].used) {
+      client = &clients[i];
+      break;
+    }
+  }
+  if (client != nullptr) {
+    memset(client, 0, sizeof(*client));
+    client->used = true;
+    client->connId = connId;
+    memcpy(client->address, address, sizeof(client->address));
+    client->role = role;
+    client->mtu = BLE_DEFAULT_MTU;
+  }
+  xSemaphoreGive(mutex);
+  return client != nullptr;
+}
+
+void NotifyFanout::removeClient(uint16_t connId) {
+  if (mutex == nullptr) return;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  Client* client = find(connId);
+  if (client != nullptr) {
+    while (client->queueCount > 0) {
+      release(client->queue[client->queueHead]);
+      client->queueHead = (client->queueHead + 1) % BLE_CONTROLLER_QUEUE;
+      client->queueCount--;
+    }
+    client->used = false;
+  }
+  xSemaphoreGive(mutex);
+}
+
+void NotifyFanout::setMtu(uint16_t connId, uint16_t mtu) {
+  if (mutex == nullptr) return;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  Client* client = find(connId);
+  if (client != nullptr) client->mtu = mtu;
+  xSemaphoreGive(mutex);
+}
+
+void NotifyFanout::setRole(uint16_t connId, BleRole role) {
+  if (mutex == nullptr) return;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  Client* client = find(connId);
+  if (client != nullptr) {
+    client->role = role;
+    // A demoted controller may be holding more than an observer's share
+    while (client->queueCount > queueDepth(*client)) {
+      release(client->queue[client->queueHead]);
+      client->queueHead = (client->queueHead + 1) % BLE_CONTROLLER_QUEUE;
+      client->queueCount--;
+      client->dropped++;
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+int NotifyFanout::onWrite(uint16_t connId, uint16_t handle, const uint8_t* value, size_t length) {
+  if (mutex == nullptr || length == 0) return -1;
+
+  // Subscriptions are per client; the shared BLE2902 value isn't
+  for (int ch = 0; ch < NOTIFY_CHANNEL_COUNT; ch++) {
+    if (cccdHandle[ch] == 0 || handle != cccdHandle[ch]) continue;
+
+    bool subscribed = false;
+    traceTake(mutex, TRACE_MUTEX_NOTIFY);
+    Client* client = find(connId);
+    if (client != nullptr) {
+      subscribed = value[0] & 0x01;
+      if (subscribed) {
+        client->subscribed |= 1 << ch;
+      } else {
+        client->subscribed &= ~(1 << ch);
+      }
+    }
+    xSemaphoreGive(mutex);
+    return subscribed ? ch : -1;
+  }
+  return -1;
+}
+
+void NotifyFanout::onCongest(uint16_t connId, bool congested) {
+  if (mutex == nullptr) return;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  Client* client = find(connId);
+  if (client != nullptr) {
+    client->congested = congested;
+    if (!congested) flush(*client);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void NotifyFanout::send(NotifyChannel channel, const uint8_t* data, size_t length, uint16_t target) {
+  if (mutex == nullptr || length == 0) return;
+  if (length > TELEMETRY_MAX_FRAME) length = TELEMETRY_MAX_FRAME;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  int slot = allocateSlot();
+  if (slot >= 0) {
+    pool[slot].channel = channel;
+    pool[slot].length = length;
+    memcpy(pool[slot].data, data, length);
+
+    for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+      Client& client = clients[i];
+      if (!client.used || !(client.subscribed & (1 << channel))) continue;
+      if (target != BLE_ALL_CLIENTS && client.connId != target) continue;
+      enqueue(client, slot);
+      flush(client);
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+int NotifyFanout::getClientCount() const {
+  if (mutex == nullptr) return 0;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  int count = 0;
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (clients[i].used) count++;
+  }
+  xSemaphoreGive(mutex);
+  return count;
+}
+
+size_t NotifyFanout::getMinPayload() const {
+  size_t payload = TELEMETRY_MAX_FRAME;
+  bool any = false;
+  if (mutex == nullptr) return BLE_DEFAULT_MTU - 3;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  for (int i = 0; i < BLE_MAX_CLIENTS; i++) {
+    if (clients[i].used && (size_t)(clients[i].mtu - 3) < payload) {
+      payload = clients[i].mtu - 3;
+    }
+    any = any || clients[i].used;
+  }
+  xSemaphoreGive(mutex);
+  return any ? payload : BLE_DEFAULT_MTU - 3;
+}
+
+bool NotifyFanout::getClient(int index, Client& out) {
+  if (mutex == nullptr || index < 0 || index >= BLE_MAX_CLIENTS) return false;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  bool used = clients[index].used;
+  if (used) out = clients[index];
+  xSemaphoreGive(mutex);
+  return used;
+}
+
+bool NotifyFanout::findClient(uint16_t connId, Client& out) {
+  if (mutex == nullptr) return false;
+
+  traceTake(mutex, TRACE_MUTEX_NOTIFY);
+  Client* client = find(connId);
+  if (client != nullptr) out = *client;
+  xSemaphoreGive(mutex);
+  return client != nullptr;
+}
@@ -0,0 +1,104 @@
+#ifndef BLE_FANOUT_H
+#define BLE_FANOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "static_alloc.h"
+#include <esp_gatts_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define BLE_ALL_CLIENTS     0xFFFF  // send target: every subscribed client
+
+enum BleRole : uint8_t {
+  ROLE_CONTROLLER,        // drives the robot; one at a time
+  ROLE_OBSERVER           // receives, but its commands are refused
+};
+
+// Notify characteristics, one bit each in a client's subscriptions
+enum NotifyChannel : uint8_t {
+  NOTIFY_SENSOR,
+  NOTIFY_STATUS,
+  NOTIFY_LOG,
+  NOTIFY_OTA,
+  NOTIFY_CHANNEL_COUNT
+};
+
+// Notifications to several connected centrals. A message is copied once
+// into a shared pool slot and every recipient queues a reference to it,
+// so fanning out costs one copy however many clients there are.
+//
+// Each client has its own bounded queue, drained whenever its link isn't
+// congested. When a queue is full the oldest telemetry in it is dropped
+// first (newer samples supersede it), then the oldest message. A slow
+// observer only ever loses its own messages: queues are independent and
+// the pool holds enough slots for every queue to be full at once.
+class NotifyFanout {
+public:
+  struct Client {
+    bool used;
+    uint16_t connId;
+    esp_bd_addr_t address;
+    BleRole role;
+    uint16_t mtu;
+    uint8_t subscribed;             // bit per NotifyChannel
+    bool congested;
+    uint8_t queue[BLE_CONTROLLER_QUEUE];  // pool slot indices, oldest first
+    uint8_t queueHead;
+    uint8_t queueCount;
+    uint32_t sent;
+    uint32_t dropped;
+  };
+
+private:
+  struct Slot {
+    uint8_t refs;                   // queue entries pointing here; 0 = free
+    uint8_t channel;
+    uint16_t length;
+    uint8_t data[TELEMETRY_MAX_FRAME];
+  };
+
+  Client clients[BLE_MAX_CLIENTS];
+  Slot pool[BLE_NOTIFY_POOL];
+  uint16_t valueHandle[NOTIFY_CHANNEL_COUNT];
+  uint16_t cccdHandle[NOTIFY_CHANNEL_COUNT];
+  esp_gatt_if_t gattsIf;
+  SemaphoreHandle_t mutex;
+  MutexStorage mutexStorage;
+
+  Client* find(uint16_t connId);
+  int allocateSlot();
+  void release(uint8_t slot);
+  void enqueue(Client& client, uint8_t slot);
+  void flush(Client& client);
+  static int queueDepth(const Client& client);
+
+public:
+  NotifyFanout();
+
+  bool begin();
+  void setChannel(NotifyChannel channel, uint16_t valueHandleId, uint16_t cccdHandleId);
+  void setGattsIf(esp_gatt_if_t gattsInterface);
+
+  // Connection events (BLE thread)
+  bool addClient(uint16_t connId, const esp_bd_addr_t address, BleRole role);
+  void removeClient(uint16_t connId);
+  void setMtu(uint16_t connId, uint16_t mtu);
+  void setRole(uint16_t connId, BleRole role);
+
+  // A descriptor write; returns the channel a client just subscribed to,
+  // or -1
+  int onWrite(uint16_t connId, uint16_t handle, const uint8_t* value, size_t length);
+  void onCongest(uint16_t connId, bool congested);
+
+  // Queue a notification for one client or BLE_ALL_CLIENTS (any task)
+  void send(NotifyChannel channel, const uint8_t* data, size_t length, uint16_t target);
+
+  int getClientCount() const;
+  size_t getMinPayload() const;     // smallest MTU - 3 among clients
+  bool getClient(int index, Client& out);   // snapshot for status output
+  bool findClient(uint16_t connId, Client& out);
+};
+
+#endif // BLE_FANOUT_H
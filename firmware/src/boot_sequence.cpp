@@ -0,0 +1,141 @@
+#include "boot_sequence.h"
+#include "sensor_manager.h"
+#include "logger.h"
+#include <Arduino.h>
+#include <string.h>
+
+// Global instance
+BootSequence bootSequence;
+
+static const char* const PHASE_NAMES[BOOT_PHASE_COUNT] = {
+  "console", "links", "navigation", "ble", "serial", "tasks", "motors", "sensors", "selftest"
+};
+
+BootSequence::BootSequence()
+  : doneMask(0),
+    setupUs(0),
+    readyUs(0),
+    selfTestFailures(0),
+    group(nullptr) {
+  memset(phases, 0, sizeof(phases));
+  lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool BootSequence::begin() {
+  setupUs = micros();
+  start(BOOT_PHASE_CONSOLE);
+
+  // Without it waitFor() polls
+  group = groupStorage.create();
+  return group != nullptr;
+}
+
+void BootSequence::start(BootPhase phase) {
+  phases[phase].core = xPortGetCoreID();
+  phases[phase].startUs = micros();
+}
+
+bool BootSequence::finish(BootPhase phase) {
+  uint32_t now = micros();
+  phases[phase].endUs = now;
+
+  portENTER_CRITICAL(&lock);
+  uint32_t before = doneMask;
+  doneMask = before | (1u << phase);
+  bool ready = (before & BOOT_READY_PHASES) != BOOT_READY_PHASES &&
+               (doneMask & BOOT_READY_PHASES) == BOOT_READY_PHASES;
+  if (ready) readyUs = now;
+  bool complete = before != BOOT_ALL_PHASES && doneMask == BOOT_ALL_PHASES;
+  portEXIT_CRITICAL(&lock);
+
+  if (group != nullptr) {
+    xEventGroupSetBits(group, 1u << phase);
+  }
+  if (phase == BOOT_PHASE_BLE) {
+    LOG_INFO("Advertising %lu ms after start", (unsigned long)(now / 1000));
+  }
+  if (ready) {
+    LOG_INFO("Ready for commands %lu ms after start", (unsigned long)(now / 1000));
+  }
+  return complete;
+}
+
+void BootSequence::waitFor(BootPhase phase) {
+  while (!isDone(phase)) {
+    if (group != nullptr) {
+      xEventGroupWaitBits(group, 1u << phase, pdFALSE, pdTRUE, portMAX_DELAY);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+  }
+}
+
+bool BootSequence::isDone(BootPhase phase) const {
+  return doneMask & (1u << phase);
+}
+
+bool BootSequence::isReady() const {
+  return (doneMask & BOOT_READY_PHASES) == BOOT_READY_PHASES;
+}
+
+bool BootSequence::isComplete() const {
+  return doneMask == BOOT_ALL_PHASES;
+}
+
+uint32_t BootSequence::getSetupUs() const {
+  return setupUs;
+}
+
+uint32_t BootSequence::getAdvertisingUs() const {
+  return isDone(BOOT_PHASE_BLE) ? phases[BOOT_PHASE_BLE].endUs : 0;
+}
+
+uint32_t BootSequence::getReadyUs() const {
+  return readyUs;
+}
+
+uint32_t BootSequence::getCompleteUs() const {
+  return isComplete() ? phases[BOOT_PHASE_SELF_TEST].endUs : 0;
+}
+
+void BootSequence::setSelfTestResult(uint8_t failures) {
+  selfTestFailures = failures;
+}
+
+uint8_t BootSequence::getSelfTestFailures() const {
+  return selfTestFailures;
+}
+
+bool BootSequence::getPhase(int index, PhaseReport& out) const {
+  if (index < 0 || index >= BOOT_PHASE_COUNT) return false;
+  const Phase& phase = phases[index];
+  out.name = PHASE_NAMES[index];
+  out.startUs = phase.startUs;
+  out.done = isDone((BootPhase)index);
+  out.durationUs = out.done ? phase.endUs - phase.startUs
+                 : phase.startUs != 0 ? micros() - phase.startUs
+                 : 0;
+  out.core = phase.core;
+  return true;
+}
+
+void BootSequence::printReport() const {
+  Serial.printf("Boot: setup at %.1f ms, advertising at %.1f ms, ready at %.1f ms\n",
+                setupUs / 1000.0, getAdvertisingUs() / 1000.0, readyUs / 1000.0);
+  PhaseReport report;
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+    getPhase(i, report);
+    Serial.printf("  %-10s core %u  %8.1f ms  +%8.1f ms%s\n", report.name, report.core,
+                  report.startUs / 1000.0, report.durationUs / 1000.0,
+                  report.done ? "" : report.startUs != 0 ? "  (running)" : "  (not started)");
+  }
+  if (!isDone(BOOT_PHASE_SELF_TEST)) {
+    Serial.println("  Self-test pending");
+  } else if (selfTestFailures == 0) {
+    Serial.println("  Self-test PASSED");
+  } else {
+    Serial.printf("  Self-test FAILED:%s%s\n",
+                  (selfTestFailures & SELF_TEST_ULTRASONIC) ? " ultrasonic" : "",
+                  (selfTestFailures & SELF_TEST_IMU) ? " imu" : "");
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "static_alloc.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// What the robot does between reset and ready, in the order started
+enum BootPhase {
+  BOOT_PHASE_CONSOLE,       // setup(): serial console, log drain, task events
+  BOOT_PHASE_LINKS,         // setup(): parameters, command queues, the OTA window
+  BOOT_PHASE_NAVIGATION,    // setup(): navigation and localization state
+  BOOT_PHASE_BLE,           // setup(): BLE stack, GATT service; ends advertising
+  BOOT_PHASE_SERIAL,        // setup(): the serial transport
+  BOOT_PHASE_TASKS,         // setup(): robot tasks created and registered
+  BOOT_PHASE_MOTORS,        // motor task: drivers, power management
+  BOOT_PHASE_SENSORS,       // sensor task: pins, I2C, IMU (and a first calibration)
+  BOOT_PHASE_SELF_TEST,     // sensor task, once ready: testAllSensors()
+  BOOT_PHASE_COUNT
+};
+
+// Every phase but the self-test: commands run from here on
+#define BOOT_READY_PHASES   ((1u << BOOT_PHASE_COUNT) - 1 - (1u << BOOT_PHASE_SELF_TEST))
+#define BOOT_ALL_PHASES     ((1u << BOOT_PHASE_COUNT) - 1)
+
+// Brings the robot up with BLE advertising first and records when each
+// step ran.
+//
+// setup() starts only what the link handlers touch, then BLE, then the
+// tasks; motors and sensors come up inside their own tasks, in parallel
+// with each other and with a client connecting. Commands that arrive
+// meanwhile wait in the command queue: the motor task only starts
+// taking them once the sensors are up (IMU calibration needs the robot
+// still, and turns use the gyro). The sensor self-test runs after that,
+// in the sensor task, so a slow echo doesn't hold anything up.
+//
+// Times are micros() since the application started (the ROM and second
+// stage bootloader before it aren't counted). Each phase is started and
+// finished by one task; the event group lets other tasks wait for it.
+class BootSequence {
+public:
+  struct PhaseReport {
+    const char* name;
+    uint32_t startUs;
+    uint32_t durationUs;
+    uint8_t core;
+    bool done;
+  };
+
+private:
+  struct Phase {
+    uint32_t startUs;
+    uint32_t endUs;
+    uint8_t core;
+  };
+
+  Phase phases[BOOT_PHASE_COUNT];
+  volatile uint32_t doneMask;
+  uint32_t setupUs;
+  volatile uint32_t readyUs;
+  volatile uint8_t selfTestFailures;
+  portMUX_TYPE lock;
+
+  EventGroupHandle_t group;
+  EventGroupStorage groupStorage;
+
+public:
+  BootSequence();
+
+  // First thing in setup(); starts BOOT_PHASE_CONSOLE
+  bool begin();
+
+  void start(BootPhase phase);
+  // Returns true for the call that completes the boot, self-test
+  // included, so exactly one task runs the wrap-up
+  bool finish(BootPhase phase);
+  // Blocks the calling task until phase has finished
+  void waitFor(BootPhase phase);
+
+  bool isDone(BootPhase phase) const;
+  bool isReady() const;
+  bool isComplete() const;
+
+  uint32_t getSetupUs() const;
+  uint32_t getAdvertisingUs() const;  // 0 until advertising
+  uint32_t getReadyUs() const;        // 0 until ready
+  uint32_t getCompleteUs() const;     // 0 until the self-test is done
+
+  void setSelfTestResult(uint8_t failures);
+  uint8_t getSelfTestFailures() const;  // SELF_TEST_* bits
+
+  bool getPhase(int index, PhaseReport& out) const;
+  void printReport() const;
+};
+
+// Global boot sequence instance
+extern BootSequence bootSequence;
+
+#endif // BOOT_SEQUENCE_H
@@ -0,0 +1,250 @@
+#include "bytecode_vm.h"
+#include "protocol.h"
+
+BytecodeVM::BytecodeVM()
+  : codeLength(0),
+    sp(0),
+    pc(0),
+    executed(0),
+    error(nullptr) {
+  reset();
+}
+
+bool BytecodeVM::load(const uint8_t* bytecode, size_t length) {
+  codeLength = 0;
+  error = nullptr;
+
+  // Pass 1: decode every instruction into the cache
+  size_t offset = 0;
+  while (offset < length) {
+    if (codeLength >= PROGRAM_MAX_INSTRUCTIONS) {
+      return reject("too many instructions");
+    }
+
+    Instruction& in = code[codeLength];
+    in.op = bytecode[offset];
+    in.var = 0;
+    in.offset = offset;
+    in.arg = 0;
+
+    size_t operands;
+    switch (in.op) {
+      case VM_PUSH:                         operands = 4; break;
+      case VM_LOAD: case VM_STORE:          operands = 1; break;
+      case VM_CMD:                          operands = 1; break;
+      case VM_JMP:  case VM_JZ:             operands = 2; break;
+      case VM_LOOP:                         operands = 3; break;
+      case VM_HALT: case VM_DUP: case VM_POP:
+      case VM_ADD:  case VM_SUB: case VM_MUL:
+      case VM_LT:   case VM_GT:  case VM_EQ:
+      case VM_DIST: case VM_MOVE: case VM_TURN:
+      case VM_WAIT:                         operands = 0; break;
+      default:
+        return reject("unknown opcode");
+    }
+    if (offset + 1 + operands > length) {
+      return reject("truncated instruction");
+    }
+
+    const uint8_t* p = bytecode + offset + 1;
+    switch (in.op) {
+      case VM_PUSH: in.arg = readI32(p); break;
+      case VM_LOAD:
+      case VM_STORE: in.var = p[0]; break;
+      case VM_CMD:  in.arg = p[0]; break;
+      case VM_JMP:
+      case VM_JZ:   in.arg = readU16(p); break;
+      case VM_LOOP: in.var = p[0]; in.arg = readU16(p + 1); break;
+    }
+    if ((in.op == VM_LOAD || in.op == VM_STORE || in.op == VM_LOOP) &&
+        in.var >= VM_VARIABLES) {
+      return reject("bad variable index");
+    }
+
+    offset += 1 + operands;
+    codeLength++;
+  }
+
+  // Pass 2: turn byte-offset jump targets into instruction indices
+  for (int i = 0; i < codeLength; i++) {
+    Instruction& in = code[i];
+    if (in.op == VM_JMP || in.op == VM_JZ || in.op == VM_LOOP) {
+      int target = resolveTarget(in.arg, length);
+      if (target < 0) {
+        return reject("jump into the middle of an instruction");
+      }
+      in.arg = target;
+    }
+  }
+
+  reset();
+  return true;
+}
+
+int BytecodeVM::resolveTarget(int offset, size_t length) const {
+  if ((size_t)offset == length) return codeLength;  // jump to the end = halt
+
+  int lo = 0, hi = codeLength - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (code[mid].offset == offset) return mid;
+    if (code[mid].offset < offset) lo = mid + 1;
+    else hi = mid - 1;
+  }
+  return -1;
+}
+
+void BytecodeVM::reset() {
+  sp = 0;
+  pc = 0;
+  executed = 0;
+  for (int i = 0; i < VM_VARIABLES; i++) {
+    vars[i] = 0;
+  }
+}
+
+bool BytecodeVM::push(int32_t value) {
+  if (sp >= VM_STACK_DEPTH) return false;
+  stack[sp++] = value;
+  return true;
+}
+
+bool BytecodeVM::pop(int32_t& value) {
+  if (sp <= 0) return false;
+  value = stack[--sp];
+  return true;
+}
+
+bool BytecodeVM::reject(const char* message) {
+  // Nothing of a bad program stays runnable
+  error = message;
+  codeLength = 0;
+  reset();
+  return false;
+}
+
+VMResult BytecodeVM::fault(const char* message) {
+  error = message;
+  pc = codeLength;
+  return VM_FAULT;
+}
+
+VMResult BytecodeVM::run(int budget, int32_t distanceCM, char& actionType, int32_t& actionValue) {
+  int32_t a, b;
+
+  while (budget-- > 0) {
+    if (pc >= codeLength) {
+      return VM_HALTED;
+    }
+
+    const Instruction& in = code[pc++];
+    executed++;
+
+    switch (in.op) {
+      case VM_HALT:
+        pc = codeLength;
+        return VM_HALTED;
+
+      case VM_PUSH:
+        if (!push(in.arg)) return fault("stack overflow");
+        break;
+
+      case VM_LOAD:
+        if (!push(vars[in.var])) return fault("stack overflow");
+        break;
+
+      case VM_STORE:
+        if (!pop(a)) return fault("stack underflow");
+        vars[in.var] = a;
+        break;
+
+      case VM_DUP:
+        if (!pop(a) || !push(a) || !push(a)) return fault("stack error");
+        break;
+
+      case VM_POP:
+        if (!pop(a)) return fault("stack underflow");
+        break;
+
+      case VM_ADD:
+      case VM_SUB:
+      case VM_MUL:
+      case VM_LT:
+      case VM_GT:
+      case VM_EQ:
+        if (!pop(b) || !pop(a)) return fault("stack underflow");
+        switch (in.op) {
+          // Wrap on overflow instead of invoking undefined behaviour
+          case VM_ADD: a = (int32_t)((uint32_t)a + (uint32_t)b); break;
+          case VM_SUB: a = (int32_t)((uint32_t)a - (uint32_t)b); break;
+          case VM_MUL: a = (int32_t)((uint32_t)a * (uint32_t)b); break;
+          case VM_LT:  a = a < b; break;
+          case VM_GT:  a = a > b; break;
+          case VM_EQ:  a = a == b; break;
+        }
+        push(a);
+        break;
+
+      case VM_JMP:
+        pc = in.arg;
+        break;
+
+      case VM_JZ:
+        if (!pop(a)) return fault("stack underflow");
+        if (a == 0) pc = in.arg;
+        break;
+
+      case VM_LOOP:
+        // A counter already below 1 ends the loop at 0 rather than counting
+        // on down (and overflowing at INT32_MIN)
+        if (vars[in.var] > 1) {
+          vars[in.var]--;
+          pc = in.arg;
+        } else {
+          vars[in.var] = 0;
+        }
+        break;
+
+      case VM_DIST:
+        if (!push(distanceCM)) return fault("stack overflow");
+        break;
+
+      case VM_MOVE:
+      case VM_TURN:
+        if (!pop(a)) return fault("stack underflow");
+        if (in.op == VM_MOVE) actionType = a < 0 ? 'B' : 'F';
+        else actionType = a < 0 ? 'L' : 'R';
+        actionValue = a < 0 ? (int32_t)(0u - (uint32_t)a) : a;
+        return VM_COMMAND;
+
+      case VM_WAIT:
+        if (!pop(a)) return fault("stack underflow");
+        actionValue = a;
+        return VM_SLEEP;
+
+      case VM_CMD:
+        if (!pop(a)) return fault("stack underflow");
+        actionType = (char)in.arg;
+        actionValue = a;
+        return VM_COMMAND;
+    }
+  }
+
+  return VM_YIELD;
+}
+
+int BytecodeVM::getInstructionCount() const {
+  return codeLength;
+}
+
+int BytecodeVM::getProgramCounter() const {
+  return pc;
+}
+
+uint32_t BytecodeVM::getExecutedCount() const {
+  return executed;
+}
+
+const char* BytecodeVM::getError() const {
+  return error;
+}
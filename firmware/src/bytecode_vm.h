@@ -0,0 +1,90 @@
+#ifndef BYTECODE_VM_H
+#define BYTECODE_VM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Stack machine for block-editor programs. Values are int32; operands are
+// little-endian and jump targets are byte offsets into the program. Like
+// protocol.*, this file has no Arduino dependencies so it can run on a host.
+enum VMOpcode {
+  VM_HALT   = 0x00,   //                          stop the program
+  VM_PUSH   = 0x01,   // i32 value                push value
+  VM_LOAD   = 0x02,   // u8 var                   push variable
+  VM_STORE  = 0x03,   // u8 var                   pop into variable
+  VM_DUP    = 0x04,   //                          duplicate top
+  VM_POP    = 0x05,   //                          drop top
+  VM_ADD    = 0x06,   //                          a b -> a+b
+  VM_SUB    = 0x07,   //                          a b -> a-b
+  VM_MUL    = 0x08,   //                          a b -> a*b
+  VM_LT     = 0x09,   //                          a b -> a<b
+  VM_GT     = 0x0A,   //                          a b -> a>b
+  VM_EQ     = 0x0B,   //                          a b -> a==b
+  VM_JMP    = 0x0C,   // u16 target
+  VM_JZ     = 0x0D,   // u16 target               pop, jump if zero
+  VM_LOOP   = 0x0E,   // u8 var, u16 target       var -= 1, jump if var > 0 (never below 0)
+  VM_DIST   = 0x0F,   //                          push front distance (cm)
+  VM_MOVE   = 0x10,   //                          pop cm, negative = backward
+  VM_TURN   = 0x11,   //                          pop degrees, negative = left
+  VM_WAIT   = 0x12,   //                          pop milliseconds
+  VM_CMD    = 0x13    // u8 type                  pop value, run Command{type, value}
+};
+
+// Why run() returned
+enum VMResult {
+  VM_YIELD,           // step budget used up; call again
+  VM_COMMAND,         // actionType/actionValue hold a command to execute
+  VM_SLEEP,           // actionValue holds a wait in milliseconds
+  VM_HALTED,          // program finished
+  VM_FAULT            // runtime error, see getError()
+};
+
+class BytecodeVM {
+private:
+  // Decoded program: one fixed-width entry per instruction, with jump
+  // targets already resolved to instruction indices, so the interpreter
+  // never re-parses or bounds-checks operands.
+  struct Instruction {
+    uint8_t op;
+    uint8_t var;
+    uint16_t offset;    // byte offset in the upload, for resolving jumps
+    int32_t arg;        // immediate, command type or target instruction
+  };
+
+  Instruction code[PROGRAM_MAX_INSTRUCTIONS];
+  int codeLength;
+
+  int32_t stack[VM_STACK_DEPTH];
+  int sp;
+  int32_t vars[VM_VARIABLES];
+  int pc;
+  uint32_t executed;
+  const char* error;
+
+  int resolveTarget(int offset, size_t length) const;
+  bool push(int32_t value);
+  bool pop(int32_t& value);
+  bool reject(const char* message);
+  VMResult fault(const char* message);
+
+public:
+  BytecodeVM();
+
+  // Decode and verify a program: opcodes, operand lengths, variable
+  // indices and jump targets. Returns false (see getError()) if it is bad.
+  bool load(const uint8_t* bytecode, size_t length);
+
+  // Restart the loaded program with cleared stack and variables
+  void reset();
+
+  // Execute at most budget instructions. distanceCM is what VM_DIST sees.
+  VMResult run(int budget, int32_t distanceCM, char& actionType, int32_t& actionValue);
+
+  int getInstructionCount() const;
+  int getProgramCounter() const;
+  uint32_t getExecutedCount() const;   // instructions since reset()
+  const char* getError() const;
+};
+
+#endif // BYTECODE_VM_H
@@ -5,6 +5,9 @@
 #define SERVICE_UUID        "12345678-1234-1234-1234-123456789abc"
 #define COMMAND_CHAR_UUID   "12345678-1234-1234-1234-123456789abd"
 #define SENSOR_CHAR_UUID    "12345678-1234-1234-1234-123456789abe"
+#define STATUS_CHAR_UUID    "12345678-1234-1234-1234-123456789abf"
+#define LOG_CHAR_UUID       "12345678-1234-1234-1234-123456789ac0"
+#define OTA_CHAR_UUID       "12345678-1234-1234-1234-123456789ac1"
 #define BLE_DEVICE_NAME     "E-Bug ESP32"
 
 // Pin Definitions
@@ -19,11 +22,21 @@
 #define SDA_PIN             21
 #define SCL_PIN             22
 
+// Optional side-facing HC-SR04s for wall following / corridor centering.
+// Mount them at the robot's left and right, pointing straight out sideways.
+#define SIDE_TRIG_LEFT_PIN  32
+#define SIDE_ECHO_LEFT_PIN  33
+#define SIDE_TRIG_RIGHT_PIN 4
+#define SIDE_ECHO_RIGHT_PIN 19
+
 // Motor Configuration
 #define STEPS_PER_REV       200
 #define WHEEL_DIAMETER      65      // mm
 #define ROBOT_WIDTH         150     // mm
 #define DEFAULT_SPEED       400     // microseconds
+#define ODOMETRY_UPDATE_STEPS 25    // credit the pose every N steps of a move
+#define MIN_STEP_INTERVAL_US  400   // fastest per-wheel step period (2 x min speed)
+#define STEP_PULSE_US         5     // STEP high time for independently timed wheels
 
 // Command Limits (clamp incoming BLE parameters to safe ranges)
 #define MAX_MOVE_DISTANCE_CM    500     // reject runaway forward/backward moves
@@ -37,6 +50,14 @@
 #define TURN_TIMEOUT_MS          5000   // give up if it cannot converge
 #define TURN_STEP_BATCH          5      // steps between yaw samples
 
+// Heading hold during straight moves. EXPERIMENTAL and OFF by default, for
+// the same reason as closed-loop turns: the yaw sign vs. wheel mapping must
+// be verified on the robot. Toggle at runtime with HOLD_ON / HOLD_OFF.
+#define HEADING_HOLD_DEFAULT     0      // 0 = plain lockstep moves
+#define HEADING_HOLD_KP          0.05   // rate trim per degree of heading error
+#define HEADING_HOLD_MAX_TRIM    0.3    // max fraction a wheel is sped up/slowed
+#define HEADING_HOLD_SLICE_STEPS 20     // steps between yaw samples
+
 // Navigation Constants
 #define MIN_OBSTACLE_DIST   25      // cm
 #define CRITICAL_DISTANCE   15      // cm
@@ -45,20 +66,171 @@
 #define SCAN_ANGLE_STEP     10      // degrees
 #define PATH_MEMORY_SIZE    10
 
+// Grid Map (occupancy grid used by exploration). The robot starts in the
+// middle of the map; size it so the arena fits inside with a small margin,
+// since coverage is reported as a fraction of the whole grid.
+#define GRID_CELL_SIZE_CM   10      // cm per cell edge
+#define GRID_MAP_WIDTH      40      // cells (4 m at 10 cm/cell)
+#define GRID_MAP_HEIGHT     40      // cells
+
+// Frontier Exploration
+#define EXPLORE_MAX_RANGE_CM    150     // trust ultrasonic returns up to this range
+#define EXPLORE_BEAM_HALF_ANGLE 7       // degrees; HC-SR04 cone is roughly +/-7.5
+#define EXPLORE_MAX_STEP_CM     40      // longest single move toward a frontier
+#define EXPLORE_LOOKAHEAD_CELLS 4       // aim this far along the frontier path
+#define EXPLORE_REPORT_INTERVAL 5000    // ms between coverage log lines
+
+// Wall Following / Corridor Centering (PD steering on the side sensors)
+#define WALL_CONTROL_PERIOD_MS  50      // drive slice; the sensor task scans as often
+#define WALL_SCAN_TIMEOUT_MS    300     // stop driving if the scans stop this long
+#define WALL_DEFAULT_DIST_CM    20      // target when none is given
+#define WALL_MIN_DIST_CM        8
+#define WALL_MAX_DIST_CM        100
+#define WALL_LOST_DIST_CM       120     // side reading beyond this = no wall
+#define WALL_KP                 0.004   // trim per cm of error
+#define WALL_KD                 0.002   // trim per cm/s of error rate
+#define WALL_MAX_TRIM           0.6     // max fraction the wheel rates may differ
+#define WALL_SETTLE_BAND_CM     2.0     // |error| counted as settled
+#define WALL_REPORT_INTERVAL    2000    // ms between control metric log lines
+
+// Pure-Pursuit Route Following
+#define ROUTE_MAX_WAYPOINTS     32
+#define ROUTE_LOOKAHEAD_CM      25.0    // pursuit circle radius
+#define ROUTE_GOAL_TOLERANCE_CM 5.0     // last waypoint counts as reached
+#define ROUTE_CONTROL_PERIOD_MS 50      // drive slice between steering updates
+#define ROUTE_MAX_COORD_CM      1000    // reject waypoints farther than this
+
+// Monte Carlo Localization against the stored arena map (arena_map.h)
+#ifndef MCL_PARTICLE_COUNT              // -D overrides it (test/bench_mcl)
+#define MCL_PARTICLE_COUNT      300     // fixed particle pool
+#endif
+#define MCL_UPDATE_RATE         200     // ms between filter updates (5 Hz)
+#define MCL_MAX_RANGE_CM        200     // ray-cast cutoff; farther = no echo
+#define MCL_SENSOR_SIGMA_CM     10.0    // ultrasonic range noise
+#define MCL_RANDOM_FLOOR        0.05    // likelihood floor for outlier echoes
+#define MCL_TRANS_NOISE         0.10    // odometry noise, fraction of distance
+#define MCL_ROT_NOISE           0.10    // odometry noise, fraction of rotation
+#define MCL_MIN_MOTION_CM       2.0     // skip the sensor update below this...
+#define MCL_MIN_MOTION_DEG      2.0     // ...much motion (avoids overconfidence)
+#define MCL_CONVERGED_SPREAD_CM 20.0    // particle spread counted as "localized"
+#define MCL_START_X_CM          -100.0  // lesson start pose for MCL_HOME,
+#define MCL_START_Y_CM          80.0    // in the arena frame (0, 0 = center)
+#define MCL_START_HEADING       0.0     // degrees
+#define MCL_START_SPREAD_CM     10.0    // initial uncertainty around it
+#define MCL_START_SPREAD_DEG    10.0
+
 // Task Configuration
 #define MOTOR_TASK_STACK    10000
 #define SENSOR_TASK_STACK   10000
 #define COMM_TASK_STACK     4096
+#define LOOP_TASK_STACK     8192    // Arduino loop task (CONFIG_ARDUINO_LOOP_STACK_SIZE)
 #define COMMAND_QUEUE_SIZE  10
+#define PRIORITY_QUEUE_SIZE 2       // STOP lane, ahead of the command queue
+#define COMMAND_MAX_LENGTH  512     // longest text command (BLE attribute limit)
+#define JSON_BUFFER_SIZE    384     // serialized telemetry / status notification
+#define MAX_TRANSPORTS      3       // BLE, serial and one spare (loopback)
+
+// Runtime Parameters (see parameters.h; the values above are the defaults)
+#define PARAM_COMMIT_DELAY_MS 2000    // quiet time after a change before it is written
+#define PARAM_COMMIT_MIN_MS   10000   // at most one flash pass this often
+
+// Boot (see boot_sequence.h)
+#define BOOT_CONSOLE_WAIT_MS 0      // wait for a serial monitor before the banner; 0 = don't
+
+// Memory (see static_alloc.h, heap_monitor.h)
+#define STATIC_ALLOCATION   0       // 1: tasks, queues, mutexes and BLE callbacks in static storage
+#define HEAP_GUARD          1       // count C++ heap allocations made after boot
+#define HEAP_GUARD_RECORDS  8       // late allocations remembered with task and caller
+
+// Serial Transport (the command protocol over the USB/UART console)
+#define SERIAL_TRANSPORT_ENABLED 1
+#define LOOPBACK_BUFFER_SIZE 2048   // bytes of queued output per loopback link
+
+// Logging (deferred: LOG_*() queue binary records, a low-priority task prints)
+#define LOG_LEVEL           LOG_LEVEL_INFO  // higher levels compile out
+#define LOG_RING_SIZE       64      // records; must be a power of two
+#define LOG_DRAIN_MS        20      // drain task period
+#define LOG_TASK_STACK      3072
+#define LOG_TASK_PRIORITY   0       // below every robot task
+#define LOG_SERIAL_BINARY   0       // 1: "@L <hex>" lines for tools/decode_log.py
+#define LOG_BLE_ENABLED     1       // log characteristic (off until LOG_ON)
+
+// Firmware Update over BLE (see ota_update.h)
+#define OTA_CHUNK_MAX       239     // image bytes per write: TELEMETRY_MAX_FRAME - 5
+#define OTA_WINDOW          8       // chunks in flight before the client waits for an ack
+#define OTA_ACK_EVERY       4       // chunks written per ack
+#define OTA_TIMEOUT_MS      5000    // transfer abandoned after this long without data
+#define OTA_REBOOT_DELAY_MS 1000    // from the final reply to the restart
+#define OTA_TASK_STACK      4096
+#define OTA_SIMULATED       0       // 1: simulated flash, the robot keeps its firmware
+#define OTA_SIM_CAPACITY    0x140000    // simulated partition size (default ota_0)
+#define OTA_SIM_ERASE_MS    45      // simulated erase time per 4 KB sector
+
+// Diagnostics (per-task load, stacks, wake-up jitter, queue depths)
+#define DIAG_MAX_QUEUES     6       // queues whose depth is sampled
+
+// Event Trace (timestamped events in a RAM ring, see trace.h)
+#define TRACE_ENABLED       1       // 0 compiles the TRACE() points out
+#define TRACE_RING_SIZE     1024    // events of 12 bytes; must be a power of two
+#define TRACE_MAX_TASKS     8       // tasks named in the dump
+#define TRACE_ANCHOR_MS     1000    // cycle counter reference interval per core
+#define TRACE_DUMP_PACE_MS  20      // pause between dump chunks
+
+// Power Management (see power_manager.h)
+#define POWER_HOLD_MS         2000    // drivers keep holding torque this long after a move
+#define POWER_ACTIVE_CPU_MHZ  240
+#define POWER_IDLE_CPU_MHZ    80      // clock while idle; 0 leaves it alone
+#define POWER_LIGHT_SLEEP     1       // light sleep while idle (needs CONFIG_PM_ENABLE and tickless idle)
+#define POWER_DRIVER_WAKE_US  100     // driver settling time after enable
+#define POWER_EST_CPU_MA      60      // estimates for the POWER report: ESP32 at full clock, BLE connected
+#define POWER_EST_CPU_IDLE_MA 30      // at POWER_IDLE_CPU_MHZ
+#define POWER_EST_SLEEP_MA    4       // light-sleeping between BLE events
+#define POWER_EST_DRIVER_MA   400     // per stepper driver at holding current
+
+// Program Upload (block-editor bytecode run on the robot)
+#define PROGRAM_MAX_SIZE        1024    // bytes of uploaded bytecode
+#define PROGRAM_MAX_INSTRUCTIONS 256    // decoded instruction cache entries
+#define PROGRAM_STEP_BUDGET     200     // instructions per motor-task pass
+#define PROGRAM_MAX_WAIT_MS     60000   // longest single wait
+#define VM_STACK_DEPTH          16
+#define VM_VARIABLES            8
+
+// Telemetry
+#define BLE_DEFAULT_MTU         23      // ATT MTU before the client negotiates
+#define TELEMETRY_MTU           247     // ATT MTU offered to the client
+#define TELEMETRY_MAX_FRAME     244     // notification payload at that MTU
+#define TELEMETRY_BATCH_MS      100     // longest a sample waits for its batch
+#define TELEMETRY_MIN_PERIOD    20      // fastest channel rate (50 Hz)
+#define TELEMETRY_MAX_PERIOD    60000   // slowest channel rate
+
+// Connection Profiles (intervals in 1.25 ms units, timeouts in 10 ms units)
+#define CONN_FAST_MIN_INTERVAL  6       // 7.5 ms: manual driving
+#define CONN_FAST_MAX_INTERVAL  12      // 15 ms
+#define CONN_FAST_LATENCY       0
+#define CONN_FAST_TIMEOUT       200     // 2 s
+#define CONN_IDLE_MIN_INTERVAL  80      // 100 ms: connected but idle
+#define CONN_IDLE_MAX_INTERVAL  160     // 200 ms
+#define CONN_IDLE_LATENCY       4       // events the robot may skip with nothing to send
+#define CONN_IDLE_TIMEOUT       600     // 6 s
+#define CONN_IDLE_AFTER_MS      30000   // auto: idle profile after this long without commands
+
+// BLE Clients (one controller, the rest observers)
+#define BLE_MAX_CLIENTS         3       // simultaneous centrals
+#define BLE_CONTROLLER_QUEUE    8       // notifications waiting per controller
+#define BLE_OBSERVER_QUEUE      4       // ... per observer; it drops telemetry first
+#define BLE_NOTIFY_POOL         (BLE_CONTROLLER_QUEUE + (BLE_MAX_CLIENTS - 1) * BLE_OBSERVER_QUEUE + 1)
 
 // Timing Constants
 #define SENSOR_UPDATE_RATE  1000    // milliseconds
 #define IMU_UPDATE_RATE     10      // milliseconds
-#define MOTOR_TASK_DELAY    10      // milliseconds
+#define MOTOR_TASK_DELAY    10      // milliseconds, while autonomous or running a program
+#define HEARTBEAT_INTERVAL  10000   // milliseconds
+#define STATUS_PRINT_INTERVAL 30000 // milliseconds
 
 // Safety Limits
 #define MAX_DISTANCE        999.0   // cm
 #define ULTRASONIC_TIMEOUT  30000   // microseconds
+#define SIDE_ULTRASONIC_TIMEOUT 10000   // microseconds (~1.7 m round trip)
 
 // Battery Monitoring
 // NOTE: Wire the battery through a resistor divider into an ADC1 pin.
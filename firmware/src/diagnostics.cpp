@@ -0,0 +1,161 @@
+#include "diagnostics.h"
+#include "trace.h"
+#include <Arduino.h>
+#include <string.h>
+
+// Global instance
+Diagnostics diagnostics;
+
+const uint32_t Diagnostics::jitterBounds[DIAG_JITTER_BUCKETS - 1] = {
+  250, 500, 1000, 2000, 5000, 10000, 50000
+};
+
+Diagnostics::Diagnostics()
+  : queueCount(0),
+    windowStart(0) {
+  memset(tasks, 0, sizeof(tasks));
+  memset(queues, 0, sizeof(queues));
+  lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void Diagnostics::registerTask(DiagTask task, const char* name, TaskHandle_t handle, uint32_t stackSize) {
+  tasks[task].name = name;
+  tasks[task].handle = handle;
+  tasks[task].stackSize = stackSize;
+}
+
+bool Diagnostics::registerQueue(const char* name, QueueDepthFn depth, int capacity) {
+  if (queueCount >= DIAG_MAX_QUEUES) {
+    Serial.printf("No room to monitor queue %s\n", name);
+    return false;
+  }
+  queues[queueCount].name = name;
+  queues[queueCount].depth = depth;
+  queues[queueCount].capacity = capacity;
+  queues[queueCount].peak = 0;
+  queueCount++;
+  return true;
+}
+
+void Diagnostics::passStart(DiagTask task) {
+  TRACE(TRACE_TASK_WAKE, task, 0);
+  uint32_t now = micros();
+  TaskSlot& slot = tasks[task];
+
+  portENTER_CRITICAL(&lock);
+  if (slot.timedWait) {
+    // Early wake-ups (tick rounding) count as on time
+    int32_t late = (int32_t)(now - slot.wakeDueUs);
+    uint32_t lateUs = late > 0 ? (uint32_t)late : 0;
+    int bucket = 0;
+    while (bucket < DIAG_JITTER_BUCKETS - 1 && lateUs >= jitterBounds[bucket]) {
+      bucket++;
+    }
+    slot.jitter[bucket]++;
+    if (lateUs > slot.maxLateUs) slot.maxLateUs = lateUs;
+  }
+  slot.passStartUs = now;
+  portEXIT_CRITICAL(&lock);
+}
+
+void Diagnostics::passEnd(DiagTask task, uint32_t sleepMs) {
+  uint32_t now = micros();
+  TaskSlot& slot = tasks[task];
+
+  portENTER_CRITICAL(&lock);
+  uint32_t busy = now - slot.passStartUs;
+  slot.passes++;
+  slot.busyUs += busy;
+  if (busy > slot.maxBusyUs) slot.maxBusyUs = busy;
+  slot.timedWait = sleepMs != DIAG_NO_DEADLINE;
+  slot.wakeDueUs = now + sleepMs * 1000;
+  portEXIT_CRITICAL(&lock);
+  TRACE(TRACE_TASK_SLEEP, task, sleepMs);
+}
+
+void Diagnostics::sampleQueues() {
+  for (int i = 0; i < queueCount; i++) {
+    int depth = queues[i].depth();
+    if (depth > queues[i].peak) queues[i].peak = depth;
+  }
+}
+
+void Diagnostics::reset() {
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < DIAG_TASK_COUNT; i++) {
+    TaskSlot& slot = tasks[i];
+    slot.passes = 0;
+    slot.busyUs = 0;
+    slot.maxBusyUs = 0;
+    slot.maxLateUs = 0;
+    slot.timedWait = false;         // the pass in progress started before the reset
+    memset(slot.jitter, 0, sizeof(slot.jitter));
+  }
+  windowStart = millis();
+  portEXIT_CRITICAL(&lock);
+
+  for (int i = 0; i < queueCount; i++) {
+    queues[i].peak = 0;
+  }
+}
+
+bool Diagnostics::getTask(int task, TaskReport& out) {
+  if (task < 0 || task >= DIAG_TASK_COUNT || tasks[task].name == nullptr) return false;
+
+  TaskSlot copy;
+  portENTER_CRITICAL(&lock);
+  copy = tasks[task];
+  unsigned long elapsed = millis() - windowStart;
+  portEXIT_CRITICAL(&lock);
+
+  out.name = copy.name;
+  out.stackSize = copy.stackSize;
+  // ESP-IDF reports the high-water mark in bytes
+  out.stackFree = copy.handle != nullptr ? uxTaskGetStackHighWaterMark(copy.handle) : 0;
+  out.passes = copy.passes;
+  out.load = elapsed > 0 ? copy.busyUs / (elapsed * 10.0f) : 0;
+  out.maxBusyUs = copy.maxBusyUs;
+  out.maxLateUs = copy.maxLateUs;
+  memcpy(out.jitter, copy.jitter, sizeof(out.jitter));
+  return true;
+}
+
+int Diagnostics::getQueueCount() const {
+  return queueCount;
+}
+
+bool Diagnostics::getQueue(int index, QueueReport& out) {
+  if (index < 0 || index >= queueCount) return false;
+
+  out.name = queues[index].name;
+  out.depth = queues[index].depth();
+  out.capacity = queues[index].capacity;
+  if (out.depth > queues[index].peak) queues[index].peak = out.depth;
+  out.peak = queues[index].peak;
+  return true;
+}
+
+void Diagnostics::printStatus() {
+  Serial.println("Diagnostics - load, longest pass, stack used/size, worst wake-up delay, delays <0.25/0.5/1/2/5/10/50/more ms");
+  TaskReport task;
+  for (int i = 0; i < DIAG_TASK_COUNT; i++) {
+    if (!getTask(i, task)) continue;
+    Serial.printf("  %-8s %5.1f%%, %lu us, %lu/%lu B, %lu us,",
+                  task.name, task.load, (unsigned long)task.maxBusyUs,
+                  (unsigned long)(task.stackSize - task.stackFree), (unsigned long)task.stackSize,
+                  (unsigned long)task.maxLateUs);
+    for (int b = 0; b < DIAG_JITTER_BUCKETS; b++) {
+      Serial.printf(" %lu", (unsigned long)task.jitter[b]);
+    }
+    Serial.println();
+  }
+
+  QueueReport queue;
+  Serial.print("  Queues (depth/peak/size):");
+  for (int i = 0; i < queueCount; i++) {
+    if (getQueue(i, queue)) {
+      Serial.printf(" %s %d/%d/%d", queue.name, queue.depth, queue.peak, queue.capacity);
+    }
+  }
+  Serial.println();
+}
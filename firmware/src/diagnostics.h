@@ -0,0 +1,118 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// The robot's own tasks, and the Arduino loop
+enum DiagTask {
+  DIAG_TASK_MOTOR,
+  DIAG_TASK_SENSOR,
+  DIAG_TASK_COMM,
+  DIAG_TASK_LOOP,
+  DIAG_TASK_COUNT
+};
+
+#define DIAG_JITTER_BUCKETS 8
+#define DIAG_NO_DEADLINE    0xFFFFFFFF  // passEnd(): the next wake-up isn't timed
+
+// Current depth of a queue, however it is implemented
+typedef int (*QueueDepthFn)();
+
+// Runtime instrumentation for sizing stacks and finding latency spikes.
+//
+// Each task brackets the work of one loop pass with passStart() and
+// passEnd(), telling passEnd() how long it may sleep at most
+// (DIAG_NO_DEADLINE when it waits for an event alone). That gives:
+//  - passes: with tasks that sleep until there is work, the wake-up count
+//  - busy time: wall time inside the pass, so it includes any preemption
+//    by higher-priority work and is an upper bound on the task's CPU time
+//  - wake-up jitter: how late each pass started against the timeout it
+//    slept with, as a histogram (tick granularity alone accounts for up
+//    to 1 ms; an event that ends the sleep early counts as on time)
+//  - the stack high-water mark, read from FreeRTOS when reported
+// Queue depths are sampled whenever the motor or communication task
+// wakes; the peak is the deepest seen, not necessarily the deepest there
+// was.
+//
+// Counters run from boot or the last reset(). Each task writes only its
+// own slot; a spinlock keeps readers from seeing half an update.
+class Diagnostics {
+public:
+  struct TaskReport {
+    const char* name;
+    uint32_t stackSize;             // bytes
+    uint32_t stackFree;             // bytes never touched, 0 if unknown
+    uint32_t passes;
+    float load;                     // busy share of the window, percent
+    uint32_t maxBusyUs;
+    uint32_t maxLateUs;
+    uint32_t jitter[DIAG_JITTER_BUCKETS];
+  };
+
+  struct QueueReport {
+    const char* name;
+    int depth;
+    int peak;
+    int capacity;
+  };
+
+  // Upper bound (us) of each jitter bucket; the last one is open
+  static const uint32_t jitterBounds[DIAG_JITTER_BUCKETS - 1];
+
+private:
+  struct TaskSlot {
+    const char* name;
+    TaskHandle_t handle;
+    uint32_t stackSize;
+    uint32_t passes;
+    uint64_t busyUs;
+    uint32_t maxBusyUs;
+    uint32_t passStartUs;
+    uint32_t wakeDueUs;
+    bool timedWait;                 // wakeDueUs is meaningful
+    uint32_t maxLateUs;
+    uint32_t jitter[DIAG_JITTER_BUCKETS];
+  };
+
+  struct QueueSlot {
+    const char* name;
+    QueueDepthFn depth;
+    int capacity;
+    int peak;
+  };
+
+  TaskSlot tasks[DIAG_TASK_COUNT];
+  QueueSlot queues[DIAG_MAX_QUEUES];
+  int queueCount;
+  unsigned long windowStart;        // millis() of boot or the last reset
+  portMUX_TYPE lock;
+
+public:
+  Diagnostics();
+
+  // Setup, before the tasks start
+  void registerTask(DiagTask task, const char* name, TaskHandle_t handle, uint32_t stackSize);
+  bool registerQueue(const char* name, QueueDepthFn depth, int capacity);
+
+  // Called by the task itself around each loop pass
+  void passStart(DiagTask task);
+  void passEnd(DiagTask task, uint32_t sleepMs);
+
+  void sampleQueues();
+  void reset();
+
+  bool getTask(int task, TaskReport& out);
+  int getQueueCount() const;
+  bool getQueue(int index, QueueReport& out);
+
+  void printStatus();
+};
+
+// Global diagnostics instance
+extern Diagnostics diagnostics;
+
+#endif // DIAGNOSTICS_H
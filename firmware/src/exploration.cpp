@@ -0,0 +1,261 @@
+#include "exploration.h"
+#include <Arduino.h>
+#include "logger.h"
+#include <cmath>
+
+#define EXPLORE_MAX_ATTEMPTS 3
+
+// Global instance
+Exploration explorer;
+
+static const int NEIGHBOR_DX[4] = {1, -1, 0, 0};
+static const int NEIGHBOR_DY[4] = {0, 0, 1, -1};
+
+Exploration::Exploration()
+  : complete(false),
+    startTime(0),
+    coverage(0),
+    lastReport(0),
+    lastTarget(-1),
+    targetAttempts(0) {
+  coverageLock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void Exploration::begin() {
+  reset();
+  Serial.println("Exploration map initialized");
+}
+
+void Exploration::reset() {
+  map.clear();
+  complete = false;
+  startTime = millis();
+  lastReport = 0;
+  lastTarget = -1;
+  targetAttempts = 0;
+  portENTER_CRITICAL(&coverageLock);
+  coverage = 0;
+  portEXIT_CRITICAL(&coverageLock);
+}
+
+void Exploration::integrateReading(const Pose& pose, float distanceCM) {
+  // No echo (or beyond the trusted range) still tells us the cone is clear
+  // up to EXPLORE_MAX_RANGE_CM.
+  bool hit = distanceCM < EXPLORE_MAX_RANGE_CM;
+  float range = hit ? distanceCM : EXPLORE_MAX_RANGE_CM;
+
+  // Approximate the sonar cone with its center and two edge rays
+  map.integrateRay(pose.x, pose.y, pose.heading - EXPLORE_BEAM_HALF_ANGLE, range, hit);
+  map.integrateRay(pose.x, pose.y, pose.heading, range, hit);
+  map.integrateRay(pose.x, pose.y, pose.heading + EXPLORE_BEAM_HALF_ANGLE, range, hit);
+}
+
+bool Exploration::nearObstacle(int cx, int cy) const {
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      if (map.isOccupied(cx + dx, cy + dy)) return true;
+    }
+  }
+  return false;
+}
+
+bool Exploration::isTraversable(int cx, int cy) const {
+  // Inflate obstacles by one cell so paths keep the chassis off walls
+  return map.isFree(cx, cy) && !nearObstacle(cx, cy);
+}
+
+bool Exploration::unknownNeighbor(int cx, int cy, int& nx, int& ny) const {
+  for (int i = 0; i < 4; i++) {
+    nx = cx + NEIGHBOR_DX[i];
+    ny = cy + NEIGHBOR_DY[i];
+    // Space outside the grid is never a frontier
+    if (map.inBounds(nx, ny) && !map.isKnown(nx, ny)) return true;
+  }
+  return false;
+}
+
+bool Exploration::isFrontier(int cx, int cy) const {
+  int nx, ny;
+  return isTraversable(cx, cy) && unknownNeighbor(cx, cy, nx, ny);
+}
+
+int Exploration::findNearestFrontier(int startIndex) {
+  // BFS over traversable cells: with uniform step cost the first frontier
+  // dequeued is the cheapest one to reach.
+  for (int i = 0; i < GRID_MAP_WIDTH * GRID_MAP_HEIGHT; i++) {
+    parent[i] = -1;
+  }
+
+  int head = 0, tail = 0;
+  parent[startIndex] = startIndex;
+  searchQueue[tail++] = startIndex;
+
+  while (head < tail) {
+    int index = searchQueue[head++];
+    int cx = index % GRID_MAP_WIDTH;
+    int cy = index / GRID_MAP_WIDTH;
+
+    if (isFrontier(cx, cy)) {
+      return index;
+    }
+
+    for (int i = 0; i < 4; i++) {
+      int nx = cx + NEIGHBOR_DX[i];
+      int ny = cy + NEIGHBOR_DY[i];
+      if (!map.inBounds(nx, ny)) continue;
+
+      int next = ny * GRID_MAP_WIDTH + nx;
+      if (parent[next] != -1 || !isTraversable(nx, ny)) continue;
+
+      parent[next] = index;
+      searchQueue[tail++] = next;
+    }
+  }
+
+  return -1; // nothing reachable borders unknown space
+}
+
+void Exploration::abandonFrontier(int index) {
+  // Close off the unknown neighbors so the frontier disappears
+  int cx = index % GRID_MAP_WIDTH;
+  int cy = index / GRID_MAP_WIDTH;
+  int nx, ny;
+  while (unknownNeighbor(cx, cy, nx, ny)) {
+    map.setCell(nx, ny, GRID_EVIDENCE_MAX);
+  }
+  LOG_WARN("Abandoning unreachable frontier at cell (%d, %d)", cx, cy);
+}
+
+bool Exploration::planStep(const Pose& pose, float& turnDegrees, float& distanceCM) {
+  turnDegrees = 0;
+  distanceCM = 0;
+
+  int sx, sy;
+  if (!map.worldToCell(pose.x, pose.y, sx, sy)) {
+    LOG_WARN("Robot is outside the exploration map");
+    complete = true;
+    return false;
+  }
+
+  int start = sy * GRID_MAP_WIDTH + sx;
+  int frontier = findNearestFrontier(start);
+
+  if (frontier >= 0 && frontier == lastTarget &&
+      ++targetAttempts > EXPLORE_MAX_ATTEMPTS) {
+    abandonFrontier(frontier);
+    lastTarget = -1;
+    targetAttempts = 0;
+    frontier = findNearestFrontier(start);
+  } else if (frontier != lastTarget) {
+    lastTarget = frontier;
+    targetAttempts = 0;
+  }
+
+  if (frontier < 0) {
+    complete = true;
+    updateCoverage(start);
+    return false;
+  }
+
+  int tx, ty;
+  if (frontier == start) {
+    // Already on the frontier: face the unknown cell so the next scan sees it
+    unknownNeighbor(sx, sy, tx, ty);
+  } else {
+    // Aim a few cells along the path rather than at the first cell, so the
+    // robot makes longer straight legs instead of cell-by-cell zig-zags.
+    int length = 0;
+    for (int i = frontier; i != start; i = parent[i]) length++;
+
+    int target = frontier;
+    for (int i = 0; i < length - EXPLORE_LOOKAHEAD_CELLS; i++) {
+      target = parent[target];
+    }
+    tx = target % GRID_MAP_WIDTH;
+    ty = target / GRID_MAP_WIDTH;
+  }
+
+  float wx, wy;
+  map.cellToWorld(tx, ty, wx, wy);
+  float dx = wx - pose.x;
+  float dy = wy - pose.y;
+
+  turnDegrees = atan2(dy, dx) * 180.0 / PI - pose.heading;
+  while (turnDegrees > 180.0) turnDegrees -= 360.0;
+  while (turnDegrees < -180.0) turnDegrees += 360.0;
+
+  if (frontier != start) {
+    distanceCM = min((float)sqrt(dx * dx + dy * dy), (float)EXPLORE_MAX_STEP_CM);
+  }
+  updateCoverage(start);   // after the path in parent[] has been used
+  return true;
+}
+
+void Exploration::updateCoverage(int startIndex) {
+  // Flood from the robot as the planner would drive, but through unknown
+  // cells as well as free ones. Cells next to an obstacle are counted and
+  // not crossed: that closes the gaps the sonar leaves between wall hits,
+  // which would otherwise let the flood out into the rest of the grid.
+  for (int i = 0; i < GRID_MAP_WIDTH * GRID_MAP_HEIGHT; i++) {
+    parent[i] = -1;
+  }
+
+  int head = 0, tail = 0;
+  int area = 0, known = 0;
+  parent[startIndex] = startIndex;
+  searchQueue[tail++] = startIndex;
+
+  while (head < tail) {
+    int index = searchQueue[head++];
+    int cx = index % GRID_MAP_WIDTH;
+    int cy = index / GRID_MAP_WIDTH;
+    area++;
+    if (map.isKnown(cx, cy)) known++;
+    if (index != startIndex && nearObstacle(cx, cy)) continue;
+
+    for (int i = 0; i < 4; i++) {
+      int nx = cx + NEIGHBOR_DX[i];
+      int ny = cy + NEIGHBOR_DY[i];
+      if (!map.inBounds(nx, ny)) continue;
+
+      int next = ny * GRID_MAP_WIDTH + nx;
+      if (parent[next] != -1) continue;
+      parent[next] = index;
+      searchQueue[tail++] = next;
+    }
+  }
+
+  float percent = known * 100.0 / area;
+  portENTER_CRITICAL(&coverageLock);
+  coverage = percent;
+  portEXIT_CRITICAL(&coverageLock);
+}
+
+float Exploration::getCoverage() {
+  portENTER_CRITICAL(&coverageLock);
+  float result = coverage;
+  portEXIT_CRITICAL(&coverageLock);
+  return result;
+}
+
+const GridMap& Exploration::getMap() const {
+  return map;
+}
+
+bool Exploration::isComplete() const {
+  return complete;
+}
+
+unsigned long Exploration::getElapsedTime() const {
+  return millis() - startTime;
+}
+
+void Exploration::reportProgress(bool force) {
+  if (!force && millis() - lastReport < EXPLORE_REPORT_INTERVAL) {
+    return;
+  }
+  lastReport = millis();
+  LOG_INFO("Exploration: %.1f%% covered after %lu s%s",
+           getCoverage(), getElapsedTime() / 1000,
+           complete ? " (complete)" : "");
+}
@@ -0,0 +1,76 @@
+#ifndef EXPLORATION_H
+#define EXPLORATION_H
+
+#include "types.h"
+#include "config.h"
+#include "grid_map.h"
+#include <freertos/FreeRTOS.h>
+
+// Frontier-based exploration: keeps an occupancy grid of what the ultrasonic
+// sensor has seen and steers toward the closest frontier, i.e. a reachable
+// free cell that borders unknown space. Driving is left to Navigation; this
+// class only maintains the map and plans the next leg.
+class Exploration {
+private:
+  GridMap map;
+
+  // Breadth-first search scratch space, sized with the map so planning
+  // never touches the heap. parent[i] is the predecessor of cell i on the
+  // shortest path from the robot, or -1 if the cell was not reached.
+  int16_t parent[GRID_MAP_WIDTH * GRID_MAP_HEIGHT];
+  int16_t searchQueue[GRID_MAP_WIDTH * GRID_MAP_HEIGHT];
+
+  bool complete;
+  unsigned long startTime;
+
+  // Refreshed on the motor task after each plan; telemetry reads it from
+  // the sensor task, so it is the only map-derived value shared
+  float coverage;
+  portMUX_TYPE coverageLock;
+
+  unsigned long lastReport;
+
+  // Frontier we keep failing to resolve (e.g. an unknown pocket the sensor
+  // cannot see into); abandoned after a few attempts.
+  int lastTarget;
+  int targetAttempts;
+
+  bool nearObstacle(int cx, int cy) const;
+  bool isTraversable(int cx, int cy) const;
+  bool isFrontier(int cx, int cy) const;
+  int findNearestFrontier(int startIndex);
+  bool unknownNeighbor(int cx, int cy, int& nx, int& ny) const;
+  void abandonFrontier(int index);
+  void updateCoverage(int startIndex);
+
+public:
+  Exploration();
+
+  // Initialization
+  void begin();
+  void reset();
+
+  // Fold one ultrasonic reading taken at the given pose into the map
+  void integrateReading(const Pose& pose, float distanceCM);
+
+  // Plan the next leg toward the cheapest frontier. Returns false when no
+  // reachable frontier is left (exploration is complete).
+  bool planStep(const Pose& pose, float& turnDegrees, float& distanceCM);
+
+  // Coverage metrics. Coverage is the percentage observed of the area the
+  // robot could still drive into (free or unknown, not walled off by known
+  // obstacles) and the cells that bound it, so an enclosed arena reads
+  // close to 100% when explored, whatever the grid size.
+  float getCoverage();
+  bool isComplete() const;
+  unsigned long getElapsedTime() const;
+  void reportProgress(bool force = false);
+
+  // The map itself; only the motor task (which plans) may read it
+  const GridMap& getMap() const;
+};
+
+// Global exploration instance
+extern Exploration explorer;
+
+#endif // EXPLORATION_H
@@ -0,0 +1,111 @@
+#include "grid_map.h"
+#include <Arduino.h>
+#include <cmath>
+
+GridMap::GridMap() : knownCells(0) {
+  clear();
+}
+
+void GridMap::clear() {
+  memset(cells, GRID_UNKNOWN, sizeof(cells));
+  knownCells = 0;
+}
+
+bool GridMap::loadFromRows(const char* const* rows, int width, int height) {
+  if (width > GRID_MAP_WIDTH || height > GRID_MAP_HEIGHT) {
+    Serial.printf("Stored map %dx%d does not fit the %dx%d grid\n",
+                  width, height, GRID_MAP_WIDTH, GRID_MAP_HEIGHT);
+    return false;
+  }
+
+  clear();
+  int offsetX = (GRID_MAP_WIDTH - width) / 2;
+  int offsetY = (GRID_MAP_HEIGHT - height) / 2;
+
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width && rows[row][col] != '\0'; col++) {
+      bool wall = rows[row][col] == '#';
+      setCell(offsetX + col, offsetY + row, wall ? GRID_EVIDENCE_MAX : GRID_EVIDENCE_MIN);
+    }
+  }
+  return true;
+}
+
+bool GridMap::worldToCell(float x, float y, int& cx, int& cy) const {
+  cx = (int)floor(x / GRID_CELL_SIZE_CM) + GRID_MAP_WIDTH / 2;
+  cy = (int)floor(y / GRID_CELL_SIZE_CM) + GRID_MAP_HEIGHT / 2;
+  return inBounds(cx, cy);
+}
+
+void GridMap::cellToWorld(int cx, int cy, float& x, float& y) const {
+  // Center of the cell
+  x = (cx - GRID_MAP_WIDTH / 2 + 0.5) * GRID_CELL_SIZE_CM;
+  y = (cy - GRID_MAP_HEIGHT / 2 + 0.5) * GRID_CELL_SIZE_CM;
+}
+
+bool GridMap::inBounds(int cx, int cy) const {
+  return cx >= 0 && cx < GRID_MAP_WIDTH && cy >= 0 && cy < GRID_MAP_HEIGHT;
+}
+
+uint8_t GridMap::getCell(int cx, int cy) const {
+  if (!inBounds(cx, cy)) return GRID_UNKNOWN;
+  return cells[cy * GRID_MAP_WIDTH + cx];
+}
+
+void GridMap::setCell(int cx, int cy, uint8_t value) {
+  if (!inBounds(cx, cy)) return;
+  uint8_t& cell = cells[cy * GRID_MAP_WIDTH + cx];
+  if (cell == GRID_UNKNOWN && value != GRID_UNKNOWN) knownCells++;
+  if (cell != GRID_UNKNOWN && value == GRID_UNKNOWN) knownCells--;
+  cell = value;
+}
+
+bool GridMap::isKnown(int cx, int cy) const {
+  return getCell(cx, cy) != GRID_UNKNOWN;
+}
+
+bool GridMap::isFree(int cx, int cy) const {
+  uint8_t cell = getCell(cx, cy);
+  return cell != GRID_UNKNOWN && cell <= GRID_EVIDENCE_NEUTRAL;
+}
+
+bool GridMap::isOccupied(int cx, int cy) const {
+  return getCell(cx, cy) > GRID_EVIDENCE_NEUTRAL;
+}
+
+void GridMap::observe(int cx, int cy, bool hit) {
+  int value = getCell(cx, cy);
+  if (value == GRID_UNKNOWN) value = GRID_EVIDENCE_NEUTRAL;
+
+  value += hit ? GRID_HIT_WEIGHT : -GRID_MISS_WEIGHT;
+  value = constrain(value, GRID_EVIDENCE_MIN, GRID_EVIDENCE_MAX);
+  setCell(cx, cy, value);
+}
+
+void GridMap::integrateRay(float x, float y, float headingDeg, float rangeCM, bool hit) {
+  int x0, y0, x1, y1;
+  worldToCell(x, y, x0, y0);
+
+  float rad = headingDeg * PI / 180.0;
+  worldToCell(x + rangeCM * cos(rad), y + rangeCM * sin(rad), x1, y1);
+
+  // Bresenham walk from the sensor cell to the end cell
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+
+  while (true) {
+    bool last = (x0 == x1 && y0 == y1);
+    if (!inBounds(x0, y0)) break;  // ray left the map
+    observe(x0, y0, last && hit);
+    if (last) break;
+
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+int GridMap::getKnownCells() const {
+  return knownCells;
+}
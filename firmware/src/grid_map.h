@@ -0,0 +1,54 @@
+#ifndef GRID_MAP_H
+#define GRID_MAP_H
+
+#include <stdint.h>
+#include "types.h"
+#include "config.h"
+
+// Fixed-size occupancy grid in world coordinates (cm, see Pose). World
+// (0, 0) sits at the center of the grid. Each cell stores 0 while unknown;
+// once observed it holds occupancy evidence in [GRID_EVIDENCE_MIN,
+// GRID_EVIDENCE_MAX], starting from GRID_EVIDENCE_NEUTRAL.
+#define GRID_UNKNOWN            0
+#define GRID_EVIDENCE_MIN       1
+#define GRID_EVIDENCE_NEUTRAL   8
+#define GRID_EVIDENCE_MAX       15
+#define GRID_HIT_WEIGHT         3       // evidence added by an echo
+#define GRID_MISS_WEIGHT        1       // evidence removed by a clear ray
+
+class GridMap {
+private:
+  uint8_t cells[GRID_MAP_WIDTH * GRID_MAP_HEIGHT];
+  int knownCells;
+
+  void observe(int cx, int cy, bool hit);
+
+public:
+  GridMap();
+
+  void clear();
+
+  // Load a stored map given as text rows ('#' = wall, anything else = free),
+  // centered in the grid so world (0, 0) is the middle of the stored map.
+  bool loadFromRows(const char* const* rows, int width, int height);
+
+  // Coordinate conversion
+  bool worldToCell(float x, float y, int& cx, int& cy) const;
+  void cellToWorld(int cx, int cy, float& x, float& y) const;
+  bool inBounds(int cx, int cy) const;
+
+  // Cell access
+  uint8_t getCell(int cx, int cy) const;
+  void setCell(int cx, int cy, uint8_t value);
+  bool isKnown(int cx, int cy) const;
+  bool isFree(int cx, int cy) const;
+  bool isOccupied(int cx, int cy) const;
+
+  // Integrate one range reading taken from (x, y) along headingDeg. Cells up
+  // to the echo are marked clear; the echo cell is marked occupied when hit.
+  void integrateRay(float x, float y, float headingDeg, float rangeCM, bool hit);
+
+  int getKnownCells() const;
+};
+
+#endif // GRID_MAP_H
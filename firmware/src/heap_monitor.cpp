@@ -0,0 +1,128 @@
+#include "heap_monitor.h"
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Global instance
+HeapMonitor heapMonitor;
+
+// Guard state is plain constant-initialized data: operator new runs from
+// static constructors too, before any object here is constructed
+static std::atomic<bool> guardSealed(false);
+static std::atomic<uint32_t> lateAllocCount(0);
+static HeapMonitor::LateAlloc lateAllocs[HEAP_GUARD_RECORDS];
+
+#if HEAP_GUARD
+static void* guardedNew(size_t size, void* caller) {
+  if (guardSealed.load(std::memory_order_relaxed)) {
+    heapMonitor.noteAllocation(size, caller);
+  }
+  void* block = malloc(size > 0 ? size : 1);
+  if (block == nullptr) {
+#if __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+  }
+  return block;
+}
+
+void* operator new(size_t size) {
+  return guardedNew(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size) {
+  return guardedNew(size, __builtin_return_address(0));
+}
+#endif
+
+HeapMonitor::HeapMonitor()
+  : lastBlocks(0),
+    sampled(false),
+    reportedAllocs(0) {
+}
+
+void HeapMonitor::seal() {
+  guardSealed.store(true, std::memory_order_relaxed);
+}
+
+bool HeapMonitor::isSealed() const {
+  return guardSealed.load(std::memory_order_relaxed);
+}
+
+void HeapMonitor::noteAllocation(size_t size, void* caller) {
+  uint32_t index = lateAllocCount.fetch_add(1, std::memory_order_relaxed);
+  if (index < HEAP_GUARD_RECORDS) {
+    lateAllocs[index].task = pcTaskGetName(nullptr);
+    lateAllocs[index].size = size;
+    lateAllocs[index].caller = caller;
+  }
+}
+
+int HeapMonitor::getLateAllocCount() const {
+  return lateAllocCount.load(std::memory_order_relaxed);
+}
+
+bool HeapMonitor::getLateAlloc(int index, LateAlloc& out) const {
+  if (index < 0 || index >= HEAP_GUARD_RECORDS || index >= getLateAllocCount()) {
+    return false;
+  }
+  out = lateAllocs[index];
+  return true;
+}
+
+void HeapMonitor::check() {
+  uint32_t count = getLateAllocCount();
+  if (count == reportedAllocs) return;
+
+  LateAlloc first;
+  if (getLateAlloc(reportedAllocs, first)) {
+    Serial.printf("Heap guard: %lu allocations after boot, next from %s (%u bytes, caller %p)\n",
+                  (unsigned long)count, first.task, (unsigned)first.size, first.caller);
+  } else {
+    Serial.printf("Heap guard: %lu allocations after boot\n", (unsigned long)count);
+  }
+  reportedAllocs = count;
+}
+
+HeapStats HeapMonitor::read() const {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+  HeapStats stats;
+  stats.freeBytes = info.total_free_bytes;
+  stats.largestBlock = info.largest_free_block;
+  stats.minFreeBytes = info.minimum_free_bytes;
+  stats.allocatedBlocks = info.allocated_blocks;
+  stats.blocksDelta = 0;
+  stats.lateAllocs = getLateAllocCount();
+  return stats;
+}
+
+HeapStats HeapMonitor::sample() {
+  HeapStats stats = read();
+  if (sampled) {
+    stats.blocksDelta = (int32_t)(stats.allocatedBlocks - lastBlocks);
+  }
+  lastBlocks = stats.allocatedBlocks;
+  sampled = true;
+  return stats;
+}
+
+void HeapMonitor::printStatus() const {
+  HeapStats stats = read();
+  Serial.printf("Heap: %lu free, %lu largest block, %lu low-water, %lu blocks\n",
+                (unsigned long)stats.freeBytes, (unsigned long)stats.largestBlock,
+                (unsigned long)stats.minFreeBytes, (unsigned long)stats.allocatedBlocks);
+
+  if (!isSealed()) return;
+  Serial.printf("Heap guard: %lu allocations after boot\n", (unsigned long)stats.lateAllocs);
+  LateAlloc alloc;
+  for (int i = 0; getLateAlloc(i, alloc); i++) {
+    Serial.printf("  %s: %u bytes, caller %p\n", alloc.task, (unsigned)alloc.size, alloc.caller);
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+struct HeapStats {
+  uint32_t freeBytes;
+  uint32_t largestBlock;      // biggest single allocation that can succeed
+  uint32_t minFreeBytes;      // low-water mark since boot
+  uint32_t allocatedBlocks;
+  int32_t blocksDelta;        // net allocations since the previous sample
+  uint32_t lateAllocs;        // operator new calls since seal() (HEAP_GUARD)
+};
+
+// Tracks heap health between heartbeats. A steady state shows blocksDelta
+// near zero and largestBlock close to freeBytes; a shrinking largestBlock
+// with plenty of free bytes is fragmentation.
+//
+// With HEAP_GUARD the firmware's operator new also counts allocations
+// once setup() has sealed the heap, and remembers who made the first
+// HEAP_GUARD_RECORDS of them. The robot is meant to allocate nothing
+// after boot. The exception is the BLE library's copy of each write longer
+// than 15 bytes (on the Bluetooth task); anything else recorded is a
+// regression. The guard sees C++ allocations only. The BLE stack's own
+// mallocs show up in blocksDelta.
+class HeapMonitor {
+public:
+  struct LateAlloc {
+    const char* task;         // FreeRTOS task name
+    size_t size;
+    void* caller;             // return address of operator new
+  };
+
+private:
+  uint32_t lastBlocks;
+  bool sampled;
+  uint32_t reportedAllocs;    // lateAllocs at the last check()
+
+  HeapStats read() const;
+
+public:
+  HeapMonitor();
+
+  // End of boot: allocations from here on are flagged
+  void seal();
+  bool isSealed() const;
+
+  // Called by operator new
+  void noteAllocation(size_t size, void* caller);
+
+  int getLateAllocCount() const;
+  bool getLateAlloc(int index, LateAlloc& out) const;
+
+  // Warns once about each batch of new allocations (heartbeat)
+  void check();
+
+  // Current stats; blocksDelta counts from the previous sample() call, so
+  // only the heartbeat should sample
+  HeapStats sample();
+  void printStatus() const;
+};
+
+// Global heap monitor instance
+extern HeapMonitor heapMonitor;
+
+#endif // HEAP_MONITOR_H
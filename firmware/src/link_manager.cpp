@@ -0,0 +1,1021 @@
+#include "link_manager.h"
+#include "motor_control.h"
+#include "navigation.h"
+#include "exploration.h"
+#include "localization.h"
+#include "program_runner.h"
+#include "ota_update.h"
+#include "logger.h"
+#include "diagnostics.h"
+#include "task_events.h"
+#include "trace.h"
+#include "power_manager.h"
+#include "boot_sequence.h"
+#include "sensor_manager.h"
+#include "parameters.h"
+#include <ArduinoJson.h>
+
+// Global instance
+LinkManager linkManager;
+
+static bool startsWith(const char* text, const char* prefix) {
+  return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+// Trim surrounding whitespace in place; returns the first kept character
+static char* trimText(char* text) {
+  while (isspace((unsigned char)*text)) text++;
+  char* end = text + strlen(text);
+  while (end > text && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+  return text;
+}
+
+LinkManager::LinkManager()
+  : transportCount(0),
+    telemetryFormat(TELEMETRY_JSON),
+    batchFormat(TELEMETRY_JSON),
+    batchStartTime(0),
+    subscriptionChanged(false),
+    sensorPeriod(0),
+    commandQueue(nullptr),
+    priorityQueue(nullptr),
+    statusMutex(nullptr) {
+  for (int i = 0; i < MAX_TRANSPORTS; i++) {
+    transports[i] = nullptr;
+  }
+  resetSubscriptions();
+}
+
+LinkManager::~LinkManager() {
+  if (commandQueue) {
+    vQueueDelete(commandQueue);
+  }
+  if (priorityQueue) {
+    vQueueDelete(priorityQueue);
+  }
+}
+
+bool LinkManager::begin() {
+  // Create command queue
+  commandQueue = commandQueueStorage.create();
+  if (commandQueue == nullptr) {
+    Serial.println("Failed to create command queue");
+    return false;
+  }
+
+  // Stops skip the command queue so they can't be stuck behind (or dropped
+  // because of) a burst of moves
+  priorityQueue = priorityQueueStorage.create();
+  if (priorityQueue == nullptr) {
+    Serial.println("Failed to create priority queue");
+    return false;
+  }
+
+  // Acks are sent from the transports' threads and the motor task
+  statusMutex = statusMutexStorage.create();
+  if (statusMutex == nullptr) {
+    Serial.println("Failed to create status mutex");
+  }
+  return true;
+}
+
+bool LinkManager::addTransport(Transport* transport) {
+  if (transportCount >= MAX_TRANSPORTS) {
+    Serial.printf("No room for transport %s\n", transport->getName());
+    return false;
+  }
+  transports[transportCount++] = transport;
+  Serial.printf("Transport %s registered\n", transport->getName());
+  return true;
+}
+
+uint8_t LinkManager::sourceOf(Transport* transport) const {
+  for (int i = 0; i < transportCount; i++) {
+    if (transports[i] == transport) return i + 1;
+  }
+  return 0;
+}
+
+bool LinkManager::isConnected() const {
+  for (int i = 0; i < transportCount; i++) {
+    if (transports[i]->isConnected()) return true;
+  }
+  return false;
+}
+
+void LinkManager::transportClosed(Transport* transport) {
+  if (isConnected()) return;
+
+  // The next client starts from the legacy stream
+  resetSubscriptions();
+  telemetryFormat = TELEMETRY_JSON;
+}
+
+void LinkManager::receiveText(Transport* source, char* text) {
+  char* cmd = trimText(text);
+  if (*cmd == '\0') {
+    return;
+  }
+  LOG_DEBUG("Received command (%s): %s", source->getName(), cmd);
+  uint8_t profile = source->noteActivity();
+
+  if (handleRouteUpload(cmd) || handleTelemetryCommand(cmd) ||
+      handleDiagnosticsCommand(source, cmd) || handleTraceCommand(source, cmd) ||
+      handlePowerCommand(source, cmd) || handleBootCommand(source, cmd) ||
+      handleParamCommand(source, cmd) || source->handleLinkCommand(cmd)) {
+    return;
+  }
+
+  Command command = parseCommand(cmd);
+  command.profile = profile;
+  command.source = sourceOf(source);
+  queueCommand(command);
+}
+
+Command LinkManager::parseCommand(const char* cmd) {
+  Command command = {'S', 0, 0, 0, 0, 0}; // Default stop command
+  
+  if (*cmd == '\0') {
+    return command;
+  }
+  
+  if (strcmp(cmd, "ROUTE_GO") == 0) {
+    // Checked first: it would otherwise parse as a right turn
+    command.type = 'P';
+    command.value = 1;
+  }
+  else if (cmd[0] == 'F') {
+    command.type = 'F';
+    command.value = atoi(cmd + 1);
+  }
+  else if (cmd[0] == 'B') {
+    command.type = 'B';
+    command.value = atoi(cmd + 1);
+  }
+  else if (cmd[0] == 'L') {
+    command.type = 'L';
+    command.value = atoi(cmd + 1);
+  }
+  else if (cmd[0] == 'R') {
+    command.type = 'R';
+    command.value = atoi(cmd + 1);
+  }
+  else if (startsWith(cmd, "WL") || startsWith(cmd, "WR")) {
+    // Wall following: the sign picks the side (negative = left wall)
+    command.type = 'W';
+    int target = atoi(cmd + 2);
+    if (target <= 0) target = WALL_DEFAULT_DIST_CM;
+    command.value = cmd[1] == 'L' ? -target : target;
+  }
+  else if (strcmp(cmd, "CORRIDOR") == 0) {
+    command.type = 'W';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "STOP") == 0) {
+    command.type = 'S';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "AUTO_NAV") == 0) {
+    command.type = 'A';
+    command.value = 1;
+  }
+  else if (strcmp(cmd, "EXPLORE") == 0) {
+    command.type = 'A';
+    command.value = 2;
+  }
+  else if (strcmp(cmd, "AUTO_OFF") == 0) {
+    command.type = 'A';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "PROG_RUN") == 0) {
+    command.type = 'G';
+    command.value = 1;
+  }
+  else if (strcmp(cmd, "PROG_ABORT") == 0) {
+    command.type = 'G';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "CALIBRATE") == 0) {
+    command.type = 'C';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "MCL_ON") == 0) {
+    command.type = 'M';
+    command.value = 1;
+  }
+  else if (strcmp(cmd, "MCL_HOME") == 0) {
+    command.type = 'M';
+    command.value = 2;
+  }
+  else if (strcmp(cmd, "MCL_OFF") == 0) {
+    command.type = 'M';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "HOLD_ON") == 0) {
+    command.type = 'H';
+    command.value = 1;
+  }
+  else if (strcmp(cmd, "HOLD_OFF") == 0) {
+    command.type = 'H';
+    command.value = 0;
+  }
+  else if (strcmp(cmd, "CLOOP_ON") == 0) {
+    command.type = 'K';
+    command.value = 1;
+  }
+  else if (strcmp(cmd, "CLOOP_OFF") == 0) {
+    command.type = 'K';
+    command.value = 0;
+  }
+  else {
+    LOG_WARN("Unknown command: %s", cmd);
+  }
+
+  return command;
+}
+
+bool LinkManager::handleRouteUpload(const char* cmd) {
+  // Route edits go straight to the navigator instead of the command queue;
+  // they would otherwise be misparsed as turns ("ROUTE...") or wall follow.
+  if (strcmp(cmd, "ROUTE_CLEAR") == 0) {
+    navigator.clearRoute();
+    LOG_INFO("Route cleared");
+    return true;
+  }
+
+  const char* p;
+  bool append;
+  if (startsWith(cmd, "WP")) {
+    p = cmd + 2;                             // WP<x>,<y>: append one waypoint
+    append = true;
+  } else if (startsWith(cmd, "ROUTE:")) {
+    p = cmd + 6;                             // ROUTE:x1,y1;x2,y2;... replaces
+    append = false;
+  } else {
+    return false;
+  }
+
+  // Parsed whole first, then handed over in one step, so a queued
+  // ROUTE_GO can't start a half-replaced route
+  Waypoint points[ROUTE_MAX_WAYPOINTS];
+  int count = 0;
+  while (*p != '\0') {
+    char* end;
+    long x = strtol(p, &end, 10);
+    if (end == p || *end != ',') break;
+    p = end + 1;
+    long y = strtol(p, &end, 10);
+    if (end == p) break;
+    p = end;
+
+    if (labs(x) > ROUTE_MAX_COORD_CM || labs(y) > ROUTE_MAX_COORD_CM) {
+      LOG_WARN("Waypoint (%ld, %ld) out of range, route unchanged", x, y);
+      return true;
+    }
+    if (count == ROUTE_MAX_WAYPOINTS) {
+      LOG_WARN("Route full, route unchanged");
+      return true;
+    }
+    points[count].x = x;
+    points[count].y = y;
+    count++;
+
+    if (*p == ';') p++;
+    else break;
+  }
+
+  if (*p != '\0') {
+    LOG_WARN("Malformed route command: %s", cmd);
+  }
+  navigator.setRoute(points, count, append);
+  LOG_INFO("Route has %d waypoints", navigator.getRouteLength());
+  return true;
+}
+
+bool LinkManager::handleTelemetryCommand(const char* cmd) {
+  // Link settings take effect immediately instead of waiting in the queue
+  if (strcmp(cmd, "TLM_JSON") == 0) {
+    setTelemetryFormat(TELEMETRY_JSON);
+  } else if (strcmp(cmd, "TLM_BIN") == 0) {
+    setTelemetryFormat(TELEMETRY_BINARY);
+  } else if (strcmp(cmd, "TLM_DELTA") == 0) {
+    setTelemetryFormat(TELEMETRY_BINARY_DELTA);
+  } else if (startsWith(cmd, "SUB:")) {
+    if (!parseSubscription(cmd + 4)) {
+      LOG_WARN("Malformed subscription: %s", cmd);
+    }
+  } else if (strcmp(cmd, "SUB_OFF") == 0) {
+    for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+      setChannelPeriod(ch, 0);
+    }
+  } else if (strcmp(cmd, "SUB_DEFAULT") == 0) {
+    resetSubscriptions();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool LinkManager::handleDiagnosticsCommand(Transport* source, const char* cmd) {
+  if (strcmp(cmd, "DIAG") == 0) {
+    sendDiagnostics(source);
+  } else if (strcmp(cmd, "DIAG_RESET") == 0) {
+    diagnostics.reset();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool LinkManager::handleTraceCommand(Transport* source, const char* cmd) {
+  if (strcmp(cmd, "TRACE_ON") == 0) {
+    trace.start();
+  } else if (strcmp(cmd, "TRACE_OFF") == 0) {
+    trace.stop();
+  } else if (strcmp(cmd, "TRACE_CLEAR") == 0) {
+    trace.clear();
+  } else if (strcmp(cmd, "TRACE_DUMP") == 0) {
+    // Sent from the communication task, paced, to the client that asked
+    trace.requestDump(source, source->getRequester());
+    taskEvents.signal(EVENT_TRACE_DUMP);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool LinkManager::handlePowerCommand(Transport* source, const char* cmd) {
+  if (strcmp(cmd, "POWER") == 0) {
+    sendPowerReport(source);
+    return true;
+  } else if (strcmp(cmd, "POWER_RESET") == 0) {
+    powerManager.reset();
+    return true;
+  } else if (strcmp(cmd, "POWER:FULL") == 0) {
+    powerManager.setAlwaysOn(true);
+  } else if (strcmp(cmd, "POWER:AUTO") == 0) {
+    powerManager.setAlwaysOn(false);
+  } else if (startsWith(cmd, "POWER_HOLD:")) {
+    long ms = strtol(cmd + 11, nullptr, 10);
+    if (ms < 0) return true;
+    powerManager.setHoldTime(ms);
+  } else {
+    return false;
+  }
+  // The motor task times the hold; let it look at the new setting
+  taskEvents.signal(EVENT_COMMAND);
+  return true;
+}
+
+void LinkManager::sendPowerReport(Transport* source) {
+  StaticJsonDocument<384> doc;
+  doc["status"] = "power";
+  doc["state"] = powerManager.getStateName();
+  doc["holdMs"] = powerManager.getHoldTime();
+  doc["alwaysOn"] = powerManager.isAlwaysOn();
+  doc["cpuMHz"] = getCpuFrequencyMhz();
+  doc["avgMA"] = powerManager.getAverageCurrent();
+  JsonObject states = doc.createNestedObject("states");
+  PowerManager::StateReport report;
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    if (!powerManager.getState(i, report)) continue;
+    JsonArray entry = states.createNestedArray(report.name);  // mA, ms, entries, wake us, worst
+    entry.add(report.currentMa);
+    entry.add(report.timeMs);
+    entry.add(report.entries);
+    entry.add(report.lastWakeUs);
+    entry.add(report.maxWakeUs);
+  }
+
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+  source->writeTelemetry((const uint8_t*)output, length);
+}
+
+bool LinkManager::handleBootCommand(Transport* source, const char* cmd) {
+  if (strcmp(cmd, "BOOT") != 0) return false;
+  sendBootReport(source);
+  return true;
+}
+
+void LinkManager::publishBootReport() {
+  if (!isConnected()) return;
+  sendBootReport(nullptr);
+}
+
+void LinkManager::sendBootReport(Transport* target) {
+  // Two messages, the summary and the phases, each within one notification
+  char output[JSON_BUFFER_SIZE];
+  size_t length;
+  {
+    StaticJsonDocument<256> doc;
+    doc["status"] = "boot";
+    doc["setupMs"] = bootSequence.getSetupUs() / 1000;
+    doc["advMs"] = bootSequence.getAdvertisingUs() / 1000;
+    doc["readyMs"] = bootSequence.getReadyUs() / 1000;
+    doc["doneMs"] = bootSequence.getCompleteUs() / 1000;
+    uint8_t failures = bootSequence.getSelfTestFailures();
+    if (!bootSequence.isDone(BOOT_PHASE_SELF_TEST)) {
+      doc["selfTest"] = "pending";
+    } else if (failures == 0) {
+      doc["selfTest"] = "pass";
+    } else {
+      doc["selfTest"] = "fail";
+      JsonArray failed = doc.createNestedArray("failed");
+      if (failures & SELF_TEST_ULTRASONIC) failed.add("ultrasonic");
+      if (failures & SELF_TEST_IMU) failed.add("imu");
+    }
+    length = serializeJson(doc, output, sizeof(output));
+  }
+  if (target != nullptr) {
+    target->writeTelemetry((const uint8_t*)output, length);
+  } else {
+    broadcast(output, length);
+  }
+
+  {
+    StaticJsonDocument<384> doc;
+    doc["status"] = "bootPhases";
+    JsonArray phases = doc.createNestedArray("phases");   // BootPhase order
+    BootSequence::PhaseReport report;
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+      bootSequence.getPhase(i, report);
+      JsonArray entry = phases.createNestedArray();       // start ms, duration us
+      entry.add(report.startUs / 1000);
+      entry.add(report.durationUs);
+    }
+    length = serializeJson(doc, output, sizeof(output));
+  }
+  if (target != nullptr) {
+    target->writeTelemetry((const uint8_t*)output, length);
+  } else {
+    broadcast(output, length);
+  }
+}
+
+bool LinkManager::handleParamCommand(Transport* source, const char* cmd) {
+  if (strcmp(cmd, "PARAMS") == 0) {
+    sendParams(source);
+    return true;
+  } else if (strcmp(cmd, "PARAM_RESET") == 0) {
+    parameters.resetDefaults();
+    sendParams(source);
+    return true;
+  } else if (!startsWith(cmd, "PARAM:")) {
+    return false;
+  }
+
+  // PARAM:<name> reads, PARAM:<name>=<value> writes (RAM now, flash later)
+  const char* spec = cmd + 6;
+  const char* equals = strchr(spec, '=');
+  size_t nameLength = equals != nullptr ? (size_t)(equals - spec) : strlen(spec);
+  char name[16];
+  if (nameLength >= sizeof(name)) nameLength = sizeof(name) - 1;
+  memcpy(name, spec, nameLength);
+  name[nameLength] = '\0';
+
+  int id = parameters.find(name);
+  bool ok = id >= 0;
+  if (ok && equals != nullptr) {
+    ok = parameters.setText((ParamId)id, equals + 1);
+    if (!ok) LOG_WARN("Rejected %s", cmd);
+  }
+  sendParam(source, id, ok);
+  return true;
+}
+
+void LinkManager::sendParam(Transport* source, int id, bool ok) {
+  StaticJsonDocument<256> doc;
+  doc["status"] = "param";
+  doc["ok"] = ok;
+  if (id >= 0) {
+    const ParamInfo& info = parameters.getInfo((ParamId)id);
+    doc["name"] = info.name;
+    doc["type"] = info.type == PARAM_INT ? "int" : "float";
+    doc["value"] = parameters.getValue((ParamId)id);
+    doc["min"] = info.min;
+    doc["max"] = info.max;
+    doc["default"] = info.defaultValue;
+    doc["saved"] = (parameters.getDirtyMask() & (1u << id)) == 0;
+  }
+
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+  source->writeTelemetry((const uint8_t*)output, length);
+}
+
+void LinkManager::sendParams(Transport* source) {
+  // Names and values only; PARAM:<name> has the type and range
+  StaticJsonDocument<384> doc;
+  doc["status"] = "params";
+  JsonObject values = doc.createNestedObject("values");
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    values[parameters.getInfo((ParamId)i).name] = parameters.getValue((ParamId)i);
+  }
+  doc["pending"] = parameters.getDirtyMask() != 0;
+
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+  source->writeTelemetry((const uint8_t*)output, length);
+}
+
+void LinkManager::sendDiagnostics(Transport* source) {
+  // One message per task and one for the queues, to the link that asked
+  char output[JSON_BUFFER_SIZE];
+  Diagnostics::TaskReport task;
+  for (int i = 0; i < DIAG_TASK_COUNT; i++) {
+    if (!diagnostics.getTask(i, task)) continue;
+
+    StaticJsonDocument<384> doc;
+    doc["status"] = "diag";
+    doc["task"] = task.name;
+    doc["passes"] = task.passes;
+    doc["load"] = task.load;                  // percent
+    doc["busyMax"] = task.maxBusyUs;          // us
+    doc["stack"] = task.stackSize;            // bytes
+    doc["stackFree"] = task.stackFree;        // bytes never used
+    doc["lateMax"] = task.maxLateUs;          // us
+    JsonArray jitter = doc.createNestedArray("jitter");
+    for (int b = 0; b < DIAG_JITTER_BUCKETS; b++) {
+      jitter.add(task.jitter[b]);
+    }
+    size_t length = serializeJson(doc, output, sizeof(output));
+    source->writeTelemetry((const uint8_t*)output, length);
+  }
+
+  StaticJsonDocument<384> doc;
+  doc["status"] = "diag";
+  JsonObject queues = doc.createNestedObject("queues");
+  Diagnostics::QueueReport queue;
+  for (int i = 0; i < diagnostics.getQueueCount(); i++) {
+    if (!diagnostics.getQueue(i, queue)) continue;
+    JsonArray entry = queues.createNestedArray(queue.name);   // depth, peak, size
+    entry.add(queue.depth);
+    entry.add(queue.peak);
+    entry.add(queue.capacity);
+  }
+  size_t length = serializeJson(doc, output, sizeof(output));
+  source->writeTelemetry((const uint8_t*)output, length);
+}
+
+bool LinkManager::parseSubscription(const char* spec) {
+  // "distance=20,heading=20,imu=0": period in ms per named channel, 0 = off.
+  // Channels not listed keep their current rate.
+  static const char* const names[TLM_CHANNEL_COUNT] = {
+    "distance", "heading", "imu", "battery", "pose", "motor"
+  };
+
+  while (*spec != '\0') {
+    const char* eq = strchr(spec, '=');
+    if (eq == nullptr) return false;
+
+    int channel = -1;
+    for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+      if (strlen(names[ch]) == (size_t)(eq - spec) && strncmp(spec, names[ch], eq - spec) == 0) {
+        channel = ch;
+      }
+    }
+    if (channel < 0) return false;
+
+    char* end;
+    long period = strtol(eq + 1, &end, 10);
+    if (end == eq + 1 || period < 0) return false;
+    setChannelPeriod(channel, period);
+
+    spec = end;
+    if (*spec == ',') spec++;
+    else if (*spec != '\0') return false;
+  }
+  return true;
+}
+
+void LinkManager::receiveFrame(Transport* source, const uint8_t* data, size_t length) {
+  uint32_t received = millis();
+  uint8_t from = sourceOf(source);
+  uint8_t profile = source->noteActivity();
+
+  Frame frame;
+  FrameStatus status = decodeFrame(data, length, frame);
+  if (status != FRAME_OK) {
+    LOG_WARN("Rejected frame (%u bytes): %s", (unsigned)length, frameStatusName(status));
+    // Best effort: echo the seq if the header made it this far
+    Command rejected = {0, 0, length >= 5 ? readU16(data + 3) : (uint16_t)0, received, profile, from};
+    sendAck(ACK_REJECTED, rejected);
+    return;
+  }
+
+  Command command;
+  if (frameToCommand(frame, command)) {
+    command.receivedAt = received;
+    command.profile = profile;
+    command.source = from;
+    queueCommand(command);
+    return;
+  }
+
+  // Everything else is applied right here and acknowledged at once
+  bool ok = false;
+  switch (frame.opcode) {
+    case OP_ROUTE:
+      ok = applyRouteFrame(frame);
+      break;
+    case OP_PROG_BEGIN:
+      ok = programRunner.beginUpload(frame.param);
+      break;
+    case OP_PROG_DATA:
+      ok = programRunner.appendChunk(frame.param, frame.payload, frame.payloadLength);
+      break;
+    case OP_PROG_END:
+      ok = programRunner.finishUpload(frame.param);
+      break;
+    case OP_SUBSCRIBE:
+      if (frame.payloadLength == TLM_CHANNEL_COUNT * 2) {
+        for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+          setChannelPeriod(ch, readU16(frame.payload + ch * 2));
+        }
+        ok = true;
+      }
+      break;
+    case OP_TELEMETRY:
+      if (frame.param >= TELEMETRY_JSON && frame.param <= TELEMETRY_BINARY_DELTA) {
+        setTelemetryFormat((TelemetryFormat)frame.param);
+        ok = true;
+      }
+      break;
+    default:
+      if (source->handleLinkFrame(frame, ok)) break;
+      LOG_WARN("Unknown opcode 0x%02X (seq %u)", frame.opcode, frame.seq);
+      break;
+  }
+
+  Command op = {(char)frame.opcode, frame.param, frame.seq, received, profile, from};
+  sendAck(ok ? ACK_COMPLETED : ACK_REJECTED, op);
+}
+
+bool LinkManager::applyRouteFrame(const Frame& frame) {
+  if (frame.payloadLength % 4 != 0) {
+    LOG_WARN("Rejected route frame seq %u: bad payload", frame.seq);
+    return false;
+  }
+  int count = frameWaypointCount(frame);
+  if (count > ROUTE_MAX_WAYPOINTS) {
+    LOG_WARN("Rejected route frame seq %u: %d waypoints", frame.seq, count);
+    return false;
+  }
+
+  // Applied whole or not at all, as for the text upload
+  Waypoint points[ROUTE_MAX_WAYPOINTS];
+  for (int i = 0; i < count; i++) {
+    int x, y;
+    frameWaypoint(frame, i, x, y);
+    if (abs(x) > ROUTE_MAX_COORD_CM || abs(y) > ROUTE_MAX_COORD_CM) {
+      LOG_WARN("Waypoint (%d, %d) out of range", x, y);
+      return false;
+    }
+    points[i].x = x;
+    points[i].y = y;
+  }
+  bool ok = navigator.setRoute(points, count, frame.param != 0);
+  LOG_INFO("Route has %d waypoints", navigator.getRouteLength());
+  return ok;
+}
+
+void LinkManager::queueCommand(Command& command) {
+  if (command.receivedAt == 0) {
+    command.receivedAt = millis();
+  }
+  TRACE(TRACE_CMD_RECEIVED, command.seq, TRACE_COMMAND(command));
+
+  // Clamp parameters to safe ranges so a bad value can't trigger a runaway
+  // (e.g. "F99999") or otherwise multi-minute blocking move.
+  if (command.type == 'F' || command.type == 'B') {
+    command.value = constrain(command.value, 0, MAX_MOVE_DISTANCE_CM);
+  } else if (command.type == 'L' || command.type == 'R') {
+    command.value = constrain(command.value, 0, MAX_TURN_ANGLE);
+  }
+
+  if (command.type == 'S') {
+    queueStop(command);
+    return;
+  }
+
+  // Flash is being rewritten; only a stop gets through
+  if (otaUpdater.isActive()) {
+    LOG_WARN("Firmware update in progress, %c rejected", command.type);
+    sendAck(ACK_REJECTED, command);
+    return;
+  }
+
+  // Clients stay within the credit advertised in acks, so a full queue
+  // means a client overran it (or ignores flow control)
+  if (xQueueSend(commandQueue, &command, 0) != pdTRUE) {
+    LOG_WARN("Command queue full (client exceeded credit), rejecting command");
+    sendAck(ACK_REJECTED, command);
+  } else {
+    LOG_DEBUG("Command queued: %c%d (seq %u)", command.type, command.value, command.seq);
+    sendAck(ACK_QUEUED, command);
+    taskEvents.signal(EVENT_COMMAND);
+  }
+}
+
+void LinkManager::queueStop(Command& command) {
+  // A stop must interrupt any in-progress blocking move immediately, before
+  // the motor task even picks it up.
+  motorController.requestStop();
+
+  // Moves queued behind the stop would restart the robot; drop them
+  Command pending;
+  while (xQueueReceive(commandQueue, &pending, 0) == pdTRUE) {
+    sendAck(ACK_ABORTED, pending);
+  }
+
+  if (xQueueSend(priorityQueue, &command, 0) != pdTRUE) {
+    // Stops already waiting cover this one
+    LOG_INFO("Stop already pending, merged");
+    sendAck(ACK_QUEUED, command);
+    sendAck(ACK_COMPLETED, command);
+    return;
+  }
+
+  LOG_INFO("Stop queued (seq %u)", command.seq);
+  sendAck(ACK_QUEUED, command);
+  taskEvents.signal(EVENT_COMMAND);
+}
+
+void LinkManager::requestStop() {
+  Command command = {'S', 0, 0, 0, 0, 0};
+  command.receivedAt = millis();
+  queueStop(command);
+}
+
+bool LinkManager::hasCommand() {
+  return uxQueueMessagesWaiting(priorityQueue) > 0 ||
+         uxQueueMessagesWaiting(commandQueue) > 0;
+}
+
+Command LinkManager::getNextCommand() {
+  Command command = {'S', 0, 0, 0, 0, 0}; // Default
+  
+  if (xQueueReceive(priorityQueue, &command, 0) == pdTRUE ||
+      xQueueReceive(commandQueue, &command, 0) == pdTRUE) {
+    if (command.source != 0) {
+      transports[command.source - 1]->commandStarted(command);
+    }
+  }
+  
+  return command;
+}
+
+void LinkManager::broadcast(const char* data, size_t length) {
+  for (int i = 0; i < transportCount; i++) {
+    if (transports[i]->isConnected()) {
+      transports[i]->writeTelemetry((const uint8_t*)data, length);
+    }
+  }
+}
+
+void LinkManager::sendTelemetry(const TelemetrySample& sample) {
+  if (!isConnected()) return;
+  
+  StaticJsonDocument<384> doc;
+  doc["timestamp"] = sample.timestamp;
+  if (sample.channels & (1 << TLM_CH_DISTANCE)) {
+    doc["distance"] = sample.distance;
+  }
+  if (sample.channels & (1 << TLM_CH_HEADING)) {
+    doc["heading"] = sample.heading;
+  }
+  if (sample.channels & (1 << TLM_CH_IMU)) {
+    JsonArray imu = doc.createNestedArray("imu");
+    for (int i = 0; i < 6; i++) {
+      imu.add(sample.imu[i]);
+    }
+  }
+  if (sample.channels & (1 << TLM_CH_BATTERY)) {
+    doc["battery"] = sample.battery;
+    doc["temperature"] = sample.temperature;
+  }
+  if (sample.channels & (1 << TLM_CH_POSE)) {
+    doc["x"] = sample.x;
+    doc["y"] = sample.y;
+    doc["frame"] = sample.poseFrame == FRAME_ARENA ? "arena" : "odometry";
+    if (localizer.isEnabled()) {
+      doc["localized"] = localizer.isConverged();
+    }
+    if (navigator.getMode() == NAV_EXPLORE) {
+      doc["coverage"] = explorer.getCoverage();
+    }
+  }
+  if (sample.channels & (1 << TLM_CH_MOTOR)) {
+    doc["state"] = sample.robotState;
+    doc["mode"] = sample.navMode;
+  }
+  
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+  
+  broadcast(output, length);
+}
+
+void LinkManager::setChannelPeriod(int channel, uint16_t periodMs) {
+  if (channel < 0 || channel >= TLM_CHANNEL_COUNT) return;
+  if (periodMs != 0) {
+    periodMs = constrain(periodMs, TELEMETRY_MIN_PERIOD, TELEMETRY_MAX_PERIOD);
+  }
+  channelPeriod[channel] = periodMs;
+  subscriptionChanged = true;
+  taskEvents.signal(EVENT_SENSOR_PLAN);
+}
+
+void LinkManager::resetSubscriptions() {
+  // The legacy stream: the basic readings once per sensor period, which
+  // can change at run time (PARAM_SENSOR_MS)
+  for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+    channelPeriod[ch] = 0;
+  }
+  channelPeriod[TLM_CH_DISTANCE] = TELEMETRY_SENSOR_PERIOD;
+  channelPeriod[TLM_CH_HEADING] = TELEMETRY_SENSOR_PERIOD;
+  channelPeriod[TLM_CH_BATTERY] = TELEMETRY_SENSOR_PERIOD;
+  channelPeriod[TLM_CH_POSE] = TELEMETRY_SENSOR_PERIOD;
+  subscriptionChanged = true;
+  taskEvents.signal(EVENT_SENSOR_PLAN);
+}
+
+uint16_t LinkManager::periodOf(int channel) const {
+  uint16_t period = channelPeriod[channel];
+  return period == TELEMETRY_SENSOR_PERIOD ? parameters.getInt(PARAM_SENSOR_MS) : period;
+}
+
+uint8_t LinkManager::takeDueChannels() {
+  unsigned long now = millis();
+
+  // A changed subscription or sensor period starts every channel afresh
+  int32_t sensorMs = parameters.getInt(PARAM_SENSOR_MS);
+  if (subscriptionChanged || sensorMs != sensorPeriod) {
+    subscriptionChanged = false;
+    sensorPeriod = sensorMs;
+    for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+      channelNext[ch] = now;
+    }
+  }
+
+  uint8_t due = 0;
+  for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+    uint16_t period = periodOf(ch);
+    if (period == 0 || (long)(now - channelNext[ch]) < 0) continue;
+
+    due |= 1 << ch;
+    // Keep to the schedule rather than drifting by the loop jitter, but
+    // don't try to catch up after a long stall
+    channelNext[ch] += period;
+    if ((long)(now - channelNext[ch]) >= 0) {
+      channelNext[ch] = now + period;
+    }
+  }
+  return due;
+}
+
+unsigned long LinkManager::getTelemetryPeriod() const {
+  unsigned long shortest = 0;
+  for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+    uint16_t period = periodOf(ch);
+    if (period != 0 && (shortest == 0 || period < shortest)) {
+      shortest = period;
+    }
+  }
+  return shortest;
+}
+
+void LinkManager::publishTelemetry(const TelemetrySample& sample) {
+  if (isBinaryTelemetry()) {
+    addTelemetrySample(sample);
+  } else {
+    sendTelemetry(sample);
+  }
+}
+
+void LinkManager::setTelemetryFormat(TelemetryFormat format) {
+  static const char* const names[] = {"JSON", "binary", "binary delta"};
+  telemetryFormat = format;
+  LOG_INFO("Telemetry format: %s", names[format]);
+}
+
+bool LinkManager::isBinaryTelemetry() const {
+  return telemetryFormat != TELEMETRY_JSON;
+}
+
+void LinkManager::addTelemetrySample(const TelemetrySample& sample) {
+  if (!isConnected()) return;
+
+  // A format change drops the partial batch rather than mixing encodings
+  TelemetryFormat format = telemetryFormat;
+  if (format != batchFormat) {
+    batchFormat = format;
+    telemetryBatch.begin(format == TELEMETRY_BINARY_DELTA);
+  }
+
+  // One batch goes to every link, so it has to fit the smallest of them
+  size_t capacity = TELEMETRY_MAX_FRAME;
+  for (int i = 0; i < transportCount; i++) {
+    if (transports[i]->isConnected()) {
+      capacity = min(capacity, transports[i]->getMaxPayload());
+    }
+  }
+  if (telemetryBatch.sampleCount() == 0) {
+    batchStartTime = millis();
+  }
+  if (!telemetryBatch.add(sample, capacity)) {
+    flushTelemetry();
+    batchStartTime = millis();
+    telemetryBatch.add(sample, capacity);
+  }
+
+  // Slow subscriptions go out straight away instead of waiting for company
+  if (millis() - batchStartTime >= TELEMETRY_BATCH_MS ||
+      getTelemetryPeriod() >= TELEMETRY_BATCH_MS) {
+    flushTelemetry();
+  }
+}
+
+void LinkManager::flushTelemetry() {
+  if (telemetryBatch.sampleCount() > 0) {
+    broadcast((const char*)telemetryBatch.data(), telemetryBatch.size());
+  }
+  telemetryBatch.begin(batchFormat == TELEMETRY_BINARY_DELTA);
+}
+
+void LinkManager::sendAck(AckEvent event, const Command& cmd) {
+  static_assert(TRACE_CMD_REJECTED - TRACE_CMD_QUEUED == ACK_REJECTED - ACK_QUEUED,
+                "TRACE_CMD_* follow AckEvent");
+  uint8_t ack[ACK_SIZE];
+
+  TRACE(TRACE_CMD_QUEUED + event, cmd.seq, TRACE_COMMAND(cmd));
+  if (statusMutex != nullptr) traceTake(statusMutex, TRACE_MUTEX_STATUS);
+  // Sample the credit under the mutex so later notifications never carry
+  // an older count than earlier ones
+  encodeAck(event, cmd, millis(), getCredits(), ack);
+  if (cmd.source != 0) {
+    Transport* link = transports[cmd.source - 1];
+    if (link->isConnected()) link->writeAck(ack, ACK_SIZE);
+  } else {
+    // On-robot commands (program steps) are reported to everyone
+    for (int i = 0; i < transportCount; i++) {
+      if (transports[i]->isConnected()) transports[i]->writeAck(ack, ACK_SIZE);
+    }
+  }
+  if (statusMutex != nullptr) xSemaphoreGive(statusMutex);
+}
+
+void LinkManager::sendStatus(const char* status) {
+  if (!isConnected()) return;
+  
+  StaticJsonDocument<100> doc;
+  doc["status"] = status;
+  doc["timestamp"] = millis();
+  
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+  
+  broadcast(output, length);
+}
+
+void LinkManager::sendHeartbeat(const HeapStats& heap) {
+  if (!isConnected()) return;
+
+  StaticJsonDocument<256> doc;
+  doc["status"] = "heartbeat";
+  doc["timestamp"] = millis();
+  doc["heapFree"] = heap.freeBytes;
+  doc["heapLargest"] = heap.largestBlock;
+  doc["heapMin"] = heap.minFreeBytes;
+  doc["heapBlocks"] = heap.allocatedBlocks;
+  doc["heapBlocksDelta"] = heap.blocksDelta;
+  doc["heapLateAllocs"] = heap.lateAllocs;
+
+  char output[JSON_BUFFER_SIZE];
+  size_t length = serializeJson(doc, output, sizeof(output));
+
+  broadcast(output, length);
+}
+
+void LinkManager::clearCommandQueue() {
+  xQueueReset(commandQueue);
+  LOG_INFO("Command queue cleared");
+}
+
+int LinkManager::getQueueSize() {
+  return uxQueueMessagesWaiting(commandQueue);
+}
+
+int LinkManager::getCredits() {
+  return commandQueue ? uxQueueSpacesAvailable(commandQueue) : 0;
+}
+
+void LinkManager::printStatus() {
+  Serial.printf("Links - Queue size: %d, Credits: %d, Transports:", getQueueSize(), getCredits());
+  for (int i = 0; i < transportCount; i++) {
+    Serial.printf(" %s%s", transports[i]->getName(), transports[i]->isConnected() ? "*" : "");
+  }
+  Serial.println();
+}
@@ -0,0 +1,140 @@
+#ifndef LINK_MANAGER_H
+#define LINK_MANAGER_H
+
+#include <Arduino.h>
+#include "types.h"
+#include "config.h"
+#include "static_alloc.h"
+#include "protocol.h"
+#include "transport.h"
+#include "telemetry_codec.h"
+#include "heap_monitor.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+// Channel period that follows the sensorMs parameter (the default stream)
+#define TELEMETRY_SENSOR_PERIOD 0xFFFF
+
+// Telemetry encoding on the sensor characteristic
+enum TelemetryFormat {
+  TELEMETRY_JSON,           // one JSON object per notification (legacy)
+  TELEMETRY_BINARY,         // packed batches, see telemetry_codec.h
+  TELEMETRY_BINARY_DELTA    // packed batches with delta-coded samples
+};
+
+// The command protocol shared by every transport: text and binary commands
+// are parsed here, queued for the motor task and acknowledged back to the
+// link they came from, and subscribed telemetry goes out to every connected
+// link. Transports only move bytes.
+class LinkManager {
+private:
+  Transport* transports[MAX_TRANSPORTS];
+  int transportCount;
+
+  // Telemetry batching (sensor task only, apart from the requested format)
+  volatile TelemetryFormat telemetryFormat;
+  TelemetryFormat batchFormat;
+  TelemetryEncoder telemetryBatch;
+  unsigned long batchStartTime;
+
+  // Channel subscriptions: period in ms per TelemetryChannel (0 = off,
+  // or TELEMETRY_SENSOR_PERIOD). Set from the transports, scheduled by
+  // the sensor task.
+  volatile uint16_t channelPeriod[TLM_CHANNEL_COUNT];
+  volatile bool subscriptionChanged;
+  unsigned long channelNext[TLM_CHANNEL_COUNT];
+  int32_t sensorPeriod;             // sensorMs the schedule started from
+  uint16_t periodOf(int channel) const;
+
+  // Command processing
+  QueueHandle_t commandQueue;
+  QueueHandle_t priorityQueue;      // STOP lane, drained before commandQueue
+  SemaphoreHandle_t statusMutex;    // serializes ack notifications
+  QueueStorage<Command, COMMAND_QUEUE_SIZE> commandQueueStorage;
+  QueueStorage<Command, PRIORITY_QUEUE_SIZE> priorityQueueStorage;
+  MutexStorage statusMutexStorage;
+
+  // Helper functions
+  uint8_t sourceOf(Transport* transport) const;
+  Command parseCommand(const char* cmd);
+  void queueCommand(Command& command);
+  void queueStop(Command& command);
+  bool applyRouteFrame(const Frame& frame);
+  bool handleRouteUpload(const char* cmd);
+  bool handleTelemetryCommand(const char* cmd);
+  bool handleDiagnosticsCommand(Transport* source, const char* cmd);
+  bool handleTraceCommand(Transport* source, const char* cmd);
+  bool handlePowerCommand(Transport* source, const char* cmd);
+  void sendPowerReport(Transport* source);
+  bool handleBootCommand(Transport* source, const char* cmd);
+  void sendBootReport(Transport* target);   // nullptr: every connected link
+  bool handleParamCommand(Transport* source, const char* cmd);
+  void sendParam(Transport* source, int id, bool ok);
+  void sendParams(Transport* source);
+  void sendDiagnostics(Transport* source);
+  bool parseSubscription(const char* spec);
+  void sendTelemetry(const TelemetrySample& sample);
+  void broadcast(const char* data, size_t length);
+
+public:
+  LinkManager();
+  ~LinkManager();
+
+  // Initialization
+  bool begin();
+  bool addTransport(Transport* transport);
+
+  // Input from a transport. Text is NUL-terminated and may be trimmed in
+  // place; frames are decoded without copying.
+  void receiveText(Transport* source, char* text);
+  void receiveFrame(Transport* source, const uint8_t* data, size_t length);
+
+  // A transport lost its client; link settings reset once nobody is left
+  void transportClosed(Transport* transport);
+  bool isConnected() const;
+
+  // Command handling
+  bool hasCommand();
+  Command getNextCommand();
+
+  // Stop on the robot's own behalf (no client command), e.g. before a
+  // firmware update; acked to every link
+  void requestStop();
+
+  // Command lifecycle event back to the command's link (any task)
+  void sendAck(AckEvent event, const Command& cmd);
+
+  // Status messages to every connected link
+  void sendStatus(const char* status);
+  void sendHeartbeat(const HeapStats& heap);
+  // Boot timing and the deferred self-test result, once both are in
+  void publishBootReport();
+
+  // Telemetry subscriptions. The sensor task asks which channels are due,
+  // samples them and publishes the result in the current format.
+  void setChannelPeriod(int channel, uint16_t periodMs);
+  void resetSubscriptions();
+  uint8_t takeDueChannels();
+  unsigned long getTelemetryPeriod() const;   // shortest active period
+  void publishTelemetry(const TelemetrySample& sample);
+
+  // Binary telemetry: samples are batched until the message is full or
+  // TELEMETRY_BATCH_MS old. Call from the sensor task.
+  void setTelemetryFormat(TelemetryFormat format);
+  bool isBinaryTelemetry() const;
+  void addTelemetrySample(const TelemetrySample& sample);
+  void flushTelemetry();
+
+  // Queue management
+  void clearCommandQueue();
+  int getQueueSize();
+  int getCredits();       // free command queue slots advertised in acks
+
+  void printStatus();
+};
+
+// Global link manager instance
+extern LinkManager linkManager;
+
+#endif // LINK_MANAGER_H
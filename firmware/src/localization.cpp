@@ -0,0 +1,393 @@
+#include "localization.h"
+#include "arena_map.h"
+#include "task_events.h"
+#include "trace.h"
+#include <Arduino.h>
+#include <cmath>
+
+// Noise floors so a perfectly still robot still keeps some particle diversity
+#define MCL_MIN_TRANS_SIGMA_CM  0.2
+#define MCL_MIN_ROT_SIGMA_DEG   0.5
+
+// Global instance
+Localization localizer;
+
+static float normalizeAngle(float degrees) {
+  while (degrees >= 360.0) degrees -= 360.0;
+  while (degrees < 0.0) degrees += 360.0;
+  return degrees;
+}
+
+static float signedAngle(float degrees) {
+  while (degrees > 180.0) degrees -= 360.0;
+  while (degrees < -180.0) degrees += 360.0;
+  return degrees;
+}
+
+// p given relative to frame, expressed in frame's parent
+static Pose compose(const Pose& frame, const Pose& p) {
+  float rad = frame.heading * PI / 180.0;
+  float c = cos(rad), s = sin(rad);
+  return {frame.x + c * p.x - s * p.y,
+          frame.y + s * p.x + c * p.y,
+          normalizeAngle(frame.heading + p.heading)};
+}
+
+// The inverse: p given in frame's parent, expressed relative to frame
+static Pose relative(const Pose& frame, const Pose& p) {
+  float rad = frame.heading * PI / 180.0;
+  float c = cos(rad), s = sin(rad);
+  float dx = p.x - frame.x, dy = p.y - frame.y;
+  return {c * dx + s * dy, -s * dx + c * dy, normalizeAngle(p.heading - frame.heading)};
+}
+
+Localization::Localization()
+  : enabled(false),
+    mapLoaded(false),
+    hasOdometry(false),
+    lastOdometry{0.0, 0.0, 0.0},
+    estimate{0.0, 0.0, 0.0},
+    spread(0.0),
+    anchor{0.0, 0.0, 0.0},
+    anchored(false),
+    rebase{0.0, 0.0, 0.0},
+    rebasePending(false),
+    estimateMutex(nullptr),
+    rngState(1),
+    enableRequested(false),
+    startPoseRequested(false),
+    disableRequested(false),
+    lastUpdateMicros(0),
+    maxUpdateMicros(0),
+    updateCount(0) {
+}
+
+void Localization::begin() {
+  estimateMutex = estimateMutexStorage.create();
+  if (estimateMutex == nullptr) {
+    Serial.println("Warning: failed to create localization mutex");
+  }
+
+  for (int deg = 0; deg < 360; deg++) {
+    cosTable[deg] = (int16_t)lround(cos(deg * PI / 180.0) * 16384);
+    sinTable[deg] = (int16_t)lround(sin(deg * PI / 180.0) * 16384);
+  }
+
+  rngState = random(1, 0x7fffffff);
+  mapLoaded = arena.loadFromRows(ARENA_MAP, ARENA_MAP_WIDTH, ARENA_MAP_HEIGHT);
+
+  Serial.printf("Localization ready (%d particles, %dx%d arena map)\n",
+                MCL_PARTICLE_COUNT, ARENA_MAP_WIDTH, ARENA_MAP_HEIGHT);
+}
+
+void Localization::requestEnable(bool fromStart) {
+  startPoseRequested = fromStart;
+  enableRequested = true;
+  taskEvents.signal(EVENT_SENSOR_PLAN);
+}
+
+void Localization::requestDisable() {
+  disableRequested = true;
+  taskEvents.signal(EVENT_SENSOR_PLAN);
+}
+
+bool Localization::isEnabled() const {
+  return enabled;
+}
+
+bool Localization::isConverged() const {
+  return enabled && spread < MCL_CONVERGED_SPREAD_CM;
+}
+
+bool Localization::needsRange() const {
+  return enabled || enableRequested;
+}
+
+float Localization::uniform() {
+  // xorshift32: cheap and good enough for particle noise
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return (rngState >> 8) * (1.0 / 16777216.0);
+}
+
+float Localization::gaussian(float sigma) {
+  // Irwin-Hall approximation: the sum of four uniforms has variance 1/3
+  float sum = uniform() + uniform() + uniform() + uniform();
+  return (sum - 2.0) * 1.7320508 * sigma;
+}
+
+void Localization::initializeGlobal() {
+  // Spread the pool uniformly over free floor with random headings
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    int cx, cy;
+    do {
+      cx = (int)(uniform() * GRID_MAP_WIDTH);
+      cy = (int)(uniform() * GRID_MAP_HEIGHT);
+    } while (!arena.isFree(cx, cy));
+
+    float x, y;
+    arena.cellToWorld(cx, cy, x, y);
+    particles[i].x = x + (uniform() - 0.5) * GRID_CELL_SIZE_CM;
+    particles[i].y = y + (uniform() - 0.5) * GRID_CELL_SIZE_CM;
+    particles[i].heading = uniform() * 360.0;
+    particles[i].weight = 1.0 / MCL_PARTICLE_COUNT;
+  }
+  spread = MCL_MAX_RANGE_CM;
+  Serial.println("Localization: particles spread over the arena");
+}
+
+void Localization::initializeAtStart() {
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    particles[i].x = MCL_START_X_CM + gaussian(MCL_START_SPREAD_CM);
+    particles[i].y = MCL_START_Y_CM + gaussian(MCL_START_SPREAD_CM);
+    particles[i].heading = normalizeAngle(MCL_START_HEADING + gaussian(MCL_START_SPREAD_DEG));
+    particles[i].weight = 1.0 / MCL_PARTICLE_COUNT;
+  }
+  spread = MCL_START_SPREAD_CM;
+  Serial.println("Localization: particles seeded at the start pose");
+}
+
+float Localization::predict(const Pose& odometry) {
+  // Decompose the odometry delta into rotate / translate / rotate
+  float dx = odometry.x - lastOdometry.x;
+  float dy = odometry.y - lastOdometry.y;
+  float trans = sqrt(dx * dx + dy * dy);
+  float rot1 = 0.0;
+  if (trans > 0.01) {
+    rot1 = signedAngle(atan2(dy, dx) * 180.0 / PI - lastOdometry.heading);
+    // Reversing shows up as a ~180 degree rot1; keep it a backward move
+    if (fabs(rot1) > 90.0) {
+      rot1 = signedAngle(rot1 + 180.0);
+      trans = -trans;
+    }
+  }
+  float rot2 = signedAngle(odometry.heading - lastOdometry.heading - rot1);
+  lastOdometry = odometry;
+
+  float transSigma = MCL_TRANS_NOISE * fabs(trans) + MCL_MIN_TRANS_SIGMA_CM;
+  float rot1Sigma = MCL_ROT_NOISE * fabs(rot1) + MCL_MIN_ROT_SIGMA_DEG;
+  float rot2Sigma = MCL_ROT_NOISE * fabs(rot2) + MCL_MIN_ROT_SIGMA_DEG;
+
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    Particle& p = particles[i];
+    p.heading += rot1 + gaussian(rot1Sigma);
+    float t = trans + gaussian(transSigma);
+    float rad = p.heading * PI / 180.0;
+    p.x += t * cos(rad);
+    p.y += t * sin(rad);
+    p.heading = normalizeAngle(p.heading + rot2 + gaussian(rot2Sigma));
+  }
+
+  return max(fabs(trans) / MCL_MIN_MOTION_CM,
+             fabs(rot1 + rot2) / MCL_MIN_MOTION_DEG);
+}
+
+int Localization::castRay(float x, float y, float headingDeg) const {
+  // March in half-cell steps with Q8 fixed-point cell coordinates
+  int deg = ((int)lround(headingDeg) % 360 + 360) % 360;
+  int32_t px = (int32_t)((x / GRID_CELL_SIZE_CM + GRID_MAP_WIDTH / 2) * 256);
+  int32_t py = (int32_t)((y / GRID_CELL_SIZE_CM + GRID_MAP_HEIGHT / 2) * 256);
+  int32_t stepX = cosTable[deg] >> 7;   // Q14 -> Q8 half cell
+  int32_t stepY = sinTable[deg] >> 7;
+  const int maxSteps = MCL_MAX_RANGE_CM * 2 / GRID_CELL_SIZE_CM;
+
+  for (int s = 1; s <= maxSteps; s++) {
+    px += stepX;
+    py += stepY;
+    int cx = px >> 8;
+    int cy = py >> 8;
+    if (!arena.inBounds(cx, cy) || arena.isOccupied(cx, cy)) {
+      return s * GRID_CELL_SIZE_CM / 2;
+    }
+  }
+  return MCL_MAX_RANGE_CM;
+}
+
+void Localization::weigh(float measuredCM) {
+  float measured = min(measuredCM, (float)MCL_MAX_RANGE_CM);
+  const float inv2Var = 1.0 / (2.0 * MCL_SENSOR_SIGMA_CM * MCL_SENSOR_SIGMA_CM);
+  float total = 0.0;
+
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    Particle& p = particles[i];
+    int cx, cy;
+    if (!arena.worldToCell(p.x, p.y, cx, cy) || !arena.isFree(cx, cy)) {
+      p.weight = 0.0;   // inside a wall or off the map
+      continue;
+    }
+
+    float error = measured - castRay(p.x, p.y, p.heading);
+    p.weight *= exp(-error * error * inv2Var) + MCL_RANDOM_FLOOR;
+    total += p.weight;
+  }
+
+  if (total <= 0.0) {
+    // Every hypothesis is impossible: we are lost, start over
+    initializeGlobal();
+    return;
+  }
+
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    particles[i].weight /= total;
+  }
+}
+
+void Localization::resample() {
+  // Only resample once the weights have degenerated
+  float sumSquares = 0.0;
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    sumSquares += particles[i].weight * particles[i].weight;
+  }
+  if (sumSquares <= 0.0 || 1.0 / sumSquares > MCL_PARTICLE_COUNT / 2) {
+    return;
+  }
+
+  // Low-variance (systematic) resampling: one random draw, O(N)
+  const float step = 1.0 / MCL_PARTICLE_COUNT;
+  float r = uniform() * step;
+  float cumulative = particles[0].weight;
+  int source = 0;
+
+  for (int m = 0; m < MCL_PARTICLE_COUNT; m++) {
+    float u = r + m * step;
+    while (u > cumulative && source < MCL_PARTICLE_COUNT - 1) {
+      source++;
+      cumulative += particles[source].weight;
+    }
+    resampled[m] = particles[source];
+    resampled[m].weight = step;
+  }
+
+  memcpy(particles, resampled, sizeof(particles));
+}
+
+void Localization::computeEstimate() {
+  float x = 0.0, y = 0.0, c = 0.0, s = 0.0;
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    const Particle& p = particles[i];
+    float rad = p.heading * PI / 180.0;
+    x += p.weight * p.x;
+    y += p.weight * p.y;
+    c += p.weight * cos(rad);
+    s += p.weight * sin(rad);
+  }
+
+  float variance = 0.0;
+  for (int i = 0; i < MCL_PARTICLE_COUNT; i++) {
+    const Particle& p = particles[i];
+    variance += p.weight * ((p.x - x) * (p.x - x) + (p.y - y) * (p.y - y));
+  }
+
+  if (estimateMutex != nullptr) traceTake(estimateMutex, TRACE_MUTEX_ESTIMATE);
+  estimate.x = x;
+  estimate.y = y;
+  estimate.heading = normalizeAngle(atan2(s, c) * 180.0 / PI);
+  spread = sqrt(variance);
+  if (isConverged()) {
+    // The correction that carries the current odometry onto the estimate
+    float heading = normalizeAngle(estimate.heading - lastOdometry.heading);
+    Pose rotated = compose({0.0, 0.0, heading}, lastOdometry);
+    anchor = {estimate.x - rotated.x, estimate.y - rotated.y, heading};
+    anchored = true;
+  }
+  if (estimateMutex != nullptr) xSemaphoreGive(estimateMutex);
+}
+
+void Localization::update(const Pose& odometry, float distanceCM) {
+  if (estimateMutex != nullptr) traceTake(estimateMutex, TRACE_MUTEX_ESTIMATE);
+  if (rebasePending) {
+    rebasePending = false;
+    lastOdometry = relative(rebase, lastOdometry);
+  }
+  if (estimateMutex != nullptr) xSemaphoreGive(estimateMutex);
+
+  if (disableRequested) {
+    disableRequested = false;
+    enableRequested = false;
+    enabled = false;
+    Serial.println("Localization disabled");
+  }
+
+  if (enableRequested) {
+    enableRequested = false;
+    if (!mapLoaded) {
+      Serial.println("Localization unavailable: no arena map loaded");
+    } else {
+      if (startPoseRequested) {
+        initializeAtStart();
+      } else {
+        initializeGlobal();
+      }
+      hasOdometry = false;
+      enabled = true;
+      Serial.println("Localization enabled");
+    }
+  }
+
+  if (!enabled) return;
+
+  unsigned long start = micros();
+
+  bool measure = true;
+  if (hasOdometry) {
+    // Re-weighing a stationary robot with the same echo would collapse the
+    // particle cloud onto noise, so only fold in readings after real motion.
+    measure = predict(odometry) >= 1.0;
+  } else {
+    lastOdometry = odometry;
+    hasOdometry = true;
+  }
+
+  if (measure) {
+    weigh(distanceCM);
+    resample();
+  }
+  computeEstimate();
+
+  lastUpdateMicros = micros() - start;
+  if (lastUpdateMicros > maxUpdateMicros) maxUpdateMicros = lastUpdateMicros;
+  updateCount++;
+}
+
+Pose Localization::getPose() const {
+  if (estimateMutex != nullptr) traceTake(estimateMutex, TRACE_MUTEX_ESTIMATE);
+  Pose result = estimate;
+  if (estimateMutex != nullptr) xSemaphoreGive(estimateMutex);
+  return result;
+}
+
+float Localization::getSpread() const {
+  return spread;
+}
+
+bool Localization::toArena(const Pose& odometry, Pose& out) const {
+  if (estimateMutex != nullptr) traceTake(estimateMutex, TRACE_MUTEX_ESTIMATE);
+  bool valid = anchored;
+  Pose frame = anchor;
+  if (estimateMutex != nullptr) xSemaphoreGive(estimateMutex);
+  if (valid) out = compose(frame, odometry);
+  return valid;
+}
+
+void Localization::rebaseOdometry(const Pose& origin) {
+  // The anchor moves at once so readers never pair it with the new
+  // odometry; lastOdometry belongs to the sensor task and follows in update()
+  if (estimateMutex != nullptr) traceTake(estimateMutex, TRACE_MUTEX_ESTIMATE);
+  if (anchored) anchor = compose(anchor, origin);
+  rebase = rebasePending ? compose(rebase, origin) : origin;
+  rebasePending = true;
+  if (estimateMutex != nullptr) xSemaphoreGive(estimateMutex);
+}
+
+void Localization::printStatus() {
+  Pose pose = getPose();
+  Serial.println("=== Localization ===");
+  Serial.printf("Enabled: %s, converged: %s\n",
+                enabled ? "YES" : "NO", isConverged() ? "YES" : "NO");
+  Serial.printf("Estimate: x=%.1f cm, y=%.1f cm, heading=%.1f deg (spread %.1f cm)\n",
+                pose.x, pose.y, pose.heading, spread);
+  Serial.printf("Update time: last %lu us, max %lu us over %lu updates (%d particles)\n",
+                lastUpdateMicros, maxUpdateMicros, updateCount, MCL_PARTICLE_COUNT);
+  Serial.println("====================");
+}
@@ -0,0 +1,108 @@
+#ifndef LOCALIZATION_H
+#define LOCALIZATION_H
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "types.h"
+#include "config.h"
+#include "static_alloc.h"
+#include "grid_map.h"
+
+// Monte Carlo localization: a fixed pool of pose hypotheses is moved with
+// the step odometry, weighted by how well the ultrasonic range matches a
+// ray cast through the stored arena map, and resampled. Runs on the sensor
+// task; the motor task only toggles it through request flags.
+class Localization {
+private:
+  struct Particle {
+    float x;        // cm, arena frame (world (0, 0) = arena center)
+    float y;
+    float heading;  // degrees, same convention as Pose
+    float weight;
+  };
+
+  GridMap arena;
+  Particle particles[MCL_PARTICLE_COUNT];
+  Particle resampled[MCL_PARTICLE_COUNT];
+
+  // Q14 cos/sin per whole degree for the integer ray caster
+  int16_t cosTable[360];
+  int16_t sinTable[360];
+
+  bool enabled;
+  bool mapLoaded;
+  bool hasOdometry;
+  Pose lastOdometry;
+  Pose estimate;
+  float spread;
+  Pose anchor;            // odometry -> arena, from the last converged estimate
+  bool anchored;
+  Pose rebase;            // odometry resets not yet applied to lastOdometry
+  bool rebasePending;
+  SemaphoreHandle_t estimateMutex;   // estimate, anchor and rebase are shared
+  MutexStorage estimateMutexStorage;
+  uint32_t rngState;
+
+  // Cross-task requests, serviced at the start of update()
+  volatile bool enableRequested;
+  volatile bool startPoseRequested;
+  volatile bool disableRequested;
+
+  // Diagnostics
+  unsigned long lastUpdateMicros;
+  unsigned long maxUpdateMicros;
+  unsigned long updateCount;
+
+  // Filter stages
+  void initializeGlobal();
+  void initializeAtStart();
+  float predict(const Pose& odometry);   // returns motion size for gating
+  void weigh(float measuredCM);
+  void resample();
+  void computeEstimate();
+
+  int castRay(float x, float y, float headingDeg) const;
+  float uniform();
+  float gaussian(float sigma);
+
+public:
+  Localization();
+
+  // Initialization
+  void begin();
+
+  // Mode control (safe to call from any task). With fromStart the pool is
+  // seeded around the configured start pose (MCL_START_*) instead of being
+  // spread over the whole arena; a single forward sensor makes global
+  // localization slow to disambiguate in a symmetric arena.
+  void requestEnable(bool fromStart = false);
+  void requestDisable();
+  bool isEnabled() const;
+  bool isConverged() const;
+  bool needsRange() const;    // the next update() will use the range reading
+
+  // One filter iteration: odometry pose from MotorControl and the latest
+  // ultrasonic range. Call at MCL_UPDATE_RATE from the sensor task.
+  void update(const Pose& odometry, float distanceCM);
+
+  // Best pose estimate in the arena frame
+  Pose getPose() const;
+  float getSpread() const;
+
+  // Odometry carried into the arena frame through the last converged
+  // estimate, so it stays continuous when convergence comes and goes.
+  // Returns false until the filter has converged once.
+  bool toArena(const Pose& odometry, Pose& out) const;
+
+  // The odometry pose was reset; origin is the pose it had (any task)
+  void rebaseOdometry(const Pose& origin);
+
+  // Diagnostics
+  void printStatus();
+};
+
+// Global localization instance
+extern Localization localizer;
+
+#endif // LOCALIZATION_H
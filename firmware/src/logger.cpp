@@ -0,0 +1,319 @@
+#include "logger.h"
+#include "trace.h"
+#include <Arduino.h>
+#include <string.h>
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Global instance
+Logger logger;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+static const char LEVEL_TAGS[] = "-EWID";
+
+static void logTask(void* parameter) {
+  for (;;) {
+    logger.drain();
+    if (logger.getPending() > 0) {
+      // A producer claimed a slot but hasn't filled it yet
+      vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+      continue;
+    }
+
+    // Sleep until the next record, then give the burst LOG_DRAIN_MS to
+    // collect so one wake-up prints all of it
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+  }
+}
+
+Logger::Logger()
+  : writePos(0),
+    readPos(0),
+    dropped(0),
+    wakePending(false),
+    drainTask(nullptr),
+    binarySink(nullptr),
+    serialBinary(LOG_SERIAL_BINARY) {
+  static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+  for (uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+void Logger::begin() {
+  TaskHandle_t task = drainTaskStorage.create(
+    logTask,
+    "LogTask",
+    nullptr,
+    LOG_TASK_PRIORITY,
+    0                           // with the sensor task, away from stepping
+  );
+  drainTask = task;
+  trace.registerTask(task, "log");
+}
+
+void Logger::push(const LogRecord& record) {
+  uint32_t pos = writePos.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot& slot = slots[pos & (LOG_RING_SIZE - 1)];
+    uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    int32_t diff = (int32_t)(sequence - pos);
+    if (diff == 0) {
+      // Free for this position: claim it, then fill it
+      if (writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        slot.record = record;
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        // One notification per batch: the drain task clears the flag
+        // before it empties the ring
+        TaskHandle_t task = drainTask;
+        if (task != nullptr && !wakePending.exchange(true, std::memory_order_acq_rel)) {
+          xTaskNotifyGive(task);
+        }
+        return;
+      }
+    } else if (diff < 0) {
+      // Still holds a record from one lap ago: the ring is full. Logging
+      // must never hold up the caller, so the record is lost.
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = writePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Logger::pop(LogRecord& record) {
+  Slot& slot = slots[readPos & (LOG_RING_SIZE - 1)];
+  uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+  if (sequence != readPos + 1) {
+    return false;                 // empty, or the producer is still writing
+  }
+  record = slot.record;
+  slot.sequence.store(readPos + LOG_RING_SIZE, std::memory_order_release);
+  readPos++;
+  return true;
+}
+
+int Logger::drain() {
+  static uint32_t reportedDrops = 0;
+  int count = 0;
+  LogRecord record;
+
+  wakePending.store(false, std::memory_order_release);
+  while (pop(record)) {
+    emit(record);
+    count++;
+  }
+
+  uint32_t drops = dropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    Serial.printf("[log] %lu records dropped\n", (unsigned long)(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+  return count;
+}
+
+void Logger::emit(const LogRecord& record) {
+  uint8_t encoded[LOG_MAX_ENCODED];
+  size_t encodedLength = 0;
+  LogSink sink = binarySink;
+
+  if (serialBinary || sink != nullptr) {
+    encodedLength = encode(record, encoded);
+  }
+
+  if (sink != nullptr) {
+    sink(encoded, encodedLength);
+  }
+
+  // One write per line, so lines from other writers can't split it
+  char line[2 * LOG_MAX_ENCODED + 8];
+  size_t n = 0;
+  if (serialBinary) {
+    line[n++] = '@';
+    line[n++] = 'L';
+    line[n++] = ' ';
+    for (size_t i = 0; i < encodedLength; i++) {
+      line[n++] = HEX_DIGITS[encoded[i] >> 4];
+      line[n++] = HEX_DIGITS[encoded[i] & 0x0F];
+    }
+  } else {
+    int prefix = snprintf(line, sizeof(line), "%lu %c ",
+                          (unsigned long)record.timestamp, LEVEL_TAGS[record.level & 0x07]);
+    n = prefix > 0 ? prefix : 0;
+    n += format(record, line + n, sizeof(line) - n - 1);
+  }
+  line[n++] = '\n';
+  Serial.write((const uint8_t*)line, n);
+}
+
+size_t Logger::format(const LogRecord& record, char* out, size_t size) {
+  if (size == 0) return 0;
+
+  const char* p = record.format;
+  const char* text = record.text;
+  const char* textEnd = record.text + record.textLength;
+  uint8_t arg = 0;
+  size_t n = 0;
+
+  while (*p != '\0' && n + 1 < size) {
+    if (*p != '%') {
+      out[n++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[n++] = '%';
+      p += 2;
+      continue;
+    }
+
+    // Copy one conversion spec without its length modifiers; every
+    // argument was widened to 32 bits (or float) when it was recorded
+    char spec[16];
+    size_t s = 0;
+    spec[s++] = *p++;
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr && s < sizeof(spec) - 3) {
+      spec[s++] = *p++;
+    }
+    while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) {
+      p++;
+    }
+    char conversion = *p;
+    if (conversion == '\0') break;
+    p++;
+
+    int written = 0;
+    size_t room = size - n;
+    if (arg >= record.argc) {
+      written = snprintf(out + n, room, "?");
+    } else {
+      LogArgType type = (LogArgType)((record.types >> (2 * arg)) & 0x03);
+      uint32_t raw = record.args[arg];
+      arg++;
+
+      if (type == LOG_ARG_TEXT || conversion == 's') {
+        spec[s++] = 's';
+        spec[s] = '\0';
+        const char* value = "";
+        if (type == LOG_ARG_TEXT && text < textEnd) {
+          value = text;
+          text += strlen(text) + 1;
+        }
+        written = snprintf(out + n, room, spec, value);
+      } else if (type == LOG_ARG_FLOAT || strchr("fFeEgGaA", conversion) != nullptr) {
+        float value;
+        if (type == LOG_ARG_FLOAT) {
+          memcpy(&value, &raw, sizeof(value));
+        } else {
+          value = (type == LOG_ARG_INT) ? (float)(int32_t)raw : (float)raw;
+        }
+        spec[s++] = strchr("fFeEgGaA", conversion) != nullptr ? conversion : 'f';
+        spec[s] = '\0';
+        written = snprintf(out + n, room, spec, (double)value);
+      } else if (conversion == 'c') {
+        spec[s++] = 'c';
+        spec[s] = '\0';
+        written = snprintf(out + n, room, spec, (int)raw);
+      } else if (conversion == 'p') {
+        written = snprintf(out + n, room, "0x%08lx", (unsigned long)raw);
+      } else {
+        spec[s++] = 'l';
+        spec[s++] = strchr("diuxXo", conversion) != nullptr ? conversion : 'd';
+        spec[s] = '\0';
+        if (type == LOG_ARG_INT) {
+          written = snprintf(out + n, room, spec, (long)(int32_t)raw);
+        } else {
+          written = snprintf(out + n, room, spec, (unsigned long)raw);
+        }
+      }
+    }
+
+    if (written < 0) break;
+    n += ((size_t)written < room) ? (size_t)written : room - 1;
+  }
+
+  out[n] = '\0';
+  return n;
+}
+
+size_t Logger::encode(const LogRecord& record, uint8_t* out) {
+  uint32_t format = (uint32_t)(uintptr_t)record.format;
+  size_t n = 0;
+
+  out[n++] = LOG_MAGIC;
+  out[n++] = (record.level << 4) | (record.argc & 0x0F);
+  out[n++] = record.types & 0xFF;
+  out[n++] = record.types >> 8;
+  for (int i = 0; i < 4; i++) out[n++] = (record.timestamp >> (8 * i)) & 0xFF;
+  for (int i = 0; i < 4; i++) out[n++] = (format >> (8 * i)) & 0xFF;
+  for (uint8_t a = 0; a < record.argc; a++) {
+    for (int i = 0; i < 4; i++) out[n++] = (record.args[a] >> (8 * i)) & 0xFF;
+  }
+  out[n++] = record.textLength;
+  memcpy(out + n, record.text, record.textLength);
+  n += record.textLength;
+  return n;
+}
+
+void Logger::setBinarySink(LogSink sink) {
+  binarySink = sink;
+}
+
+void Logger::setSerialBinary(bool enabled) {
+  serialBinary = enabled;
+}
+
+uint32_t Logger::getDropped() const {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t Logger::getPending() const {
+  // Claimed slots count even if their producer is still filling them in
+  return writePos.load(std::memory_order_relaxed) - readPos;
+}
+
+void logBegin(LogRecord& record, uint8_t level, const char* format) {
+  record.timestamp = millis();
+  record.format = format;
+  record.level = level;
+  record.argc = 0;
+  record.types = 0;
+  record.textLength = 0;
+}
+
+static bool logAddRaw(LogRecord& record, LogArgType type, uint32_t value) {
+  if (record.argc >= LOG_MAX_ARGS) return false;
+  record.types |= (uint16_t)type << (2 * record.argc);
+  record.args[record.argc++] = value;
+  return true;
+}
+
+void logAddInt(LogRecord& record, int32_t value) {
+  logAddRaw(record, LOG_ARG_INT, (uint32_t)value);
+}
+
+void logAddUint(LogRecord& record, uint32_t value) {
+  logAddRaw(record, LOG_ARG_UINT, value);
+}
+
+void logAddFloat(LogRecord& record, float value) {
+  uint32_t raw;
+  memcpy(&raw, &value, sizeof(raw));
+  logAddRaw(record, LOG_ARG_FLOAT, raw);
+}
+
+void logAddText(LogRecord& record, const char* text) {
+  if (!logAddRaw(record, LOG_ARG_TEXT, 0)) return;
+  if (text == nullptr) text = "(null)";
+
+  // Each string is stored NUL-terminated; a full text area keeps the
+  // strings that fit and the rest print empty
+  size_t room = LOG_TEXT_SIZE - record.textLength;
+  if (room == 0) return;
+  size_t length = strnlen(text, room - 1);
+  memcpy(record.text + record.textLength, text, length);
+  record.text[record.textLength + length] = '\0';
+  record.textLength += length + 1;
+}
@@ -0,0 +1,189 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+#include "config.h"
+#include "static_alloc.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Deferred binary logging. LOG_*() copies the format string's address and
+// the raw arguments into a lock-free ring (any task or core, never blocks);
+// a low-priority task formats and prints them later, so motion code doesn't
+// stall on a 115200 baud UART. Levels above LOG_LEVEL compile to nothing.
+//
+// Records can also leave the robot in binary, as
+//
+//   [0]     magic      LOG_MAGIC
+//   [1]     level << 4 | argument count
+//   [2..3]  types      u16, 2 bits per argument (LogArgType)
+//   [4..7]  timestamp  u32 ms since boot
+//   [8..11] format     u32 address of the format string in the firmware
+//   then    u32 per argument, u8 text length, inline text (the %s args,
+//           each NUL-terminated)
+//
+// tools/decode_log.py looks the format up in firmware.elf and prints the
+// line. Format strings must be literals.
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+#define LOG_MAGIC           0xE7
+#define LOG_MAX_ARGS        6
+#define LOG_TEXT_SIZE       32      // inline bytes for %s arguments
+#define LOG_HEADER_SIZE     12
+#define LOG_MAX_ENCODED     (LOG_HEADER_SIZE + 4 * LOG_MAX_ARGS + 1 + LOG_TEXT_SIZE)
+
+enum LogArgType {
+  LOG_ARG_INT,
+  LOG_ARG_UINT,
+  LOG_ARG_FLOAT,
+  LOG_ARG_TEXT      // copied into the record's text area
+};
+
+struct LogRecord {
+  uint32_t timestamp;
+  const char* format;
+  uint8_t level;
+  uint8_t argc;
+  uint16_t types;
+  uint32_t args[LOG_MAX_ARGS];
+  uint8_t textLength;
+  char text[LOG_TEXT_SIZE];
+};
+
+// Receives encoded records, e.g. a BLE log characteristic
+typedef void (*LogSink)(const uint8_t* data, size_t length);
+
+class Logger {
+private:
+  // Bounded MPMC ring (Vyukov): a slot's sequence says whether it is free
+  // for the producer at that position or ready for the consumer
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    LogRecord record;
+  };
+
+  Slot slots[LOG_RING_SIZE];
+  std::atomic<uint32_t> writePos;
+  uint32_t readPos;                   // drain task only
+  std::atomic<uint32_t> dropped;
+  std::atomic<bool> wakePending;      // drain task notified, not yet draining
+  TaskHandle_t volatile drainTask;
+  TaskStorage<LOG_TASK_STACK> drainTaskStorage;
+  volatile LogSink binarySink;
+  volatile bool serialBinary;
+
+  bool pop(LogRecord& record);
+  void emit(const LogRecord& record);
+
+public:
+  Logger();
+
+  void begin();                      // starts the drain task
+
+  // Producer side (any task)
+  void push(const LogRecord& record);
+
+  // Drain side: print everything queued; returns the number of records
+  int drain();
+
+  void setBinarySink(LogSink sink);   // nullptr = off
+  void setSerialBinary(bool enabled); // "@L <hex>" lines instead of text
+  uint32_t getDropped() const;
+  uint32_t getPending() const;       // records not yet drained (approximate)
+
+  // Render a record as text; returns the length
+  static size_t format(const LogRecord& record, char* out, size_t size);
+  static size_t encode(const LogRecord& record, uint8_t* out);
+};
+
+// Global logger instance
+extern Logger logger;
+
+// Argument capture. Integers are stored as 32 bits, floating point as a
+// float, strings are copied (truncated to what's left of LOG_TEXT_SIZE).
+void logBegin(LogRecord& record, uint8_t level, const char* format);
+void logAddInt(LogRecord& record, int32_t value);
+void logAddUint(LogRecord& record, uint32_t value);
+void logAddFloat(LogRecord& record, float value);
+void logAddText(LogRecord& record, const char* text);
+
+inline void logAddArg(LogRecord& r, int v) { logAddInt(r, v); }
+inline void logAddArg(LogRecord& r, long v) { logAddInt(r, (int32_t)v); }
+inline void logAddArg(LogRecord& r, short v) { logAddInt(r, v); }
+inline void logAddArg(LogRecord& r, char v) { logAddInt(r, v); }
+inline void logAddArg(LogRecord& r, signed char v) { logAddInt(r, v); }
+inline void logAddArg(LogRecord& r, bool v) { logAddInt(r, v); }
+inline void logAddArg(LogRecord& r, unsigned int v) { logAddUint(r, v); }
+inline void logAddArg(LogRecord& r, unsigned long v) { logAddUint(r, (uint32_t)v); }
+inline void logAddArg(LogRecord& r, unsigned short v) { logAddUint(r, v); }
+inline void logAddArg(LogRecord& r, unsigned char v) { logAddUint(r, v); }
+inline void logAddArg(LogRecord& r, float v) { logAddFloat(r, v); }
+inline void logAddArg(LogRecord& r, double v) { logAddFloat(r, (float)v); }
+inline void logAddArg(LogRecord& r, const char* v) { logAddText(r, v); }
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value>::type logAddArg(LogRecord& r, T v) {
+  logAddInt(r, (int32_t)v);
+}
+
+inline void logAddArgs(LogRecord&) {}
+
+template<typename T, typename... Rest>
+inline void logAddArgs(LogRecord& r, T first, Rest... rest) {
+  logAddArg(r, first);
+  logAddArgs(r, rest...);
+}
+
+template<typename... Args>
+inline void logWrite(uint8_t level, const char* format, Args... args) {
+  LogRecord record;
+  logBegin(record, level, format);
+  logAddArgs(record, args...);
+  logger.push(record);
+}
+
+// Never called; lets the compiler check the format against the arguments
+void logFormatCheck(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#define LOG_AT(level, fmt, ...) do { \
+    if (0) logFormatCheck(fmt, ##__VA_ARGS__); \
+    logWrite(level, fmt, ##__VA_ARGS__); \
+  } while (0)
+
+// Compiled out, but still type-checked and counting as a use of its args
+#define LOG_ELIDED(fmt, ...) do { \
+    if (0) logFormatCheck(fmt, ##__VA_ARGS__); \
+  } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) LOG_ELIDED(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) LOG_ELIDED(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) LOG_ELIDED(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) LOG_ELIDED(fmt, ##__VA_ARGS__)
+#endif
+
+#endif // LOGGER_H
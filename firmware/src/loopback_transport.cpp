@@ -0,0 +1,114 @@
+#include "loopback_transport.h"
+#include "link_manager.h"
+#include <string.h>
+
+LoopbackTransport::LoopbackTransport()
+  : head(0),
+    tail(0),
+    used(0),
+    dropped(0),
+    open(false),
+    mutex(nullptr) {
+}
+
+bool LoopbackTransport::begin() {
+  // The robot writes from several tasks; the client reads from its own
+  mutex = mutexStorage.create();
+  if (mutex == nullptr) {
+    Serial.println("Failed to create loopback mutex");
+    return false;
+  }
+  open = true;
+  return true;
+}
+
+void LoopbackTransport::setOpen(bool isOpen) {
+  open = isOpen;
+  if (!open) {
+    linkManager.transportClosed(this);
+  }
+}
+
+void LoopbackTransport::sendText(const char* cmd) {
+  // Parsing trims in place, so work on a copy
+  strncpy(textBuffer, cmd, COMMAND_MAX_LENGTH);
+  textBuffer[COMMAND_MAX_LENGTH] = '\0';
+  linkManager.receiveText(this, textBuffer);
+}
+
+void LoopbackTransport::sendFrame(const uint8_t* data, size_t length) {
+  linkManager.receiveFrame(this, data, length);
+}
+
+void LoopbackTransport::putByte(uint8_t value) {
+  ring[head] = value;
+  head = (head + 1) % LOOPBACK_BUFFER_SIZE;
+  used++;
+}
+
+uint8_t LoopbackTransport::takeByte() {
+  uint8_t value = ring[tail];
+  tail = (tail + 1) % LOOPBACK_BUFFER_SIZE;
+  used--;
+  return value;
+}
+
+void LoopbackTransport::push(MessageKind kind, const uint8_t* data, size_t length) {
+  if (!open || mutex == nullptr) return;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (length > 0xFFFF || used + 3 + length > LOOPBACK_BUFFER_SIZE) {
+    // A slow reader loses new messages rather than blocking the robot
+    dropped++;
+  } else {
+    putByte(kind);
+    putByte(length & 0xFF);
+    putByte(length >> 8);
+    for (size_t i = 0; i < length; i++) {
+      putByte(data[i]);
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+size_t LoopbackTransport::receive(MessageKind& kind, uint8_t* out, size_t capacity) {
+  if (mutex == nullptr) return 0;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  size_t copied = 0;
+  if (used > 0) {
+    kind = (MessageKind)takeByte();
+    size_t length = takeByte();
+    length |= (size_t)takeByte() << 8;
+    for (size_t i = 0; i < length; i++) {
+      uint8_t value = takeByte();
+      if (i < capacity) out[copied++] = value;
+    }
+  }
+  xSemaphoreGive(mutex);
+  return copied;
+}
+
+uint32_t LoopbackTransport::getDropped() const {
+  return dropped;
+}
+
+const char* LoopbackTransport::getName() const {
+  return "Loopback";
+}
+
+bool LoopbackTransport::isConnected() const {
+  return open;
+}
+
+size_t LoopbackTransport::getMaxPayload() const {
+  return TELEMETRY_MAX_FRAME;
+}
+
+void LoopbackTransport::writeTelemetry(const uint8_t* data, size_t length) {
+  push(LOOPBACK_TELEMETRY, data, length);
+}
+
+void LoopbackTransport::writeAck(const uint8_t* data, size_t length) {
+  push(LOOPBACK_ACK, data, length);
+}
@@ -0,0 +1,62 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "static_alloc.h"
+#include "transport.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// An in-process link: code on the robot (or a host test harness) sends
+// commands with the same parsing, queueing and acks as a real client, and
+// reads back what the robot sent, oldest first. Nothing leaves the chip,
+// so benchmarks see the firmware's own cost without any radio or UART.
+class LoopbackTransport : public Transport {
+public:
+  enum MessageKind : uint8_t {
+    LOOPBACK_TELEMETRY,
+    LOOPBACK_ACK
+  };
+
+private:
+  // Output ring of [kind][u16 length][bytes] records
+  uint8_t ring[LOOPBACK_BUFFER_SIZE];
+  size_t head;                      // next byte to write
+  size_t tail;                      // next byte to read
+  size_t used;
+  uint32_t dropped;                 // messages that didn't fit
+  bool open;
+  char textBuffer[COMMAND_MAX_LENGTH + 1];
+  SemaphoreHandle_t mutex;
+  MutexStorage mutexStorage;
+
+  void push(MessageKind kind, const uint8_t* data, size_t length);
+  void putByte(uint8_t value);
+  uint8_t takeByte();
+
+public:
+  LoopbackTransport();
+
+  bool begin();
+  void setOpen(bool isOpen);      // a closed link receives nothing
+
+  // Client side: send a text command or a binary frame
+  void sendText(const char* cmd);
+  void sendFrame(const uint8_t* data, size_t length);
+
+  // Client side: take the oldest message the robot sent. Returns its length
+  // (truncated to capacity), or 0 if there is none.
+  size_t receive(MessageKind& kind, uint8_t* out, size_t capacity);
+  uint32_t getDropped() const;
+
+  // Transport
+  const char* getName() const override;
+  bool isConnected() const override;
+  size_t getMaxPayload() const override;
+  void writeTelemetry(const uint8_t* data, size_t length) override;
+  void writeAck(const uint8_t* data, size_t length) override;
+};
+
+#endif // LOOPBACK_TRANSPORT_H
@@ -26,13 +26,32 @@
 #include "motor_control.h"
 #include "sensor_manager.h"
 #include "ble_communication.h"
+#include "link_manager.h"
+#include "serial_transport.h"
 #include "navigation.h"
+#include "localization.h"
+#include "program_runner.h"
+#include "heap_monitor.h"
+#include "logger.h"
+#include "ota_update.h"
+#include "diagnostics.h"
+#include "task_events.h"
+#include "trace.h"
+#include "power_manager.h"
+#include "static_alloc.h"
+#include "boot_sequence.h"
+#include "parameters.h"
 
 // Task handles
 TaskHandle_t motorTaskHandle = NULL;
 TaskHandle_t sensorTaskHandle = NULL;
 TaskHandle_t communicationTaskHandle = NULL;
 
+// Task stacks (static with STATIC_ALLOCATION)
+static TaskStorage<MOTOR_TASK_STACK> motorTaskStorage;
+static TaskStorage<SENSOR_TASK_STACK> sensorTaskStorage;
+static TaskStorage<COMM_TASK_STACK> communicationTaskStorage;
+
 // Global state
 RobotState currentState = IDLE;
 unsigned long lastHeartbeat = 0;
@@ -43,129 +62,235 @@ void motorTask(void *parameter);
 void sensorTask(void *parameter);
 void communicationTask(void *parameter);
 void executeCommand(const Command& cmd);
+TelemetrySample collectTelemetry(uint8_t channels);
 void printSystemStatus();
-void handleSystemError(const String& error);
+void handleSystemError(const char* error);
 bool initializeSystem();
+void endBootPhase(BootPhase phase);
 
 void setup() {
+  bool bootEvents = bootSequence.begin();
   Serial.begin(115200);
-  delay(1000); // Wait for serial monitor
+#if BOOT_CONSOLE_WAIT_MS > 0
+  delay(BOOT_CONSOLE_WAIT_MS); // Wait for serial monitor
+#endif
   
   Serial.println("========================================");
   Serial.println("E-Bug Educational Robot Starting...");
   Serial.println("Version: 1.0.0");
   Serial.println("========================================");
+
+  // Start the log drain first so subsystems can log while they come up
+  logger.begin();
+
+  // Tasks sleep on these until there is work
+  if (!taskEvents.begin()) {
+    Serial.println("WARNING: task events unavailable, tasks will poll");
+  }
+  if (!bootEvents) {
+    Serial.println("WARNING: boot events unavailable, tasks will poll");
+  }
+  bootSequence.finish(BOOT_PHASE_CONSOLE);
   
-  // Initialize all subsystems
+  // Bring up the links and start advertising
   if (!initializeSystem()) {
     Serial.println("FATAL: System initialization failed!");
     handleSystemError("System initialization failed");
     return;
   }
   
-  // Create FreeRTOS tasks
+  // Create FreeRTOS tasks; motors and sensors come up inside them
   Serial.println("Creating system tasks...");
+  bootSequence.start(BOOT_PHASE_TASKS);
   
   // Motor control task (Core 1 - for real-time control)
-  xTaskCreatePinnedToCore(
+  motorTaskHandle = motorTaskStorage.create(
     motorTask,                    // Task function
     "MotorTask",                 // Task name
-    MOTOR_TASK_STACK,            // Stack size
     NULL,                        // Parameters
     2,                           // Priority (high)
-    &motorTaskHandle,            // Task handle
     1                            // Core 1
   );
   
   // Sensor management task (Core 0)
-  xTaskCreatePinnedToCore(
+  sensorTaskHandle = sensorTaskStorage.create(
     sensorTask,                  // Task function
     "SensorTask",               // Task name
-    SENSOR_TASK_STACK,          // Stack size
     NULL,                       // Parameters
     1,                          // Priority (medium)
-    &sensorTaskHandle,          // Task handle
     0                           // Core 0
   );
   
   // Communication task (Core 0)
-  xTaskCreatePinnedToCore(
+  communicationTaskHandle = communicationTaskStorage.create(
     communicationTask,           // Task function
     "CommTask",                 // Task name
-    COMM_TASK_STACK,            // Stack size
     NULL,                       // Parameters
     1,                          // Priority (medium)
-    &communicationTaskHandle,   // Task handle
     0                           // Core 0
   );
+
+  // Stack, load and jitter tracking for the tasks above
+  diagnostics.registerTask(DIAG_TASK_MOTOR, "motor", motorTaskHandle, MOTOR_TASK_STACK);
+  diagnostics.registerTask(DIAG_TASK_SENSOR, "sensor", sensorTaskHandle, SENSOR_TASK_STACK);
+  diagnostics.registerTask(DIAG_TASK_COMM, "comm", communicationTaskHandle, COMM_TASK_STACK);
+  diagnostics.registerTask(DIAG_TASK_LOOP, "loop", xTaskGetCurrentTaskHandle(), LOOP_TASK_STACK);
+  trace.registerTask(motorTaskHandle, "motor");
+  trace.registerTask(sensorTaskHandle, "sensor");
+  trace.registerTask(communicationTaskHandle, "comm");
+  trace.registerTask(xTaskGetCurrentTaskHandle(), "loop");
+  diagnostics.registerQueue("commands", []() { return linkManager.getQueueSize(); }, COMMAND_QUEUE_SIZE);
+  diagnostics.registerQueue("log", []() { return (int)logger.getPending(); }, LOG_RING_SIZE);
+  diagnostics.registerQueue("ota", []() { return otaUpdater.getQueueDepth(); }, OTA_WINDOW);
+  bootSequence.finish(BOOT_PHASE_TASKS);
   
+  // The loop serves connections from here on; the tasks finish the boot
   systemInitialized = true;
+}
+
+// Motor and sensor tasks end their boot phases here; whichever completes
+// the boot reports it
+void endBootPhase(BootPhase phase) {
+  if (!bootSequence.finish(phase)) return;
+
   Serial.println("System initialization complete!");
   Serial.println("Robot ready for commands...");
   
-  // Initial system status
+  // Initial system status, and boot timing to any client already there
   printSystemStatus();
+  linkManager.publishBootReport();
+
+  // Load and jitter from here on, without the boot
+  diagnostics.reset();
+
+  // Everything the robot needs exists now; later allocations are flagged
+  heapMonitor.seal();
 }
 
 void loop() {
   // Main loop handles connection management and heartbeat
-  if (systemInitialized) {
-    // Handle BLE connection state
-    bleManager.handleConnection();
+  if (!systemInitialized) {
+    delay(1000);
+    return;
+  }
+  diagnostics.passStart(DIAG_TASK_LOOP);
+
+  // Handle BLE connection state
+  unsigned long wait = bleManager.handleConnection();
+
+  // Heartbeat every HEARTBEAT_INTERVAL
+  unsigned long sinceHeartbeat = millis() - lastHeartbeat;
+  if (sinceHeartbeat >= HEARTBEAT_INTERVAL) {
+    lastHeartbeat = millis();
+    sinceHeartbeat = 0;
+    HeapStats heap = heapMonitor.sample();
+    Serial.printf("Heartbeat - Uptime: %lu ms, Free heap: %lu bytes, Largest block: %lu, Blocks: %lu (%+ld)\n", 
+                  millis(), (unsigned long)heap.freeBytes, (unsigned long)heap.largestBlock,
+                  (unsigned long)heap.allocatedBlocks, (long)heap.blocksDelta);
+    heapMonitor.check();
     
-    // Heartbeat every 10 seconds
-    if (millis() - lastHeartbeat > 10000) {
-      lastHeartbeat = millis();
-      Serial.printf("Heartbeat - Uptime: %lu ms, Free heap: %d bytes\n", 
-                    millis(), ESP.getFreeHeap());
-      
-      if (bleManager.isConnected()) {
-        bleManager.sendStatus("heartbeat");
-      }
+    if (linkManager.isConnected()) {
+      linkManager.sendHeartbeat(heap);
     }
   }
-  
-  delay(100); // Prevent watchdog reset
+
+  // Sleep until the next heartbeat, the BLE idle check or a client coming
+  // or going, whichever is first
+  wait = min(wait, HEARTBEAT_INTERVAL - sinceHeartbeat);
+  diagnostics.passEnd(DIAG_TASK_LOOP, wait);
+  taskEvents.wait(EVENT_CONNECTION, pdMS_TO_TICKS(wait));
 }
 
 bool initializeSystem() {
   Serial.println("Initializing subsystems...");
   
-  // Initialize motor control
-  Serial.print("- Motor control... ");
-  motorController.begin();
-  Serial.println("OK");
-  
-  // Initialize sensor management
-  Serial.print("- Sensor management... ");
-  sensorManager.begin();
-  if (!sensorManager.testAllSensors()) {
-    Serial.println("WARNING: Some sensors failed tests");
+  // What the command handlers use comes up before a client can connect
+  bootSequence.start(BOOT_PHASE_LINKS);
+  Serial.print("- Parameters... ");
+  if (parameters.begin()) {
+    Serial.println("OK");
   } else {
+    Serial.println("WARNING: defaults, changes won't be saved");
+  }
+
+  Serial.print("- Command links... ");
+  if (!linkManager.begin()) {
+    Serial.println("FAILED");
+    return false;
+  }
+  Serial.println("OK");
+
+  // Firmware updates over BLE
+  Serial.print("- OTA update... ");
+  if (otaUpdater.begin()) {
     Serial.println("OK");
+  } else {
+    Serial.println("WARNING: updates unavailable");
   }
-  
-  // Initialize BLE communication
+  bootSequence.finish(BOOT_PHASE_LINKS);
+
+  // Initialize navigation (routes are uploaded over the links)
+  bootSequence.start(BOOT_PHASE_NAVIGATION);
+  Serial.print("- Navigation system... ");
+  navigator.begin();
+  Serial.println("OK");
+
+  // Initialize localization (loads the stored arena map)
+  Serial.print("- Localization... ");
+  localizer.begin();
+  Serial.println("OK");
+  bootSequence.finish(BOOT_PHASE_NAVIGATION);
+
+  // Initialize BLE communication; the robot is connectable from here
+  bootSequence.start(BOOT_PHASE_BLE);
   Serial.print("- BLE communication... ");
   bleManager.begin();
+  linkManager.addTransport(&bleManager);
   Serial.println("OK");
-  
-  // Initialize navigation
-  Serial.print("- Navigation system... ");
-  navigator.begin();
+  bootSequence.finish(BOOT_PHASE_BLE);
+
+  bootSequence.start(BOOT_PHASE_SERIAL);
+#if SERIAL_TRANSPORT_ENABLED
+  // The same protocol on the console, for wired lab use
+  Serial.print("- Serial transport... ");
+  if (serialTransport.begin()) {
+    linkManager.addTransport(&serialTransport);
+    // Wake the communication task per burst of input instead of polling
+    Serial.onReceive([]() { taskEvents.signal(EVENT_SERIAL); });
+  }
   Serial.println("OK");
+#endif
+  bootSequence.finish(BOOT_PHASE_SERIAL);
   
-  Serial.println("All subsystems initialized successfully");
+  Serial.println("Links up; motors and sensors start in their tasks");
   return true;
 }
 
 void motorTask(void *parameter) {
   Serial.println("Motor task started on Core 1");
+
+  // Drivers first; power management takes them over from there
+  bootSequence.start(BOOT_PHASE_MOTORS);
+  motorController.begin();
+  powerManager.begin();
+  endBootPhase(BOOT_PHASE_MOTORS);
+
+  // Commands queued meanwhile wait for the sensors: a first IMU
+  // calibration needs the robot still, and turns read the gyro
+  bootSequence.waitFor(BOOT_PHASE_SENSORS);
   
   while (true) {
-    // Process commands from BLE
-    if (bleManager.hasCommand()) {
-      Command cmd = bleManager.getNextCommand();
+    diagnostics.passStart(DIAG_TASK_MOTOR);
+    diagnostics.sampleQueues();
+
+    // Drivers and clock back up before anything moves
+    if (linkManager.hasCommand() || navigator.isAutonomous() || programRunner.isRunning()) {
+      powerManager.wake();
+    }
+
+    // Process commands from the links
+    if (linkManager.hasCommand()) {
+      Command cmd = linkManager.getNextCommand();
       executeCommand(cmd);
     }
     
@@ -173,59 +298,188 @@ void motorTask(void *parameter) {
     if (navigator.isAutonomous()) {
       navigator.executeAutonomousStep();
     }
+
+    // Step an uploaded program; an autonomous mode it started runs to the
+    // end (or until STOP) before the next step
+    if (programRunner.isRunning() && !navigator.isAutonomous()) {
+      Command step;
+      if (programRunner.nextCommand(step)) {
+        executeCommand(step);
+      }
+    }
     
-    // Task delay
-    vTaskDelay(pdMS_TO_TICKS(MOTOR_TASK_DELAY));
+    // Autonomous modes and programs step every MOTOR_TASK_DELAY; otherwise
+    // sleep until a command arrives, waking once more at the end of the
+    // power hold or to save parameters. A command queued since the check
+    // above leaves its bit set, so the wait returns at once.
+    if (linkManager.hasCommand()) {
+      diagnostics.passEnd(DIAG_TASK_MOTOR, 0);
+    } else if (navigator.isAutonomous() || programRunner.isRunning()) {
+      diagnostics.passEnd(DIAG_TASK_MOTOR, MOTOR_TASK_DELAY);
+      taskEvents.wait(EVENT_COMMAND, pdMS_TO_TICKS(MOTOR_TASK_DELAY));
+    } else {
+      // Parameter changes go to flash here: nothing moves until this task
+      // picks up the next command, so no move starts during the write
+      uint32_t hold = powerManager.idle();
+      uint32_t save = parameters.service();
+      if (hold == POWER_NO_TIMEOUT && save == PARAM_NO_TIMEOUT) {
+        diagnostics.passEnd(DIAG_TASK_MOTOR, DIAG_NO_DEADLINE);
+        taskEvents.wait(EVENT_COMMAND | EVENT_PARAMS, portMAX_DELAY);
+      } else {
+        uint32_t wait = min(hold, save);
+        diagnostics.passEnd(DIAG_TASK_MOTOR, wait);
+        taskEvents.wait(EVENT_COMMAND | EVENT_PARAMS, pdMS_TO_TICKS(wait));
+      }
+    }
   }
 }
 
 void sensorTask(void *parameter) {
   Serial.println("Sensor task started on Core 0");
+
+  // Sensors come up here, alongside the motors and any client connecting
+  bootSequence.start(BOOT_PHASE_SENSORS);
+  sensorManager.begin();
+  endBootPhase(BOOT_PHASE_SENSORS);
+
+  // The self-test (a blocking echo read) waits until the robot is up;
+  // its result goes out with the boot report
+  bootSequence.start(BOOT_PHASE_SELF_TEST);
+  uint8_t failures = sensorManager.testAllSensors();
+  bootSequence.setSelfTestResult(failures);
+  if (failures != 0) {
+    LOG_WARN("Sensor self-test failed:%s%s",
+             (failures & SELF_TEST_ULTRASONIC) ? " ultrasonic" : "",
+             (failures & SELF_TEST_IMU) ? " imu" : "");
+  }
+  endBootPhase(BOOT_PHASE_SELF_TEST);
   
+  unsigned long lastLocalization = 0;
+
   while (true) {
+    diagnostics.passStart(DIAG_TASK_SENSOR);
+
     // Run any pending IMU recalibration here so all I2C access stays on one core
     sensorManager.serviceRecalibration();
 
+    // Ping only for a reader of the range: a due distance channel, the
+    // localizer, or the obstacle checks while anything moves. A ping can
+    // block for ULTRASONIC_TIMEOUT, which would otherwise cap every channel
+    // at ~30 Hz.
+    uint8_t due = linkManager.isConnected() ? linkManager.takeDueChannels() : 0;
+    bool localize = millis() - lastLocalization >= MCL_UPDATE_RATE;
+    bool moving = currentState != IDLE || navigator.isAutonomous() || programRunner.isRunning();
+    bool ping = (due & (1 << TLM_CH_DISTANCE)) || (localize && localizer.needsRange()) || moving;
+
+    // Wall following steers from these scans; they include the front ping
+    uint8_t sides = navigator.getSideSensors();
+
     // Update sensor readings
-    sensorManager.updateSensorData();
+    sensorManager.updateSensorData(ping && sides == 0);
+    if (sides != 0) {
+      sensorManager.scanRanges(sides);
+    }
 
     // Update IMU data
     sensorManager.updateIMU();
+
+    // Correct the pose against the arena map with the fresh range reading
+    if (localize) {
+      lastLocalization = millis();
+      localizer.update(motorController.getPose(), sensorManager.getCurrentDistance());
+    }
     
-    // Broadcast telemetry if connected
-    if (bleManager.isConnected()) {
-      SensorData data = sensorManager.getSensorData();
-      bleManager.sendTelemetry(data);
+    // Broadcast the telemetry channels the client subscribed to
+    if (due != 0) {
+      linkManager.publishTelemetry(collectTelemetry(due));
     }
     
-    // Task delay (1Hz sensor updates)
-    vTaskDelay(pdMS_TO_TICKS(SENSOR_UPDATE_RATE));
+    // Sleep for the update period (1Hz sensor updates, faster while
+    // localizing or for high-rate subscriptions), or until the schedule
+    // changes
+    unsigned long period = parameters.getInt(PARAM_SENSOR_MS);
+    if (localizer.isEnabled()) period = min(period, (unsigned long)MCL_UPDATE_RATE);
+    if (sides != 0) period = min(period, (unsigned long)WALL_CONTROL_PERIOD_MS);
+    unsigned long telemetryPeriod = linkManager.getTelemetryPeriod();
+    if (linkManager.isConnected() && telemetryPeriod != 0) {
+      period = min(period, telemetryPeriod);
+    }
+    diagnostics.passEnd(DIAG_TASK_SENSOR, period);
+    taskEvents.wait(EVENT_SENSOR_PLAN, pdMS_TO_TICKS(period));
+  }
+}
+
+TelemetrySample collectTelemetry(uint8_t channels) {
+  SensorData data = sensorManager.getSensorData();
+  PoseFrame frame;
+  Pose pose = navigator.getPose(&frame);
+
+  TelemetrySample sample = {};
+  sample.timestamp = data.timestamp;
+  sample.channels = channels;
+  sample.distance = data.distance;
+  sample.heading = data.heading;
+  sample.battery = data.batteryLevel;
+  sample.temperature = data.temperature;
+  sample.x = pose.x;
+  sample.y = pose.y;
+  sample.poseFrame = frame;
+  sample.robotState = currentState;
+  sample.navMode = navigator.getMode();
+  if (channels & (1 << TLM_CH_IMU)) {
+    sensorManager.readRawIMU(sample.imu);
   }
+  return sample;
 }
 
 void communicationTask(void *parameter) {
   Serial.println("Communication task started on Core 0");
+  EventBits_t events = 0;
   
   while (true) {
+    diagnostics.passStart(DIAG_TASK_COMM);
+
+    // A trace dump takes a while; this task can spare it
+    if (events & EVENT_TRACE_DUMP) {
+      trace.serviceDump();
+    }
+
     // Handle any communication-specific tasks
     // (Most BLE handling is done in callbacks)
+
+#if SERIAL_TRANSPORT_ENABLED
+    // The UART driver signals EVENT_SERIAL; the line parsing happens here
+    serialTransport.poll();
+#endif
     
     // Print connection status periodically
     static unsigned long lastStatusPrint = 0;
-    if (millis() - lastStatusPrint > 30000) { // Every 30 seconds
+    unsigned long sincePrint = millis() - lastStatusPrint;
+    if (sincePrint >= STATUS_PRINT_INTERVAL) {
       lastStatusPrint = millis();
+      sincePrint = 0;
+      linkManager.printStatus();
       bleManager.printConnectionStatus();
+      diagnostics.printStatus();
     }
-    
-    vTaskDelay(pdMS_TO_TICKS(1000)); // 1 second delay
+
+    // Catch queue build-ups between reports
+    diagnostics.sampleQueues();
+
+    // Sleep until console input, a dump request or the next status print
+    unsigned long wait = STATUS_PRINT_INTERVAL - sincePrint;
+    diagnostics.passEnd(DIAG_TASK_COMM, wait);
+    events = taskEvents.wait(EVENT_SERIAL | EVENT_TRACE_DUMP, pdMS_TO_TICKS(wait));
   }
 }
 
 void executeCommand(const Command& cmd) {
-  Serial.printf("Executing command: %c%d\n", cmd.type, cmd.value);
+  LOG_INFO("Executing command: %c%d", cmd.type, cmd.value);
+  linkManager.sendAck(ACK_STARTED, cmd);
 
   // A new explicit movement command re-arms motion after any prior stop
-  if (cmd.type == 'F' || cmd.type == 'B' || cmd.type == 'L' || cmd.type == 'R') {
+  if (cmd.type == 'F' || cmd.type == 'B' || cmd.type == 'L' || cmd.type == 'R' ||
+      cmd.type == 'W' || cmd.type == 'P' || cmd.type == 'G') {
     motorController.clearStop();
   }
 
@@ -258,12 +512,16 @@ void executeCommand(const Command& cmd) {
       currentState = IDLE;
       motorController.stopMoving();
       navigator.disableAutonomousMode();
+      programRunner.stop();
       break;
       
-    case 'A': // Autonomous mode
+    case 'A': // Autonomous mode (1 = wander, 2 = frontier exploration)
       if (cmd.value == 1) {
         currentState = AUTONOMOUS;
         navigator.enableAutonomousMode();
+      } else if (cmd.value == 2) {
+        currentState = AUTONOMOUS;
+        navigator.enableExplorationMode();
       } else {
         currentState = IDLE;
         navigator.disableAutonomousMode();
@@ -277,20 +535,54 @@ void executeCommand(const Command& cmd) {
       sensorManager.requestRecalibration();
       break;
 
+    case 'W': // Wall following (value = signed target cm) or corridor (0)
+      currentState = AUTONOMOUS;
+      if (cmd.value == 0) {
+        navigator.enableCorridorCentering();
+      } else {
+        navigator.enableWallFollow(cmd.value);
+      }
+      break;
+
+    case 'P': // Follow the uploaded route (pure pursuit)
+      if (navigator.startRoute()) {
+        currentState = AUTONOMOUS;
+      }
+      break;
+
+    case 'G': // Run (1) or abort (0) the uploaded program
+      if (cmd.value == 1) {
+        programRunner.start();
+      } else {
+        programRunner.stop();
+      }
+      break;
+
+    case 'M': // Monte Carlo localization (1 = global, 2 = from start pose, 0 = off)
+      if (cmd.value == 1 || cmd.value == 2) {
+        localizer.requestEnable(cmd.value == 2);
+      } else {
+        localizer.requestDisable();
+      }
+      break;
+
     case 'K': // Toggle closed-loop (IMU-based) turning (experimental)
       motorController.setClosedLoop(cmd.value == 1);
       break;
 
+    case 'H': // Toggle gyro heading hold on straight moves (experimental)
+      motorController.setHeadingHold(cmd.value == 1);
+      break;
+
     default:
-      Serial.printf("Unknown command type: %c\n", cmd.type);
+      LOG_WARN("Unknown command type: %c", cmd.type);
       break;
   }
   
-  // Send status update
-  if (bleManager.isConnected()) {
-    String status = "Command executed: " + String(cmd.type) + String(cmd.value);
-    bleManager.sendStatus(status);
-  }
+  // A move cut short by STOP reports as aborted
+  bool move = cmd.type == 'F' || cmd.type == 'B' || cmd.type == 'L' || cmd.type == 'R';
+  bool aborted = move && motorController.isStopPending();
+  linkManager.sendAck(aborted ? ACK_ABORTED : ACK_COMPLETED, cmd);
 }
 
 void printSystemStatus() {
@@ -299,18 +591,27 @@ void printSystemStatus() {
   Serial.printf("CPU frequency: %d MHz\n", ESP.getCpuFreqMHz());
   Serial.printf("Free heap: %d bytes\n", ESP.getFreeHeap());
   Serial.printf("Flash size: %d bytes\n", ESP.getFlashChipSize());
-  Serial.printf("BLE address: %s\n", bleManager.getDeviceAddress().c_str());
+  Serial.printf("BLE address: %s\n", bleManager.getDeviceAddress());
   Serial.printf("Current state: %d\n", currentState);
   Serial.println("===================================\n");
   
   // Subsystem status
+  bootSequence.printReport();
   sensorManager.printSensorStatus();
   navigator.printNavigationStats();
+  localizer.printStatus();
+  programRunner.printStatus();
+  heapMonitor.printStatus();
+  linkManager.printStatus();
+  otaUpdater.printStatus();
   bleManager.printConnectionStatus();
+  diagnostics.printStatus();
+  powerManager.printStatus();
+  parameters.printStatus();
 }
 
-void handleSystemError(const String& error) {
-  Serial.printf("SYSTEM ERROR: %s\n", error.c_str());
+void handleSystemError(const char* error) {
+  Serial.printf("SYSTEM ERROR: %s\n", error);
   
   // Stop all motors
   motorController.emergencyStop();
@@ -319,8 +620,10 @@ void handleSystemError(const String& error) {
   navigator.disableAutonomousMode();
   
   // Send error status if connected
-  if (bleManager.isConnected()) {
-    bleManager.sendStatus("ERROR: " + error);
+  if (linkManager.isConnected()) {
+    char status[64];
+    snprintf(status, sizeof(status), "ERROR: %s", error);
+    linkManager.sendStatus(status);
   }
   
   // Flash LED or other error indication could go here
@@ -1,21 +1,21 @@
 #include "motor_control.h"
 #include "sensor_manager.h"
+#include "logger.h"
+#include "trace.h"
+#include "parameters.h"
 #include <Arduino.h>
 #include <cmath>
-#include <Preferences.h>
-
-// NVS namespace + key for the persisted motor speed
-static const char* MOTOR_NAMESPACE = "motorcfg";
-static const char* SPEED_KEY = "speed";
 
 // Global instance
 MotorControl motorController;
 
 MotorControl::MotorControl()
-  : currentSpeed(DEFAULT_SPEED),
-    stopRequested(false),
+  : stopRequested(false),
     closedLoopEnabled(CLOSED_LOOP_TURN_DEFAULT),
-    wheelCircumference(PI * WHEEL_DIAMETER) {
+    headingHoldEnabled(HEADING_HOLD_DEFAULT),
+    wheelCircumference(PI * WHEEL_DIAMETER),
+    pose{0.0, 0.0, 0.0},
+    poseMutex(nullptr) {
 }
 
 void MotorControl::begin() {
@@ -26,21 +26,16 @@ void MotorControl::begin() {
   pinMode(RIGHT_DIR_PIN, OUTPUT);
   pinMode(LEFT_ENABLE_PIN, OUTPUT);
   pinMode(RIGHT_ENABLE_PIN, OUTPUT);
+
+  // Guard for the odometry pose (motor task writes, others read)
+  poseMutex = poseMutexStorage.create();
+  if (poseMutex == nullptr) {
+    Serial.println("Warning: failed to create pose mutex");
+  }
   
   // Enable motors by default
   enableMotors();
 
-  // Restore a previously saved speed (falls back to DEFAULT_SPEED)
-  Preferences prefs;
-  if (prefs.begin(MOTOR_NAMESPACE, true)) {
-    int savedSpeed = prefs.getInt(SPEED_KEY, DEFAULT_SPEED);
-    prefs.end();
-    if (savedSpeed >= 200 && savedSpeed <= 1000) {
-      currentSpeed = savedSpeed;
-      Serial.printf("Restored motor speed: %d us\n", currentSpeed);
-    }
-  }
-
   Serial.println("Motor control initialized");
 }
 
@@ -63,25 +58,40 @@ int MotorControl::angleToSteps(float degrees) {
   return (arc / wheelCircumference) * STEPS_PER_REV;
 }
 
+float MotorControl::stepsToDistance(int steps) {
+  return (steps * wheelCircumference / STEPS_PER_REV) / 10.0;
+}
+
+float MotorControl::stepsToAngle(int steps) {
+  float arc = steps * wheelCircumference / STEPS_PER_REV;
+  return arc * 360.0 / (ROBOT_WIDTH * PI);
+}
+
 void MotorControl::moveForward(int distanceCM) {
   int steps = distanceToSteps(distanceCM);
   moveForwardSteps(steps);
 }
 
 void MotorControl::moveForwardSteps(int steps) {
-  Serial.printf("Moving forward %d steps\n", steps);
+  LOG_INFO("Moving forward %d steps", steps);
 
-  for (int i = 0; i < steps; i++) {
+  if (headingHoldEnabled) {
+    moveStraightHeadingHold(steps, true);
+    return;
+  }
+
+  int i = 0;
+  for (; i < steps; i++) {
     // Abort if a stop was requested mid-move
     if (stopRequested) {
-      Serial.println("Move interrupted by stop request");
+      LOG_WARN("Move interrupted by stop request");
       break;
     }
 
     // Safety check every 50 steps
     if (i % 50 == 0) {
-      if (sensorManager.getCurrentDistance() < CRITICAL_DISTANCE) {
-        Serial.println("Emergency stop: Obstacle detected!");
+      if (sensorManager.getCurrentDistance() < parameters.getInt(PARAM_CRITICAL_CM)) {
+        LOG_WARN("Emergency stop: Obstacle detected!");
         break;
       }
     }
@@ -91,12 +101,21 @@ void MotorControl::moveForwardSteps(int steps) {
     
     digitalWrite(LEFT_STEP_PIN, HIGH);
     digitalWrite(RIGHT_STEP_PIN, HIGH);
-    delayMicroseconds(currentSpeed);
+    delayMicroseconds(getSpeed());
     
     digitalWrite(LEFT_STEP_PIN, LOW);
     digitalWrite(RIGHT_STEP_PIN, LOW);
-    delayMicroseconds(currentSpeed);
+    delayMicroseconds(getSpeed());
+
+    // Credit odometry as we go so the pose stays live during long moves
+    if ((i + 1) % ODOMETRY_UPDATE_STEPS == 0) {
+      TRACE(TRACE_STEPS, ODOMETRY_UPDATE_STEPS, ODOMETRY_UPDATE_STEPS);
+      advancePose(stepsToDistance(ODOMETRY_UPDATE_STEPS));
+    }
   }
+
+  TRACE(TRACE_STEPS, i % ODOMETRY_UPDATE_STEPS, i % ODOMETRY_UPDATE_STEPS);
+  advancePose(stepsToDistance(i % ODOMETRY_UPDATE_STEPS));
 }
 
 void MotorControl::moveBackward(int distanceCM) {
@@ -105,26 +124,141 @@ void MotorControl::moveBackward(int distanceCM) {
 }
 
 void MotorControl::moveBackwardSteps(int steps) {
-  Serial.printf("Moving backward %d steps\n", steps);
+  LOG_INFO("Moving backward %d steps", steps);
+
+  if (headingHoldEnabled) {
+    moveStraightHeadingHold(steps, false);
+    return;
+  }
   
   digitalWrite(LEFT_DIR_PIN, LOW);
   digitalWrite(RIGHT_DIR_PIN, LOW);
 
-  for (int i = 0; i < steps; i++) {
+  int i = 0;
+  for (; i < steps; i++) {
     // Abort if a stop was requested mid-move
     if (stopRequested) {
-      Serial.println("Move interrupted by stop request");
+      LOG_WARN("Move interrupted by stop request");
       break;
     }
 
     digitalWrite(LEFT_STEP_PIN, HIGH);
     digitalWrite(RIGHT_STEP_PIN, HIGH);
-    delayMicroseconds(currentSpeed);
+    delayMicroseconds(getSpeed());
 
     digitalWrite(LEFT_STEP_PIN, LOW);
     digitalWrite(RIGHT_STEP_PIN, LOW);
-    delayMicroseconds(currentSpeed);
+    delayMicroseconds(getSpeed());
+
+    if ((i + 1) % ODOMETRY_UPDATE_STEPS == 0) {
+      TRACE(TRACE_STEPS, ODOMETRY_UPDATE_STEPS, ODOMETRY_UPDATE_STEPS);
+      advancePose(-stepsToDistance(ODOMETRY_UPDATE_STEPS));
+    }
   }
+
+  TRACE(TRACE_STEPS, i % ODOMETRY_UPDATE_STEPS, i % ODOMETRY_UPDATE_STEPS);
+  advancePose(-stepsToDistance(i % ODOMETRY_UPDATE_STEPS));
+}
+
+unsigned long MotorControl::rateToInterval(float rate) {
+  // Step period for a wheel rate in steps/s; 0 keeps that wheel still
+  if (fabs(rate) <= 1.0) return 0;
+  return max((unsigned long)(1000000.0 / fabs(rate)), (unsigned long)MIN_STEP_INTERVAL_US);
+}
+
+void MotorControl::stepWheels(unsigned long leftInterval, unsigned long rightInterval,
+                              unsigned long durationUs, int& leftSteps, int& rightSteps) {
+  unsigned long start = micros();
+  unsigned long nextLeft = start + leftInterval;
+  unsigned long nextRight = start + rightInterval;
+  leftSteps = 0;
+  rightSteps = 0;
+
+  while (!stopRequested && micros() - start < durationUs) {
+    unsigned long now = micros();
+    bool stepLeft = leftInterval > 0 && (long)(now - nextLeft) >= 0;
+    bool stepRight = rightInterval > 0 && (long)(now - nextRight) >= 0;
+    if (!stepLeft && !stepRight) continue;
+
+    if (stepLeft) digitalWrite(LEFT_STEP_PIN, HIGH);
+    if (stepRight) digitalWrite(RIGHT_STEP_PIN, HIGH);
+    delayMicroseconds(STEP_PULSE_US);
+    digitalWrite(LEFT_STEP_PIN, LOW);
+    digitalWrite(RIGHT_STEP_PIN, LOW);
+
+    if (stepLeft) {
+      leftSteps++;
+      nextLeft += leftInterval;
+    }
+    if (stepRight) {
+      rightSteps++;
+      nextRight += rightInterval;
+    }
+  }
+  TRACE(TRACE_STEPS, leftSteps, rightSteps);
+}
+
+void MotorControl::driveDifferential(float leftRate, float rightRate, unsigned long durationMs) {
+  digitalWrite(LEFT_DIR_PIN, leftRate >= 0 ? HIGH : LOW);
+  digitalWrite(RIGHT_DIR_PIN, rightRate >= 0 ? HIGH : LOW);
+
+  int leftSteps, rightSteps;
+  stepWheels(rateToInterval(leftRate), rateToInterval(rightRate),
+             durationMs * 1000UL, leftSteps, rightSteps);
+
+  creditDifferential(leftRate >= 0 ? leftSteps : -leftSteps,
+                     rightRate >= 0 ? rightSteps : -rightSteps);
+}
+
+void MotorControl::moveStraightHeadingHold(int steps, bool forward) {
+  // Sample yaw every slice and trim the wheel rates around the base rate:
+  // one side speeds up as much as the other slows down, so the move takes
+  // as long as an untrimmed one. Finishes when the wheels average `steps`.
+  float target = sensorManager.sampleYaw();
+  float base = getBaseStepRate();
+  unsigned long basePeriod = 2UL * getSpeed();
+  float worstError = 0;
+
+  digitalWrite(LEFT_DIR_PIN, forward ? HIGH : LOW);
+  digitalWrite(RIGHT_DIR_PIN, forward ? HIGH : LOW);
+
+  int leftTotal = 0, rightTotal = 0;
+  while ((leftTotal + rightTotal) / 2 < steps) {
+    if (stopRequested) {
+      LOG_WARN("Move interrupted by stop request");
+      break;
+    }
+    if (forward && sensorManager.getCurrentDistance() < parameters.getInt(PARAM_CRITICAL_CM)) {
+      LOG_WARN("Emergency stop: Obstacle detected!");
+      break;
+    }
+
+    // Shortest signed error in [-180, 180]; > 0 means we drifted left
+    float error = target - sensorManager.sampleYaw();
+    while (error > 180.0) error -= 360.0;
+    while (error < -180.0) error += 360.0;
+    if (fabs(error) > fabs(worstError)) worstError = error;
+
+    // Speeding up the left wheel turns right going forward, left in reverse
+    float trim = constrain(parameters.getFloat(PARAM_HOLD_KP) * error, -HEADING_HOLD_MAX_TRIM, HEADING_HOLD_MAX_TRIM);
+    if (!forward) trim = -trim;
+
+    int slice = min(steps - (leftTotal + rightTotal) / 2, HEADING_HOLD_SLICE_STEPS);
+    int left, right;
+    stepWheels(rateToInterval(base * (1.0 + trim)), rateToInterval(base * (1.0 - trim)),
+               slice * basePeriod, left, right);
+
+    leftTotal += left;
+    rightTotal += right;
+    creditDifferential(forward ? left : -left, forward ? right : -right);
+  }
+
+  LOG_INFO("Heading hold: worst drift %.1f deg", worstError);
+}
+
+float MotorControl::getBaseStepRate() const {
+  // Lockstep moves spend the speed high + the speed low per step
+  return 1000000.0 / (2.0 * getSpeed());
 }
 
 void MotorControl::rotateLeft(float degrees) {
@@ -143,27 +277,38 @@ void MotorControl::rotateRobot(float degrees) {
 
   int steps = angleToSteps(degrees);
 
-  Serial.printf("Rotating %.1f degrees (%d steps)\n", degrees, steps);
+  LOG_INFO("Rotating %.1f degrees (%d steps)", degrees, steps);
 
   // Set direction pins
   digitalWrite(LEFT_DIR_PIN, degrees > 0 ? HIGH : LOW);
   digitalWrite(RIGHT_DIR_PIN, degrees > 0 ? LOW : HIGH);
 
-  for (int i = 0; i < steps; i++) {
+  int i = 0;
+  for (; i < steps; i++) {
     // Abort if a stop was requested mid-turn
     if (stopRequested) {
-      Serial.println("Rotation interrupted by stop request");
+      LOG_WARN("Rotation interrupted by stop request");
       break;
     }
 
     digitalWrite(LEFT_STEP_PIN, HIGH);
     digitalWrite(RIGHT_STEP_PIN, HIGH);
-    delayMicroseconds(currentSpeed);
+    delayMicroseconds(getSpeed());
 
     digitalWrite(LEFT_STEP_PIN, LOW);
     digitalWrite(RIGHT_STEP_PIN, LOW);
-    delayMicroseconds(currentSpeed);
+    delayMicroseconds(getSpeed());
+
+    if ((i + 1) % ODOMETRY_UPDATE_STEPS == 0) {
+      TRACE(TRACE_STEPS, ODOMETRY_UPDATE_STEPS, ODOMETRY_UPDATE_STEPS);
+      float turned = stepsToAngle(ODOMETRY_UPDATE_STEPS);
+      rotatePose(degrees > 0 ? turned : -turned);
+    }
   }
+
+  TRACE(TRACE_STEPS, i % ODOMETRY_UPDATE_STEPS, i % ODOMETRY_UPDATE_STEPS);
+  float turned = stepsToAngle(i % ODOMETRY_UPDATE_STEPS);
+  rotatePose(degrees > 0 ? turned : -turned);
 }
 
 void MotorControl::rotateRobotClosedLoop(float degrees) {
@@ -175,7 +320,7 @@ void MotorControl::rotateRobotClosedLoop(float degrees) {
   while (target >= 360.0) target -= 360.0;
   while (target < 0.0) target += 360.0;
 
-  Serial.printf("Closed-loop turn %.1f deg (target heading %.1f)\n", degrees, target);
+  LOG_INFO("Closed-loop turn %.1f deg (target heading %.1f)", degrees, target);
 
   unsigned long startMs = millis();
 
@@ -197,19 +342,27 @@ void MotorControl::rotateRobotClosedLoop(float degrees) {
     digitalWrite(LEFT_DIR_PIN, error > 0 ? HIGH : LOW);
     digitalWrite(RIGHT_DIR_PIN, error > 0 ? LOW : HIGH);
 
-    for (int s = 0; s < TURN_STEP_BATCH && !stopRequested; s++) {
+    int s = 0;
+    for (; s < TURN_STEP_BATCH && !stopRequested; s++) {
       digitalWrite(LEFT_STEP_PIN, HIGH);
       digitalWrite(RIGHT_STEP_PIN, HIGH);
-      delayMicroseconds(currentSpeed);
+      delayMicroseconds(getSpeed());
       digitalWrite(LEFT_STEP_PIN, LOW);
       digitalWrite(RIGHT_STEP_PIN, LOW);
-      delayMicroseconds(currentSpeed);
+      delayMicroseconds(getSpeed());
     }
+    TRACE(TRACE_STEPS, s, s);
   }
 
   if (millis() - startMs >= TURN_TIMEOUT_MS) {
-    Serial.println("Closed-loop turn timed out before converging");
+    LOG_WARN("Closed-loop turn timed out before converging");
   }
+
+  // Credit the odometry with what the gyro says we actually turned
+  float turned = sensorManager.sampleYaw() - start;
+  while (turned > 180.0) turned -= 360.0;
+  while (turned < -180.0) turned += 360.0;
+  rotatePose(turned);
 }
 
 void MotorControl::requestStop() {
@@ -225,7 +378,7 @@ bool MotorControl::isStopPending() const {
 }
 
 void MotorControl::stopMoving() {
-  Serial.println("Stopping motors");
+  LOG_INFO("Stopping motors");
 
   // Briefly disable then re-enable for immediate stop
   disableMotors();
@@ -237,7 +390,7 @@ void MotorControl::stopMoving() {
 }
 
 void MotorControl::emergencyStop() {
-  Serial.println("EMERGENCY STOP!");
+  LOG_WARN("EMERGENCY STOP!");
   disableMotors();
   delay(100);
   enableMotors();
@@ -245,34 +398,80 @@ void MotorControl::emergencyStop() {
 }
 
 void MotorControl::setSpeed(int speed) {
-  if (speed >= 200 && speed <= 1000) { // Safe speed range
-    currentSpeed = speed;
-    Serial.printf("Motor speed set to %d microseconds\n", speed);
-
-    // Persist so the speed survives a reboot
-    Preferences prefs;
-    if (prefs.begin(MOTOR_NAMESPACE, false)) {
-      prefs.putInt(SPEED_KEY, speed);
-      prefs.end();
-    }
+  // RAM only; the parameter store saves it later, off the motion path
+  if (parameters.setInt(PARAM_SPEED, speed)) {
+    LOG_INFO("Motor speed set to %d microseconds", speed);
   } else {
-    Serial.println("Invalid speed value. Must be between 200-1000 microseconds");
+    LOG_WARN("Invalid speed value. Must be between 200-1000 microseconds");
   }
 }
 
 void MotorControl::setClosedLoop(bool enabled) {
   closedLoopEnabled = enabled;
-  Serial.printf("Closed-loop turning %s\n", enabled ? "ENABLED (experimental)" : "disabled");
+  LOG_INFO("Closed-loop turning %s", enabled ? "ENABLED (experimental)" : "disabled");
 }
 
 bool MotorControl::isClosedLoop() const {
   return closedLoopEnabled;
 }
 
+void MotorControl::setHeadingHold(bool enabled) {
+  headingHoldEnabled = enabled;
+  LOG_INFO("Heading hold %s", enabled ? "ENABLED (experimental)" : "disabled");
+}
+
+bool MotorControl::isHeadingHold() const {
+  return headingHoldEnabled;
+}
+
 int MotorControl::getSpeed() const {
-  return currentSpeed;
+  return parameters.getInt(PARAM_SPEED);
+}
+
+void MotorControl::advancePose(float distanceCM) {
+  if (poseMutex != nullptr) traceTake(poseMutex, TRACE_MUTEX_POSE);
+  float rad = pose.heading * PI / 180.0;
+  pose.x += distanceCM * cos(rad);
+  pose.y += distanceCM * sin(rad);
+  if (poseMutex != nullptr) xSemaphoreGive(poseMutex);
+}
+
+void MotorControl::rotatePose(float degrees) {
+  if (poseMutex != nullptr) traceTake(poseMutex, TRACE_MUTEX_POSE);
+  pose.heading += degrees;
+  while (pose.heading >= 360.0) pose.heading -= 360.0;
+  while (pose.heading < 0.0) pose.heading += 360.0;
+  if (poseMutex != nullptr) xSemaphoreGive(poseMutex);
+}
+
+void MotorControl::creditDifferential(int leftSteps, int rightSteps) {
+  // Arc approximation: half the heading change, the mean travel, then the
+  // other half. A right turn (left wheel ahead) is positive, as in Pose.
+  float left = stepsToDistance(leftSteps);
+  float right = stepsToDistance(rightSteps);
+  float turn = (left - right) / (ROBOT_WIDTH / 10.0) * 180.0 / PI;
+
+  rotatePose(turn / 2.0);
+  advancePose((left + right) / 2.0);
+  rotatePose(turn / 2.0);
+}
+
+Pose MotorControl::getPose() {
+  if (poseMutex != nullptr) traceTake(poseMutex, TRACE_MUTEX_POSE);
+  Pose result = pose;
+  if (poseMutex != nullptr) xSemaphoreGive(poseMutex);
+  return result;
+}
+
+Pose MotorControl::resetPose() {
+  if (poseMutex != nullptr) traceTake(poseMutex, TRACE_MUTEX_POSE);
+  Pose previous = pose;
+  pose = {0.0, 0.0, 0.0};
+  if (poseMutex != nullptr) xSemaphoreGive(poseMutex);
+  LOG_INFO("Odometry pose reset");
+  return previous;
 }
 
 bool MotorControl::checkObstacle() {
-  return sensorManager.getCurrentDistance() < MIN_OBSTACLE_DIST;
+  return sensorManager.getCurrentDistance() < parameters.getInt(PARAM_OBSTACLE_CM);
 }
\ No newline at end of file
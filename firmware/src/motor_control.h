@@ -3,20 +3,39 @@
 
 #include "types.h"
 #include "config.h"
+#include "static_alloc.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 class MotorControl {
 private:
-  int currentSpeed;
   // Set from the BLE task to abort an in-progress blocking move. volatile
   // because it is written and read from different FreeRTOS tasks/cores.
   volatile bool stopRequested;
   // When true, rotateRobot() uses IMU feedback instead of open-loop steps.
   bool closedLoopEnabled;
+  // When true, forward/backward moves trim wheel rates to hold the gyro heading.
+  bool headingHoldEnabled;
   const float wheelCircumference;
 
+  // Dead-reckoned pose, advanced by the steps each move actually executed.
+  // Written by the motor task and read by navigation/telemetry, so guarded.
+  Pose pose;
+  SemaphoreHandle_t poseMutex;
+  MutexStorage poseMutexStorage;
+
   int distanceToSteps(int distanceCM);
   int angleToSteps(float degrees);
+  float stepsToDistance(int steps);     // cm
+  float stepsToAngle(int steps);        // degrees of in-place rotation
   void rotateRobotClosedLoop(float degrees);
+  void moveStraightHeadingHold(int steps, bool forward);
+  unsigned long rateToInterval(float rate);
+  void stepWheels(unsigned long leftInterval, unsigned long rightInterval,
+                  unsigned long durationUs, int& leftSteps, int& rightSteps);
+  void advancePose(float distanceCM);
+  void rotatePose(float degrees);
+  void creditDifferential(int leftSteps, int rightSteps);
 
 public:
   MotorControl();
@@ -31,6 +50,12 @@ public:
   // Advanced movement functions
   void moveForwardSteps(int steps);
   void moveBackwardSteps(int steps);
+
+  // Drive each wheel at its own signed step rate (steps/s, + = forward) for
+  // durationMs, or until a stop is requested. Used by the steering
+  // controllers, which call it in short slices and re-trim the rates.
+  void driveDifferential(float leftRate, float rightRate, unsigned long durationMs);
+  float getBaseStepRate() const;   // steps/s at the current speed setting
   
   // Control functions
   void stopMoving();
@@ -42,6 +67,12 @@ public:
   int getSpeed() const;
   void setClosedLoop(bool enabled);   // toggle IMU-based turning (experimental)
   bool isClosedLoop() const;
+  void setHeadingHold(bool enabled);  // gyro heading hold on straight moves (experimental)
+  bool isHeadingHold() const;
+
+  // Odometry
+  Pose getPose();
+  Pose resetPose();                   // returns the pose it discarded
   
   // Safety functions
   bool checkObstacle();
@@ -1,6 +1,11 @@
 #include "navigation.h"
 #include "motor_control.h"
 #include "sensor_manager.h"
+#include "exploration.h"
+#include "localization.h"
+#include "logger.h"
+#include "parameters.h"
+#include "task_events.h"
 #include <Arduino.h>
 #include <cmath>
 
@@ -8,72 +13,244 @@
 Navigation navigator;
 
 Navigation::Navigation() 
-  : isAutonomousMode(false),
-    pathIndex(0),
+  : mode(NAV_OFF),
     lastNavigationUpdate(0),
     lastBestAngle(0),
-    stuckCounter(0) {
-  
+    stuckCounter(0),
+    wallSide(1),
+    wallTarget(WALL_DEFAULT_DIST_CM),
+    lastSteerError(0),
+    haveSteerError(false),
+    followSteer(0),
+    lastControlTime(0),
+    scanAfter(0),
+    followStart(0),
+    inBandSince(0),
+    settleTime(0),
+    errorSquareSum(0),
+    errorSamples(0),
+    followDistance(0),
+    lastFollowReport(0),
+    routeLength(0),
+    routeIndex(0),
+    routeOrigin{0.0, 0.0},
+    routeLocalized(false),
+    routeBlocked(false),
+    routeStartTime(0),
+    pathIndex(0) {
+  routeLock = portMUX_INITIALIZER_UNLOCKED;
+
   // Initialize path memory
   clearPathMemory();
 }
 
 void Navigation::begin() {
   clearPathMemory();
-  isAutonomousMode = false;
+  explorer.begin();
+  mode = NAV_OFF;
   stuckCounter = 0;
   Serial.println("Navigation system initialized");
 }
 
 void Navigation::enableAutonomousMode() {
-  isAutonomousMode = true;
+  mode = NAV_WANDER;
   clearPathMemory();
   stuckCounter = 0;
   lastNavigationUpdate = millis();
-  Serial.println("Autonomous navigation enabled");
+  LOG_INFO("Autonomous navigation enabled");
+}
+
+void Navigation::enableExplorationMode() {
+  // The map is built around the starting point, so restart both together
+  resetOdometry();
+  explorer.reset();
+  stuckCounter = 0;
+  lastNavigationUpdate = millis();
+  mode = NAV_EXPLORE;
+  LOG_INFO("Frontier exploration enabled");
+}
+
+void Navigation::enableWallFollow(int targetCM) {
+  wallSide = targetCM < 0 ? -1 : 1;
+  wallTarget = constrain(abs(targetCM), WALL_MIN_DIST_CM, WALL_MAX_DIST_CM);
+  startFollowing(NAV_WALL_FOLLOW);
+  LOG_INFO("Wall following enabled (%s wall at %.0f cm)",
+           wallSide < 0 ? "left" : "right", wallTarget);
+}
+
+void Navigation::enableCorridorCentering() {
+  startFollowing(NAV_CORRIDOR);
+  LOG_INFO("Corridor centering enabled");
+}
+
+void Navigation::startFollowing(NavMode followMode) {
+  haveSteerError = false;
+  followSteer = 0;
+  followStart = millis();
+  lastControlTime = followStart;
+  scanAfter = followStart;
+  inBandSince = 0;
+  settleTime = 0;
+  errorSquareSum = 0;
+  errorSamples = 0;
+  followDistance = 0;
+  lastFollowReport = followStart;
+  mode = followMode;
+  taskEvents.signal(EVENT_SENSOR_PLAN);   // scans start now, not after a sleep
+}
+
+bool Navigation::setRoute(const Waypoint* points, int count, bool append) {
+  portENTER_CRITICAL(&routeLock);
+  bool busy = mode == NAV_ROUTE;
+  int start = append ? routeLength : 0;
+  bool fits = start + count <= ROUTE_MAX_WAYPOINTS;
+  if (!busy && fits) {
+    for (int i = 0; i < count; i++) {
+      route[start + i] = points[i];
+    }
+    routeLength = start + count;
+  }
+  portEXIT_CRITICAL(&routeLock);
+
+  if (busy) {
+    LOG_WARN("Route busy, not changed");
+  } else if (!fits) {
+    LOG_WARN("Route full, %d waypoints rejected", count);
+  }
+  return !busy && fits;
+}
+
+bool Navigation::addWaypoint(float x, float y) {
+  Waypoint point = {x, y};
+  return setRoute(&point, 1, true);
+}
+
+void Navigation::clearRoute() {
+  setRoute(nullptr, 0, false);
+}
+
+int Navigation::getRouteLength() const {
+  return routeLength;
+}
+
+bool Navigation::startRoute() {
+  // Claimed under the lock: from here on the links can't change it
+  portENTER_CRITICAL(&routeLock);
+  int length = routeLength;
+  if (length > 0) {
+    mode = NAV_ROUTE;
+  }
+  portEXIT_CRITICAL(&routeLock);
+  if (length == 0) {
+    LOG_WARN("No route uploaded");
+    return false;
+  }
+
+  // Follow in the arena frame when localized; otherwise the route is
+  // relative to where the robot stands now (x ahead, y to the right).
+  routeLocalized = localizer.isConverged();
+  if (!routeLocalized) {
+    resetOdometry();
+  }
+
+  Pose pose = getRoutePose();
+  routeOrigin.x = pose.x;
+  routeOrigin.y = pose.y;
+  routeIndex = 0;
+  routeBlocked = false;
+  routeStartTime = millis();
+  LOG_INFO("Following %d-waypoint route (%s frame)",
+           length, routeLocalized ? "arena" : "start-relative");
+  return true;
+}
+
+Pose Navigation::getRoutePose() {
+  return routeLocalized ? getPose() : motorController.getPose();
+}
+
+void Navigation::resetOdometry() {
+  localizer.rebaseOdometry(motorController.resetPose());
 }
 
 void Navigation::disableAutonomousMode() {
-  isAutonomousMode = false;
+  if (mode == NAV_EXPLORE) {
+    explorer.reportProgress(true);
+  } else if (mode == NAV_WALL_FOLLOW || mode == NAV_CORRIDOR) {
+    reportFollowMetrics(true);
+  }
+  mode = NAV_OFF;
   motorController.stopMoving();
-  Serial.println("Autonomous navigation disabled");
+  LOG_INFO("Autonomous navigation disabled");
 }
 
 bool Navigation::isAutonomous() const {
-  return isAutonomousMode;
+  return mode != NAV_OFF;
+}
+
+NavMode Navigation::getMode() const {
+  return mode;
+}
+
+uint8_t Navigation::getSideSensors() const {
+  if (mode == NAV_CORRIDOR) return SIDE_SENSOR_LEFT | SIDE_SENSOR_RIGHT;
+  if (mode == NAV_WALL_FOLLOW) return wallSide < 0 ? SIDE_SENSOR_LEFT : SIDE_SENSOR_RIGHT;
+  return 0;
+}
+
+Pose Navigation::getPose(PoseFrame* frame) {
+  Pose odometry = motorController.getPose();
+  Pose arena;
+  bool anchored = localizer.toArena(odometry, arena);
+  if (frame != nullptr) *frame = anchored ? FRAME_ARENA : FRAME_ODOMETRY;
+  return anchored ? arena : odometry;
 }
 
 void Navigation::executeAutonomousStep() {
-  if (!isAutonomousMode) return;
+  if (mode == NAV_OFF) return;
+
+  // Steering modes run continuously; their drive slice sets the pace
+  if (mode == NAV_WALL_FOLLOW || mode == NAV_CORRIDOR) {
+    executeFollowStep();
+    return;
+  }
+  if (mode == NAV_ROUTE) {
+    executeRouteStep();
+    return;
+  }
   
   // Rate limiting - update every 500ms
   if (millis() - lastNavigationUpdate < 500) {
     return;
   }
   lastNavigationUpdate = millis();
+
+  if (mode == NAV_EXPLORE) {
+    executeExplorationStep();
+    return;
+  }
   
   float currentDistance = sensorManager.getCurrentDistance();
   
   // Emergency reverse if too close
-  if (currentDistance < CRITICAL_DISTANCE) {
-    Serial.println("Emergency maneuver: Too close to obstacle");
+  if (currentDistance < parameters.getInt(PARAM_CRITICAL_CM)) {
+    LOG_WARN("Emergency maneuver: Too close to obstacle");
     emergencyManeuver();
     return;
   }
   
   // Continue forward if path is clear
-  if (currentDistance > MIN_OBSTACLE_DIST * 2) {
+  if (currentDistance > parameters.getInt(PARAM_OBSTACLE_CM) * 2) {
     motorController.moveForward(10); // Small forward step
     stuckCounter = 0; // Reset stuck counter
     return;
   }
   
   // Obstacle detected - find new path
-  if (currentDistance < MIN_OBSTACLE_DIST) {
+  if (currentDistance < parameters.getInt(PARAM_OBSTACLE_CM)) {
     float bestAngle = findBestPath();
     
     if (bestAngle != -999) {
-      Serial.printf("Turning to best angle: %.1f degrees\n", bestAngle);
+      LOG_INFO("Turning to best angle: %.1f degrees", bestAngle);
       motorController.rotateRobot(bestAngle);
       lastBestAngle = bestAngle;
       stuckCounter = 0;
@@ -91,17 +268,20 @@ float Navigation::findBestPath() {
   float bestScore = 0;
   float bestAngle = -999; // Invalid angle indicates no good path
   
-  Serial.println("Scanning for best path...");
+  LOG_DEBUG("Scanning for best path...");
 
   // rotateRobot() turns RELATIVE to the current heading, so we track the
   // chassis heading (relative to center) and only ever turn by the delta.
   // This sweeps left-to-right across the arc instead of spinning in place.
   int currentHeading = 0;
 
-  for (int angle = SCAN_ANGLE_START; angle <= SCAN_ANGLE_END; angle += SCAN_ANGLE_STEP) {
+  // The sweep as set when it starts
+  const int scanEnd = parameters.getInt(PARAM_SCAN_END);
+  const int scanStep = parameters.getInt(PARAM_SCAN_STEP);
+  for (int angle = parameters.getInt(PARAM_SCAN_START); angle <= scanEnd; angle += scanStep) {
     // Bail out of the scan promptly if the user requested a stop
     if (motorController.isStopPending()) {
-      Serial.println("Scan aborted by stop request");
+      LOG_WARN("Scan aborted by stop request");
       break;
     }
 
@@ -128,8 +308,8 @@ float Navigation::findBestPath() {
     float avgDistance = totalDistance / validReadings;
     float score = calculateScore(avgDistance, angle);
 
-    Serial.printf("Angle: %d°, Distance: %.1f cm, Score: %.2f\n",
-                  angle, avgDistance, score);
+    LOG_DEBUG("Angle: %d°, Distance: %.1f cm, Score: %.2f",
+              angle, avgDistance, score);
 
     if (score > bestScore) {
       bestScore = score;
@@ -143,10 +323,248 @@ float Navigation::findBestPath() {
   // Return to center by undoing the net rotation accumulated during the scan
   motorController.rotateRobot(-currentHeading);
 
-  Serial.printf("Best path: %.1f° (score: %.2f)\n", bestAngle, bestScore);
+  LOG_INFO("Best path: %.1f° (score: %.2f)", bestAngle, bestScore);
   return bestAngle;
 }
 
+void Navigation::executeExplorationStep() {
+  scanIntoMap();
+  if (motorController.isStopPending()) return;
+
+  float turn, distance;
+  if (!explorer.planStep(motorController.getPose(), turn, distance)) {
+    LOG_INFO("No reachable frontier left, exploration complete");
+    explorer.reportProgress(true);
+    disableAutonomousMode();
+    return;
+  }
+
+  if (fabs(turn) > 1.0) {
+    motorController.rotateRobot(turn);
+  }
+
+  // moveForward() already stops short of obstacles it sees on the way
+  if (distance > 0 && sensorManager.readDistanceCM() > parameters.getInt(PARAM_CRITICAL_CM)) {
+    motorController.moveForward(distance);
+  }
+
+  explorer.reportProgress();
+}
+
+void Navigation::scanIntoMap() {
+  // Same relative sweep as findBestPath(), but every reading goes into the
+  // map at the odometry pose it was taken from.
+  int currentHeading = 0;
+
+  const int scanEnd = parameters.getInt(PARAM_SCAN_END);
+  const int scanStep = parameters.getInt(PARAM_SCAN_STEP);
+  for (int angle = parameters.getInt(PARAM_SCAN_START); angle <= scanEnd; angle += scanStep) {
+    if (motorController.isStopPending()) {
+      LOG_WARN("Scan aborted by stop request");
+      break;
+    }
+
+    motorController.rotateRobot(angle - currentHeading);
+    currentHeading = angle;
+    delay(100); // Stabilization time
+
+    float distance = sensorManager.getFilteredDistance(2);
+    explorer.integrateReading(motorController.getPose(), distance);
+  }
+
+  motorController.rotateRobot(-currentHeading);
+}
+
+void Navigation::executeFollowStep() {
+  // The sensor task scans the front and side sensors (getSideSensors()), so
+  // a slice never waits on an echo and the wheels keep turning. Each scan
+  // updates the steer once; slices in between hold it.
+  RangeScan scan = sensorManager.getRangeScan();
+  bool fresh = scan.timestamp != lastControlTime && (long)(scan.timestamp - scanAfter) >= 0;
+  if (!fresh && (!haveSteerError || millis() - lastControlTime > WALL_SCAN_TIMEOUT_MS)) {
+    return;   // no scan since the start or the last turn, or the scans stopped
+  }
+
+  if (fresh) {
+    if (scan.front < parameters.getInt(PARAM_OBSTACLE_CM)) {
+      // Inside corner (or end of the corridor): turn away and carry on
+      if (mode == NAV_WALL_FOLLOW) {
+        motorController.rotateRobot(wallSide < 0 ? 90 : -90);
+      } else {
+        motorController.rotateRobot(180);
+      }
+      haveSteerError = false;
+      scanAfter = millis();   // earlier scans saw the old heading
+      return;
+    }
+
+    // Positive steer = turn right. A missing wall reads as WALL_LOST_DIST_CM,
+    // which saturates the trim and arcs the robot around an outside corner.
+    float error;
+    if (mode == NAV_WALL_FOLLOW) {
+      float side = min(wallSide > 0 ? scan.right : scan.left, (float)WALL_LOST_DIST_CM);
+      error = side - wallTarget;              // + = too far from the wall
+    } else {
+      float left = min(scan.left, (float)WALL_LOST_DIST_CM);
+      float right = min(scan.right, (float)WALL_LOST_DIST_CM);
+      error = (right - left) / 2.0;           // + = centerline is to the right
+    }
+
+    float dt = (scan.timestamp - lastControlTime) / 1000.0;
+    float rate = 0;
+    if (haveSteerError && dt > 0) {
+      rate = (error - lastSteerError) / dt;
+    }
+    lastControlTime = scan.timestamp;
+    lastSteerError = error;
+    haveSteerError = true;
+
+    float steer = parameters.getFloat(PARAM_WALL_KP) * error + parameters.getFloat(PARAM_WALL_KD) * rate;
+    if (mode == NAV_WALL_FOLLOW && wallSide < 0) {
+      steer = -steer;                         // left wall: too far = turn left
+    }
+    float maxTrim = parameters.getFloat(PARAM_WALL_TRIM);
+    followSteer = constrain(steer, -maxTrim, maxTrim);
+    recordSteerError(error);
+  }
+
+  float base = motorController.getBaseStepRate();
+  Pose before = motorController.getPose();
+  motorController.driveDifferential(base * (1.0 + followSteer), base * (1.0 - followSteer),
+                                    WALL_CONTROL_PERIOD_MS);
+  Pose after = motorController.getPose();
+  followDistance += sqrt((after.x - before.x) * (after.x - before.x) +
+                         (after.y - before.y) * (after.y - before.y));
+
+  reportFollowMetrics();
+}
+
+bool Navigation::findLookahead(const Pose& pose, Waypoint& goal) {
+  // Move on to the next waypoint once the current one is inside the
+  // pursuit circle (the last one must actually be reached).
+  while (routeIndex < routeLength - 1 &&
+         hypot(route[routeIndex].x - pose.x, route[routeIndex].y - pose.y) < ROUTE_LOOKAHEAD_CM) {
+    routeIndex++;
+  }
+
+  const Waypoint& a = routeIndex == 0 ? routeOrigin : route[routeIndex - 1];
+  const Waypoint& b = route[routeIndex];
+  goal = b;
+
+  if (routeIndex == routeLength - 1 &&
+      hypot(b.x - pose.x, b.y - pose.y) < ROUTE_GOAL_TOLERANCE_CM) {
+    return false; // arrived
+  }
+
+  // Farthest intersection of the pursuit circle with segment a-b
+  float dx = b.x - a.x, dy = b.y - a.y;
+  float fx = a.x - pose.x, fy = a.y - pose.y;
+  float qa = dx * dx + dy * dy;
+  float qb = 2 * (fx * dx + fy * dy);
+  float qc = fx * fx + fy * fy - ROUTE_LOOKAHEAD_CM * ROUTE_LOOKAHEAD_CM;
+  float disc = qb * qb - 4 * qa * qc;
+  if (qa > 0 && disc >= 0) {
+    float t = (-qb + sqrt(disc)) / (2 * qa);
+    if (t >= 0 && t <= 1) {
+      goal.x = a.x + t * dx;
+      goal.y = a.y + t * dy;
+    }
+  }
+  return true;
+}
+
+void Navigation::executeRouteStep() {
+  // A fresh reading every slice: the cached distance is only as new as the
+  // sensor task's last ping, which can be a whole telemetry period old.
+  // Short timeout, as in executeFollowStep: only close range matters here.
+  float front = sensorManager.readDistanceCM(SIDE_ULTRASONIC_TIMEOUT);
+  if (front < parameters.getInt(PARAM_CRITICAL_CM)) {
+    if (!routeBlocked) {
+      LOG_WARN("Route paused: obstacle ahead");
+      routeBlocked = true;
+    }
+    return;
+  }
+  routeBlocked = false;
+
+  Pose pose = getRoutePose();
+  Waypoint goal;
+  if (!findLookahead(pose, goal)) {
+    LOG_INFO("Route complete in %lu ms", millis() - routeStartTime);
+    disableAutonomousMode();
+    return;
+  }
+
+  // Goal in the robot frame: ahead = +x, right = +y (heading is clockwise)
+  float rad = pose.heading * PI / 180.0;
+  float dx = goal.x - pose.x, dy = goal.y - pose.y;
+  float ahead = dx * cos(rad) + dy * sin(rad);
+  float right = -dx * sin(rad) + dy * cos(rad);
+  float distSq = dx * dx + dy * dy;
+
+  // Pure pursuit cannot swing round to a point behind it; turn in place
+  if (ahead <= 0) {
+    motorController.rotateRobot(atan2(right, ahead) * 180.0 / PI);
+    return;
+  }
+
+  // Arc through the goal point: curvature = 2 * lateral offset / distance^2
+  float curvature = 2.0 * right / distSq;
+  float trim = constrain(curvature * ROBOT_WIDTH / 20.0, -1.0, 1.0);  // half track in cm
+
+  // Ease off near the final waypoint so one slice cannot overshoot it
+  float scale = 1.0;
+  if (routeIndex == routeLength - 1) {
+    float remaining = hypot(route[routeIndex].x - pose.x, route[routeIndex].y - pose.y);
+    scale = constrain(remaining / ROUTE_LOOKAHEAD_CM, 0.3, 1.0);
+  }
+
+  float base = motorController.getBaseStepRate() * scale;
+  motorController.driveDifferential(base * (1.0 + trim), base * (1.0 - trim),
+                                    ROUTE_CONTROL_PERIOD_MS);
+}
+
+void Navigation::recordSteerError(float error) {
+  errorSquareSum += error * error;
+  errorSamples++;
+
+  // Settled = error stayed inside the band for a full second
+  unsigned long now = millis();
+  if (fabs(error) > WALL_SETTLE_BAND_CM) {
+    inBandSince = 0;
+  } else if (inBandSince == 0) {
+    inBandSince = now;
+  } else if (settleTime == 0 && now - inBandSince >= 1000) {
+    settleTime = inBandSince - followStart;
+  }
+}
+
+void Navigation::reportFollowMetrics(bool force) {
+  if (!force && millis() - lastFollowReport < WALL_REPORT_INTERVAL) {
+    return;
+  }
+  lastFollowReport = millis();
+
+  FollowMetrics metrics = getFollowMetrics();
+  const char* name = mode == NAV_CORRIDOR ? "Corridor" : "Wall follow";
+  if (metrics.settleMs > 0) {
+    LOG_INFO("%s: error %.1f cm (RMS %.1f), settled after %lu ms, speed %.1f cm/s",
+             name, lastSteerError, metrics.rmsError, metrics.settleMs, metrics.speed);
+  } else {
+    LOG_INFO("%s: error %.1f cm (RMS %.1f), settled no, speed %.1f cm/s",
+             name, lastSteerError, metrics.rmsError, metrics.speed);
+  }
+}
+
+FollowMetrics Navigation::getFollowMetrics() const {
+  FollowMetrics metrics;
+  float elapsed = (millis() - followStart) / 1000.0;
+  metrics.rmsError = errorSamples > 0 ? sqrt(errorSquareSum / errorSamples) : 0;
+  metrics.settleMs = settleTime;
+  metrics.speed = elapsed > 0 ? followDistance / elapsed : 0;
+  return metrics;
+}
+
 float Navigation::calculateScore(float distance, float angle) {
   // Base score from distance
   float score = distance;
@@ -161,7 +579,7 @@ float Navigation::calculateScore(float distance, float angle) {
   }
   
   // Minimum distance threshold
-  if (distance < MIN_OBSTACLE_DIST) {
+  if (distance < parameters.getInt(PARAM_OBSTACLE_CM)) {
     score = 0; // Unusable path
   }
   
@@ -198,11 +616,11 @@ void Navigation::clearPathMemory() {
     pathMemory[i].timestamp = 0;
   }
   pathIndex = 0;
-  Serial.println("Path memory cleared");
+  LOG_INFO("Path memory cleared");
 }
 
 void Navigation::emergencyManeuver() {
-  Serial.println("Executing emergency maneuver");
+  LOG_WARN("Executing emergency maneuver");
   
   // Stop immediately
   motorController.stopMoving();
@@ -220,7 +638,7 @@ void Navigation::emergencyManeuver() {
 }
 
 void Navigation::avoidStuckSituation() {
-  Serial.println("Robot appears stuck, executing avoidance maneuver");
+  LOG_WARN("Robot appears stuck, executing avoidance maneuver");
   
   // Random maneuver to break out of stuck situation
   int maneuver = random(0, 3);
@@ -249,7 +667,7 @@ void Navigation::avoidStuckSituation() {
 }
 
 void Navigation::performUTurn() {
-  Serial.println("Performing U-turn");
+  LOG_INFO("Performing U-turn");
   motorController.moveBackward(10);
   delay(200);
   motorController.rotateRobot(180);
@@ -278,25 +696,26 @@ bool Navigation::detectDeadEnd() {
   motorController.rotateRobot(-45);
   
   // Dead end if all directions are blocked
-  bool deadEnd = (leftDist < MIN_OBSTACLE_DIST && 
-                  centerDist < MIN_OBSTACLE_DIST && 
-                  rightDist < MIN_OBSTACLE_DIST);
+  int obstacle = parameters.getInt(PARAM_OBSTACLE_CM);
+  bool deadEnd = (leftDist < obstacle && 
+                  centerDist < obstacle && 
+                  rightDist < obstacle);
   
   if (deadEnd) {
-    Serial.println("Dead end detected!");
+    LOG_WARN("Dead end detected!");
   }
   
   return deadEnd;
 }
 
 void Navigation::scanEnvironment() {
-  Serial.println("Performing environmental scan...");
+  LOG_INFO("Performing environmental scan...");
   
   for (int angle = -90; angle <= 90; angle += 30) {
     motorController.rotateRobot(angle);
     delay(200);
     float distance = sensorManager.getFilteredDistance(2);
-    Serial.printf("Angle %d°: %.1f cm\n", angle, distance);
+    LOG_DEBUG("Angle %d°: %.1f cm", angle, distance);
   }
   
   // Return to forward position
@@ -317,10 +736,24 @@ void Navigation::printPathMemory() {
 
 void Navigation::printNavigationStats() {
   Serial.println("=== Navigation Stats ===");
-  Serial.printf("Autonomous mode: %s\n", isAutonomousMode ? "ON" : "OFF");
+  const char* modeName = "OFF";
+  switch (mode) {
+    case NAV_WANDER:      modeName = "WANDER"; break;
+    case NAV_EXPLORE:     modeName = "EXPLORE"; break;
+    case NAV_WALL_FOLLOW: modeName = "WALL_FOLLOW"; break;
+    case NAV_CORRIDOR:    modeName = "CORRIDOR"; break;
+    case NAV_ROUTE:       modeName = "ROUTE"; break;
+    default: break;
+  }
+  Serial.printf("Autonomous mode: %s\n", modeName);
+  if (mode == NAV_EXPLORE) {
+    Serial.printf("Exploration coverage: %.1f%%\n", explorer.getCoverage());
+  }
   Serial.printf("Stuck counter: %d\n", stuckCounter);
   Serial.printf("Last best angle: %.1f°\n", lastBestAngle);
   Serial.printf("Path memory entries: %d\n", getPathMemorySize());
+  Serial.printf("Route: %d waypoints%s\n", routeLength,
+                mode == NAV_ROUTE ? " (following)" : "");
   Serial.println("========================");
 }
 
@@ -338,5 +771,5 @@ void Navigation::resetNavigationStats() {
   stuckCounter = 0;
   lastBestAngle = 0;
   clearPathMemory();
-  Serial.println("Navigation stats reset");
+  LOG_INFO("Navigation stats reset");
 }
\ No newline at end of file
@@ -3,15 +3,46 @@
 
 #include "types.h"
 #include "config.h"
+#include <freertos/FreeRTOS.h>
 
 class Navigation {
 private:
   // State
-  bool isAutonomousMode;
+  NavMode mode;
   unsigned long lastNavigationUpdate;
   float lastBestAngle;
   int stuckCounter;
 
+  // Wall following / corridor centering
+  int wallSide;                 // -1 = left wall, +1 = right wall
+  float wallTarget;             // cm
+  float lastSteerError;
+  bool haveSteerError;
+  float followSteer;            // trim held until the next range scan
+  unsigned long lastControlTime;  // timestamp of the scan last steered from
+  unsigned long scanAfter;      // ignore scans taken before this (a turn)
+
+  // Steering metrics (reported over Serial)
+  unsigned long followStart;
+  unsigned long inBandSince;    // 0 while outside WALL_SETTLE_BAND_CM
+  unsigned long settleTime;     // 0 until settled
+  float errorSquareSum;
+  unsigned long errorSamples;
+  float followDistance;         // cm travelled since the mode started
+  unsigned long lastFollowReport;
+
+  // Uploaded route (pure pursuit). The links edit it and the motor task
+  // starts it; routeLock covers both, and the motor task reads it without
+  // the lock once mode is NAV_ROUTE, when edits are refused.
+  portMUX_TYPE routeLock;
+  Waypoint route[ROUTE_MAX_WAYPOINTS];
+  int routeLength;
+  int routeIndex;               // waypoint currently being pursued
+  Waypoint routeOrigin;         // pose the route was started from
+  bool routeLocalized;          // route frame: arena (MCL) or start-relative
+  bool routeBlocked;
+  unsigned long routeStartTime;
+
   // Path memory (circular buffer)
   PathMemoryEntry pathMemory[PATH_MEMORY_SIZE];
   int pathIndex;
@@ -23,6 +54,22 @@ private:
   void updatePathMemory(float distance, float angle);
   void clearPathMemory();
 
+  // Frontier exploration
+  void executeExplorationStep();
+  void scanIntoMap();
+
+  // Wall following / corridor centering
+  void startFollowing(NavMode followMode);
+  void executeFollowStep();
+  void recordSteerError(float error);
+  void reportFollowMetrics(bool force = false);
+
+  // Route following
+  void executeRouteStep();
+  Pose getRoutePose();
+  void resetOdometry();
+  bool findLookahead(const Pose& pose, Waypoint& goal);
+
   // Recovery maneuvers
   void emergencyManeuver();
   void avoidStuckSituation();
@@ -36,8 +83,27 @@ public:
 
   // Mode control
   void enableAutonomousMode();
+  void enableExplorationMode();
+  void enableWallFollow(int targetCM);   // negative = left wall, positive = right
+  void enableCorridorCentering();
+  bool startRoute();
+
+  // Route upload (rejected while a route is being followed). Each call
+  // changes the route in one step, so a route starting meanwhile gets the
+  // old one or the new one, never half of it.
+  bool setRoute(const Waypoint* points, int count, bool append);
+  bool addWaypoint(float x, float y);
+  void clearRoute();
+  int getRouteLength() const;
   void disableAutonomousMode();
   bool isAutonomous() const;
+  NavMode getMode() const;
+  uint8_t getSideSensors() const;   // SIDE_SENSOR_* the sensor task should scan
+
+  // Best available pose: odometry carried into the arena frame once
+  // localization has converged (and from then on, even if it loses
+  // convergence), otherwise raw odometry. frame, if given, says which.
+  Pose getPose(PoseFrame* frame = nullptr);
 
   // Main autonomous step (called from the motor task)
   void executeAutonomousStep();
@@ -47,6 +113,7 @@ public:
   void scanEnvironment();
 
   // Diagnostics
+  FollowMetrics getFollowMetrics() const;   // motor task, or while it's idle
   void printPathMemory();
   void printNavigationStats();
   int getPathMemorySize() const;
@@ -0,0 +1,162 @@
+#include "ota_backend.h"
+#include "config.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define FLASH_SECTOR_SIZE   4096
+
+EspOtaBackend::EspOtaBackend()
+  : partition(nullptr),
+    handle(0),
+    open(false),
+    error("none") {
+}
+
+bool EspOtaBackend::check(esp_err_t err) {
+  if (err != ESP_OK) {
+    error = esp_err_to_name(err);
+    return false;
+  }
+  return true;
+}
+
+const char* EspOtaBackend::getName() const {
+  return "flash";
+}
+
+bool EspOtaBackend::begin(uint32_t size) {
+  abort();
+
+  partition = esp_ota_get_next_update_partition(nullptr);
+  if (partition == nullptr) {
+    error = "no OTA partition";
+    return false;
+  }
+  if (size == 0 || size > partition->size) {
+    error = "image does not fit the partition";
+    return false;
+  }
+
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+  if (!check(esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle))) return false;
+#else
+  if (!check(esp_ota_begin(partition, size, &handle))) return false;
+#endif
+  open = true;
+  return true;
+}
+
+bool EspOtaBackend::write(const uint8_t* data, size_t length) {
+  if (!open) {
+    error = "not started";
+    return false;
+  }
+  return check(esp_ota_write(handle, data, length));
+}
+
+bool EspOtaBackend::finish() {
+  if (!open) {
+    error = "not started";
+    return false;
+  }
+
+  // esp_ota_end checks the image header and its own checksum
+  open = false;
+  if (!check(esp_ota_end(handle))) return false;
+  return check(esp_ota_set_boot_partition(partition));
+}
+
+void EspOtaBackend::abort() {
+  if (open) {
+    esp_ota_abort(handle);
+    open = false;
+  }
+}
+
+bool EspOtaBackend::needsRestart() const {
+  return true;
+}
+
+const char* EspOtaBackend::getError() const {
+  return error;
+}
+
+SimulatedOtaBackend::SimulatedOtaBackend(uint32_t capacityBytes)
+  : capacity(capacityBytes),
+    imageSize(0),
+    written(0),
+    erasedSectors(0),
+    failAt(0),
+    open(false),
+    error("none") {
+}
+
+void SimulatedOtaBackend::failWriteAt(uint32_t offset) {
+  failAt = offset;
+}
+
+const char* SimulatedOtaBackend::getName() const {
+  return "simulated";
+}
+
+bool SimulatedOtaBackend::begin(uint32_t size) {
+  if (size == 0 || size > capacity) {
+    error = "image does not fit the partition";
+    return false;
+  }
+  imageSize = size;
+  written = 0;
+  erasedSectors = 0;
+  open = true;
+  return true;
+}
+
+bool SimulatedOtaBackend::write(const uint8_t* data, size_t length) {
+  if (!open) {
+    error = "not started";
+    return false;
+  }
+  if (written + length > imageSize) {
+    error = "write past the end of the image";
+    return false;
+  }
+  if (failAt != 0 && written <= failAt && failAt < written + length) {
+    error = "injected write failure";
+    return false;
+  }
+
+  // Erase-before-write, one sector at a time as the image reaches it
+  uint32_t sectorsNeeded = (written + length + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+  while (erasedSectors < sectorsNeeded) {
+    vTaskDelay(pdMS_TO_TICKS(OTA_SIM_ERASE_MS));
+    erasedSectors++;
+  }
+
+  written += length;
+  return true;
+}
+
+bool SimulatedOtaBackend::finish() {
+  if (!open) {
+    error = "not started";
+    return false;
+  }
+  open = false;
+  if (written != imageSize) {
+    error = "image incomplete";
+    return false;
+  }
+  return true;
+}
+
+void SimulatedOtaBackend::abort() {
+  open = false;
+}
+
+bool SimulatedOtaBackend::needsRestart() const {
+  return false;
+}
+
+const char* SimulatedOtaBackend::getError() const {
+  return error;
+}
@@ -0,0 +1,81 @@
+#ifndef OTA_BACKEND_H
+#define OTA_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_ota_ops.h>
+
+// Where an incoming firmware image is written. Writes are sequential and go
+// straight to flash; nothing holds the image in RAM.
+class OtaBackend {
+public:
+  virtual ~OtaBackend() {}
+
+  virtual const char* getName() const = 0;
+
+  // Prepare for an image of size bytes; false if it can't be taken
+  virtual bool begin(uint32_t size) = 0;
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+
+  // All bytes written and verified: validate the image and boot it next
+  virtual bool finish() = 0;
+  virtual void abort() = 0;
+
+  // Whether finish() leaves a new image to restart into
+  virtual bool needsRestart() const = 0;
+  virtual const char* getError() const = 0;
+};
+
+// The inactive app partition, through esp_ota_*. Flash is erased as the
+// image arrives rather than all at once, so the first chunk isn't held up
+// by a full-partition erase.
+class EspOtaBackend : public OtaBackend {
+private:
+  const esp_partition_t* partition;
+  esp_ota_handle_t handle;
+  bool open;
+  const char* error;
+
+  bool check(esp_err_t err);
+
+public:
+  EspOtaBackend();
+
+  const char* getName() const override;
+  bool begin(uint32_t size) override;
+  bool write(const uint8_t* data, size_t length) override;
+  bool finish() override;
+  void abort() override;
+  bool needsRestart() const override;
+  const char* getError() const override;
+};
+
+// A stand-in partition for testing the transfer path: it enforces the same
+// size limit and sequential writes, spends OTA_SIM_ERASE_MS per 4 KB sector
+// like a real erase, and can fail on purpose at a given offset. Nothing is
+// stored and the running firmware stays in place.
+class SimulatedOtaBackend : public OtaBackend {
+private:
+  uint32_t capacity;
+  uint32_t imageSize;
+  uint32_t written;
+  uint32_t erasedSectors;
+  uint32_t failAt;            // offset of an injected write error, 0 = none
+  bool open;
+  const char* error;
+
+public:
+  SimulatedOtaBackend(uint32_t capacityBytes);
+
+  void failWriteAt(uint32_t offset);
+
+  const char* getName() const override;
+  bool begin(uint32_t size) override;
+  bool write(const uint8_t* data, size_t length) override;
+  bool finish() override;
+  void abort() override;
+  bool needsRestart() const override;
+  const char* getError() const override;
+};
+
+#endif // OTA_BACKEND_H
@@ -0,0 +1,352 @@
+#include "ota_update.h"
+#include "link_manager.h"
+#include "logger.h"
+#include "trace.h"
+#include "parameters.h"
+#include <Arduino.h>
+#include <string.h>
+#include <freertos/task.h>
+#include <mbedtls/version.h>
+
+#if OTA_SIMULATED
+static SimulatedOtaBackend otaStorage(OTA_SIM_CAPACITY);
+#else
+static EspOtaBackend otaStorage;
+#endif
+
+// Global instance
+OtaUpdater otaUpdater(&otaStorage);
+
+// mbedtls 3 dropped the _ret suffixes that 2.x (arduino-esp32 2.x) uses
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#define sha256Starts  mbedtls_sha256_starts
+#define sha256Update  mbedtls_sha256_update
+#define sha256Finish  mbedtls_sha256_finish
+#else
+#define sha256Starts  mbedtls_sha256_starts_ret
+#define sha256Update  mbedtls_sha256_update_ret
+#define sha256Finish  mbedtls_sha256_finish_ret
+#endif
+
+static uint32_t readU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+static const char* otaErrorName(OtaError error) {
+  switch (error) {
+    case OTA_ERR_NONE: return "none";
+    case OTA_ERR_MALFORMED: return "malformed packet";
+    case OTA_ERR_STATE: return "no transfer in progress";
+    case OTA_ERR_FLASH: return "flash error";
+    case OTA_ERR_INCOMPLETE: return "image incomplete";
+    case OTA_ERR_HASH: return "hash mismatch";
+    case OTA_ERR_TIMEOUT: return "timed out";
+    case OTA_ERR_ABORTED: return "aborted";
+  }
+  return "unknown";
+}
+
+OtaUpdater::OtaUpdater(OtaBackend* storage)
+  : backend(storage),
+    packetQueue(nullptr),
+    replySink(nullptr),
+    active(false),
+    imageSize(0),
+    received(0),
+    lastNack(0),
+    chunksSinceAck(0),
+    startTime(0),
+    nackCount(0),
+    overrunCount(0),
+    lastDuration(0),
+    lastThroughput(0),
+    lastError(OTA_ERR_NONE) {
+  memset(expectedHash, 0, sizeof(expectedHash));
+}
+
+bool OtaUpdater::begin() {
+  // The window lives here: chunks wait in the queue while the previous
+  // one is written, so the BLE thread never waits on flash
+  packetQueue = packetQueueStorage.create();
+  if (packetQueue == nullptr) {
+    Serial.println("Failed to create OTA queue");
+    return false;
+  }
+
+  TaskHandle_t task = taskStorage.create(
+    taskEntry,
+    "OtaTask",
+    this,
+    1,                          // with the other core 0 tasks
+    0
+  );
+  if (task == nullptr) {
+    Serial.println("Failed to create OTA task");
+    return false;
+  }
+  trace.registerTask(task, "ota");
+  return true;
+}
+
+void OtaUpdater::setReplySink(OtaReplySink sink) {
+  replySink = sink;
+}
+
+void OtaUpdater::receive(const uint8_t* data, size_t length) {
+  if (packetQueue == nullptr || length == 0) return;
+
+  incoming.opcode = data[0];
+  incoming.length = 0;
+  incoming.offset = 0;
+
+  switch (data[0]) {
+    case OTA_BEGIN:
+      if (length != 5 + OTA_HASH_SIZE) {
+        reply(OTA_ERROR, OTA_ERR_MALFORMED, 0);
+        return;
+      }
+      incoming.offset = readU32(data + 1);
+      incoming.length = OTA_HASH_SIZE;
+      memcpy(incoming.data, data + 5, OTA_HASH_SIZE);
+      break;
+
+    case OTA_DATA:
+      if (length <= OTA_DATA_HEADER || length - OTA_DATA_HEADER > OTA_CHUNK_MAX) {
+        reply(OTA_ERROR, OTA_ERR_MALFORMED, received);
+        return;
+      }
+      incoming.offset = readU32(data + 1);
+      incoming.length = length - OTA_DATA_HEADER;
+      memcpy(incoming.data, data + OTA_DATA_HEADER, incoming.length);
+      break;
+
+    case OTA_END:
+    case OTA_ABORT:
+      break;
+
+    default:
+      reply(OTA_ERROR, OTA_ERR_MALFORMED, received);
+      return;
+  }
+
+  if (xQueueSend(packetQueue, &incoming, 0) != pdTRUE) {
+    // The client went past its window. The gap this leaves is NACKed when
+    // the next chunk arrives (or the client times out and resends).
+    overrunCount++;
+  }
+}
+
+void OtaUpdater::linkLost() {
+  if (!active || packetQueue == nullptr) return;
+
+  incoming.opcode = OTA_ABORT;
+  incoming.length = 0;
+  xQueueSendToFront(packetQueue, &incoming, 0);
+}
+
+bool OtaUpdater::isActive() const {
+  return active;
+}
+
+int OtaUpdater::getQueueDepth() const {
+  return packetQueue != nullptr ? uxQueueMessagesWaiting(packetQueue) : 0;
+}
+
+void OtaUpdater::taskEntry(void* parameter) {
+  static_cast<OtaUpdater*>(parameter)->run();
+}
+
+void OtaUpdater::run() {
+  for (;;) {
+    // Idle until a client starts; during a transfer, silence is an error
+    TickType_t wait = active ? pdMS_TO_TICKS(OTA_TIMEOUT_MS) : portMAX_DELAY;
+    if (xQueueReceive(packetQueue, &current, wait) != pdTRUE) {
+      fail(OTA_ERR_TIMEOUT);
+      continue;
+    }
+    handlePacket();
+  }
+}
+
+void OtaUpdater::handlePacket() {
+  switch (current.opcode) {
+    case OTA_BEGIN:
+      startTransfer();
+      break;
+
+    case OTA_DATA:
+      if (!active) {
+        reply(OTA_ERROR, OTA_ERR_STATE, 0);
+      } else {
+        writeChunk();
+      }
+      break;
+
+    case OTA_END:
+      if (!active) {
+        reply(OTA_ERROR, OTA_ERR_STATE, 0);
+      } else {
+        endTransfer();
+      }
+      break;
+
+    case OTA_ABORT:
+      if (active) {
+        fail(OTA_ERR_ABORTED);
+      }
+      break;
+  }
+}
+
+void OtaUpdater::startTransfer() {
+  // A repeated BEGIN restarts the transfer (the client may have timed out)
+  if (active) {
+    backend->abort();
+    mbedtls_sha256_free(&sha);
+    active = false;
+  }
+
+  imageSize = current.offset;
+  memcpy(expectedHash, current.data, OTA_HASH_SIZE);
+  received = 0;
+  lastNack = UINT32_MAX;
+  chunksSinceAck = 0;
+  nackCount = 0;
+  overrunCount = 0;
+  lastError = OTA_ERR_NONE;
+
+  // Nothing may move while flash is written; commands are refused until
+  // the transfer ends
+  linkManager.requestStop();
+
+  if (!backend->begin(imageSize)) {
+    LOG_ERROR("OTA rejected (%u bytes): %s", (unsigned)imageSize, backend->getError());
+    lastError = OTA_ERR_FLASH;
+    reply(OTA_ERROR, OTA_ERR_FLASH, 0);
+    return;
+  }
+
+  mbedtls_sha256_init(&sha);
+  sha256Starts(&sha, 0);
+  startTime = millis();
+  active = true;
+
+  LOG_INFO("OTA started: %u bytes to %s", (unsigned)imageSize, backend->getName());
+  reply(OTA_READY, OTA_WINDOW, OTA_CHUNK_MAX);
+}
+
+void OtaUpdater::writeChunk() {
+  if (current.offset != received) {
+    // Chunks behind us are resends we already have; a chunk ahead means
+    // one went missing. Ask for the gap once and drop the rest of the
+    // window until the client goes back.
+    if (current.offset > received && lastNack != received) {
+      lastNack = received;
+      nackCount++;
+      reply(OTA_NACK, received, 0);
+    }
+    return;
+  }
+
+  if (current.length > imageSize - received) {
+    fail(OTA_ERR_FLASH);
+    return;
+  }
+  if (!backend->write(current.data, current.length)) {
+    LOG_ERROR("OTA write at %u failed: %s", (unsigned)received, backend->getError());
+    fail(OTA_ERR_FLASH);
+    return;
+  }
+
+  sha256Update(&sha, current.data, current.length);
+  received += current.length;
+
+  if (++chunksSinceAck >= OTA_ACK_EVERY || received == imageSize) {
+    chunksSinceAck = 0;
+    reply(OTA_ACK, received, 0);
+  }
+}
+
+void OtaUpdater::endTransfer() {
+  if (received != imageSize) {
+    fail(OTA_ERR_INCOMPLETE);
+    return;
+  }
+
+  uint8_t hash[OTA_HASH_SIZE];
+  sha256Finish(&sha, hash);
+  mbedtls_sha256_free(&sha);
+  active = false;
+
+  if (memcmp(hash, expectedHash, OTA_HASH_SIZE) != 0) {
+    backend->abort();
+    lastError = OTA_ERR_HASH;
+    LOG_ERROR("OTA image hash mismatch, discarded");
+    reply(OTA_ERROR, OTA_ERR_HASH, received);
+    return;
+  }
+  if (!backend->finish()) {
+    lastError = OTA_ERR_FLASH;
+    LOG_ERROR("OTA image rejected: %s", backend->getError());
+    reply(OTA_ERROR, OTA_ERR_FLASH, received);
+    return;
+  }
+
+  lastDuration = millis() - startTime;
+  lastThroughput = lastDuration > 0 ? (uint64_t)imageSize * 1000 / lastDuration : imageSize;
+  LOG_INFO("OTA complete: %u bytes in %lu ms (%lu B/s), %lu NACKs, %lu overruns",
+           (unsigned)imageSize, (unsigned long)lastDuration, (unsigned long)lastThroughput,
+           (unsigned long)nackCount, (unsigned long)overrunCount);
+  reply(OTA_DONE, imageSize, lastThroughput);
+
+  if (backend->needsRestart()) {
+    // Give the reply (and the log line) time to get out, and keep
+    // parameter changes still waiting for their write
+    vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+    parameters.commit();
+    ESP.restart();
+  }
+}
+
+void OtaUpdater::fail(OtaError error) {
+  if (active) {
+    backend->abort();
+    mbedtls_sha256_free(&sha);
+    active = false;
+  }
+  lastError = error;
+  LOG_WARN("OTA failed at %u of %u bytes: %s", (unsigned)received, (unsigned)imageSize,
+           otaErrorName(error));
+  reply(OTA_ERROR, error, received);
+}
+
+void OtaUpdater::reply(OtaEvent event, uint32_t value, uint32_t extra) {
+  OtaReplySink sink = replySink;
+  if (sink == nullptr) return;
+
+  uint8_t out[OTA_REPLY_SIZE];
+  out[0] = OTA_MAGIC;
+  out[1] = event;
+  writeU32(out + 2, value);
+  writeU32(out + 6, extra);
+  sink(out, sizeof(out));
+}
+
+void OtaUpdater::printStatus() {
+  if (active) {
+    Serial.printf("OTA - %u of %u bytes to %s, %lu NACKs, %lu overruns\n",
+                  (unsigned)received, (unsigned)imageSize, backend->getName(),
+                  (unsigned long)nackCount, (unsigned long)overrunCount);
+  } else if (lastError != OTA_ERR_NONE) {
+    Serial.printf("OTA - last update failed: %s\n", otaErrorName(lastError));
+  } else if (lastDuration > 0) {
+    Serial.printf("OTA - last update %lu B/s over %lu ms\n",
+                  (unsigned long)lastThroughput, (unsigned long)lastDuration);
+  }
+}
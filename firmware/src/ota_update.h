@@ -0,0 +1,131 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "static_alloc.h"
+#include "ota_backend.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <mbedtls/sha256.h>
+
+// Firmware update over the OTA characteristic. The client writes
+//
+//   OTA_BEGIN  [op][size u32][sha256 32 bytes]
+//   OTA_DATA   [op][offset u32][image bytes, at most OTA_CHUNK_MAX]
+//   OTA_END    [op]
+//   OTA_ABORT  [op]
+//
+// and the robot notifies (OTA_REPLY_SIZE bytes)
+//
+//   [0]     magic     OTA_MAGIC
+//   [1]     event     OtaEvent
+//   [2..5]  value     u32, see OtaEvent
+//   [6..9]  extra     u32, see OtaEvent
+//
+// Transfer is a sliding window: the client keeps up to OTA_WINDOW chunks
+// in flight past the last OTA_ACK. The robot writes them to flash in order
+// and acks every OTA_ACK_EVERY chunks; a chunk at the wrong offset is
+// dropped and answered with one OTA_NACK carrying the offset it needs, and
+// the client resends from there (go-back-N). After OTA_END the hash of
+// everything written is checked against the one from OTA_BEGIN, the new
+// image is marked for boot and the robot restarts. All fields are
+// little-endian.
+#define OTA_MAGIC               0xED
+#define OTA_HASH_SIZE           32
+#define OTA_REPLY_SIZE          10
+#define OTA_DATA_HEADER         5
+
+enum OtaOpcode {
+  OTA_BEGIN = 0x01,
+  OTA_DATA  = 0x02,
+  OTA_END   = 0x03,
+  OTA_ABORT = 0x04
+};
+
+enum OtaEvent {
+  OTA_READY,      // value = window in chunks, extra = largest chunk
+  OTA_ACK,        // value = bytes written so far
+  OTA_NACK,       // value = offset the robot needs next
+  OTA_DONE,       // value = image size, extra = bytes per second
+  OTA_ERROR       // value = OtaError, extra = bytes written
+};
+
+enum OtaError {
+  OTA_ERR_NONE,
+  OTA_ERR_MALFORMED,    // packet too short, or unknown opcode
+  OTA_ERR_STATE,        // data or end without a transfer
+  OTA_ERR_FLASH,        // the backend refused the image or a write
+  OTA_ERR_INCOMPLETE,   // end before all bytes arrived
+  OTA_ERR_HASH,         // image doesn't match the announced SHA-256
+  OTA_ERR_TIMEOUT,      // nothing received for OTA_TIMEOUT_MS
+  OTA_ERR_ABORTED       // client abort or disconnect
+};
+
+// Sends a reply notification to the client
+typedef void (*OtaReplySink)(const uint8_t* data, size_t length);
+
+class OtaUpdater {
+private:
+  // A client packet on its way from the BLE thread to the OTA task
+  struct Packet {
+    uint8_t opcode;
+    uint16_t length;            // bytes in data
+    uint32_t offset;            // OTA_DATA offset, OTA_BEGIN size
+    uint8_t data[OTA_CHUNK_MAX];
+  };
+
+  OtaBackend* backend;
+  QueueHandle_t packetQueue;    // OTA_WINDOW deep: the window's own buffer
+  QueueStorage<Packet, OTA_WINDOW> packetQueueStorage;
+  TaskStorage<OTA_TASK_STACK> taskStorage;
+  volatile OtaReplySink replySink;
+  Packet incoming;              // BLE thread only
+  Packet current;               // OTA task only
+
+  // Transfer state (OTA task)
+  volatile bool active;
+  uint32_t imageSize;
+  volatile uint32_t received;
+  uint32_t lastNack;            // don't repeat a NACK for the same gap
+  int chunksSinceAck;
+  uint8_t expectedHash[OTA_HASH_SIZE];
+  mbedtls_sha256_context sha;
+  unsigned long startTime;
+
+  // Statistics of the last transfer
+  volatile uint32_t nackCount;
+  volatile uint32_t overrunCount;   // chunks beyond the window, dropped
+  uint32_t lastDuration;
+  uint32_t lastThroughput;          // bytes per second
+  OtaError lastError;
+
+  static void taskEntry(void* parameter);
+  void run();
+  void handlePacket();
+  void startTransfer();
+  void writeChunk();
+  void endTransfer();
+  void fail(OtaError error);
+  void reply(OtaEvent event, uint32_t value, uint32_t extra);
+
+public:
+  OtaUpdater(OtaBackend* storage);
+
+  bool begin();
+  void setReplySink(OtaReplySink sink);
+
+  // A write on the OTA characteristic (BLE thread); never blocks
+  void receive(const uint8_t* data, size_t length);
+  void linkLost();
+
+  bool isActive() const;
+  int getQueueDepth() const;        // chunks waiting to be written
+  void printStatus();
+};
+
+// Global OTA updater instance
+extern OtaUpdater otaUpdater;
+
+#endif // OTA_UPDATE_H
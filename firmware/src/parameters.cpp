@@ -0,0 +1,258 @@
+#include "parameters.h"
+#include "task_events.h"
+#include "logger.h"
+#include <Arduino.h>
+#include <stdlib.h>
+
+// NVS namespace for the parameters; keys are the parameter names
+static const char* PARAM_NAMESPACE = "params";
+
+// Where MotorControl kept the speed before there were parameters
+static const char* LEGACY_MOTOR_NAMESPACE = "motorcfg";
+static const char* LEGACY_SPEED_KEY = "speed";
+
+static const ParamInfo PARAM_TABLE[] = {
+  // name         type         min     max     default
+  {"speed",      PARAM_INT,   200,    1000,   DEFAULT_SPEED},
+  {"obstacleCm", PARAM_INT,   5,      200,    MIN_OBSTACLE_DIST},
+  {"criticalCm", PARAM_INT,   5,      100,    CRITICAL_DISTANCE},
+  {"scanStart",  PARAM_INT,   -180,   0,      SCAN_ANGLE_START},
+  {"scanEnd",    PARAM_INT,   0,      180,    SCAN_ANGLE_END},
+  {"scanStep",   PARAM_INT,   1,      90,     SCAN_ANGLE_STEP},
+  {"wallKp",     PARAM_FLOAT, 0,      1,      WALL_KP},
+  {"wallKd",     PARAM_FLOAT, 0,      1,      WALL_KD},
+  {"wallTrim",   PARAM_FLOAT, 0,      0.9,    WALL_MAX_TRIM},
+  {"holdKp",     PARAM_FLOAT, 0,      1,      HEADING_HOLD_KP},
+  {"sensorMs",   PARAM_INT,   100,    10000,  SENSOR_UPDATE_RATE},
+};
+static_assert(sizeof(PARAM_TABLE) / sizeof(PARAM_TABLE[0]) == PARAM_COUNT,
+              "one PARAM_TABLE entry per ParamId");
+
+// Global instance
+Parameters parameters;
+
+static int32_t floatBits(float value) {
+  int32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static int32_t defaultBits(const ParamInfo& info) {
+  return info.type == PARAM_INT ? (int32_t)lroundf(info.defaultValue) : floatBits(info.defaultValue);
+}
+
+static bool inRange(const ParamInfo& info, float value) {
+  // Written this way round so NaN fails
+  return value >= info.min && value <= info.max;
+}
+
+Parameters::Parameters()
+  : dirty(0),
+    lastChange(0),
+    lastCommit(0),
+    commitCount(0),
+    writeCount(0),
+    opened(false),
+    commitMutex(nullptr) {
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    values[i] = defaultBits(PARAM_TABLE[i]);
+    stored[i] = values[i];
+  }
+}
+
+bool Parameters::begin() {
+  // Service and a commit before a restart may run on different tasks
+  commitMutex = commitMutexStorage.create();
+  if (commitMutex == nullptr) {
+    Serial.println("Failed to create parameter mutex");
+    return false;
+  }
+
+  // Kept open for good: opening allocates, committing then doesn't
+  opened = prefs.begin(PARAM_NAMESPACE, false);
+  if (!opened) {
+    Serial.println("Failed to open parameter storage, using defaults");
+    return false;
+  }
+
+  // A key that was never written holds the default; stored[] says so,
+  // and the key is only created once the value differs
+  int loaded = 0;
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    const ParamInfo& info = PARAM_TABLE[i];
+    if (!prefs.isKey(info.name)) continue;
+
+    float value;
+    int32_t bits;
+    if (info.type == PARAM_INT) {
+      int32_t saved = prefs.getInt(info.name, defaultBits(info));
+      value = saved;
+      bits = saved;
+    } else {
+      value = prefs.getFloat(info.name, info.defaultValue);
+      bits = floatBits(value);
+    }
+    stored[i] = bits;
+    if (!inRange(info, value)) {
+      Serial.printf("Ignoring saved %s: out of range\n", info.name);
+      continue;
+    }
+    values[i] = bits;
+    loaded++;
+  }
+
+  // Carry over a speed saved by older firmware; it moves to this
+  // namespace with the next commit
+  if (!prefs.isKey(PARAM_TABLE[PARAM_SPEED].name)) {
+    Preferences legacy;
+    if (legacy.begin(LEGACY_MOTOR_NAMESPACE, true)) {
+      int32_t speed = legacy.getInt(LEGACY_SPEED_KEY, DEFAULT_SPEED);
+      legacy.end();
+      setInt(PARAM_SPEED, speed);
+    }
+  }
+
+  Serial.printf("Parameters: %d of %d loaded from NVS\n", loaded, PARAM_COUNT);
+  return true;
+}
+
+void Parameters::store(ParamId id, int32_t bits) {
+  if (values[id] == bits) return;
+  values[id] = bits;
+  lastChange = millis();
+  dirty.fetch_or(1u << id, std::memory_order_relaxed);
+  // The motor task times the write; the sensor task runs on this one
+  taskEvents.signal(id == PARAM_SENSOR_MS ? EVENT_PARAMS | EVENT_SENSOR_PLAN : EVENT_PARAMS);
+}
+
+bool Parameters::setInt(ParamId id, int32_t value) {
+  const ParamInfo& info = PARAM_TABLE[id];
+  if (info.type != PARAM_INT || value < info.min || value > info.max) return false;
+  store(id, value);
+  return true;
+}
+
+bool Parameters::setFloat(ParamId id, float value) {
+  const ParamInfo& info = PARAM_TABLE[id];
+  if (info.type != PARAM_FLOAT || !inRange(info, value)) return false;
+  store(id, floatBits(value));
+  return true;
+}
+
+bool Parameters::setText(ParamId id, const char* text) {
+  char* end = nullptr;
+  if (PARAM_TABLE[id].type == PARAM_INT) {
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0') return false;
+    return setInt(id, value);
+  }
+  float value = strtof(text, &end);
+  if (end == text || *end != '\0') return false;
+  return setFloat(id, value);
+}
+
+void Parameters::resetDefaults() {
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    store((ParamId)i, defaultBits(PARAM_TABLE[i]));
+  }
+}
+
+int Parameters::find(const char* name) const {
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    if (strcmp(PARAM_TABLE[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+const ParamInfo& Parameters::getInfo(ParamId id) const {
+  return PARAM_TABLE[id];
+}
+
+float Parameters::getValue(ParamId id) const {
+  return PARAM_TABLE[id].type == PARAM_INT ? (float)getInt(id) : getFloat(id);
+}
+
+uint32_t Parameters::service() {
+  if (dirty.load(std::memory_order_relaxed) == 0) return PARAM_NO_TIMEOUT;
+
+  // Let a burst of changes settle, and space the writes out
+  unsigned long now = millis();
+  unsigned long quiet = now - lastChange;
+  unsigned long wait = quiet < PARAM_COMMIT_DELAY_MS ? PARAM_COMMIT_DELAY_MS - quiet : 0;
+  unsigned long sinceCommit = now - lastCommit;
+  if (commitCount > 0 && sinceCommit < PARAM_COMMIT_MIN_MS) {
+    wait = max(wait, PARAM_COMMIT_MIN_MS - sinceCommit);
+  }
+  if (wait > 0) return wait;
+
+  commit();
+  return dirty.load(std::memory_order_relaxed) == 0 ? PARAM_NO_TIMEOUT : PARAM_COMMIT_MIN_MS;
+}
+
+bool Parameters::commit() {
+  if (!opened || commitMutex == nullptr) return false;
+  xSemaphoreTake(commitMutex, portMAX_DELAY);
+
+  uint32_t pending = dirty.exchange(0, std::memory_order_relaxed);
+  bool ok = true;
+  int written = 0;
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    if (!(pending & (1u << i))) continue;
+    int32_t bits = values[i];
+    if (bits == stored[i]) continue;      // changed and changed back
+
+    const ParamInfo& info = PARAM_TABLE[i];
+    size_t length;
+    if (info.type == PARAM_INT) {
+      length = prefs.putInt(info.name, bits);
+    } else {
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      length = prefs.putFloat(info.name, value);
+    }
+    if (length == 0) {
+      // Try again with the next commit
+      dirty.fetch_or(1u << i, std::memory_order_relaxed);
+      ok = false;
+      continue;
+    }
+    stored[i] = bits;
+    written++;
+  }
+
+  if (pending != 0) {
+    lastCommit = millis();
+    commitCount++;
+    writeCount += written;
+  }
+  xSemaphoreGive(commitMutex);
+
+  if (written > 0) {
+    LOG_INFO("Parameters saved (%d written)", written);
+  }
+  if (!ok) {
+    LOG_WARN("Some parameters could not be saved");
+  }
+  return ok;
+}
+
+uint32_t Parameters::getDirtyMask() const {
+  return dirty.load(std::memory_order_relaxed);
+}
+
+void Parameters::printStatus() {
+  uint32_t pending = getDirtyMask();
+  Serial.printf("Parameters: %lu commits, %lu values written%s\n",
+                (unsigned long)commitCount, (unsigned long)writeCount,
+                pending != 0 ? ", changes pending (*)" : "");
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    const ParamInfo& info = PARAM_TABLE[i];
+    if (info.type == PARAM_INT) {
+      Serial.printf("  %-10s %8ld%s\n", info.name, (long)getInt((ParamId)i),
+                    (pending & (1u << i)) ? " *" : "");
+    } else {
+      Serial.printf("  %-10s %8.3f%s\n", info.name, getFloat((ParamId)i),
+                    (pending & (1u << i)) ? " *" : "");
+    }
+  }
+}
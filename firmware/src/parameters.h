@@ -0,0 +1,117 @@
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <Preferences.h>
+#include "config.h"
+#include "static_alloc.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Tunables that can change at run time. The config.h values are the
+// defaults. To add one, extend this enum and the table in parameters.cpp.
+enum ParamId {
+  PARAM_SPEED,            // us per step half-period (lower = faster)
+  PARAM_OBSTACLE_CM,      // obstacle avoidance starts turning below this
+  PARAM_CRITICAL_CM,      // emergency stop / reverse below this
+  PARAM_SCAN_START,       // degrees, path scan sweep
+  PARAM_SCAN_END,
+  PARAM_SCAN_STEP,
+  PARAM_WALL_KP,          // wall following PD gains and trim limit
+  PARAM_WALL_KD,
+  PARAM_WALL_TRIM,
+  PARAM_HOLD_KP,          // heading hold trim per degree
+  PARAM_SENSOR_MS,        // sensor task period
+  PARAM_COUNT
+};
+
+enum ParamType : uint8_t {
+  PARAM_INT,
+  PARAM_FLOAT
+};
+
+struct ParamInfo {
+  const char* name;       // also the NVS key: 15 characters at most
+  ParamType type;
+  float min;
+  float max;
+  float defaultValue;
+};
+
+#define PARAM_NO_TIMEOUT  0xFFFFFFFF  // service(): nothing waiting for flash
+
+// Runtime parameters with a RAM copy and deferred, batched flash writes.
+//
+// Reads are a load from the RAM copy, cheap enough for the step loops;
+// values are 32 bits, so a reader on the other core never sees half a
+// write. set*() validates against the range, updates RAM and marks the
+// parameter dirty; nothing touches flash there, so a change over BLE
+// never holds up a move.
+//
+// The motor task calls service() when it has nothing to run, and it is
+// the task that starts every move, so none can start during a write: a
+// flash write stalls code running from flash on both cores, the step
+// loops included. service() writes the dirty parameters in one pass once
+// they have been left alone for PARAM_COMMIT_DELAY_MS (a dragged slider
+// writes once), at most every PARAM_COMMIT_MIN_MS.
+// Values equal to what flash already holds aren't written again. The NVS
+// handle stays open from begin(), so a commit allocates nothing.
+class Parameters {
+private:
+  volatile int32_t values[PARAM_COUNT];   // int, or float bits
+  int32_t stored[PARAM_COUNT];            // what flash holds (commit() only)
+  std::atomic<uint32_t> dirty;            // bit per ParamId
+  volatile unsigned long lastChange;      // millis()
+  unsigned long lastCommit;
+  uint32_t commitCount;
+  uint32_t writeCount;
+  bool opened;
+  Preferences prefs;
+  SemaphoreHandle_t commitMutex;
+  MutexStorage commitMutexStorage;
+
+  void store(ParamId id, int32_t bits);
+
+public:
+  Parameters();
+
+  // Loads saved values over the defaults. Before anything reads them.
+  bool begin();
+
+  int32_t getInt(ParamId id) const {
+    return values[id];
+  }
+
+  float getFloat(ParamId id) const {
+    int32_t bits = values[id];
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // False (and no change) when out of range or of the wrong type
+  bool setInt(ParamId id, int32_t value);
+  bool setFloat(ParamId id, float value);
+  bool setText(ParamId id, const char* text);
+  void resetDefaults();
+
+  int find(const char* name) const;     // ParamId, or -1
+  const ParamInfo& getInfo(ParamId id) const;
+  float getValue(ParamId id) const;     // either type, for reports
+
+  // Motor task, between moves. Returns ms until it wants to run again,
+  // or PARAM_NO_TIMEOUT.
+  uint32_t service();
+  // Write everything dirty now, e.g. before a restart
+  bool commit();
+
+  uint32_t getDirtyMask() const;
+  void printStatus();
+};
+
+// Global parameters instance
+extern Parameters parameters;
+
+#endif // PARAMETERS_H
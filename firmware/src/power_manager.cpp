@@ -0,0 +1,221 @@
+#include "power_manager.h"
+#include "motor_control.h"
+#include "logger.h"
+#include "trace.h"
+#include <Arduino.h>
+#include <string.h>
+#if CONFIG_PM_ENABLE
+#include <esp_sleep.h>
+#include <driver/uart.h>
+#endif
+
+// Global instance
+PowerManager powerManager;
+
+static const char* const STATE_NAMES[POWER_STATE_COUNT] = {"active", "hold", "idle"};
+
+PowerManager::PowerManager()
+  : state(POWER_HOLD),
+    enteredUs(0),
+    holdStart(0),
+    holdMs(POWER_HOLD_MS),
+    alwaysOn(false),
+    lightSleep(false) {
+  memset(slots, 0, sizeof(slots));
+  lock = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_PM_ENABLE
+  cpuLock = nullptr;
+  sleepLock = nullptr;
+#endif
+}
+
+void PowerManager::begin() {
+#if CONFIG_PM_ENABLE
+  // Dynamic frequency scaling, and light sleep when every task is blocked.
+  // The locks keep the chip at full speed and awake outside IDLE.
+  esp_pm_config_esp32_t config = {};
+  config.max_freq_mhz = POWER_ACTIVE_CPU_MHZ;
+  config.min_freq_mhz = POWER_IDLE_CPU_MHZ > 0 ? POWER_IDLE_CPU_MHZ : POWER_ACTIVE_CPU_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  config.light_sleep_enable = POWER_LIGHT_SLEEP;
+#endif
+  if (esp_pm_configure(&config) != ESP_OK ||
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "robot", &cpuLock) != ESP_OK ||
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "robot", &sleepLock) != ESP_OK) {
+    Serial.println("Failed to configure power management");
+    cpuLock = nullptr;
+    sleepLock = nullptr;
+  } else {
+    esp_pm_lock_acquire(cpuLock);
+    esp_pm_lock_acquire(sleepLock);
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    lightSleep = POWER_LIGHT_SLEEP;
+    // The console wakes the chip too; the character that does is lost
+    uart_set_wakeup_threshold(UART_NUM_0, 3);
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+#endif
+  }
+#endif
+
+  // motorController.begin() left the drivers on: hold from boot
+  enteredUs = micros();
+  holdStart = millis();
+  slots[POWER_HOLD].entries = 1;
+}
+
+void PowerManager::setFullPower(bool full) {
+#if CONFIG_PM_ENABLE
+  if (cpuLock != nullptr) {
+    if (full) {
+      esp_pm_lock_acquire(cpuLock);
+      esp_pm_lock_acquire(sleepLock);
+    } else {
+      esp_pm_lock_release(sleepLock);
+      esp_pm_lock_release(cpuLock);
+    }
+    // Trace timestamps are cycle counts: take new clock references
+    trace.resync();
+    return;
+  }
+#endif
+  if (POWER_IDLE_CPU_MHZ > 0) {
+    setCpuFrequencyMhz(full ? POWER_ACTIVE_CPU_MHZ : POWER_IDLE_CPU_MHZ);
+    trace.resync();
+  }
+}
+
+void PowerManager::enter(PowerState next) {
+  uint32_t now = micros();
+  portENTER_CRITICAL(&lock);
+  slots[state].timeUs += now - enteredUs;
+  slots[next].entries++;
+  enteredUs = now;
+  state = next;
+  portEXIT_CRITICAL(&lock);
+}
+
+void PowerManager::wake() {
+  PowerState from = state;
+  if (from == POWER_ACTIVE) return;
+
+  uint32_t start = micros();
+  if (from == POWER_IDLE) {
+    setFullPower(true);
+    motorController.enableMotors();
+    delayMicroseconds(POWER_DRIVER_WAKE_US);
+  }
+  uint32_t took = micros() - start;
+
+  portENTER_CRITICAL(&lock);
+  slots[from].lastWakeUs = took;
+  if (took > slots[from].maxWakeUs) slots[from].maxWakeUs = took;
+  portEXIT_CRITICAL(&lock);
+  enter(POWER_ACTIVE);
+}
+
+uint32_t PowerManager::idle() {
+  // POWER:FULL brings an idle robot back up
+  if (alwaysOn && state == POWER_IDLE) wake();
+
+  if (state == POWER_ACTIVE) {
+    holdStart = millis();
+    enter(POWER_HOLD);
+  }
+  if (state != POWER_HOLD || alwaysOn) return POWER_NO_TIMEOUT;
+
+  unsigned long held = millis() - holdStart;
+  uint32_t hold = holdMs;
+  if (held < hold) return hold - held;
+
+  motorController.disableMotors();
+  setFullPower(false);
+  enter(POWER_IDLE);
+  LOG_INFO("Idle: motor drivers off");
+  return POWER_NO_TIMEOUT;
+}
+
+void PowerManager::setHoldTime(uint32_t ms) {
+  holdMs = ms;
+}
+
+uint32_t PowerManager::getHoldTime() const {
+  return holdMs;
+}
+
+void PowerManager::setAlwaysOn(bool on) {
+  alwaysOn = on;
+}
+
+bool PowerManager::isAlwaysOn() const {
+  return alwaysOn;
+}
+
+PowerState PowerManager::getState() const {
+  return state;
+}
+
+const char* PowerManager::getStateName() const {
+  return STATE_NAMES[state];
+}
+
+bool PowerManager::getState(int index, StateReport& out) {
+  if (index < 0 || index >= POWER_STATE_COUNT) return false;
+
+  uint32_t drivers = 2 * POWER_EST_DRIVER_MA;
+  uint32_t idleCpu = lightSleep ? POWER_EST_SLEEP_MA
+                   : POWER_IDLE_CPU_MHZ > 0 ? POWER_EST_CPU_IDLE_MA
+                   : POWER_EST_CPU_MA;
+  out.name = STATE_NAMES[index];
+  out.currentMa = index == POWER_IDLE ? idleCpu : POWER_EST_CPU_MA + drivers;
+
+  uint32_t now = micros();
+  portENTER_CRITICAL(&lock);
+  uint64_t timeUs = slots[index].timeUs;
+  if (index == state) timeUs += now - enteredUs;
+  out.entries = slots[index].entries;
+  out.lastWakeUs = slots[index].lastWakeUs;
+  out.maxWakeUs = slots[index].maxWakeUs;
+  portEXIT_CRITICAL(&lock);
+  out.timeMs = timeUs / 1000;
+  return true;
+}
+
+uint32_t PowerManager::getAverageCurrent() {
+  uint64_t charge = 0;
+  uint64_t total = 0;
+  StateReport report;
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    getState(i, report);
+    charge += (uint64_t)report.currentMa * report.timeMs;
+    total += report.timeMs;
+  }
+  return total > 0 ? charge / total : 0;
+}
+
+void PowerManager::reset() {
+  uint32_t now = micros();
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    slots[i].timeUs = 0;
+    slots[i].entries = 0;
+    slots[i].maxWakeUs = 0;
+  }
+  enteredUs = now;
+  portEXIT_CRITICAL(&lock);
+}
+
+void PowerManager::printStatus() {
+  Serial.printf("Power: %s, hold %lu ms%s%s, ~%lu mA average\n",
+                STATE_NAMES[state], (unsigned long)holdMs,
+                alwaysOn ? ", always on" : "",
+                lightSleep ? ", light sleep" : "",
+                (unsigned long)getAverageCurrent());
+  StateReport report;
+  for (int i = 0; i < POWER_STATE_COUNT; i++) {
+    getState(i, report);
+    Serial.printf("  %-6s ~%4lu mA  %8lu ms  %5lu entries  wake %lu us (max %lu)\n",
+                  report.name, (unsigned long)report.currentMa, (unsigned long)report.timeMs,
+                  (unsigned long)report.entries, (unsigned long)report.lastWakeUs,
+                  (unsigned long)report.maxWakeUs);
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stdint.h>
+#include "config.h"
+#include <freertos/FreeRTOS.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+enum PowerState {
+  POWER_ACTIVE,         // running a command or an autonomous mode
+  POWER_HOLD,           // just stopped: drivers hold position, full clock
+  POWER_IDLE,           // drivers off, clock down, light sleep between events
+  POWER_STATE_COUNT
+};
+
+#define POWER_NO_TIMEOUT  0xFFFFFFFF  // idle(): nothing more to time
+
+// Saves battery while the robot sits still.
+//
+// The stepper drivers draw their holding current whenever enabled, which
+// dwarfs everything else, so after POWER_HOLD_MS without motion they are
+// switched off; the clock comes down too and, in builds with ESP-IDF
+// power management (CONFIG_PM_ENABLE), the chip light-sleeps between
+// BLE events. Without it the clock is lowered with setCpuFrequencyMhz().
+// A command brings everything back before it runs.
+//
+// Driven by the motor task alone: wake() before work, idle() when there
+// is none, so the drivers never change state under a move. Other tasks
+// only read the report and change settings.
+class PowerManager {
+public:
+  struct StateReport {
+    const char* name;
+    uint32_t currentMa;       // estimate, from the POWER_EST_* figures
+    uint32_t timeMs;          // spent in the state since boot or reset
+    uint32_t entries;
+    uint32_t lastWakeUs;      // wake() from this state to ready
+    uint32_t maxWakeUs;
+  };
+
+private:
+  struct StateSlot {
+    uint64_t timeUs;
+    uint32_t entries;
+    uint32_t lastWakeUs;
+    uint32_t maxWakeUs;
+  };
+
+  volatile PowerState state;
+  uint32_t enteredUs;         // micros() when state was entered
+  unsigned long holdStart;    // millis() of the last move
+  volatile uint32_t holdMs;
+  volatile bool alwaysOn;     // POWER:FULL, e.g. while measuring timing
+  bool lightSleep;            // automatic light sleep is configured
+  StateSlot slots[POWER_STATE_COUNT];
+  portMUX_TYPE lock;
+
+#if CONFIG_PM_ENABLE
+  esp_pm_lock_handle_t cpuLock;     // both held outside IDLE
+  esp_pm_lock_handle_t sleepLock;
+#endif
+
+  void enter(PowerState next);
+  void setFullPower(bool full);
+
+public:
+  PowerManager();
+
+  void begin();
+
+  // Motor task: before running a command or an autonomous step
+  void wake();
+  // Motor task: nothing to do. Returns how long it may sleep before the
+  // next step down, POWER_NO_TIMEOUT once idle.
+  uint32_t idle();
+
+  void setHoldTime(uint32_t ms);
+  uint32_t getHoldTime() const;
+  void setAlwaysOn(bool on);
+  bool isAlwaysOn() const;
+
+  PowerState getState() const;
+  const char* getStateName() const;
+  bool getState(int state, StateReport& out);
+  uint32_t getAverageCurrent();   // mA, weighted by time in each state
+  void reset();
+
+  void printStatus();
+};
+
+// Global power manager instance
+extern PowerManager powerManager;
+
+#endif // POWER_MANAGER_H
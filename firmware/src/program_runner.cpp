@@ -0,0 +1,201 @@
+#include "program_runner.h"
+#include "protocol.h"
+#include "sensor_manager.h"
+#include "logger.h"
+#include <Arduino.h>
+
+// Global instance
+ProgramRunner programRunner;
+
+ProgramRunner::ProgramRunner()
+  : expectedLength(0),
+    receivedLength(0),
+    uploading(false),
+    ready(false),
+    running(false),
+    waiting(false),
+    waitUntil(0),
+    startTime(0) {
+}
+
+bool ProgramRunner::beginUpload(size_t length) {
+  if (running) {
+    LOG_WARN("Program running, upload rejected");
+    return false;
+  }
+  if (length == 0 || length > PROGRAM_MAX_SIZE) {
+    LOG_WARN("Invalid program length %u", (unsigned)length);
+    return false;
+  }
+
+  ready = false;
+  uploading = true;
+  expectedLength = length;
+  receivedLength = 0;
+  LOG_INFO("Receiving program (%u bytes)", (unsigned)length);
+  return true;
+}
+
+bool ProgramRunner::appendChunk(size_t offset, const uint8_t* data, size_t length) {
+  if (!uploading) {
+    LOG_WARN("Program chunk without upload, ignored");
+    return false;
+  }
+  if (offset != receivedLength || receivedLength + length > expectedLength) {
+    LOG_WARN("Program chunk at %u out of sequence (have %u), upload aborted",
+             (unsigned)offset, (unsigned)receivedLength);
+    uploading = false;
+    return false;
+  }
+
+  memcpy(program + offset, data, length);
+  receivedLength += length;
+  return true;
+}
+
+bool ProgramRunner::finishUpload(uint16_t crc) {
+  if (!uploading) {
+    return false;
+  }
+  uploading = false;
+
+  if (receivedLength != expectedLength) {
+    LOG_WARN("Program incomplete (%u of %u bytes)",
+             (unsigned)receivedLength, (unsigned)expectedLength);
+    return false;
+  }
+  if (crc16(program, receivedLength) != crc) {
+    LOG_WARN("Program CRC mismatch");
+    return false;
+  }
+
+  if (!vm.load(program, receivedLength)) {
+    LOG_WARN("Program rejected: %s", vm.getError());
+    return false;
+  }
+
+  ready = true;
+  LOG_INFO("Program ready: %d instructions", getInstructionCount());
+  return true;
+}
+
+bool ProgramRunner::validateCommand(char type, int32_t value) const {
+  // Values are computed at run time, so check them as they are issued
+  switch (type) {
+    case 'F':
+    case 'B':
+      return value >= 0 && value <= MAX_MOVE_DISTANCE_CM;
+    case 'L':
+    case 'R':
+      return value >= 0 && value <= MAX_TURN_ANGLE;
+    case 'W':
+      return value == 0 || (abs(value) >= WALL_MIN_DIST_CM && abs(value) <= WALL_MAX_DIST_CM);
+    case 'A':
+    case 'M':
+      return value >= 0 && value <= 2;
+    case 'K':
+    case 'H':
+      return value == 0 || value == 1;
+    case 'S':
+    case 'C':
+    case 'P':
+      return true;
+    default:
+      return false;   // includes 'G': a program cannot start itself
+  }
+}
+
+bool ProgramRunner::isReady() const {
+  return ready;
+}
+
+int ProgramRunner::getInstructionCount() const {
+  return vm.getInstructionCount();
+}
+
+bool ProgramRunner::start() {
+  if (!ready) {
+    LOG_WARN("No program uploaded");
+    return false;
+  }
+
+  vm.reset();
+  waiting = false;
+  startTime = millis();
+  running = true;
+  LOG_INFO("Running program (%d instructions)", getInstructionCount());
+  return true;
+}
+
+void ProgramRunner::stop() {
+  if (running) {
+    running = false;
+    LOG_INFO("Program stopped at instruction %d", vm.getProgramCounter());
+  }
+}
+
+bool ProgramRunner::isRunning() const {
+  return running;
+}
+
+bool ProgramRunner::nextCommand(Command& command) {
+  if (!running) {
+    return false;
+  }
+
+  if (waiting) {
+    if ((long)(millis() - waitUntil) < 0) {
+      return false;
+    }
+    waiting = false;
+  }
+
+  char type = 0;
+  int32_t value = 0;
+  switch (vm.run(PROGRAM_STEP_BUDGET, sensorManager.getCurrentDistance(), type, value)) {
+    case VM_YIELD:
+      return false;   // budget used up; resume on the next motor-task pass
+
+    case VM_SLEEP:
+      if (value < 0 || value > PROGRAM_MAX_WAIT_MS) {
+        LOG_WARN("Program wait of %ld ms out of range", (long)value);
+        stop();
+        return false;
+      }
+      waiting = true;
+      waitUntil = millis() + value;
+      return false;
+
+    case VM_COMMAND:
+      if (!validateCommand(type, value)) {
+        LOG_WARN("Program command %c%ld rejected", type, (long)value);
+        stop();
+        return false;
+      }
+      command.type = type;
+      command.value = value;
+      command.seq = 0;
+      command.receivedAt = millis();
+      command.profile = 0;
+      command.source = 0;
+      return true;
+
+    case VM_HALTED:
+      running = false;
+      LOG_INFO("Program finished in %lu ms (%lu instructions)",
+               millis() - startTime, (unsigned long)vm.getExecutedCount());
+      return false;
+
+    case VM_FAULT:
+      LOG_ERROR("Program fault: %s", vm.getError());
+      stop();
+      return false;
+  }
+  return false;
+}
+
+void ProgramRunner::printStatus() {
+  Serial.printf("Program: %d instructions, %s, %lu executed\n", getInstructionCount(),
+                running ? "running" : (ready ? "ready" : "none"),
+                (unsigned long)vm.getExecutedCount());
+}
@@ -0,0 +1,58 @@
+#ifndef PROGRAM_RUNNER_H
+#define PROGRAM_RUNNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "config.h"
+#include "bytecode_vm.h"
+
+// Holds a block-editor program uploaded in chunks over BLE and runs it on
+// the bytecode VM from the motor task. Uploading runs on the BLE callback
+// thread, execution on the motor task; an upload is refused while a program
+// is running, so the two never touch the program at the same time.
+class ProgramRunner {
+private:
+  uint8_t program[PROGRAM_MAX_SIZE];
+  BytecodeVM vm;
+  size_t expectedLength;
+  size_t receivedLength;
+  bool uploading;
+  volatile bool ready;
+  volatile bool running;
+
+  // Execution state (motor task only)
+  bool waiting;
+  unsigned long waitUntil;
+  unsigned long startTime;
+
+  bool validateCommand(char type, int32_t value) const;
+
+public:
+  ProgramRunner();
+
+  // Upload (BLE thread). Chunks must arrive in order; a gap aborts.
+  bool beginUpload(size_t length);
+  bool appendChunk(size_t offset, const uint8_t* data, size_t length);
+  bool finishUpload(uint16_t crc);
+  bool isReady() const;
+  int getInstructionCount() const;
+
+  // Execution (motor task)
+  bool start();
+  void stop();
+  bool isRunning() const;
+
+  // Run the VM for up to PROGRAM_STEP_BUDGET instructions and return the
+  // next command to execute, if any. Waits are timed here rather than
+  // blocking, so a STOP in the command queue can still interrupt them.
+  bool nextCommand(Command& command);
+
+  // Diagnostics
+  void printStatus();
+};
+
+// Global program runner instance
+extern ProgramRunner programRunner;
+
+#endif // PROGRAM_RUNNER_H
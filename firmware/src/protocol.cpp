@@ -0,0 +1,140 @@
+#include "protocol.h"
+#include <string.h>
+
+uint16_t readU16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+int32_t readI32(const uint8_t* p) {
+  return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                   ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static void writeU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void writeI32(uint8_t* p, int32_t value) {
+  uint32_t u = (uint32_t)value;
+  for (int i = 0; i < 4; i++) {
+    p[i] = (u >> (8 * i)) & 0xFF;
+  }
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  writeI32(p, (int32_t)value);
+}
+
+uint16_t crc16(const uint8_t* data, size_t length) {
+  // CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF, no reflection
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+FrameStatus decodeFrame(const uint8_t* data, size_t length, Frame& frame) {
+  if (length < FRAME_HEADER_SIZE + FRAME_CRC_SIZE) return FRAME_TOO_SHORT;
+  if (data[0] != PROTOCOL_MAGIC) return FRAME_BAD_MAGIC;
+  if (data[1] != PROTOCOL_VERSION) return FRAME_BAD_VERSION;
+
+  uint8_t payloadLength = data[9];
+  size_t frameLength = FRAME_HEADER_SIZE + payloadLength + FRAME_CRC_SIZE;
+  if (length != frameLength) return FRAME_BAD_LENGTH;
+
+  size_t crcOffset = FRAME_HEADER_SIZE + payloadLength;
+  if (crc16(data, crcOffset) != readU16(data + crcOffset)) return FRAME_BAD_CRC;
+
+  frame.opcode = data[2];
+  frame.seq = readU16(data + 3);
+  frame.param = readI32(data + 5);
+  frame.payloadLength = payloadLength;
+  frame.payload = payloadLength > 0 ? data + FRAME_HEADER_SIZE : nullptr;
+  return FRAME_OK;
+}
+
+size_t encodeFrame(const Frame& frame, uint8_t* out, size_t capacity) {
+  size_t frameLength = FRAME_HEADER_SIZE + frame.payloadLength + FRAME_CRC_SIZE;
+  if (frameLength > capacity) return 0;
+
+  out[0] = PROTOCOL_MAGIC;
+  out[1] = PROTOCOL_VERSION;
+  out[2] = frame.opcode;
+  writeU16(out + 3, frame.seq);
+  writeI32(out + 5, frame.param);
+  out[9] = frame.payloadLength;
+  if (frame.payloadLength > 0) {
+    memcpy(out + FRAME_HEADER_SIZE, frame.payload, frame.payloadLength);
+  }
+
+  size_t crcOffset = FRAME_HEADER_SIZE + frame.payloadLength;
+  writeU16(out + crcOffset, crc16(out, crcOffset));
+  return frameLength;
+}
+
+bool frameToCommand(const Frame& frame, Command& command) {
+  switch (frame.opcode) {
+    case OP_FORWARD:
+    case OP_BACKWARD:
+    case OP_LEFT:
+    case OP_RIGHT:
+    case OP_STOP:
+    case OP_AUTO:
+    case OP_CALIBRATE:
+    case OP_CLOSED_LOOP:
+    case OP_HEADING_HOLD:
+    case OP_LOCALIZE:
+    case OP_WALL:
+    case OP_ROUTE_GO:
+    case OP_PROGRAM:
+      command.type = (char)frame.opcode;
+      command.value = frame.param;
+      command.seq = frame.seq;
+      command.receivedAt = 0;
+      command.profile = 0;
+      command.source = 0;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+int frameWaypointCount(const Frame& frame) {
+  return frame.payloadLength / 4;
+}
+
+void frameWaypoint(const Frame& frame, int index, int& x, int& y) {
+  const uint8_t* p = frame.payload + index * 4;
+  x = (int16_t)readU16(p);
+  y = (int16_t)readU16(p + 2);
+}
+
+const char* frameStatusName(FrameStatus status) {
+  switch (status) {
+    case FRAME_OK:          return "ok";
+    case FRAME_TOO_SHORT:   return "too short";
+    case FRAME_BAD_MAGIC:   return "bad magic";
+    case FRAME_BAD_VERSION: return "unsupported version";
+    case FRAME_BAD_LENGTH:  return "length mismatch";
+    case FRAME_BAD_CRC:     return "CRC mismatch";
+  }
+  return "unknown";
+}
+
+size_t encodeAck(AckEvent event, const Command& cmd, uint32_t time, uint8_t credits, uint8_t* out) {
+  out[0] = ACK_MAGIC;
+  out[1] = PROTOCOL_VERSION;
+  out[2] = event;
+  out[3] = cmd.type;
+  writeU16(out + 4, cmd.seq);
+  writeU32(out + 6, cmd.receivedAt);
+  writeU32(out + 10, time);
+  out[14] = credits;
+  return ACK_SIZE;
+}
@@ -0,0 +1,122 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+// Binary command frames. Everything is little-endian:
+//
+//   [0]    magic   PROTOCOL_MAGIC (never a printable character, so a write
+//                  can be told apart from a text command by its first byte)
+//   [1]    version PROTOCOL_VERSION
+//   [2]    opcode  FrameOpcode
+//   [3..4] seq     u16, echoed back so the app can match responses
+//   [5..8] param   i32, same meaning as Command::value
+//   [9]    length  payload bytes that follow (0 for plain commands)
+//   [..]   payload
+//   [..]   crc     u16 CRC-16/CCITT-FALSE over everything before it
+//
+// This file has no Arduino dependencies so it can be built on a host.
+#define PROTOCOL_MAGIC          0xEB
+#define PROTOCOL_VERSION        1
+#define FRAME_HEADER_SIZE       10
+#define FRAME_CRC_SIZE          2
+#define FRAME_MAX_PAYLOAD       255
+#define FRAME_MAX_SIZE          (FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD + FRAME_CRC_SIZE)
+
+// Opcodes for queued commands use the Command type letter, so a frame maps
+// onto a Command without a lookup table. Opcodes from 0x80 carry a payload.
+enum FrameOpcode {
+  OP_FORWARD      = 'F',
+  OP_BACKWARD     = 'B',
+  OP_LEFT         = 'L',
+  OP_RIGHT        = 'R',
+  OP_STOP         = 'S',
+  OP_AUTO         = 'A',
+  OP_CALIBRATE    = 'C',
+  OP_CLOSED_LOOP  = 'K',
+  OP_HEADING_HOLD = 'H',
+  OP_LOCALIZE     = 'M',
+  OP_WALL         = 'W',
+  OP_ROUTE_GO     = 'P',
+  OP_PROGRAM      = 'G',   // param 1 = run the uploaded program, 0 = abort
+  OP_ROUTE        = 0x80,  // payload: (i16 x, i16 y) waypoints; param 1 = append
+  OP_PROG_BEGIN   = 0x81,  // param = program length in bytes
+  OP_PROG_DATA    = 0x82,  // param = byte offset, payload = bytecode (bytecode_vm.h)
+  OP_PROG_END     = 0x83,  // param = CRC-16 of the whole program
+  OP_TELEMETRY    = 0x84,  // param = TelemetryFormat
+  OP_SUBSCRIBE    = 0x85,  // payload: u16 period ms per telemetry channel
+  OP_CONN_PROFILE = 0x86   // param = ConnMode
+};
+
+// Command lifecycle events, notified on the status characteristic as
+//
+//   [0]     magic     ACK_MAGIC
+//   [1]     version   PROTOCOL_VERSION
+//   [2]     event     AckEvent
+//   [3]     type      command letter (0 if the frame could not be decoded)
+//   [4..5]  seq       u16 from the command frame (0 for text commands)
+//   [6..9]  received  u32 ms since boot when the robot received the command
+//   [10..13] time     u32 ms since boot when the event happened
+//   [14]    credits   free command queue slots when the event was sent
+//
+// Flow control: a client may have at most `credits` commands written but
+// not yet acknowledged as queued or rejected. STOP is exempt; it takes the
+// priority lane and never uses a queue slot.
+#define ACK_MAGIC               0xEA
+#define ACK_SIZE                15
+
+enum AckEvent {
+  ACK_QUEUED,
+  ACK_STARTED,
+  ACK_COMPLETED,
+  ACK_ABORTED,      // interrupted, or dropped from the queue, by a stop
+  ACK_REJECTED      // malformed, unknown or dropped; never executed
+};
+
+enum FrameStatus {
+  FRAME_OK,
+  FRAME_TOO_SHORT,
+  FRAME_BAD_MAGIC,
+  FRAME_BAD_VERSION,
+  FRAME_BAD_LENGTH,
+  FRAME_BAD_CRC
+};
+
+// A decoded frame. payload points into the buffer it was decoded from and
+// is only valid as long as that buffer is.
+struct Frame {
+  uint8_t opcode;
+  uint16_t seq;
+  int32_t param;
+  uint8_t payloadLength;
+  const uint8_t* payload;
+};
+
+uint16_t crc16(const uint8_t* data, size_t length);
+
+// Little-endian field access, shared with payload parsers
+uint16_t readU16(const uint8_t* p);
+int32_t readI32(const uint8_t* p);
+
+// Validate and decode a frame in place; nothing is copied or allocated.
+FrameStatus decodeFrame(const uint8_t* data, size_t length, Frame& frame);
+
+// Encode a frame into out. Returns the frame size, or 0 if it doesn't fit.
+size_t encodeFrame(const Frame& frame, uint8_t* out, size_t capacity);
+
+// Map a command opcode onto a queued Command; false for unknown opcodes
+// and for payload opcodes, which are handled by the receiver directly.
+bool frameToCommand(const Frame& frame, Command& command);
+
+// Waypoints carried by an OP_ROUTE payload
+int frameWaypointCount(const Frame& frame);
+void frameWaypoint(const Frame& frame, int index, int& x, int& y);
+
+const char* frameStatusName(FrameStatus status);
+
+// Encode a lifecycle event for cmd into out (ACK_SIZE bytes)
+size_t encodeAck(AckEvent event, const Command& cmd, uint32_t time, uint8_t credits, uint8_t* out);
+
+#endif // PROTOCOL_H
@@ -1,4 +1,5 @@
 #include "sensor_manager.h"
+#include "trace.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
@@ -18,21 +19,27 @@ SensorManager::SensorManager()
     ultrasonicMutex(nullptr),
     imuMutex(nullptr),
     recalibrateRequested(false) {
+  rangeScan = {MAX_DISTANCE, MAX_DISTANCE, MAX_DISTANCE, 0};
+  rangeLock = portMUX_INITIALIZER_UNLOCKED;
 }
 
 void SensorManager::begin() {
   // Initialize ultrasonic sensor pins
   pinMode(TRIG_PIN, OUTPUT);
   pinMode(ECHO_PIN, INPUT);
+  pinMode(SIDE_TRIG_LEFT_PIN, OUTPUT);
+  pinMode(SIDE_ECHO_LEFT_PIN, INPUT);
+  pinMode(SIDE_TRIG_RIGHT_PIN, OUTPUT);
+  pinMode(SIDE_ECHO_RIGHT_PIN, INPUT);
 
   // Guard for cross-core ultrasonic access (created before the first read)
-  ultrasonicMutex = xSemaphoreCreateMutex();
+  ultrasonicMutex = ultrasonicMutexStorage.create();
   if (ultrasonicMutex == nullptr) {
     Serial.println("Warning: failed to create ultrasonic mutex");
   }
 
   // Guard for cross-core IMU access (sensor task vs closed-loop turn)
-  imuMutex = xSemaphoreCreateMutex();
+  imuMutex = imuMutexStorage.create();
   if (imuMutex == nullptr) {
     Serial.println("Warning: failed to create IMU mutex");
   }
@@ -158,45 +165,93 @@ void SensorManager::serviceRecalibration() {
   }
 }
 
-float SensorManager::readDistanceCM() {
+float SensorManager::ping(int trigPin, int echoPin, unsigned long timeoutUs) {
+  // Send trigger pulse
+  digitalWrite(trigPin, LOW);
+  delayMicroseconds(2);
+  digitalWrite(trigPin, HIGH);
+  delayMicroseconds(10);
+  digitalWrite(trigPin, LOW);
+
+  // Read echo pulse with timeout
+  long duration = pulseIn(echoPin, HIGH, timeoutUs);
+  if (duration == 0) {
+    return MAX_DISTANCE;
+  }
+
+  // Temperature-compensated speed of sound: 331.3 + 0.606*T m/s, expressed
+  // as cm/us (/10000). sensorData.temperature is the cached MPU die temp
+  // (an approximation of ambient) refreshed by the sensor task, so we avoid
+  // a cross-core I2C read here.
+  float speedCmPerUs = (331.3 + 0.606 * sensorData.temperature) / 10000.0;
+  float distance = duration * speedCmPerUs / 2.0;
+
+  // Validate reading
+  if (distance < 2.0 || distance > 400.0) {
+    return MAX_DISTANCE;
+  }
+  return distance;
+}
+
+float SensorManager::readDistanceCM(unsigned long timeoutUs) {
   // Serialize access: concurrent trigger/echo cycles from two cores would
   // corrupt each other's reading. Held only here (leaf), so no nesting.
   if (ultrasonicMutex != nullptr) {
-    xSemaphoreTake(ultrasonicMutex, portMAX_DELAY);
+    traceTake(ultrasonicMutex, TRACE_MUTEX_ULTRASONIC);
   }
 
-  // Send trigger pulse
-  digitalWrite(TRIG_PIN, LOW);
-  delayMicroseconds(2);
-  digitalWrite(TRIG_PIN, HIGH);
-  delayMicroseconds(10);
-  digitalWrite(TRIG_PIN, LOW);
+  float result = ping(TRIG_PIN, ECHO_PIN, timeoutUs);
+  TRACE(TRACE_SENSOR, TRACE_SENSOR_DISTANCE, result * 10.0);
 
-  // Read echo pulse with timeout
-  long duration = pulseIn(ECHO_PIN, HIGH, ULTRASONIC_TIMEOUT);
-
-  float result = MAX_DISTANCE;
-  if (duration != 0) {
-    // Temperature-compensated speed of sound: 331.3 + 0.606*T m/s, expressed
-    // as cm/us (/10000). sensorData.temperature is the cached MPU die temp
-    // (an approximation of ambient) refreshed by the sensor task, so we avoid
-    // a cross-core I2C read here.
-    float speedCmPerUs = (331.3 + 0.606 * sensorData.temperature) / 10000.0;
-    float distance = duration * speedCmPerUs / 2.0;
-
-    // Validate reading; only a valid sample updates the cached distance
-    if (distance >= 2.0 && distance <= 400.0) {
-      currentDistance = distance;
-      result = distance;
-    }
+  // Only a valid sample updates the cached distance
+  if (result < MAX_DISTANCE) {
+    currentDistance = result;
+  }
+
+  if (ultrasonicMutex != nullptr) {
+    xSemaphoreGive(ultrasonicMutex);
+  }
+  return result;
+}
+
+float SensorManager::readSideDistanceCM(bool right) {
+  // Same mutex as the front sensor: one ping in flight at a time also keeps
+  // the sensors from hearing each other's echoes.
+  if (ultrasonicMutex != nullptr) {
+    traceTake(ultrasonicMutex, TRACE_MUTEX_ULTRASONIC);
   }
 
+  float result = right
+    ? ping(SIDE_TRIG_RIGHT_PIN, SIDE_ECHO_RIGHT_PIN, SIDE_ULTRASONIC_TIMEOUT)
+    : ping(SIDE_TRIG_LEFT_PIN, SIDE_ECHO_LEFT_PIN, SIDE_ULTRASONIC_TIMEOUT);
+  TRACE(TRACE_SENSOR, right ? TRACE_SENSOR_SIDE_RIGHT : TRACE_SENSOR_SIDE_LEFT, result * 10.0);
+
   if (ultrasonicMutex != nullptr) {
     xSemaphoreGive(ultrasonicMutex);
   }
   return result;
 }
 
+void SensorManager::scanRanges(uint8_t sides) {
+  RangeScan scan;
+  scan.front = readDistanceCM(SIDE_ULTRASONIC_TIMEOUT);
+  scan.left = (sides & SIDE_SENSOR_LEFT) ? readSideDistanceCM(false) : MAX_DISTANCE;
+  scan.right = (sides & SIDE_SENSOR_RIGHT) ? readSideDistanceCM(true) : MAX_DISTANCE;
+  scan.timestamp = millis();
+  sensorData.distance = scan.front;
+
+  portENTER_CRITICAL(&rangeLock);
+  rangeScan = scan;
+  portEXIT_CRITICAL(&rangeLock);
+}
+
+RangeScan SensorManager::getRangeScan() {
+  portENTER_CRITICAL(&rangeLock);
+  RangeScan scan = rangeScan;
+  portEXIT_CRITICAL(&rangeLock);
+  return scan;
+}
+
 float SensorManager::getCurrentDistance() const {
   return currentDistance;
 }
@@ -228,17 +283,18 @@ void SensorManager::integrateYaw() {
   // Normalize yaw to 0-360 degrees
   if (yaw > 360.0) yaw -= 360.0;
   if (yaw < 0.0) yaw += 360.0;
+  TRACE(TRACE_SENSOR, TRACE_SENSOR_YAW, yaw * 100.0);
 }
 
 void SensorManager::updateYaw() {
-  if (imuMutex != nullptr) xSemaphoreTake(imuMutex, portMAX_DELAY);
+  if (imuMutex != nullptr) traceTake(imuMutex, TRACE_MUTEX_IMU);
   integrateYaw();
   if (imuMutex != nullptr) xSemaphoreGive(imuMutex);
 }
 
 float SensorManager::sampleYaw() {
   // Thread-safe fresh yaw read for closed-loop turns on the motor task.
-  if (imuMutex != nullptr) xSemaphoreTake(imuMutex, portMAX_DELAY);
+  if (imuMutex != nullptr) traceTake(imuMutex, TRACE_MUTEX_IMU);
   integrateYaw();
   float result = yaw;
   if (imuMutex != nullptr) xSemaphoreGive(imuMutex);
@@ -253,6 +309,20 @@ float SensorManager::getYaw() const {
   return yaw;
 }
 
+void SensorManager::readRawIMU(int16_t raw[6]) {
+  // Guarded: shares the IMU/I2C bus with sampleYaw() on the motor task
+  if (imuMutex != nullptr) traceTake(imuMutex, TRACE_MUTEX_IMU);
+  imu.getMotion6(&raw[0], &raw[1], &raw[2], &raw[3], &raw[4], &raw[5]);
+  if (imuMutex != nullptr) xSemaphoreGive(imuMutex);
+
+  raw[0] -= axOffset;
+  raw[1] -= ayOffset;
+  raw[2] -= azOffset;
+  raw[3] -= gxOffset;
+  raw[4] -= gyOffset;
+  raw[5] -= gzOffset;
+}
+
 void SensorManager::resetYaw() {
   yaw = 0.0;
   Serial.println("Yaw reset to 0");
@@ -260,7 +330,7 @@ void SensorManager::resetYaw() {
 
 float SensorManager::getTemperature() {
   // Guarded: shares the IMU/I2C bus with sampleYaw() on the motor task
-  if (imuMutex != nullptr) xSemaphoreTake(imuMutex, portMAX_DELAY);
+  if (imuMutex != nullptr) traceTake(imuMutex, TRACE_MUTEX_IMU);
   int16_t rawTemp = imu.getTemperature();
   if (imuMutex != nullptr) xSemaphoreGive(imuMutex);
   return rawTemp / 340.0 + 36.53; // MPU6050 temperature formula
@@ -284,10 +354,12 @@ float SensorManager::readBatteryPercent() {
   return percent;
 }
 
-void SensorManager::updateSensorData() {
+void SensorManager::updateSensorData(bool measureDistance) {
   // Refresh temperature first so readDistanceCM() uses a current value
   sensorData.temperature = getTemperature();
-  sensorData.distance = readDistanceCM();
+  if (measureDistance) {
+    sensorData.distance = readDistanceCM();
+  }
   updateIMU();
   sensorData.heading = yaw;
   sensorData.batteryLevel = readBatteryPercent();
@@ -298,7 +370,7 @@ SensorData SensorManager::getSensorData() const {
   return sensorData;
 }
 
-String SensorManager::getSensorDataJSON() {
+size_t SensorManager::getSensorDataJSON(char* output, size_t size) {
   StaticJsonDocument<200> doc;
   
   doc["distance"] = sensorData.distance;
@@ -307,9 +379,7 @@ String SensorManager::getSensorDataJSON() {
   doc["heading"] = sensorData.heading;
   doc["timestamp"] = sensorData.timestamp;
   
-  String output;
-  serializeJson(doc, output);
-  return output;
+  return serializeJson(doc, output, size);
 }
 
 float SensorManager::getFilteredDistance(int samples) {
@@ -366,8 +436,8 @@ void SensorManager::printSensorStatus() {
   Serial.println("====================");
 }
 
-bool SensorManager::testAllSensors() {
-  bool allPassed = true;
+uint8_t SensorManager::testAllSensors() {
+  uint8_t failed = 0;
   
   Serial.println("Testing all sensors...");
   
@@ -375,18 +445,21 @@ bool SensorManager::testAllSensors() {
   float distance = readDistanceCM();
   if (distance >= MAX_DISTANCE) {
     Serial.println("Ultrasonic sensor test FAILED");
-    allPassed = false;
+    failed |= SELF_TEST_ULTRASONIC;
   } else {
     Serial.printf("Ultrasonic sensor test PASSED (%.2f cm)\n", distance);
   }
   
-  // Test IMU
-  if (!imu.testConnection()) {
+  // Test IMU (the motor task may be sampling it for a turn by now)
+  if (imuMutex != nullptr) traceTake(imuMutex, TRACE_MUTEX_IMU);
+  bool imuConnected = imu.testConnection();
+  if (imuMutex != nullptr) xSemaphoreGive(imuMutex);
+  if (!imuConnected) {
     Serial.println("IMU test FAILED");
-    allPassed = false;
+    failed |= SELF_TEST_IMU;
   } else {
     Serial.println("IMU test PASSED");
   }
   
-  return allPassed;
+  return failed;
 }
\ No newline at end of file
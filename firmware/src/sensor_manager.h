@@ -4,11 +4,28 @@
 #include <Arduino.h>
 #include "types.h"
 #include "config.h"
+#include "static_alloc.h"
 #include <MPU6050.h>
 #include <Wire.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 
+// testAllSensors() results
+#define SELF_TEST_ULTRASONIC  (1 << 0)
+#define SELF_TEST_IMU         (1 << 1)
+
+// Side sensors for scanRanges()
+#define SIDE_SENSOR_LEFT      (1 << 0)
+#define SIDE_SENSOR_RIGHT     (1 << 1)
+
+// One ranging pass of the sensor task while wall following
+struct RangeScan {
+  float front;                  // cm; MAX_DISTANCE = no echo
+  float left;                   // cm; MAX_DISTANCE = no echo or not scanned
+  float right;
+  unsigned long timestamp;      // ms; 0 = no scan yet
+};
+
 class SensorManager {
 private:
   MPU6050 imu;
@@ -24,14 +41,24 @@ private:
   // Serializes HC-SR04 access: readDistanceCM() runs on both the sensor task
   // (core 0) and the motor/navigation task (core 1) during autonomy.
   SemaphoreHandle_t ultrasonicMutex;
+  MutexStorage ultrasonicMutexStorage;
 
   // Serializes IMU/I2C access so the motor task can sample fresh yaw during a
   // closed-loop turn while the sensor task is also reading the IMU.
   SemaphoreHandle_t imuMutex;
+  MutexStorage imuMutexStorage;
+
+  // One trigger/echo cycle on the given HC-SR04 (caller holds
+  // ultrasonicMutex). Returns MAX_DISTANCE when there is no valid echo.
+  float ping(int trigPin, int echoPin, unsigned long timeoutUs);
 
   // Gyro yaw integration without locking (callers hold imuMutex).
   void integrateYaw();
 
+  // Latest scanRanges() result, read by the motor task
+  RangeScan rangeScan;
+  portMUX_TYPE rangeLock;
+
   // Set from the motor task; the sensor task services it so all IMU/I2C
   // access stays on a single core.
   volatile bool recalibrateRequested;
@@ -54,15 +81,23 @@ public:
   void serviceRecalibration();
   
   // Distance sensor functions
-  float readDistanceCM();
+  float readDistanceCM(unsigned long timeoutUs = ULTRASONIC_TIMEOUT);
+  float readSideDistanceCM(bool right);   // side sensors (wall following)
   float getCurrentDistance() const;
   bool isObstacleDetected() const;
+
+  // Wall following: the sensor task pings the front (short timeout) and
+  // the given SIDE_SENSOR_* sensors and publishes them together, so the
+  // motor task steers from the latest scan without waiting on an echo.
+  void scanRanges(uint8_t sides);
+  RangeScan getRangeScan();
   
   // IMU functions
   void updateIMU();
   void updateYaw();
   float sampleYaw();   // integrate + return fresh yaw (thread-safe; for closed-loop turns)
   float getYaw() const;
+  void readRawIMU(int16_t raw[6]);   // ax, ay, az, gx, gy, gz minus the resting offsets
   float getTemperature();
   void resetYaw();
 
@@ -70,14 +105,15 @@ public:
   float readBatteryVoltage();
   float readBatteryPercent();
   
-  // Data management
-  void updateSensorData();
+  // Data management. A ping can block for ULTRASONIC_TIMEOUT, so callers
+  // that don't need a fresh range skip it and keep the last distance.
+  void updateSensorData(bool measureDistance = true);
   SensorData getSensorData() const;
-  String getSensorDataJSON();
+  size_t getSensorDataJSON(char* output, size_t size);   // returns length
   
   // Calibration and testing
   void printSensorStatus();
-  bool testAllSensors();
+  uint8_t testAllSensors();    // SELF_TEST_* bits of what failed, 0 = all passed
   
   // Advanced functions
   float getFilteredDistance(int samples = 3);
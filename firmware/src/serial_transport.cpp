@@ -0,0 +1,137 @@
+#include "serial_transport.h"
+#include "link_manager.h"
+#include "task_events.h"
+#include "trace.h"
+
+// Global instance
+SerialTransport serialTransport(Serial);
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+SerialTransport::SerialTransport(Stream& stream)
+  : port(stream),
+    active(false),
+    overflow(false),
+    lineLength(0),
+    writeMutex(nullptr) {
+}
+
+bool SerialTransport::begin() {
+  // Telemetry (sensor task), acks (motor task) and status lines can be
+  // written at the same time; output lines must not interleave
+  writeMutex = writeMutexStorage.create();
+  if (writeMutex == nullptr) {
+    Serial.println("Failed to create serial transport mutex");
+    return false;
+  }
+  return true;
+}
+
+void SerialTransport::poll() {
+  while (port.available() > 0) {
+    int c = port.read();
+    if (c < 0) break;
+
+    if (c == '\n' || c == '\r') {
+      if (overflow) {
+        Serial.println("Serial command too long, ignored");
+      } else if (lineLength > 0) {
+        line[lineLength] = '\0';
+        handleLine();
+      }
+      lineLength = 0;
+      overflow = false;
+    } else if (lineLength < SERIAL_LINE_MAX) {
+      line[lineLength++] = (char)c;
+    } else {
+      overflow = true;
+    }
+  }
+}
+
+void SerialTransport::handleLine() {
+  if (!active) {
+    // Telemetry starts now; the sensor task may be on a slow period
+    active = true;
+    taskEvents.signal(EVENT_SENSOR_PLAN);
+  }
+
+  if (line[0] != '@') {
+    linkManager.receiveText(this, line);
+    return;
+  }
+
+  // "@<hex>": a binary frame
+  size_t digits = lineLength - 1;
+  if (digits % 2 != 0 || digits / 2 > FRAME_MAX_SIZE) {
+    Serial.println("Malformed serial frame, ignored");
+    return;
+  }
+  for (size_t i = 0; i < digits / 2; i++) {
+    int hi = hexValue(line[1 + 2 * i]);
+    int lo = hexValue(line[2 + 2 * i]);
+    if (hi < 0 || lo < 0) {
+      Serial.println("Malformed serial frame, ignored");
+      return;
+    }
+    frame[i] = (hi << 4) | lo;
+  }
+  linkManager.receiveFrame(this, frame, digits / 2);
+}
+
+void SerialTransport::writeLine(char kind, const uint8_t* data, size_t length, bool hex) {
+  if (!active) return;
+
+  if (writeMutex != nullptr) traceTake(writeMutex, TRACE_MUTEX_SERIAL);
+
+  size_t n = 0;
+  output[n++] = '@';
+  output[n++] = kind;
+  output[n++] = ' ';
+  for (size_t i = 0; i < length && n + 3 <= SERIAL_OUT_MAX; i++) {
+    if (hex) {
+      output[n++] = HEX_DIGITS[data[i] >> 4];
+      output[n++] = HEX_DIGITS[data[i] & 0x0F];
+    } else {
+      output[n++] = (char)data[i];
+    }
+  }
+  output[n++] = '\n';
+  port.write((const uint8_t*)output, n);
+
+  if (writeMutex != nullptr) xSemaphoreGive(writeMutex);
+}
+
+const char* SerialTransport::getName() const {
+  return "Serial";
+}
+
+bool SerialTransport::isConnected() const {
+  return active;
+}
+
+size_t SerialTransport::getMaxPayload() const {
+  return TELEMETRY_MAX_FRAME;
+}
+
+void SerialTransport::writeTelemetry(const uint8_t* data, size_t length) {
+  // JSON goes out as text; packed batches start with their magic byte
+  if (length > 0 && data[0] == TELEMETRY_MAGIC) {
+    writeLine('B', data, length, true);
+  } else if (length > 0 && data[0] == TRACE_MAGIC) {
+    writeLine('R', data, length, true);
+  } else {
+    writeLine('T', data, length, false);
+  }
+}
+
+void SerialTransport::writeAck(const uint8_t* data, size_t length) {
+  writeLine('A', data, length, true);
+}
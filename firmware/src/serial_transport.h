@@ -0,0 +1,60 @@
+#ifndef SERIAL_TRANSPORT_H
+#define SERIAL_TRANSPORT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "static_alloc.h"
+#include "transport.h"
+#include <freertos/semphr.h>
+
+// The command protocol over a serial port, for wired lab use and for host
+// builds driven through a pty. Everything is line based so it can share
+// the console with log output:
+//
+//   in:   <text command>           e.g. "F20", "SUB:imu=20"
+//         @<hex frame>             a binary frame, hex encoded
+//   out:  @T <json>                telemetry or status JSON
+//         @B <hex>                 packed telemetry batch
+//         @A <hex>                 ack record
+//
+// Log lines never start with '@'. The link counts as connected from the
+// first command it receives, so an idle console isn't flooded.
+#define SERIAL_LINE_MAX         (2 * FRAME_MAX_SIZE + 2)
+#define SERIAL_OUT_MAX          (2 * TELEMETRY_MAX_FRAME + 8)
+
+class SerialTransport : public Transport {
+private:
+  Stream& port;
+  bool active;
+  bool overflow;                    // dropping the rest of a long line
+  size_t lineLength;
+  char line[SERIAL_LINE_MAX + 1];
+  uint8_t frame[FRAME_MAX_SIZE];
+  char output[SERIAL_OUT_MAX];
+  SemaphoreHandle_t writeMutex;
+  MutexStorage writeMutexStorage;
+
+  void handleLine();
+  void writeLine(char kind, const uint8_t* data, size_t length, bool hex);
+
+public:
+  SerialTransport(Stream& stream);
+
+  bool begin();
+
+  // Read whatever has arrived; the communication task calls it when the
+  // console signals EVENT_SERIAL
+  void poll();
+
+  // Transport
+  const char* getName() const override;
+  bool isConnected() const override;
+  size_t getMaxPayload() const override;
+  void writeTelemetry(const uint8_t* data, size_t length) override;
+  void writeAck(const uint8_t* data, size_t length) override;
+};
+
+// Global serial transport on the console port
+extern SerialTransport serialTransport;
+
+#endif // SERIAL_TRANSPORT_H
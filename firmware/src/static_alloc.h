@@ -0,0 +1,125 @@
+#ifndef STATIC_ALLOC_H
+#define STATIC_ALLOC_H
+
+#include <new>
+#include <utility>
+#include "config.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+
+// Where the robot's FreeRTOS objects and long-lived C++ objects live.
+//
+// Declare one storage object per object created, at file scope or as a
+// member, and create through it. With STATIC_ALLOCATION the memory is
+// part of the storage object itself, reserved at link time; otherwise it
+// comes from the heap as before and the storage objects are empty. Either
+// way create() returns nullptr (or a failed handle) the same way the
+// FreeRTOS calls do, so callers keep their checks.
+
+// A task and its stack. StackBytes is in bytes, like every stack size in
+// ESP-IDF.
+template <uint32_t StackBytes>
+class TaskStorage {
+#if STATIC_ALLOCATION
+  StackType_t stack[StackBytes / sizeof(StackType_t)];
+  StaticTask_t tcb;
+#endif
+
+public:
+  TaskHandle_t create(TaskFunction_t function, const char* name, void* parameter,
+                      UBaseType_t priority, BaseType_t core) {
+#if STATIC_ALLOCATION
+    return xTaskCreateStaticPinnedToCore(function, name, StackBytes, parameter, priority,
+                                         stack, &tcb, core);
+#else
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreatePinnedToCore(function, name, StackBytes, parameter, priority,
+                                &handle, core) != pdPASS) {
+      return nullptr;
+    }
+    return handle;
+#endif
+  }
+};
+
+// A queue of Length items of type Item
+template <typename Item, UBaseType_t Length>
+class QueueStorage {
+#if STATIC_ALLOCATION
+  uint8_t items[Length * sizeof(Item)];
+  StaticQueue_t queue;
+#endif
+
+public:
+  QueueHandle_t create() {
+#if STATIC_ALLOCATION
+    return xQueueCreateStatic(Length, sizeof(Item), items, &queue);
+#else
+    return xQueueCreate(Length, sizeof(Item));
+#endif
+  }
+};
+
+class MutexStorage {
+#if STATIC_ALLOCATION
+  StaticSemaphore_t mutex;
+#endif
+
+public:
+  SemaphoreHandle_t create() {
+#if STATIC_ALLOCATION
+    return xSemaphoreCreateMutexStatic(&mutex);
+#else
+    return xSemaphoreCreateMutex();
+#endif
+  }
+};
+
+class EventGroupStorage {
+#if STATIC_ALLOCATION
+  StaticEventGroup_t group;
+#endif
+
+public:
+  EventGroupHandle_t create() {
+#if STATIC_ALLOCATION
+    return xEventGroupCreateStatic(&group);
+#else
+    return xEventGroupCreate();
+#endif
+  }
+};
+
+// One object of class T that is handed to a library by pointer and lives
+// for the rest of the run, e.g. BLE callbacks. Constructed in place in
+// static storage, or with new.
+template <typename T>
+class ObjectStorage {
+#if STATIC_ALLOCATION
+  alignas(T) uint8_t buffer[sizeof(T)];
+#endif
+
+public:
+  template <typename... Args>
+  T* create(Args&&... args) {
+#if STATIC_ALLOCATION
+    return new (buffer) T(std::forward<Args>(args)...);
+#else
+    return new T(std::forward<Args>(args)...);
+#endif
+  }
+
+  void destroy(T* object) {
+    if (object == nullptr) return;
+#if STATIC_ALLOCATION
+    object->~T();
+#else
+    delete object;
+#endif
+  }
+};
+
+#endif // STATIC_ALLOC_H
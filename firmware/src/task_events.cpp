@@ -0,0 +1,35 @@
+#include "task_events.h"
+#include <Arduino.h>
+#include <freertos/task.h>
+
+// Global instance
+TaskEvents taskEvents;
+
+TaskEvents::TaskEvents()
+  : group(nullptr) {
+}
+
+bool TaskEvents::begin() {
+  group = groupStorage.create();
+  if (group == nullptr) {
+    Serial.println("Failed to create task event group");
+    return false;
+  }
+  return true;
+}
+
+void TaskEvents::signal(EventBits_t bits) {
+  // Modules signal from their constructors and setup too; nobody waits yet
+  if (group == nullptr) return;
+  xEventGroupSetBits(group, bits);
+}
+
+EventBits_t TaskEvents::wait(EventBits_t bits, TickType_t timeout) {
+  if (group == nullptr) {
+    // Without the group, fall back to polling at the timeout (capped so
+    // an indefinite wait still comes round)
+    vTaskDelay(timeout < pdMS_TO_TICKS(100) ? timeout : pdMS_TO_TICKS(100));
+    return 0;
+  }
+  return xEventGroupWaitBits(group, bits, pdTRUE, pdFALSE, timeout) & bits;
+}
@@ -0,0 +1,43 @@
+#ifndef TASK_EVENTS_H
+#define TASK_EVENTS_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include "static_alloc.h"
+
+// What the robot's tasks wait for. Each bit has one consumer, which
+// clears it when it wakes.
+enum TaskEvent : EventBits_t {
+  EVENT_COMMAND     = 1 << 0,   // a command was queued (motor task)
+  EVENT_SENSOR_PLAN = 1 << 1,   // telemetry rates, links or localization changed (sensor task)
+  EVENT_SERIAL      = 1 << 2,   // bytes arrived on the console (communication task)
+  EVENT_CONNECTION  = 1 << 3,   // a BLE client came or went (loop)
+  EVENT_TRACE_DUMP  = 1 << 4,   // a trace dump was requested (communication task)
+  EVENT_PARAMS      = 1 << 5    // a parameter changed (motor task)
+};
+
+// Lets tasks sleep until there is work instead of polling. Producers set
+// bits from any task; a bit set while nobody is waiting stays set, so the
+// next wait returns at once and nothing is missed between checking for
+// work and going to sleep.
+class TaskEvents {
+private:
+  EventGroupHandle_t group;
+  EventGroupStorage groupStorage;
+
+public:
+  TaskEvents();
+
+  bool begin();
+
+  void signal(EventBits_t bits);
+
+  // Block until any of bits is set or the timeout passes; returns the
+  // bits that were set (and clears them), 0 on timeout
+  EventBits_t wait(EventBits_t bits, TickType_t timeout);
+};
+
+// Global task events instance
+extern TaskEvents taskEvents;
+
+#endif // TASK_EVENTS_H
@@ -0,0 +1,246 @@
+#include "telemetry_codec.h"
+#include "protocol.h"
+#include <math.h>
+
+static const uint8_t FULL_SIZE[TLM_CHANNEL_COUNT] = {2, 2, 12, 2, 4, 2};
+static const int32_t HEADING_FULL_TURN = 36000;
+
+static int32_t quantize(float value, float scale, int32_t lo, int32_t hi) {
+  int32_t q = (int32_t)lroundf(value * scale);
+  return q < lo ? lo : (q > hi ? hi : q);
+}
+
+static int32_t quantizeHeading(float heading) {
+  int32_t q = (int32_t)lroundf(heading * 100) % HEADING_FULL_TURN;
+  return q < 0 ? q + HEADING_FULL_TURN : q;
+}
+
+static int32_t headingDelta(int32_t value, int32_t previous) {
+  // Heading wraps: take the short way round
+  int32_t d = value - previous;
+  if (d >= HEADING_FULL_TURN / 2) d -= HEADING_FULL_TURN;
+  if (d < -HEADING_FULL_TURN / 2) d += HEADING_FULL_TURN;
+  return d;
+}
+
+static bool fitsInt8(int32_t d) {
+  return d >= -128 && d <= 127;
+}
+
+static uint8_t* put16(uint8_t* p, int32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  return p + 2;
+}
+
+TelemetryEncoder::TelemetryEncoder()
+  : length(0),
+    count(0),
+    delta(false),
+    seen(0),
+    lastTimestamp(0),
+    lastDistance(0),
+    lastHeading(0),
+    lastX(0),
+    lastY(0) {
+  begin(false);
+}
+
+void TelemetryEncoder::begin(bool deltaCoding) {
+  delta = deltaCoding;
+  count = 0;
+  seen = 0;
+  length = TLM_HEADER_SIZE;
+  buffer[0] = TELEMETRY_MAGIC;
+  buffer[1] = TELEMETRY_VERSION;
+  buffer[2] = delta ? TLM_FLAG_DELTA : 0;
+  buffer[3] = 0;
+}
+
+bool TelemetryEncoder::add(const TelemetrySample& sample, size_t capacity) {
+  if (capacity > TELEMETRY_MAX_FRAME) capacity = TELEMETRY_MAX_FRAME;
+  if (count == 255) return false;
+
+  uint32_t dt = sample.timestamp - lastTimestamp;
+  if (count > 0 && dt > 0xFFFF) return false;
+  bool arena = sample.poseFrame == FRAME_ARENA;
+  if (count > 0 && arena != ((buffer[2] & TLM_FLAG_ARENA) != 0)) return false;
+
+  uint8_t present = sample.channels & ((1 << TLM_CHANNEL_COUNT) - 1);
+  int32_t distance = quantize(sample.distance, 10, 0, 65535);
+  int32_t heading = quantizeHeading(sample.heading);
+  int32_t x = quantize(sample.x, 1, -32768, 32767);
+  int32_t y = quantize(sample.y, 1, -32768, 32767);
+
+  // Pick the encoding per channel before writing anything
+  uint8_t deltaMask = 0;
+  if (delta) {
+    uint8_t known = present & seen;
+    if ((known & (1 << TLM_CH_DISTANCE)) && fitsInt8(distance - lastDistance)) {
+      deltaMask |= 1 << TLM_CH_DISTANCE;
+    }
+    if ((known & (1 << TLM_CH_HEADING)) && fitsInt8(headingDelta(heading, lastHeading))) {
+      deltaMask |= 1 << TLM_CH_HEADING;
+    }
+    if ((known & (1 << TLM_CH_POSE)) && fitsInt8(x - lastX) && fitsInt8(y - lastY)) {
+      deltaMask |= 1 << TLM_CH_POSE;
+    }
+  }
+
+  size_t need = (count > 0 ? 2 : 0) + 2;
+  for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+    if (!(present & (1 << ch))) continue;
+    need += (deltaMask & (1 << ch)) ? FULL_SIZE[ch] / 2 : FULL_SIZE[ch];
+  }
+  if (length + need > capacity) return false;
+
+  uint8_t* p = buffer + length;
+  if (count == 0) {
+    if (arena) buffer[2] |= TLM_FLAG_ARENA;
+    else buffer[2] &= ~TLM_FLAG_ARENA;
+    uint32_t t = sample.timestamp;
+    for (int i = 0; i < 4; i++) buffer[4 + i] = (t >> (8 * i)) & 0xFF;
+  } else {
+    p = put16(p, dt);
+  }
+  *p++ = present;
+  *p++ = deltaMask;
+
+  if (present & (1 << TLM_CH_DISTANCE)) {
+    if (deltaMask & (1 << TLM_CH_DISTANCE)) *p++ = (uint8_t)(distance - lastDistance);
+    else p = put16(p, distance);
+    lastDistance = distance;
+  }
+  if (present & (1 << TLM_CH_HEADING)) {
+    if (deltaMask & (1 << TLM_CH_HEADING)) *p++ = (uint8_t)headingDelta(heading, lastHeading);
+    else p = put16(p, heading);
+    lastHeading = heading;
+  }
+  if (present & (1 << TLM_CH_IMU)) {
+    for (int i = 0; i < 6; i++) p = put16(p, sample.imu[i]);
+  }
+  if (present & (1 << TLM_CH_BATTERY)) {
+    *p++ = (uint8_t)quantize(sample.battery, 2, 0, 255);
+    *p++ = (uint8_t)quantize(sample.temperature, 1, -128, 127);
+  }
+  if (present & (1 << TLM_CH_POSE)) {
+    if (deltaMask & (1 << TLM_CH_POSE)) {
+      *p++ = (uint8_t)(x - lastX);
+      *p++ = (uint8_t)(y - lastY);
+    } else {
+      p = put16(p, x);
+      p = put16(p, y);
+    }
+    lastX = x;
+    lastY = y;
+  }
+  if (present & (1 << TLM_CH_MOTOR)) {
+    *p++ = sample.robotState;
+    *p++ = sample.navMode;
+  }
+
+  length = p - buffer;
+  seen |= present;
+  buffer[3] = ++count;
+  lastTimestamp = sample.timestamp;
+  return true;
+}
+
+const uint8_t* TelemetryEncoder::data() const {
+  return buffer;
+}
+
+size_t TelemetryEncoder::size() const {
+  return count > 0 ? length : 0;
+}
+
+int TelemetryEncoder::sampleCount() const {
+  return count;
+}
+
+int decodeTelemetryBatch(const uint8_t* data, size_t length, TelemetrySample* out, int maxSamples) {
+  if (length < TLM_HEADER_SIZE || data[0] != TELEMETRY_MAGIC || data[1] != TELEMETRY_VERSION) {
+    return -1;
+  }
+
+  int count = data[3];
+  if (count > maxSamples) return -1;
+
+  uint32_t timestamp = (uint32_t)readI32(data + 4);
+  uint8_t frame = (data[2] & TLM_FLAG_ARENA) ? FRAME_ARENA : FRAME_ODOMETRY;
+  int32_t distance = 0, heading = 0, x = 0, y = 0;
+  uint8_t seen = 0;
+  size_t pos = TLM_HEADER_SIZE;
+
+  for (int n = 0; n < count; n++) {
+    if (n > 0) {
+      if (pos + 2 > length) return -1;
+      timestamp += readU16(data + pos);
+      pos += 2;
+    }
+    if (pos + 2 > length) return -1;
+    uint8_t present = data[pos++];
+    uint8_t deltaMask = data[pos++];
+    if ((deltaMask & ~(present & seen)) != 0) return -1;
+
+    size_t need = 0;
+    for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+      if (!(present & (1 << ch))) continue;
+      need += (deltaMask & (1 << ch)) ? FULL_SIZE[ch] / 2 : FULL_SIZE[ch];
+    }
+    if (pos + need > length) return -1;
+
+    TelemetrySample& s = out[n];
+    s = TelemetrySample();
+    s.timestamp = timestamp;
+    s.channels = present;
+    s.poseFrame = frame;
+    const uint8_t* p = data + pos;
+
+    if (present & (1 << TLM_CH_DISTANCE)) {
+      if (deltaMask & (1 << TLM_CH_DISTANCE)) distance += (int8_t)*p++;
+      else { distance = readU16(p); p += 2; }
+      s.distance = distance / 10.0f;
+    }
+    if (present & (1 << TLM_CH_HEADING)) {
+      if (deltaMask & (1 << TLM_CH_HEADING)) {
+        heading = (heading + (int8_t)*p++ + HEADING_FULL_TURN) % HEADING_FULL_TURN;
+      } else {
+        heading = readU16(p);
+        p += 2;
+      }
+      s.heading = heading / 100.0f;
+    }
+    if (present & (1 << TLM_CH_IMU)) {
+      for (int i = 0; i < 6; i++, p += 2) s.imu[i] = (int16_t)readU16(p);
+    }
+    if (present & (1 << TLM_CH_BATTERY)) {
+      s.battery = p[0] / 2.0f;
+      s.temperature = (int8_t)p[1];
+      p += 2;
+    }
+    if (present & (1 << TLM_CH_POSE)) {
+      if (deltaMask & (1 << TLM_CH_POSE)) {
+        x += (int8_t)p[0];
+        y += (int8_t)p[1];
+        p += 2;
+      } else {
+        x = (int16_t)readU16(p);
+        y = (int16_t)readU16(p + 2);
+        p += 4;
+      }
+      s.x = x;
+      s.y = y;
+    }
+    if (present & (1 << TLM_CH_MOTOR)) {
+      s.robotState = p[0];
+      s.navMode = p[1];
+      p += 2;
+    }
+
+    pos = p - data;
+    seen |= present;
+  }
+
+  return pos == length ? count : -1;
+}
@@ -0,0 +1,101 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "types.h"
+
+// Telemetry channels. A client subscribes to each one at its own rate, so a
+// sample only carries the channels that were due when it was taken.
+enum TelemetryChannel {
+  TLM_CH_DISTANCE,      // front range
+  TLM_CH_HEADING,       // IMU yaw
+  TLM_CH_IMU,           // raw accelerometer and gyro
+  TLM_CH_BATTERY,       // battery level and board temperature
+  TLM_CH_POSE,          // x, y (odometry or localization)
+  TLM_CH_MOTOR,         // robot state and navigation mode
+  TLM_CHANNEL_COUNT
+};
+
+// Packed telemetry batches: several timestamped samples per notification.
+// Everything is little-endian:
+//
+//   [0]    magic      TELEMETRY_MAGIC
+//   [1]    version    TELEMETRY_VERSION
+//   [2]    flags      TLM_FLAG_DELTA if samples may be delta-coded,
+//                     TLM_FLAG_ARENA if poses are in the arena frame
+//                     (otherwise odometry); a batch never mixes frames
+//   [3]    count      samples in the batch
+//   [4..7] timestamp  u32 ms of the first sample
+//   then per sample:
+//     u16 ms since the previous sample (absent for the first one)
+//     u8  present    bit i set = channel i follows
+//     u8  delta      bit i set = channel i is coded as i8 deltas from its
+//                    previous value in this batch, otherwise full values
+//     channels present, in channel order:
+//       distance   u16  0.1 cm                         (delta: i8)
+//       heading    u16  0.01 degree                    (delta: i8)
+//       imu        6 x i16 raw ax, ay, az, gx, gy, gz
+//       battery    u8 0.5 %, i8 degree C
+//       pose       i16 x, i16 y, cm                    (delta: i8, i8)
+//       motor      u8 RobotState, u8 NavMode
+//
+// A channel's first value in a batch is always full, so every notification
+// decodes on its own. No Arduino dependencies, so it can be built on a host.
+#define TELEMETRY_MAGIC         0xEC
+#define TELEMETRY_VERSION       2
+#define TLM_FLAG_DELTA          0x01
+#define TLM_FLAG_ARENA          0x02
+#define TLM_HEADER_SIZE         8
+#define TLM_MAX_SAMPLE_SIZE     28      // dt + masks + every channel in full
+
+struct TelemetrySample {
+  uint32_t timestamp;   // ms
+  uint8_t channels;     // bit per TelemetryChannel present
+  float distance;       // cm
+  float heading;        // degrees
+  int16_t imu[6];       // raw ax, ay, az, gx, gy, gz
+  float battery;        // percent
+  float temperature;    // celsius
+  float x;              // cm
+  float y;              // cm
+  uint8_t poseFrame;    // PoseFrame of x, y
+  uint8_t robotState;
+  uint8_t navMode;
+};
+
+class TelemetryEncoder {
+private:
+  uint8_t buffer[TELEMETRY_MAX_FRAME];
+  size_t length;
+  uint8_t count;
+  bool delta;
+  uint8_t seen;                 // channels already sent in this batch
+  uint32_t lastTimestamp;
+  int32_t lastDistance;
+  int32_t lastHeading;
+  int32_t lastX;
+  int32_t lastY;
+
+public:
+  TelemetryEncoder();
+
+  // Start an empty batch
+  void begin(bool deltaCoding);
+
+  // Append a sample if it fits in capacity bytes (the notification payload
+  // the link allows) and shares the batch's pose frame. Returns false when
+  // it doesn't; flush and begin again.
+  bool add(const TelemetrySample& sample, size_t capacity);
+
+  const uint8_t* data() const;
+  size_t size() const;
+  int sampleCount() const;
+};
+
+// Decode a batch into out. Returns the number of samples, or -1 if the
+// batch is malformed.
+int decodeTelemetryBatch(const uint8_t* data, size_t length, TelemetrySample* out, int maxSamples);
+
+#endif // TELEMETRY_CODEC_H
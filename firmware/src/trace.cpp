@@ -0,0 +1,155 @@
+#include "trace.h"
+#include "transport.h"
+#include <string.h>
+
+// Global instance
+Trace trace;
+
+#define TRACE_VERSION 1
+
+Trace::Trace()
+  : writePos(0),
+    recording(TRACE_ENABLED),
+    taskCount(0),
+    dumpTarget(nullptr),
+    dumpClient(0) {
+  static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+  static_assert(sizeof(TraceEvent) == 12, "TraceEvent is part of the dump format");
+  static_assert(TRACE_MAX_TASKS < TRACE_TASK_OTHER, "task index must fit in 7 bits");
+  memset(ring, 0, sizeof(ring));
+  memset(tasks, 0, sizeof(tasks));
+  memset(taskNames, 0, sizeof(taskNames));
+  for (int i = 0; i < portNUM_PROCESSORS; i++) {
+    anchorTick[i] = 0;
+    anchored[i] = false;
+    lastTask[i] = TRACE_TASK_OTHER;
+  }
+}
+
+void Trace::registerTask(TaskHandle_t handle, const char* name) {
+  if (handle == nullptr) return;
+  if (taskCount >= TRACE_MAX_TASKS) {
+    Serial.printf("No room to trace task %s\n", name);
+    return;
+  }
+  // Fill the slot before the count covers it: record() may be scanning
+  tasks[taskCount] = handle;
+  taskNames[taskCount] = name;
+  taskCount = taskCount + 1;
+}
+
+void Trace::anchor(int core) {
+  // Read both clocks back to back; the pair is what the converter uses
+  uint32_t cycles = ESP.getCycleCount();
+  uint32_t now = micros();
+  anchorTick[core] = xTaskGetTickCount();
+  anchored[core] = true;
+
+  TraceEvent& event = ring[writePos.fetch_add(1, std::memory_order_relaxed) & (TRACE_RING_SIZE - 1)];
+  event.cycles = cycles;
+  event.type = TRACE_CLOCK;
+  event.task = (core << 7) | TRACE_TASK_OTHER;
+  event.arg16 = getCpuFrequencyMhz();
+  event.arg = now;
+}
+
+void Trace::resync() {
+  for (int i = 0; i < portNUM_PROCESSORS; i++) {
+    anchored[i] = false;
+  }
+}
+
+void Trace::start() {
+  resync();
+  recording = TRACE_ENABLED;
+}
+
+void Trace::stop() {
+  recording = false;
+}
+
+void Trace::clear() {
+  bool was = recording;
+  recording = false;
+  vTaskDelay(1);                // let a record() in progress finish
+  writePos.store(0, std::memory_order_relaxed);
+  if (was) start();
+}
+
+bool Trace::isRecording() const {
+  return recording;
+}
+
+void Trace::requestDump(Transport* target, uint16_t client) {
+  // The client first: the pointer is what serviceDump() looks for
+  dumpClient = client;
+  dumpTarget = target;
+}
+
+bool Trace::sendChunk(Transport* target, uint16_t client, uint8_t* chunk, uint8_t kind,
+                      uint16_t index, size_t payload) {
+  chunk[0] = TRACE_MAGIC;
+  chunk[1] = kind;
+  chunk[2] = index & 0xFF;
+  chunk[3] = index >> 8;
+  if (!target->writeReply(client, chunk, TRACE_CHUNK_HEADER + payload)) return false;
+  vTaskDelay(pdMS_TO_TICKS(TRACE_DUMP_PACE_MS));
+  return true;
+}
+
+void Trace::serviceDump() {
+  Transport* target = dumpTarget;
+  uint16_t client = dumpClient;
+  dumpTarget = nullptr;
+  if (target == nullptr || !target->isConnected()) return;
+
+  // Freeze the ring while it goes out, so the oldest events aren't
+  // overwritten under the reader
+  bool was = recording;
+  recording = false;
+  vTaskDelay(1);
+
+  uint8_t chunk[TELEMETRY_MAX_FRAME];
+  size_t capacity = min(target->getMaxPayload(), (size_t)TELEMETRY_MAX_FRAME) - TRACE_CHUNK_HEADER;
+  size_t perChunk = capacity / sizeof(TraceEvent);
+  uint8_t* payload = chunk + TRACE_CHUNK_HEADER;
+  uint16_t index = 0;
+
+  uint32_t end = writePos.load(std::memory_order_relaxed);
+  uint32_t count = min(end, (uint32_t)TRACE_RING_SIZE);
+  uint32_t overwritten = end - count;
+
+  uint16_t mhz = getCpuFrequencyMhz();
+  payload[0] = TRACE_VERSION;
+  memcpy(payload + 1, &mhz, 2);
+  payload[3] = sizeof(TraceEvent);
+  memcpy(payload + 4, &count, 4);
+  memcpy(payload + 8, &overwritten, 4);
+  bool connected = sendChunk(target, client, chunk, TRACE_CHUNK_START, index++, 12);
+
+  for (int i = 0; connected && i < taskCount; i++) {
+    size_t length = min(strlen(taskNames[i]), capacity - 1);
+    payload[0] = i;
+    memcpy(payload + 1, taskNames[i], length);
+    connected = sendChunk(target, client, chunk, TRACE_CHUNK_TASK, index++, 1 + length);
+  }
+
+  uint32_t pos = overwritten;
+  while (connected && pos < end) {
+    size_t n = 0;
+    for (; n < perChunk && pos < end; n++, pos++) {
+      memcpy(payload + n * sizeof(TraceEvent), &ring[pos & (TRACE_RING_SIZE - 1)], sizeof(TraceEvent));
+    }
+    connected = sendChunk(target, client, chunk, TRACE_CHUNK_EVENTS, index++, n * sizeof(TraceEvent));
+  }
+
+  if (connected) {
+    uint32_t sent = pos - overwritten;
+    memcpy(payload, &sent, 4);
+    sendChunk(target, client, chunk, TRACE_CHUNK_END, index, 4);
+  }
+
+  // Continue where the dump left off; the references start over so the
+  // first events after the gap have one close by
+  if (was) start();
+}
@@ -0,0 +1,183 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+class Transport;
+
+// What an event records. arg16/arg are per type:
+enum TraceType : uint8_t {
+  TRACE_CLOCK,            // CPU MHz, micros() at this cycle count (per core)
+  TRACE_TASK_WAKE,        // DiagTask, -
+  TRACE_TASK_SLEEP,       // DiagTask, longest sleep in ms (DIAG_NO_DEADLINE = until an event)
+  TRACE_CMD_RECEIVED,     // seq, type << 24 | value (24 bits)
+  TRACE_CMD_QUEUED,       // as TRACE_CMD_RECEIVED; these five follow AckEvent
+  TRACE_CMD_STARTED,
+  TRACE_CMD_COMPLETED,
+  TRACE_CMD_ABORTED,
+  TRACE_CMD_REJECTED,
+  TRACE_STEPS,            // left steps, right steps of a burst just sent
+  TRACE_SENSOR,           // TraceSensor, reading (mm, or centidegrees)
+  TRACE_MUTEX_WAIT,       // TraceMutex, - : blocked on a held mutex
+  TRACE_MUTEX_TAKEN,      // TraceMutex, - : and got it
+  TRACE_MARK              // free for ad-hoc instrumentation
+};
+
+enum TraceSensor : uint16_t {
+  TRACE_SENSOR_DISTANCE,
+  TRACE_SENSOR_SIDE_LEFT,
+  TRACE_SENSOR_SIDE_RIGHT,
+  TRACE_SENSOR_YAW
+};
+
+enum TraceMutex : uint16_t {
+  TRACE_MUTEX_POSE,
+  TRACE_MUTEX_ULTRASONIC,
+  TRACE_MUTEX_IMU,
+  TRACE_MUTEX_STATUS,
+  TRACE_MUTEX_NOTIFY,
+  TRACE_MUTEX_SERIAL,
+  TRACE_MUTEX_ESTIMATE
+};
+
+// Dump chunks, sent as telemetry messages:
+//   [0] TRACE_MAGIC  [1] TraceChunk  [2..3] chunk index  [4..] payload
+#define TRACE_MAGIC         0xEE
+#define TRACE_CHUNK_HEADER  4
+#define TRACE_TASK_OTHER    0x7F    // recorded by a task nobody registered
+
+enum TraceChunk : uint8_t {
+  TRACE_CHUNK_START,      // version, cpu MHz (u16), event size, events (u32), overwritten (u32)
+  TRACE_CHUNK_TASK,       // task index, name
+  TRACE_CHUNK_EVENTS,     // whole TraceEvents, oldest first
+  TRACE_CHUNK_END         // events sent (u32)
+};
+
+struct TraceEvent {
+  uint32_t cycles;        // CPU cycle counter of the recording core
+  uint8_t type;           // TraceType
+  uint8_t task;           // core << 7 | registered task index
+  uint16_t arg16;
+  uint32_t arg;
+};
+
+// A flight recorder for timing problems: events with a cycle-accurate
+// timestamp go into a fixed ring in RAM, the oldest overwritten, until a
+// client asks for a dump. tools/trace_to_perfetto.py turns the dump into
+// a timeline for ui.perfetto.dev or chrome://tracing.
+//
+// Recording is a handful of register reads, one atomic increment and a
+// 12-byte store, cheap enough for the step loops (bench_trace times it on
+// a PC). The cycle counters of
+// the two cores aren't synchronized and wrap every ~18 s, so each core
+// drops a TRACE_CLOCK reference (its cycle count against micros()) at
+// least every TRACE_ANCHOR_MS; the converter times events from the last
+// reference of their core.
+class Trace {
+private:
+  TraceEvent ring[TRACE_RING_SIZE];
+  std::atomic<uint32_t> writePos;
+  volatile bool recording;
+  TaskHandle_t tasks[TRACE_MAX_TASKS];
+  const char* taskNames[TRACE_MAX_TASKS];
+  volatile int taskCount;
+  volatile TickType_t anchorTick[portNUM_PROCESSORS];
+  volatile bool anchored[portNUM_PROCESSORS];
+  volatile uint8_t lastTask[portNUM_PROCESSORS];  // index guess per core
+  Transport* volatile dumpTarget;
+  volatile uint16_t dumpClient;         // Transport::getRequester()
+
+  void anchor(int core);
+  bool sendChunk(Transport* target, uint16_t client, uint8_t* chunk, uint8_t kind,
+                 uint16_t index, size_t payload);
+
+  uint8_t taskIndex(TaskHandle_t handle) const {
+    for (int i = 0; i < taskCount; i++) {
+      if (tasks[i] == handle) return i;
+    }
+    return TRACE_TASK_OTHER;
+  }
+
+  // The task that recorded last on this core usually records again, so
+  // try its index before scanning. The guess is one byte and checked
+  // against tasks[], so a switch to another task mid-update can only
+  // cost a scan, never name the wrong task.
+  uint8_t currentTask(int core) {
+    TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+    uint8_t index = lastTask[core];
+    if (index < taskCount && tasks[index] == handle) return index;
+    index = taskIndex(handle);
+    lastTask[core] = index;
+    return index;
+  }
+
+public:
+  Trace();
+
+  // Names a task in the dump; tasks not registered show up as "other"
+  void registerTask(TaskHandle_t handle, const char* name);
+
+  void record(uint8_t type, uint16_t arg16, uint32_t arg) {
+    if (!recording) return;
+    uint32_t cycles = ESP.getCycleCount();
+    int core = xPortGetCoreID();
+    if (!anchored[core] || xTaskGetTickCount() - anchorTick[core] >= pdMS_TO_TICKS(TRACE_ANCHOR_MS)) {
+      anchor(core);
+    }
+    uint8_t task = (core << 7) | currentTask(core);
+
+    TraceEvent& event = ring[writePos.fetch_add(1, std::memory_order_relaxed) & (TRACE_RING_SIZE - 1)];
+    event.cycles = cycles;
+    event.type = type;
+    event.task = task;
+    event.arg16 = arg16;
+    event.arg = arg;
+  }
+
+  // The CPU clock changed: each core takes a new reference before its
+  // next event
+  void resync();
+
+  void start();
+  void stop();
+  void clear();
+  bool isRecording() const;
+
+  // Dump to one client of a link. Requested from any task, sent by the
+  // communication task, paced so the BLE queues keep up; recording pauses
+  // meanwhile.
+  void requestDump(Transport* target, uint16_t client);
+  void serviceDump();
+};
+
+// Global trace instance
+extern Trace trace;
+
+#if TRACE_ENABLED
+#define TRACE(type, arg16, arg) trace.record((type), (uint16_t)(arg16), (uint32_t)(arg))
+#else
+#define TRACE(type, arg16, arg) do { } while (0)
+#endif
+
+// Command identity for the TRACE_CMD_* events
+#define TRACE_COMMAND(cmd)  (((uint32_t)(uint8_t)(cmd).type << 24) | ((uint32_t)(cmd).value & 0xFFFFFF))
+
+// xSemaphoreTake(mutex, portMAX_DELAY) that records the time spent
+// blocked. An uncontended take records nothing.
+inline void traceTake(SemaphoreHandle_t mutex, TraceMutex id) {
+#if TRACE_ENABLED
+  if (xSemaphoreTake(mutex, 0) == pdTRUE) return;
+  TRACE(TRACE_MUTEX_WAIT, id, 0);
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  TRACE(TRACE_MUTEX_TAKEN, id, 0);
+#else
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+}
+
+#endif // TRACE_H
@@ -0,0 +1,55 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "protocol.h"
+
+// A link to a client that speaks the robot's command protocol: the BLE
+// characteristics, a serial port or an in-process loopback. A transport
+// hands whatever it receives to linkManager, which parses, queues and
+// acknowledges it; telemetry and acks come back through the write calls.
+class Transport {
+public:
+  virtual ~Transport() {}
+
+  virtual const char* getName() const = 0;
+
+  // Whether a client is there to receive telemetry and acks
+  virtual bool isConnected() const = 0;
+
+  // Largest telemetry message the link carries in one piece
+  virtual size_t getMaxPayload() const = 0;
+
+  // Telemetry and status messages (JSON or packed batches)
+  virtual void writeTelemetry(const uint8_t* data, size_t length) = 0;
+
+  // Command lifecycle records (ACK_SIZE bytes)
+  virtual void writeAck(const uint8_t* data, size_t length) = 0;
+
+  // Replies that only the client who asked should get. getRequester() is
+  // called while its command is handled; writeReply() sends a telemetry
+  // message to that client alone and returns false once it has gone.
+  // Links with a single client have nothing to pick between.
+  virtual uint16_t getRequester() const { return 0; }
+  virtual bool writeReply(uint16_t requester, const uint8_t* data, size_t length) {
+    writeTelemetry(data, length);
+    return isConnected();
+  }
+
+  // Settings that only make sense for this link, e.g. BLE connection
+  // parameters. Return true if the command (or frame) was consumed; for a
+  // frame, ok reports whether it was applied.
+  virtual bool handleLinkCommand(const char* cmd) { return false; }
+  virtual bool handleLinkFrame(const Frame& frame, bool& ok) { return false; }
+
+  // Something arrived on this link. Returns the link's profile (e.g. the
+  // BLE connection profile) as it was on arrival, before this wakes it.
+  virtual uint8_t noteActivity() { return 0; }
+
+  // A command from this link is about to run
+  virtual void commandStarted(const Command& command) {}
+};
+
+#endif // TRANSPORT_H
@@ -1,10 +1,17 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stdint.h>
+
 // Command structure for BLE communication
 struct Command {
-  char type;    // F,B,L,R,S,A,C,K (Forward,Backward,Left,Right,Stop,Auto,Calibrate,closed-loop)
+  char type;    // F,B,L,R,S,A,C,K,H,M,W,P,G (Forward,Backward,Left,Right,Stop,Auto,Calibrate,
+                //  closed-loop, heading Hold, MCL, Wall, Path/route, Go program)
   int value;    // Parameter value (distance in cm, angle in degrees)
+  uint16_t seq; // Binary frame sequence number (0 for text commands)
+  uint32_t receivedAt;  // millis() when the robot received it (for acks)
+  uint8_t profile;      // the link's profile when it arrived (transport-defined)
+  uint8_t source;       // transport it came from (0 = on-robot, e.g. a program)
 };
 
 // Robot state enumeration
@@ -34,6 +41,45 @@ struct PathMemoryEntry {
   unsigned long timestamp;
 };
 
+// Dead-reckoned robot pose. The origin is where the robot was when the pose
+// was last reset; heading is in degrees and grows clockwise (a right turn is
+// positive, matching rotateRobot()), so at heading 0 the robot faces +x and
+// +y is to its right.
+struct Pose {
+  float x;              // cm
+  float y;              // cm
+  float heading;        // degrees, 0-360
+};
+
+// Frame a reported pose is in
+enum PoseFrame {
+  FRAME_ODOMETRY,       // dead reckoning since the last pose reset
+  FRAME_ARENA           // arena map frame (0, 0 = center), via localization
+};
+
+// Autonomous behaviour currently run by the navigation system
+enum NavMode {
+  NAV_OFF,
+  NAV_WANDER,           // E-Bug wander-and-avoid
+  NAV_EXPLORE,          // frontier-based exploration of the grid map
+  NAV_WALL_FOLLOW,      // keep a set distance from the left/right wall
+  NAV_CORRIDOR,         // stay centered between two walls
+  NAV_ROUTE             // pure-pursuit along an uploaded waypoint route
+};
+
+// Wall-follow / corridor steering since the mode started
+struct FollowMetrics {
+  float rmsError;       // cm, over every scan steered from
+  unsigned long settleMs;   // until the error held inside the band; 0 = not yet
+  float speed;          // cm/s, mean forward speed
+};
+
+// Route waypoint, in the same frame as Pose
+struct Waypoint {
+  float x;              // cm
+  float y;              // cm
+};
+
 // Motor parameters
 struct MotorParams {
   int speed;            // microseconds delay
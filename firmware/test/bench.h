@@ -0,0 +1,52 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Timing for the bench_* programs. Figures are host wall-clock time, best
+// of a few runs, and only comparable with each other on the same machine.
+// With --quick (as ctest runs them) every loop is cut short.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+namespace bench {
+
+inline bool& quick() {
+  static bool value = false;
+  return value;
+}
+
+inline void parseArgs(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) quick() = true;
+  }
+}
+
+inline long iterations(long full) {
+  return quick() ? (full / 1000 > 0 ? full / 1000 : 1) : full;
+}
+
+// Nanoseconds per call of body(i), best of five runs of n calls
+template <typename Body>
+double nsPerCall(long n, Body body) {
+  n = iterations(n);
+  double best = 0;
+  for (int run = 0; run < 5; run++) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < n; i++) body(i);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / n;
+    if (run == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+// Keeps the optimizer from dropping a result
+template <typename T>
+inline void keep(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+}  // namespace bench
+
+#endif // BENCH_H
@@ -0,0 +1,182 @@
+// Frontier exploration on simulated arenas: how long (robot time) until
+// 90% coverage, by the firmware's own metric and by the share of the
+// arena's free cells actually observed, and where exploration ends.
+//
+// The robot is the firmware's own Navigation / Exploration / MotorControl
+// on simulated time; the front ultrasonic sensor is a ray cast through the
+// arena drawing from the odometry pose. Odometry is exact here, so the
+// figures show the planner and coverage metric, not drift. Doors and
+// corridors are 4+ cells wide: the planner keeps a cell clear of walls and
+// the sonar cone marks door edges a cell wide, so narrower ones stay shut.
+
+#include <Arduino.h>
+#include <chrono>
+#include <cmath>
+#include "arena_map.h"
+#include "bench.h"
+#include "exploration.h"
+#include "host_hw.h"
+#include "motor_control.h"
+#include "navigation.h"
+#include "sensor_manager.h"
+
+struct Arena {
+  const char* name;
+  const char* const* rows;
+  int width;
+  int height;
+  int startCol;                 // robot starts on this cell's corner, facing
+  int startRow;                 // +x, so map cells line up with arena cells
+};
+
+static const char* const EMPTY_ROOM[] = {
+  "######################",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "#....................#",
+  "######################",
+};
+
+static const char* const TWO_ROOMS[] = {
+  "##########################",
+  "#...........#............#",
+  "#...........#............#",
+  "#........................#",
+  "#........................#",
+  "#........................#",
+  "#........................#",
+  "#........................#",
+  "#........................#",
+  "#...........#............#",
+  "#...........#............#",
+  "##########################",
+};
+
+static const char* const CORRIDORS[] = {
+  "############################",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "####....##########....######",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#########....########....###",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "#..........................#",
+  "############################",
+};
+
+static const Arena ARENAS[] = {
+  {"empty room 2.0 x 1.2 m", EMPTY_ROOM, 22, 14, 11, 7},
+  {"two rooms 2.4 x 1.0 m", TWO_ROOMS, 26, 12, 6, 6},
+  {"corridors 2.6 x 1.7 m", CORRIDORS, 28, 19, 13, 9},
+  {"arena_map.h 2.8 x 2.2 m", ARENA_MAP, ARENA_MAP_WIDTH, ARENA_MAP_HEIGHT, 15, 12},
+};
+
+class SimArena : public host::Hardware {
+public:
+  const Arena* arena = nullptr;
+
+  bool wall(float x, float y) const {
+    int col = (int)floor(x / GRID_CELL_SIZE_CM);
+    int row = (int)floor(y / GRID_CELL_SIZE_CM);
+    if (col < 0 || row < 0 || col >= arena->width || row >= arena->height) return true;
+    return arena->rows[row][col] == '#';
+  }
+
+  unsigned long echo(uint8_t pin, unsigned long timeoutUs) override {
+    if (pin != ECHO_PIN) return 0;
+    Pose pose = motorController.getPose();
+    float x = arena->startCol * GRID_CELL_SIZE_CM + pose.x;
+    float y = arena->startRow * GRID_CELL_SIZE_CM + pose.y;
+    float rad = pose.heading * PI / 180.0;
+    for (float d = 1; d < 400; d += 1) {
+      if (wall(x + d * cos(rad), y + d * sin(rad))) {
+        unsigned long width = (unsigned long)(d * 2.0 / 0.0346);   // 25 C
+        return width < timeoutUs ? width : 0;
+      }
+    }
+    return 0;
+  }
+};
+
+static SimArena sim;
+
+// Ground truth: the share of the arena's free cells the map has observed
+static double arenaObserved(const Arena& arena) {
+  const GridMap& map = explorer.getMap();
+  int free = 0, seen = 0;
+  for (int row = 0; row < arena.height; row++) {
+    for (int col = 0; col < arena.width; col++) {
+      if (arena.rows[row][col] == '#') continue;
+      free++;
+      if (map.isKnown(col - arena.startCol + GRID_MAP_WIDTH / 2,
+                      row - arena.startRow + GRID_MAP_HEIGHT / 2)) seen++;
+    }
+  }
+  return seen * 100.0 / free;
+}
+
+static void formatTime(char* text, size_t size, unsigned long ms) {
+  if (ms) snprintf(text, size, "%.0f s", ms / 1000.0);
+  else snprintf(text, size, "-");
+}
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+  host::setConsoleOutput(getenv("EXPLORE_LOG") != nullptr);
+  host::setHardware(&sim);
+  host::setSimulatedTime(true);
+  sensorManager.updateSensorData(false);    // 25 C for the speed of sound
+
+  // Robot time allowed per arena
+  const unsigned long limitMs = bench::quick() ? 120000 : 1800000;
+
+  printf("robot time to 90%%: by getCoverage(), and by the share of the arena's\n"
+         "free cells actually observed\n");
+  printf("%-26s %9s %9s %9s %9s %8s %8s\n", "", "90% cov", "90% true", "cov",
+         "true", "done at", "CPU");
+  for (const Arena& arena : ARENAS) {
+    sim.arena = &arena;
+    motorController.clearStop();
+    navigator.enableExplorationMode();
+
+    auto cpuStart = std::chrono::steady_clock::now();
+    unsigned long start = millis();
+    unsigned long reached = 0, reachedTrue = 0;
+    while (navigator.getMode() == NAV_EXPLORE && millis() - start < limitMs) {
+      navigator.executeAutonomousStep();
+      host::advanceMicros(MOTOR_TASK_DELAY * 1000UL);
+      if (reached == 0 && explorer.getCoverage() >= 90.0) reached = millis() - start;
+      if (reachedTrue == 0 && arenaObserved(arena) >= 90.0) reachedTrue = millis() - start;
+    }
+    unsigned long done = navigator.getMode() != NAV_EXPLORE ? millis() - start : 0;
+    navigator.disableAutonomousMode();
+    double cpu = std::chrono::duration<double>(std::chrono::steady_clock::now() - cpuStart).count();
+
+    char at90[16], atTrue90[16], doneAt[16];
+    formatTime(at90, sizeof(at90), reached);
+    formatTime(atTrue90, sizeof(atTrue90), reachedTrue);
+    formatTime(doneAt, sizeof(doneAt), done);
+    printf("%-26s %9s %9s %8.1f%% %8.1f%% %8s %5.0f ms\n", arena.name, at90, atTrue90,
+           explorer.getCoverage(), arenaObserved(arena), doneAt, cpu * 1000);
+  }
+  return 0;
+}
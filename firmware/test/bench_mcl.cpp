@@ -0,0 +1,43 @@
+// Monte Carlo localization update time against the particle count. The
+// pool is a compile-time size, so CMake builds this once per count
+// (bench_mcl_<count>) and each binary prints its own row.
+//
+// The robot drives a slow circle through the arena with every update far
+// enough apart to run the full predict / weigh / resample cycle, from a
+// global start (particles over the whole arena, the costly case for the
+// ray caster) and from the start pose.
+
+#include <Arduino.h>
+#include <cmath>
+#include "bench.h"
+#include "host_hw.h"
+#include "localization.h"
+
+static double updateMicros(bool fromStart) {
+  localizer.requestEnable(fromStart);
+  Pose odometry = {0.0, 0.0, 0.0};
+  localizer.update(odometry, 80.0);
+  double ns = bench::nsPerCall(2000, [&](long i) {
+    odometry.heading = fmod(odometry.heading + 3.0, 360.0);
+    float rad = odometry.heading * PI / 180.0;
+    odometry.x += 3.0 * cos(rad);
+    odometry.y += 3.0 * sin(rad);
+    localizer.update(odometry, 40.0 + (i % 50));
+  });
+  localizer.requestDisable();
+  localizer.update(odometry, 0.0);
+  return ns / 1000.0;
+}
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+  host::setConsoleOutput(false);
+  localizer.begin();
+
+  double global = updateMicros(false);
+  double start = updateMicros(true);
+  printf("%5d particles: %8.1f us/update global, %8.1f us/update from start, "
+         "%5.0f ns/particle\n", MCL_PARTICLE_COUNT, global, start,
+         global * 1000.0 / MCL_PARTICLE_COUNT);
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Command parsing cost: the CRC, the in-place frame decoder, and a whole
+// command through the link (parse, queue, dequeue) as text and as a frame.
+
+#include "bench.h"
+#include "loopback_client.h"
+#include "host_hw.h"
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+  host::setConsoleOutput(false);
+
+  uint8_t frame[FRAME_MAX_SIZE];
+  Frame plain = {OP_FORWARD, 1, 20, 0, nullptr};
+  size_t plainLength = encodeFrame(plain, frame, sizeof(frame));
+
+  uint8_t bigFrame[FRAME_MAX_SIZE];
+  uint8_t payload[FRAME_MAX_PAYLOAD] = {};
+  Frame big = {OP_PROG_DATA, 2, 0, FRAME_MAX_PAYLOAD, payload};
+  size_t bigLength = encodeFrame(big, bigFrame, sizeof(bigFrame));
+
+  printf("%-40s %10s\n", "", "ns/call");
+
+  double ns = bench::nsPerCall(10000000, [&](long) {
+    bench::keep(crc16(frame, plainLength - FRAME_CRC_SIZE));
+  });
+  printf("%-40s %10.1f\n", "crc16, 10-byte header", ns);
+
+  ns = bench::nsPerCall(10000000, [&](long) {
+    Frame decoded;
+    Command command;
+    bench::keep(decodeFrame(frame, plainLength, decoded));
+    bench::keep(frameToCommand(decoded, command));
+  });
+  printf("%-40s %10.1f\n", "decodeFrame + frameToCommand, 12 B", ns);
+
+  ns = bench::nsPerCall(1000000, [&](long) {
+    Frame decoded;
+    bench::keep(decodeFrame(bigFrame, bigLength, decoded));
+  });
+  printf("%-40s %10.1f\n", "decodeFrame, 267 B", ns);
+
+  // Through linkManager on a closed loopback link, so no acks are written
+  static LoopbackClient client;
+  client.connect();
+  client.link.setOpen(false);
+
+  ns = bench::nsPerCall(1000000, [&](long) {
+    client.link.sendText("F20");
+    bench::keep(linkManager.getNextCommand());
+  });
+  printf("%-40s %10.1f\n", "link: text \"F20\" to dequeued Command", ns);
+
+  ns = bench::nsPerCall(1000000, [&](long) {
+    client.link.sendFrame(frame, plainLength);
+    bench::keep(linkManager.getNextCommand());
+  });
+  printf("%-40s %10.1f\n", "link: frame to dequeued Command", ns);
+
+  ns = bench::nsPerCall(1000000, [&](long) {
+    client.link.sendText("CLOOP_OFF");
+    bench::keep(linkManager.getNextCommand());
+  });
+  printf("%-40s %10.1f\n", "link: text \"CLOOP_OFF\" (last compare)", ns);
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Telemetry encoding cost and size: packed batches (full and delta-coded)
+// against one JSON object per sample through the link.
+
+#include "bench.h"
+#include "loopback_client.h"
+#include "host_hw.h"
+#include <math.h>
+
+// A robot driving a slow arc: the channels a client typically subscribes to
+static TelemetrySample sampleAt(long i, uint8_t channels) {
+  TelemetrySample sample = {};
+  sample.timestamp = 1000 + i * 20;
+  sample.channels = channels;
+  sample.distance = 80 + 30 * sinf(i * 0.05f);
+  sample.heading = fmodf(i * 0.7f, 360);
+  for (int k = 0; k < 6; k++) sample.imu[k] = (int16_t)(100 * k + i % 7);
+  sample.battery = 87.5;
+  sample.temperature = 31;
+  sample.x = 50 + i * 0.4f;
+  sample.y = 20 + i * 0.1f;
+  return sample;
+}
+
+static void encoder(const char* name, uint8_t channels, bool delta) {
+  TelemetryEncoder batch;
+  batch.begin(delta);
+  long samples = 0;
+  size_t bytes = 0;
+  double ns = bench::nsPerCall(2000000, [&](long i) {
+    TelemetrySample sample = sampleAt(i, channels);
+    if (!batch.add(sample, TELEMETRY_MAX_FRAME)) {
+      bytes += batch.size();
+      samples += batch.sampleCount();
+      batch.begin(delta);
+      batch.add(sample, TELEMETRY_MAX_FRAME);
+    }
+  });
+  printf("%-36s %10.1f %12.1f\n", name, ns, samples > 0 ? (double)bytes / samples : 0.0);
+}
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+  host::setConsoleOutput(false);
+
+  const uint8_t typical = (1 << TLM_CH_DISTANCE) | (1 << TLM_CH_HEADING) | (1 << TLM_CH_POSE);
+  const uint8_t all = (1 << TLM_CHANNEL_COUNT) - 1;
+
+  printf("%-36s %10s %12s\n", "", "ns/sample", "bytes/sample");
+  encoder("binary, distance+heading+pose", typical, false);
+  encoder("delta, distance+heading+pose", typical, true);
+  encoder("binary, every channel", all, false);
+  encoder("delta, every channel", all, true);
+
+  // Through linkManager, as the sensor task publishes, read back off a
+  // loopback link (the JSON side uses the host ArduinoJson shim)
+  static LoopbackClient client;
+  client.connect();
+  for (int ch = 0; ch < TLM_CHANNEL_COUNT; ch++) {
+    linkManager.setChannelPeriod(ch, (typical & (1 << ch)) ? TELEMETRY_MIN_PERIOD : 0);
+  }
+  const TelemetryFormat formats[] = {TELEMETRY_JSON, TELEMETRY_BINARY, TELEMETRY_BINARY_DELTA};
+  const char* names[] = {"link, JSON", "link, binary", "link, delta"};
+  for (int f = 0; f < 3; f++) {
+    linkManager.setTelemetryFormat(formats[f]);
+    linkManager.flushTelemetry();
+    client.clear();
+    size_t bytes = 0;
+    LoopbackTransport::MessageKind kind;
+    uint8_t message[LOOPBACK_BUFFER_SIZE];
+    size_t length;
+    long published = 0;
+    double ns = bench::nsPerCall(200000, [&](long i) {
+      linkManager.publishTelemetry(sampleAt(i, typical));
+      published++;
+      while ((length = client.link.receive(kind, message, sizeof(message))) > 0) bytes += length;
+    });
+    printf("%-36s %10.1f %12.1f\n", names[f], ns, (double)bytes / published);
+  }
+  return 0;
+}
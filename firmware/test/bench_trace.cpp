@@ -0,0 +1,63 @@
+// Cost of one TRACE() point: Trace::record() with the recording task
+// registered first or last of TRACE_MAX_TASKS, or not registered at all.
+// The clocks run on simulated time, so reading them is an atomic add
+// rather than a system call; the first row (the RTOS and clock calls
+// record() makes, and nothing else) is still subtracted out in the last
+// column, which is the recorder's own work.
+
+#include <Arduino.h>
+#include "bench.h"
+#include "host_hw.h"
+#include "trace.h"
+
+static int others[TRACE_MAX_TASKS];
+
+// A recorder with every slot taken; the calling task at `slot`, or
+// nowhere if slot is negative
+static void fill(Trace& probe, int slot) {
+  for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+    TaskHandle_t handle = i == slot ? xTaskGetCurrentTaskHandle() : (TaskHandle_t)&others[i];
+    probe.registerTask(handle, "task");
+  }
+}
+
+static double recordNs(Trace& probe) {
+  return bench::nsPerCall(5000000, [&](long i) {
+    probe.record(TRACE_MARK, 0, (uint32_t)i);
+  });
+}
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+  host::setConsoleOutput(false);
+  host::setSimulatedTime(true);
+
+  double calls = bench::nsPerCall(5000000, [](long i) {
+    uint32_t cycles = ESP.getCycleCount();
+    int core = xPortGetCoreID();
+    TickType_t now = xTaskGetTickCount();
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    bench::keep(cycles);
+    bench::keep(core);
+    bench::keep(now);
+    bench::keep(task);
+  });
+
+  static Trace first, last, unregistered;
+  fill(first, 0);
+  fill(last, TRACE_MAX_TASKS - 1);
+  fill(unregistered, -1);
+
+  printf("%-36s %10s %14s\n", "", "ns/event", "less the calls");
+  printf("%-36s %10.1f\n", "clock and task calls alone", calls);
+  const struct { const char* name; Trace* probe; } rows[] = {
+    {"record(), task registered first", &first},
+    {"record(), task registered last", &last},
+    {"record(), task not registered", &unregistered},
+  };
+  for (const auto& row : rows) {
+    double ns = recordNs(*row.probe);
+    printf("%-36s %10.1f %14.1f\n", row.name, ns, ns - calls);
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Program VM throughput: a counting loop run in motor-task slices of
+// PROGRAM_STEP_BUDGET instructions and in one long run, and the cost of
+// loading (verifying and decoding) a program.
+
+#include "bench.h"
+#include "bytecode_vm.h"
+
+static size_t countingLoop(uint8_t* out, int32_t count) {
+  // var 0 = count; do { var 1 += 1 } while (--var 0 > 0)
+  const uint8_t program[] = {
+    VM_PUSH, (uint8_t)count, (uint8_t)(count >> 8), (uint8_t)(count >> 16), (uint8_t)(count >> 24),
+    VM_STORE, 0,
+    VM_LOAD, 1, VM_PUSH, 1, 0, 0, 0, VM_ADD, VM_STORE, 1,   // body at 7
+    VM_LOOP, 0, 7, 0,
+    VM_HALT
+  };
+  memcpy(out, program, sizeof(program));
+  return sizeof(program);
+}
+
+static BytecodeVM vm;
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+
+  uint8_t program[PROGRAM_MAX_SIZE];
+  const int32_t count = bench::quick() ? 1000 : 1000000;
+  size_t length = countingLoop(program, count);
+  if (!vm.load(program, length)) {
+    printf("load failed: %s\n", vm.getError());
+    return 1;
+  }
+
+  printf("%-44s %12s\n", "", "M instr/s");
+  const int budgets[] = {PROGRAM_STEP_BUDGET, 1 << 30};
+  const char* names[] = {"loop, PROGRAM_STEP_BUDGET per run()", "loop, one run()"};
+  for (int i = 0; i < 2; i++) {
+    uint32_t executed = 0;
+    double ns = bench::nsPerCall(bench::quick() ? 1000 : 10, [&](long) {
+      vm.reset();
+      char type;
+      int32_t value;
+      while (vm.run(budgets[i], 0, type, value) == VM_YIELD) {}
+      executed = vm.getExecutedCount();
+    });
+    printf("%-44s %12.1f\n", names[i], executed / ns * 1000.0);
+  }
+
+  // The largest program the cache takes, with a jump to resolve per entry
+  size_t big = 0;
+  for (int i = 0; i < PROGRAM_MAX_INSTRUCTIONS; i++) {
+    program[big++] = VM_JMP;
+    program[big++] = 0;
+    program[big++] = 0;
+  }
+  double ns = bench::nsPerCall(100000, [&](long) {
+    bench::keep(vm.load(program, big));
+  });
+  printf("%-44s %12s\n", "", "us/load");
+  printf("%-44s %12.2f\n", "load, 256 jumps (768 B)", ns / 1000.0);
+  return 0;
+}
@@ -0,0 +1,173 @@
+// Idle wake-ups and command pickup latency of the task loops, polling (as
+// before the tasks blocked on events) against blocking on task_events.h,
+// on host threads in real time.
+//
+// main.cpp isn't part of the host build, so each task here is its loop's
+// sleep and nothing else: the polling variant sleeps the fixed periods
+// the loops used to (motor 10 ms, console 5 ms, loop() 100 ms, log drain
+// 20 ms), the blocking variant makes the waits main.cpp and logger.cpp
+// make now. The sensor task sleeps its period in both. Commands go through
+// the real link manager and command queue. tools/bench_idle.py measures
+// the same on a robot.
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "host_hw.h"
+#include "loopback_client.h"
+
+#define POLL_SERIAL_MS  5       // the console poll before EVENT_SERIAL
+#define POLL_LOOP_MS    100     // loop()'s delay()
+
+enum TaskId { MOTOR, SENSOR, COMM, LOOP, LOG_DRAIN, TASK_COUNT };
+static const char* const TASK_NAMES[TASK_COUNT] = {"motor", "sensor", "comm", "loop", "log drain"};
+
+static bool blocking;
+static std::atomic<bool> running;
+static std::atomic<int> stopped;
+static std::atomic<long> wakeups[TASK_COUNT];
+static std::atomic<uint32_t> queuedAt;
+static std::vector<uint32_t> latencies;       // motor task only
+static TaskHandle_t drainTask;
+
+static void motorLoop(void*) {
+  while (running) {
+    wakeups[MOTOR]++;
+    while (linkManager.hasCommand()) {
+      linkManager.getNextCommand();
+      latencies.push_back(micros() - queuedAt);
+    }
+    if (blocking) {
+      taskEvents.wait(EVENT_COMMAND | EVENT_PARAMS, portMAX_DELAY);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(MOTOR_TASK_DELAY));
+    }
+  }
+  stopped++;
+}
+
+static void sensorLoop(void*) {
+  while (running) {
+    wakeups[SENSOR]++;
+    if (blocking) {
+      taskEvents.wait(EVENT_SENSOR_PLAN, pdMS_TO_TICKS(SENSOR_UPDATE_RATE));
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(SENSOR_UPDATE_RATE));
+    }
+  }
+  stopped++;
+}
+
+static void commLoop(void*) {
+  while (running) {
+    wakeups[COMM]++;
+    if (blocking) {
+      taskEvents.wait(EVENT_SERIAL | EVENT_TRACE_DUMP, pdMS_TO_TICKS(STATUS_PRINT_INTERVAL));
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(POLL_SERIAL_MS));
+    }
+  }
+  stopped++;
+}
+
+static void loopLoop(void*) {
+  while (running) {
+    wakeups[LOOP]++;
+    if (blocking) {
+      taskEvents.wait(EVENT_CONNECTION, pdMS_TO_TICKS(HEARTBEAT_INTERVAL));
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(POLL_LOOP_MS));
+    }
+  }
+  stopped++;
+}
+
+static void drainLoop(void*) {
+  while (running) {
+    wakeups[LOG_DRAIN]++;
+    if (blocking) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    }
+  }
+  stopped++;
+}
+
+static void run(bool events, double idleSeconds, int commands) {
+  static LoopbackClient client;
+  static bool connected = false;
+  if (!connected) {
+    client.connect();
+    connected = true;
+  }
+
+  blocking = events;
+  running = true;
+  stopped = 0;
+  for (auto& count : wakeups) count = 0;
+  latencies.clear();
+  // The last run's shutdown left its bits set
+  taskEvents.wait(EVENT_COMMAND | EVENT_SENSOR_PLAN | EVENT_SERIAL | EVENT_CONNECTION, 0);
+
+  TaskFunction_t loops[TASK_COUNT] = {motorLoop, sensorLoop, commLoop, loopLoop, drainLoop};
+  for (int i = 0; i < TASK_COUNT; i++) {
+    xTaskCreatePinnedToCore(loops[i], TASK_NAMES[i], 4096, nullptr, 1,
+                            i == LOG_DRAIN ? &drainTask : nullptr, 0);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(idleSeconds));
+  double idle = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  long idleWakeups[TASK_COUNT];
+  for (int i = 0; i < TASK_COUNT; i++) idleWakeups[i] = wakeups[i];
+
+  // Spaced out so each command finds the motor task asleep
+  for (int i = 0; i < commands; i++) {
+    queuedAt = micros();
+    client.link.sendText("STOP");
+    std::this_thread::sleep_for(std::chrono::milliseconds(23));
+  }
+
+  running = false;
+  taskEvents.signal(EVENT_COMMAND | EVENT_SENSOR_PLAN | EVENT_SERIAL | EVENT_CONNECTION);
+  xTaskNotifyGive(drainTask);
+  while (stopped < TASK_COUNT) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  client.acks.clear();
+  drainCommands();
+
+  printf("%s\n", events ? "blocking on events" : "polling");
+  double total = 0;
+  for (int i = 0; i < TASK_COUNT; i++) {
+    // The first pass of each task is its start, not a wake-up
+    double rate = (idleWakeups[i] - 1) / idle;
+    total += rate;
+    printf("  %-28s %10.2f\n", TASK_NAMES[i], rate);
+  }
+  printf("  %-28s %10.2f\n", "total wake-ups/s", total);
+
+  std::sort(latencies.begin(), latencies.end());
+  if (!latencies.empty()) {
+    double sum = 0;
+    for (uint32_t us : latencies) sum += us;
+    uint32_t p95 = latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)];
+    printf("  queue to start: mean %.0f us, p95 %u us, max %u us (%d commands)\n",
+           sum / latencies.size(), p95, latencies.back(), (int)latencies.size());
+  }
+}
+
+int main(int argc, char** argv) {
+  bench::parseArgs(argc, argv);
+  host::setConsoleOutput(false);
+
+  double idle = bench::quick() ? 0.3 : 10;
+  int commands = bench::quick() ? 5 : 100;
+  printf("idle wake-ups per second over %.1f s, then %d STOPs\n", idle, commands);
+  run(false, idle, commands);
+  run(true, idle, commands);
+  return 0;
+}
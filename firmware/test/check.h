@@ -0,0 +1,80 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// A few macros are all the host tests need, so the build doesn't depend
+// on a test framework being installed:
+//
+//   TEST_CASE(name) { ... }     registered and run by test_main.cpp
+//   CHECK(cond)                 record a failure and carry on
+//   CHECK_EQ(a, b)              the same, printing both values
+//   REQUIRE(cond)               record a failure and end the test case
+//   REQUIRE_EQ(a, b)
+
+#include <stdio.h>
+#include <sstream>
+#include <string>
+
+namespace check {
+
+typedef void (*TestFunction)();
+
+struct TestCase {
+  const char* name;
+  TestFunction function;
+  TestCase* next;
+};
+
+TestCase*& registry();
+void fail(const char* file, int line, const std::string& message);
+
+struct Registration {
+  TestCase entry;
+  Registration(const char* name, TestFunction function) : entry{name, function, nullptr} {
+    TestCase** tail = &registry();
+    while (*tail != nullptr) tail = &(*tail)->next;
+    *tail = &entry;
+  }
+};
+
+template <typename T>
+std::string show(const T& value) {
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+inline std::string show(char value) {
+  return std::string("'") + value + "'";
+}
+
+inline std::string show(unsigned char value) {
+  return std::to_string(value);
+}
+
+template <typename A, typename B>
+bool equal(const char* file, int line, const char* expression, const A& a, const B& b) {
+  if (a == b) return true;
+  fail(file, line, std::string(expression) + ": " + show(a) + " != " + show(b));
+  return false;
+}
+
+}  // namespace check
+
+#define TEST_CASE(name) \
+  static void name(); \
+  static check::Registration name##Registration(#name, name); \
+  static void name()
+
+#define CHECK(cond) \
+  ((cond) ? (void)0 : check::fail(__FILE__, __LINE__, #cond))
+
+#define CHECK_EQ(a, b) \
+  ((void)check::equal(__FILE__, __LINE__, #a " == " #b, (a), (b)))
+
+#define REQUIRE(cond) \
+  do { if (!(cond)) { check::fail(__FILE__, __LINE__, #cond); return; } } while (0)
+
+#define REQUIRE_EQ(a, b) \
+  do { if (!check::equal(__FILE__, __LINE__, #a " == " #b, (a), (b))) return; } while (0)
+
+#endif // CHECK_H
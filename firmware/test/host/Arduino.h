@@ -0,0 +1,78 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// The Arduino core as the firmware uses it, on the host. Time is the
+// process clock, or a simulated one (host_hw.h); pins, the echo timer and
+// the ADC go to the simulated hardware. Serial writes to stdout.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+#include "freertos/FreeRTOS.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::abs;
+using std::max;
+using std::min;
+
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) {}
+  size_t write(uint8_t value);
+  size_t write(const uint8_t* data, size_t length);
+  size_t print(const char* text);
+  size_t println(const char* text = "");
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  void flush();
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeoutUs);
+uint16_t analogRead(uint8_t pin);
+uint32_t analogReadMilliVolts(uint8_t pin);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+class EspClass {
+public:
+  // Nanoseconds of the process clock: a 1 GHz "CPU" for cycle counts
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  const char* getChipModel();
+  uint32_t getCpuFreqMHz();
+  uint32_t getFlashChipSize();
+  void restart();
+};
+
+extern EspClass ESP;
+
+uint32_t getCpuFrequencyMhz();
+bool setCpuFrequencyMhz(uint32_t mhz);
+
+#endif // HOST_ARDUINO_H
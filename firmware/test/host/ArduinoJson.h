@@ -0,0 +1,316 @@
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+// The part of ArduinoJson 6 the firmware uses: building a document in a
+// fixed pool and serializeJson() into a buffer. Like the library, the pool
+// holds JsonDocument capacity / 16 values, strings are kept by pointer and
+// whatever doesn't fit is dropped, so an undersized document shows up on
+// the host too. Nothing is parsed.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+namespace host_json {
+
+enum NodeType : uint8_t {
+  NODE_NULL,
+  NODE_OBJECT,
+  NODE_ARRAY,
+  NODE_STRING,
+  NODE_INT,
+  NODE_UINT,
+  NODE_FLOAT,
+  NODE_BOOL
+};
+
+struct Node {
+  const char* key;
+  NodeType type;
+  int16_t first;      // children, for objects and arrays
+  int16_t last;
+  int16_t next;
+  union {
+    const char* text;
+    long long integer;
+    unsigned long long uinteger;
+    double real;
+    bool boolean;
+  };
+};
+
+class Pool {
+  Node* nodes;
+  int capacity;
+  int used;
+
+public:
+  Pool(Node* storage, int size) : nodes(storage), capacity(size), used(0) {}
+
+  Node* at(int index) { return index >= 0 ? &nodes[index] : nullptr; }
+
+  int allocate(const char* key, NodeType type) {
+    if (used >= capacity) return -1;
+    Node& node = nodes[used];
+    node.key = key;
+    node.type = type;
+    node.first = node.last = node.next = -1;
+    node.uinteger = 0;
+    return used++;
+  }
+
+  int append(int parent, const char* key, NodeType type) {
+    int index = allocate(key, type);
+    if (index < 0) return -1;
+    Node& owner = nodes[parent];
+    if (owner.last >= 0) nodes[owner.last].next = index;
+    else owner.first = index;
+    owner.last = index;
+    return index;
+  }
+
+  int member(int parent, const char* key) {
+    for (int i = nodes[parent].first; i >= 0; i = nodes[i].next) {
+      if (nodes[i].key != nullptr && strcmp(nodes[i].key, key) == 0) return i;
+    }
+    return append(parent, key, NODE_NULL);
+  }
+};
+
+inline void setValue(Node& node, const char* text) {
+  node.type = text != nullptr ? NODE_STRING : NODE_NULL;
+  node.text = text;
+}
+
+inline void setValue(Node& node, bool value) {
+  node.type = NODE_BOOL;
+  node.boolean = value;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+setValue(Node& node, T value) {
+  if (std::is_signed<T>::value || std::is_enum<T>::value) {
+    node.type = NODE_INT;
+    node.integer = (long long)value;
+  } else {
+    node.type = NODE_UINT;
+    node.uinteger = (unsigned long long)value;
+  }
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+setValue(Node& node, T value) {
+  node.type = NODE_FLOAT;
+  node.real = value;
+}
+
+class Writer {
+  char* out;
+  size_t capacity;
+  size_t length;
+
+public:
+  Writer(char* buffer, size_t size) : out(buffer), capacity(size), length(0) {}
+
+  void put(char c) {
+    if (length + 1 < capacity) out[length++] = c;
+  }
+
+  void put(const char* text) {
+    while (*text != '\0') put(*text++);
+  }
+
+  void string(const char* text) {
+    put('"');
+    for (; *text != '\0'; text++) {
+      switch (*text) {
+        case '"': put("\\\""); break;
+        case '\\': put("\\\\"); break;
+        case '\n': put("\\n"); break;
+        case '\r': put("\\r"); break;
+        case '\t': put("\\t"); break;
+        case '\b': put("\\b"); break;
+        case '\f': put("\\f"); break;
+        default: put(*text); break;
+      }
+    }
+    put('"');
+  }
+
+  size_t finish() {
+    if (capacity > 0) out[length] = '\0';
+    return length;
+  }
+};
+
+inline void write(Pool& pool, Writer& writer, int index) {
+  Node& node = *pool.at(index);
+  char number[32];
+  switch (node.type) {
+    case NODE_OBJECT:
+    case NODE_ARRAY: {
+      bool object = node.type == NODE_OBJECT;
+      writer.put(object ? '{' : '[');
+      for (int child = node.first; child >= 0; child = pool.at(child)->next) {
+        if (child != node.first) writer.put(',');
+        if (object) {
+          writer.string(pool.at(child)->key);
+          writer.put(':');
+        }
+        write(pool, writer, child);
+      }
+      writer.put(object ? '}' : ']');
+      break;
+    }
+    case NODE_STRING:
+      writer.string(node.text);
+      break;
+    case NODE_INT:
+      snprintf(number, sizeof(number), "%lld", node.integer);
+      writer.put(number);
+      break;
+    case NODE_UINT:
+      snprintf(number, sizeof(number), "%llu", node.uinteger);
+      writer.put(number);
+      break;
+    case NODE_FLOAT:
+      if (!isfinite(node.real)) {
+        writer.put("null");
+      } else {
+        snprintf(number, sizeof(number), "%.9g", node.real);
+        writer.put(number);
+      }
+      break;
+    case NODE_BOOL:
+      writer.put(node.boolean ? "true" : "false");
+      break;
+    default:
+      writer.put("null");
+      break;
+  }
+}
+
+}  // namespace host_json
+
+class JsonArray;
+class JsonObject;
+
+// doc["key"] or object["key"]: created on assignment
+class JsonMemberProxy {
+  host_json::Pool* pool;
+  int parent;
+  const char* key;
+
+public:
+  JsonMemberProxy(host_json::Pool* owner, int index, const char* name)
+    : pool(owner), parent(index), key(name) {}
+
+  template <typename T>
+  JsonMemberProxy& operator=(T value) {
+    if (parent < 0) return *this;
+    int index = pool->member(parent, key);
+    if (index >= 0) host_json::setValue(*pool->at(index), value);
+    return *this;
+  }
+};
+
+class JsonArray {
+  host_json::Pool* pool;
+  int index;
+
+public:
+  JsonArray() : pool(nullptr), index(-1) {}
+  JsonArray(host_json::Pool* owner, int node) : pool(owner), index(node) {}
+
+  bool isNull() const { return index < 0; }
+
+  template <typename T>
+  bool add(T value) {
+    if (index < 0) return false;
+    int child = pool->append(index, nullptr, host_json::NODE_NULL);
+    if (child < 0) return false;
+    host_json::setValue(*pool->at(child), value);
+    return true;
+  }
+
+  JsonArray createNestedArray() {
+    if (index < 0) return JsonArray();
+    return JsonArray(pool, pool->append(index, nullptr, host_json::NODE_ARRAY));
+  }
+};
+
+class JsonObject {
+  host_json::Pool* pool;
+  int index;
+
+public:
+  JsonObject() : pool(nullptr), index(-1) {}
+  JsonObject(host_json::Pool* owner, int node) : pool(owner), index(node) {}
+
+  bool isNull() const { return index < 0; }
+
+  JsonMemberProxy operator[](const char* key) {
+    return JsonMemberProxy(pool, index, key);
+  }
+
+  JsonArray createNestedArray(const char* key) {
+    if (index < 0) return JsonArray();
+    return JsonArray(pool, pool->append(index, key, host_json::NODE_ARRAY));
+  }
+
+  JsonObject createNestedObject(const char* key) {
+    if (index < 0) return JsonObject();
+    return JsonObject(pool, pool->append(index, key, host_json::NODE_OBJECT));
+  }
+};
+
+class JsonDocument {
+protected:
+  host_json::Pool pool;
+
+  JsonDocument(host_json::Node* storage, int size) : pool(storage, size) {
+    pool.allocate(nullptr, host_json::NODE_OBJECT);
+  }
+
+public:
+  JsonDocument(const JsonDocument&) = delete;
+  JsonDocument& operator=(const JsonDocument&) = delete;
+
+  JsonMemberProxy operator[](const char* key) {
+    return JsonMemberProxy(&pool, 0, key);
+  }
+
+  JsonArray createNestedArray(const char* key) {
+    return JsonObject(&pool, 0).createNestedArray(key);
+  }
+
+  JsonObject createNestedObject(const char* key) {
+    return JsonObject(&pool, 0).createNestedObject(key);
+  }
+
+  size_t serialize(char* output, size_t size) {
+    host_json::Writer writer(output, size);
+    host_json::write(pool, writer, 0);
+    return writer.finish();
+  }
+};
+
+template <size_t Capacity>
+class StaticJsonDocument : public JsonDocument {
+  // One slot for the root, as the library counts it outside the capacity
+  host_json::Node nodes[Capacity / 16 + 1];
+
+public:
+  StaticJsonDocument() : JsonDocument(nodes, Capacity / 16 + 1) {}
+};
+
+inline size_t serializeJson(JsonDocument& doc, char* output, size_t size) {
+  return doc.serialize(output, size);
+}
+
+#endif // HOST_ARDUINOJSON_H
@@ -0,0 +1,17 @@
+#ifndef HOST_MPU6050_H
+#define HOST_MPU6050_H
+
+#include <stdint.h>
+
+// Reads come from the simulated hardware (host_hw.h)
+class MPU6050 {
+public:
+  void initialize() {}
+  bool testConnection();
+  void getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz);
+  void getRotation(int16_t* gx, int16_t* gy, int16_t* gz);
+  void getAcceleration(int16_t* ax, int16_t* ay, int16_t* az);
+  int16_t getTemperature();
+};
+
+#endif // HOST_MPU6050_H
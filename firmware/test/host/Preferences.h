@@ -0,0 +1,38 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// NVS in memory, for the life of the process. host::clearPreferences()
+// wipes it between tests.
+class Preferences {
+private:
+  const char* space;
+  bool readOnly;
+
+  size_t put(const char* key, const void* value, size_t length);
+  bool get(const char* key, void* value, size_t length);
+
+public:
+  Preferences() : space(nullptr), readOnly(true) {}
+
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+  bool isKey(const char* key);
+  bool remove(const char* key);
+
+  size_t putInt(const char* key, int32_t value) { return put(key, &value, sizeof(value)); }
+  size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+  size_t putShort(const char* key, int16_t value) { return put(key, &value, sizeof(value)); }
+  size_t putFloat(const char* key, float value) { return put(key, &value, sizeof(value)); }
+  size_t putBool(const char* key, bool value) { return put(key, &value, sizeof(value)); }
+
+  int32_t getInt(const char* key, int32_t fallback = 0) { get(key, &fallback, sizeof(fallback)); return fallback; }
+  uint32_t getUInt(const char* key, uint32_t fallback = 0) { get(key, &fallback, sizeof(fallback)); return fallback; }
+  int16_t getShort(const char* key, int16_t fallback = 0) { get(key, &fallback, sizeof(fallback)); return fallback; }
+  float getFloat(const char* key, float fallback = 0) { get(key, &fallback, sizeof(fallback)); return fallback; }
+  bool getBool(const char* key, bool fallback = false) { get(key, &fallback, sizeof(fallback)); return fallback; }
+};
+
+#endif // HOST_PREFERENCES_H
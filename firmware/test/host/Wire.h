@@ -0,0 +1,15 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <stdint.h>
+
+// The IMU fake doesn't go through I2C
+class TwoWire {
+public:
+  bool begin(int sda, int scl) { return true; }
+  void setClock(uint32_t frequency) {}
+};
+
+extern TwoWire Wire;
+
+#endif // HOST_WIRE_H
@@ -0,0 +1,11 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+#include <stdint.h>
+
+// Types only: firmware updates aren't part of the host build
+typedef int esp_err_t;
+typedef uint32_t esp_ota_handle_t;
+typedef struct esp_partition esp_partition_t;
+
+#endif // HOST_ESP_OTA_OPS_H
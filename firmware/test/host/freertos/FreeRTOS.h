@@ -0,0 +1,54 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// FreeRTOS on the host: tasks are threads, queues, semaphores and event
+// groups are built on a mutex and a condition variable (host.cpp). Ticks
+// are milliseconds. Only what the firmware calls is here.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef uint32_t StackType_t;
+
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostQueue* QueueHandle_t;
+typedef struct HostQueue* SemaphoreHandle_t;
+typedef struct HostEventGroup* EventGroupHandle_t;
+
+typedef void (*TaskFunction_t)(void*);
+
+// The static variants are accepted; the host allocates anyway
+typedef struct { uint8_t unused; } StaticTask_t;
+typedef struct { uint8_t unused; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct { uint8_t unused; } StaticEventGroup_t;
+
+// Every critical section takes one process-wide recursive lock
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void hostEnterCritical();
+void hostExitCritical();
+#define portENTER_CRITICAL(mux) hostEnterCritical()
+#define portEXIT_CRITICAL(mux) hostExitCritical()
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical()
+#define portEXIT_CRITICAL_ISR(mux) hostExitCritical()
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7fffffff
+#define portNUM_PROCESSORS 2
+
+BaseType_t xPortGetCoreID();
+
+#endif // HOST_FREERTOS_H
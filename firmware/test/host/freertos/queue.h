@@ -0,0 +1,19 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage,
+                                 StaticQueue_t* queue);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t timeout);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t timeout);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t timeout);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#endif // HOST_FREERTOS_QUEUE_H
@@ -0,0 +1,16 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "queue.h"
+
+// As in FreeRTOS, a semaphore is a queue of empty items
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* mutex);
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* semaphore);
+
+#define xSemaphoreTake(semaphore, timeout) xQueueReceive((semaphore), nullptr, (timeout))
+#define xSemaphoreGive(semaphore) xQueueSend((semaphore), nullptr, 0)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+
+#endif // HOST_FREERTOS_SEMPHR_H
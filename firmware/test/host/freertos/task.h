@@ -0,0 +1,24 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackBytes,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name,
+                                           uint32_t stackBytes, void* parameter,
+                                           UBaseType_t priority, StackType_t* stack,
+                                           StaticTask_t* tcb, BaseType_t core);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previous, TickType_t increment);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char* pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout);
+
+#endif // HOST_FREERTOS_TASK_H
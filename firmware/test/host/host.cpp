@@ -0,0 +1,652 @@
+// The Arduino core and FreeRTOS calls the firmware makes, on the host.
+//
+// Nothing here allocates after the object it works on was created, so the
+// heap guard sees the firmware's own allocations only.
+
+#include <Arduino.h>
+#include <MPU6050.h>
+#include <Preferences.h>
+#include <Wire.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include "host_hw.h"
+#include "config.h"
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+
+// ---------------------------------------------------------------------------
+// Time and simulated hardware
+
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+static std::atomic<bool> simulatedTime(false);
+static std::atomic<uint64_t> simulatedUs(0);
+static std::atomic<bool> consoleOutput(true);
+static host::Hardware defaultHardware;
+static host::Hardware* volatile hardware = &defaultHardware;
+static uint32_t cpuMhz = 240;
+
+struct Wheel {
+  uint8_t stepPin;
+  uint8_t dirPin;
+  bool forward;
+  bool stepHigh;
+  double slip;                  // share of the steps lost
+  double lost;                  // slip owed, in steps
+};
+static Wheel wheels[2] = {
+  {LEFT_STEP_PIN, LEFT_DIR_PIN, true, false, 0, 0},
+  {RIGHT_STEP_PIN, RIGHT_DIR_PIN, true, false, 0, 0},
+};
+static host::WheelPose wheelPose = {0, 0, 0};
+static double gyroHeading = 0;      // wheelPose.heading at the last gyro read
+static uint64_t gyroUs = 0;
+
+static uint64_t nowUs() {
+  if (simulatedTime) return simulatedUs.fetch_add(1) + 1;
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - processStart).count();
+}
+
+static void spend(uint64_t us) {
+  if (simulatedTime) {
+    simulatedUs += us;
+  } else if (us > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+namespace host {
+
+void setHardware(Hardware* replacement) {
+  hardware = replacement != nullptr ? replacement : &defaultHardware;
+}
+
+void setSimulatedTime(bool simulated) {
+  if (simulated && !simulatedTime) {
+    simulatedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - processStart).count();
+  }
+  simulatedTime = simulated;
+}
+
+bool isSimulatedTime() {
+  return simulatedTime;
+}
+
+void advanceMicros(uint64_t us) {
+  simulatedUs += us;
+}
+
+void setConsoleOutput(bool enabled) {
+  consoleOutput = enabled;
+}
+
+void resetWheels() {
+  ::wheelPose = {0, 0, 0};
+  gyroHeading = 0;
+  gyroUs = nowUs();
+  for (Wheel& wheel : wheels) wheel.lost = 0;
+}
+
+void setWheelSlip(double left, double right) {
+  wheels[0].slip = left;
+  wheels[1].slip = right;
+}
+
+WheelPose wheelPose() {
+  return ::wheelPose;
+}
+
+int16_t wheelYawRate() {
+  uint64_t now = nowUs();
+  double seconds = (now - gyroUs) / 1000000.0;
+  double degrees = ::wheelPose.heading - gyroHeading;
+  gyroHeading = ::wheelPose.heading;
+  gyroUs = now;
+  if (seconds <= 0) return 0;
+  double raw = degrees / seconds * 131.0;     // +-250 deg/s range
+  return (int16_t)fmax(-32768.0, fmin(32767.0, round(raw)));
+}
+
+}  // namespace host
+
+unsigned long millis() {
+  return (unsigned long)(nowUs() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)nowUs();
+}
+
+void delay(unsigned long ms) {
+  spend((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  spend(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+// One wheel's step swings the robot about the other wheel: half the step
+// forward along the mean heading, and a turn of step / track
+static void stepWheel(int side) {
+  Wheel& wheel = wheels[side];
+  wheel.lost += wheel.slip;
+  if (wheel.lost >= 1.0) {
+    wheel.lost -= 1.0;
+    return;
+  }
+  double cm = PI * WHEEL_DIAMETER / STEPS_PER_REV / 10.0;
+  if (!wheel.forward) cm = -cm;
+  double turn = (side == 0 ? cm : -cm) / (ROBOT_WIDTH / 10.0) * 180.0 / PI;
+  double rad = (wheelPose.heading + turn / 2.0) * PI / 180.0;
+  wheelPose.x += cm / 2.0 * cos(rad);
+  wheelPose.y += cm / 2.0 * sin(rad);
+  wheelPose.heading += turn;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  for (int side = 0; side < 2; side++) {
+    Wheel& wheel = wheels[side];
+    if (pin == wheel.dirPin) wheel.forward = value == HIGH;
+    if (pin == wheel.stepPin) {
+      if (value == HIGH && !wheel.stepHigh) stepWheel(side);
+      wheel.stepHigh = value == HIGH;
+    }
+  }
+  hardware->pinWrite(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  return LOW;
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeoutUs) {
+  unsigned long width = hardware->echo(pin, timeoutUs);
+  if (width > timeoutUs) width = 0;
+  spend(width != 0 ? width : timeoutUs);
+  return width;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  return (uint16_t)(hardware->milliVolts(pin) * 4095 / 3300);
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin) {
+  return hardware->milliVolts(pin);
+}
+
+// Fixed seed: a simulation runs the same every time
+static std::mutex randomMutex;
+static uint32_t randomState = 12345;
+
+long random(long howBig) {
+  if (howBig <= 0) return 0;
+  std::lock_guard<std::mutex> lock(randomMutex);
+  randomState = randomState * 1103515245u + 12345u;
+  return (long)((randomState >> 1) % (unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig) {
+  if (howSmall >= howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed) {
+  std::lock_guard<std::mutex> lock(randomMutex);
+  randomState = (uint32_t)seed;
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(nowUs() * cpuMhz);
+}
+
+uint32_t EspClass::getFreeHeap() { return 200000; }
+uint32_t EspClass::getMinFreeHeap() { return 200000; }
+uint32_t EspClass::getMaxAllocHeap() { return 110000; }
+const char* EspClass::getChipModel() { return "host"; }
+uint32_t EspClass::getCpuFreqMHz() { return cpuMhz; }
+uint32_t EspClass::getFlashChipSize() { return 4 * 1024 * 1024; }
+void EspClass::restart() { exit(0); }
+
+uint32_t getCpuFrequencyMhz() {
+  return cpuMhz;
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+  cpuMhz = mhz;
+  return true;
+}
+
+void heap_caps_get_info(multi_heap_info_t* info, uint32_t caps) {
+  memset(info, 0, sizeof(*info));
+}
+
+// ---------------------------------------------------------------------------
+// Serial
+
+size_t HardwareSerial::write(uint8_t value) {
+  if (consoleOutput) fputc(value, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length) {
+  if (consoleOutput) fwrite(data, 1, length, stdout);
+  return length;
+}
+
+size_t HardwareSerial::print(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t HardwareSerial::println(const char* text) {
+  size_t length = print(text);
+  return length + write('\n');
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int length = consoleOutput ? vprintf(format, args) : vsnprintf(nullptr, 0, format, args);
+  va_end(args);
+  return length > 0 ? length : 0;
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+// ---------------------------------------------------------------------------
+// IMU
+
+bool MPU6050::testConnection() {
+  return hardware->imuConnected();
+}
+
+void MPU6050::getMotion6(int16_t* ax, int16_t* ay, int16_t* az, int16_t* gx, int16_t* gy, int16_t* gz) {
+  int16_t raw[6];
+  hardware->motion(raw);
+  *ax = raw[0]; *ay = raw[1]; *az = raw[2];
+  *gx = raw[3]; *gy = raw[4]; *gz = raw[5];
+}
+
+void MPU6050::getRotation(int16_t* gx, int16_t* gy, int16_t* gz) {
+  int16_t raw[6];
+  hardware->motion(raw);
+  *gx = raw[3]; *gy = raw[4]; *gz = raw[5];
+}
+
+void MPU6050::getAcceleration(int16_t* ax, int16_t* ay, int16_t* az) {
+  int16_t raw[6];
+  hardware->motion(raw);
+  *ax = raw[0]; *ay = raw[1]; *az = raw[2];
+}
+
+int16_t MPU6050::getTemperature() {
+  return hardware->temperature();
+}
+
+// ---------------------------------------------------------------------------
+// NVS
+
+static std::mutex preferencesMutex;
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> preferenceStore;
+
+namespace host {
+
+void clearPreferences() {
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  preferenceStore.clear();
+}
+
+}  // namespace host
+
+bool Preferences::begin(const char* name, bool readOnlyMode) {
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  // As NVS: read-only fails for a namespace never written
+  if (readOnlyMode && preferenceStore.find(name) == preferenceStore.end()) return false;
+  preferenceStore[name];
+  space = name;
+  readOnly = readOnlyMode;
+  return true;
+}
+
+void Preferences::end() {
+  space = nullptr;
+}
+
+bool Preferences::isKey(const char* key) {
+  if (space == nullptr) return false;
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  const auto& keys = preferenceStore[space];
+  return keys.find(key) != keys.end();
+}
+
+bool Preferences::remove(const char* key) {
+  if (space == nullptr || readOnly) return false;
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  return preferenceStore[space].erase(key) > 0;
+}
+
+size_t Preferences::put(const char* key, const void* value, size_t length) {
+  if (space == nullptr || readOnly) return 0;
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  const uint8_t* bytes = (const uint8_t*)value;
+  preferenceStore[space][key].assign(bytes, bytes + length);
+  return length;
+}
+
+bool Preferences::get(const char* key, void* value, size_t length) {
+  if (space == nullptr) return false;
+  std::lock_guard<std::mutex> lock(preferencesMutex);
+  const auto& keys = preferenceStore[space];
+  auto entry = keys.find(key);
+  if (entry == keys.end() || entry->second.size() != length) return false;
+  memcpy(value, entry->second.data(), length);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// FreeRTOS
+
+static std::recursive_mutex criticalMutex;
+
+void hostEnterCritical() {
+  criticalMutex.lock();
+}
+
+void hostExitCritical() {
+  criticalMutex.unlock();
+}
+
+// Waits on condition for up to timeout ticks. With simulated time a wait
+// that would time out moves the clock on instead.
+template <typename Predicate>
+static bool waitFor(std::unique_lock<std::mutex>& lock, std::condition_variable& condition,
+                    TickType_t timeout, Predicate ready) {
+  if (ready()) return true;
+  if (timeout == 0) return false;
+  if (timeout == portMAX_DELAY) {
+    condition.wait(lock, ready);
+    return true;
+  }
+  if (simulatedTime) {
+    spend((uint64_t)timeout * 1000);
+    return ready();
+  }
+  return condition.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+}
+
+struct HostTask {
+  char name[16];
+  int core;
+  std::mutex mutex;
+  std::condition_variable condition;
+  uint32_t notifications;
+
+  HostTask(const char* taskName, int taskCore) : core(taskCore), notifications(0) {
+    strncpy(name, taskName, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+  }
+};
+
+static thread_local HostTask* currentTask = nullptr;
+
+static HostTask* self() {
+  // Threads the firmware didn't create (main, test threads) are tasks too
+  static thread_local HostTask unnamed("host", 0);
+  return currentTask != nullptr ? currentTask : &unnamed;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackBytes,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+  HostTask* task = new HostTask(name, core == tskNO_AFFINITY ? 0 : core);
+  std::thread([task, function, parameter]() {
+    currentTask = task;
+    function(parameter);
+  }).detach();
+  if (handle != nullptr) *handle = task;
+  return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name,
+                                           uint32_t stackBytes, void* parameter,
+                                           UBaseType_t priority, StackType_t* stack,
+                                           StaticTask_t* tcb, BaseType_t core) {
+  TaskHandle_t handle = nullptr;
+  xTaskCreatePinnedToCore(function, name, stackBytes, parameter, priority, &handle, core);
+  return handle;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) {
+    std::this_thread::yield();
+    return;
+  }
+  spend((uint64_t)ticks * 1000);
+}
+
+void vTaskDelayUntil(TickType_t* previous, TickType_t increment) {
+  *previous += increment;
+  long remaining = (long)(*previous - xTaskGetTickCount());
+  if (remaining > 0) vTaskDelay(remaining);
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return self();
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+  return (task != nullptr ? task : self())->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 0;
+}
+
+BaseType_t xPortGetCoreID() {
+  return self()->core;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->notifications++;
+  task->condition.notify_all();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout) {
+  HostTask* task = self();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (!waitFor(lock, task->condition, timeout, [task]() { return task->notifications > 0; })) {
+    return 0;
+  }
+  uint32_t count = task->notifications;
+  task->notifications = clearOnExit ? 0 : count - 1;
+  return count;
+}
+
+struct HostQueue {
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::vector<uint8_t> storage;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  UBaseType_t head;       // oldest item
+  UBaseType_t count;
+
+  HostQueue(UBaseType_t queueLength, UBaseType_t size)
+    : storage(queueLength * size), length(queueLength), itemSize(size), head(0), count(0) {}
+
+  uint8_t* slot(UBaseType_t index) {
+    return storage.data() + (index % length) * itemSize;
+  }
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  if (length == 0) return nullptr;
+  return new HostQueue(length, itemSize);
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage,
+                                 StaticQueue_t* queue) {
+  return xQueueCreate(length, itemSize);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t timeout, bool front) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(lock, queue->condition, timeout, [queue]() { return queue->count < queue->length; })) {
+    return pdFALSE;
+  }
+  UBaseType_t index;
+  if (front) {
+    queue->head = (queue->head + queue->length - 1) % queue->length;
+    index = queue->head;
+  } else {
+    index = queue->head + queue->count;
+  }
+  if (queue->itemSize > 0) memcpy(queue->slot(index), item, queue->itemSize);
+  queue->count++;
+  queue->condition.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t timeout) {
+  return queueSend(queue, item, timeout, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t timeout) {
+  return queueSend(queue, item, timeout, true);
+}
+
+static BaseType_t queueReceive(QueueHandle_t queue, void* item, TickType_t timeout, bool remove) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(lock, queue->condition, timeout, [queue]() { return queue->count > 0; })) {
+    return pdFALSE;
+  }
+  if (queue->itemSize > 0) memcpy(item, queue->slot(queue->head), queue->itemSize);
+  if (remove) {
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->condition.notify_all();
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t timeout) {
+  return queueReceive(queue, item, timeout, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t timeout) {
+  return queueReceive(queue, item, timeout, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->head = 0;
+  queue->count = 0;
+  queue->condition.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  // Not recursive and without priority inheritance; the firmware never
+  // takes a mutex it holds
+  SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+  xQueueSend(mutex, nullptr, 0);
+  return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* mutex) {
+  return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* semaphore) {
+  return xSemaphoreCreateBinary();
+}
+
+struct HostEventGroup {
+  std::mutex mutex;
+  std::condition_variable condition;
+  EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate() {
+  return new HostEventGroup();
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* group) {
+  return xEventGroupCreate();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+  std::lock_guard<std::mutex> lock(group->mutex);
+  group->bits |= bits;
+  group->condition.notify_all();
+  return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+  std::lock_guard<std::mutex> lock(group->mutex);
+  EventBits_t before = group->bits;
+  group->bits &= ~bits;
+  return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+  std::lock_guard<std::mutex> lock(group->mutex);
+  return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t timeout) {
+  std::unique_lock<std::mutex> lock(group->mutex);
+  auto ready = [group, bits, waitForAll]() {
+    return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+  };
+  bool met = waitFor(lock, group->condition, timeout, ready);
+  EventBits_t result = group->bits;
+  if (met && clearOnExit) group->bits &= ~bits;
+  return result;
+}
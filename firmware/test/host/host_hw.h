@@ -0,0 +1,68 @@
+#ifndef HOST_HW_H
+#define HOST_HW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What a host test controls in place of the robot's hardware.
+namespace host {
+
+// Pins, the echo timer and the IMU. The default has nothing connected:
+// no echo, a still IMU at 25 C, a full battery.
+class Hardware {
+public:
+  virtual ~Hardware() {}
+
+  virtual void pinWrite(uint8_t pin, uint8_t value) {}
+
+  // Echo pulse width in us on an ultrasonic echo pin, 0 for none.
+  // pulseIn() takes this long (or the whole timeout for none).
+  virtual unsigned long echo(uint8_t pin, unsigned long timeoutUs) { return 0; }
+
+  // ax, ay, az, gx, gy, gz in raw MPU6050 units
+  virtual void motion(int16_t raw[6]) {
+    for (int i = 0; i < 6; i++) raw[i] = 0;
+  }
+  virtual int16_t temperature() { return (int16_t)((25.0 - 36.53) * 340.0); }
+  virtual bool imuConnected() { return true; }
+
+  virtual uint32_t milliVolts(uint8_t pin) { return 2100; }
+};
+
+// nullptr puts the default back
+void setHardware(Hardware* hardware);
+
+// Simulated time: delays, pulseIn() and waits that time out advance the
+// clock instead of sleeping, and every micros() call costs a microsecond
+// so busy-wait loops end. For single-threaded simulations; tests with
+// several tasks run on the process clock.
+void setSimulatedTime(bool simulated);
+bool isSimulatedTime();
+void advanceMicros(uint64_t us);
+
+// The wheels: each STEP pulse turns its wheel one step the way its DIR pin
+// says, and the robot moves as those wheels would take it over the floor.
+// Slip loses that share of a wheel's steps (evenly spread), which the
+// firmware's odometry can't see but the gyro can. The pose is in odometry
+// units: cm, and degrees clockwise from +x. For single-threaded
+// simulations; nothing slips by default.
+struct WheelPose {
+  double x, y, heading;
+};
+void resetWheels();                             // pose back to 0
+void setWheelSlip(double left, double right);   // 0..1 of the steps lost
+WheelPose wheelPose();
+
+// The gyro z reading (raw MPU6050 units) for the wheels' turn since the
+// last call or reset; for a Hardware::motion() that follows the wheels
+int16_t wheelYawRate();
+
+// Serial output on stdout (on by default)
+void setConsoleOutput(bool enabled);
+
+// Wipes the in-memory NVS
+void clearPreferences();
+
+}  // namespace host
+
+#endif // HOST_HW_H
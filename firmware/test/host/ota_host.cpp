@@ -0,0 +1,24 @@
+// Firmware updates need flash and mbedtls; on the host there is never one
+// in progress.
+
+#include "ota_update.h"
+
+OtaUpdater otaUpdater(nullptr);
+
+OtaUpdater::OtaUpdater(OtaBackend* storage)
+  : backend(storage),
+    packetQueue(nullptr),
+    replySink(nullptr),
+    active(false) {
+}
+
+bool OtaUpdater::isActive() const {
+  return active;
+}
+
+int OtaUpdater::getQueueDepth() const {
+  return 0;
+}
+
+void OtaUpdater::printStatus() {
+}
@@ -0,0 +1,95 @@
+#ifndef LOOPBACK_CLIENT_H
+#define LOOPBACK_CLIENT_H
+
+// The client end of a LoopbackTransport for host tests: sends commands,
+// reads the robot's acks and telemetry back, and can stand in for the
+// motor task.
+
+#include <string>
+#include <vector>
+#include "link_manager.h"
+#include "loopback_transport.h"
+#include "motor_control.h"
+#include "task_events.h"
+#include "protocol.h"
+
+struct Ack {
+  AckEvent event;
+  char type;
+  uint16_t seq;
+  uint32_t receivedAt;
+  uint32_t time;
+  uint8_t credits;
+};
+
+inline Ack decodeAck(const uint8_t* data) {
+  Ack ack;
+  ack.event = (AckEvent)data[2];
+  ack.type = (char)data[3];
+  ack.seq = readU16(data + 4);
+  ack.receivedAt = (uint32_t)readI32(data + 6);
+  ack.time = (uint32_t)readI32(data + 10);
+  ack.credits = data[14];
+  return ack;
+}
+
+// linkManager and the task events come up once per process, as in setup()
+inline void startLinks() {
+  static bool started = false;
+  if (started) return;
+  started = true;
+  taskEvents.begin();
+  linkManager.begin();
+}
+
+// Empties both command queues, as the motor task would
+inline void drainCommands() {
+  while (linkManager.hasCommand()) {
+    linkManager.getNextCommand();
+  }
+  motorController.clearStop();
+}
+
+class LoopbackClient {
+public:
+  LoopbackTransport link;
+  std::vector<Ack> acks;
+  std::vector<std::string> telemetry;     // JSON text or packed bytes
+
+  // Registers the link with linkManager; once per client per process
+  void connect() {
+    startLinks();
+    link.begin();
+    linkManager.addTransport(&link);
+  }
+
+  // Move everything the robot sent into acks and telemetry
+  void poll() {
+    LoopbackTransport::MessageKind kind;
+    uint8_t message[LOOPBACK_BUFFER_SIZE];
+    size_t length;
+    while ((length = link.receive(kind, message, sizeof(message))) > 0) {
+      if (kind == LoopbackTransport::LOOPBACK_ACK && length == ACK_SIZE) {
+        acks.push_back(decodeAck(message));
+      } else {
+        telemetry.push_back(std::string((const char*)message, length));
+      }
+    }
+  }
+
+  void clear() {
+    poll();
+    acks.clear();
+    telemetry.clear();
+  }
+
+  void sendFrame(uint8_t opcode, uint16_t seq, int32_t param,
+                 const uint8_t* payload = nullptr, uint8_t payloadLength = 0) {
+    Frame frame = {opcode, seq, param, payloadLength, payload};
+    uint8_t out[FRAME_MAX_SIZE];
+    size_t length = encodeFrame(frame, out, sizeof(out));
+    link.sendFrame(out, length);
+  }
+};
+
+#endif // LOOPBACK_CLIENT_H
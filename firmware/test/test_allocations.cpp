@@ -0,0 +1,140 @@
+// The command path allocates nothing once boot is over. The firmware's
+// own operator new (HEAP_GUARD, heap_monitor.cpp) is the instrumented
+// allocator: after heapMonitor.seal() it counts every C++ allocation.
+
+#include <string>
+#include "check.h"
+#include "heap_monitor.h"
+#include "loopback_client.h"
+#include "host_hw.h"
+#include "navigation.h"
+
+static LoopbackClient client;
+
+// Everything the robot sent, read into a fixed buffer (the client's own
+// vectors would allocate)
+static int drainOutput() {
+  LoopbackTransport::MessageKind kind;
+  uint8_t message[LOOPBACK_BUFFER_SIZE];
+  int count = 0;
+  while (client.link.receive(kind, message, sizeof(message)) > 0) count++;
+  return count;
+}
+
+// Plays the motor task for whatever is queued
+static void runQueued() {
+  while (linkManager.hasCommand()) {
+    Command command = linkManager.getNextCommand();
+    linkManager.sendAck(ACK_STARTED, command);
+    linkManager.sendAck(ACK_COMPLETED, command);
+  }
+}
+
+static void reportLateAllocs(int before) {
+  for (int i = before; i < heapMonitor.getLateAllocCount(); i++) {
+    HeapMonitor::LateAlloc alloc;
+    if (!heapMonitor.getLateAlloc(i, alloc)) break;
+    printf("  allocation %d: %u bytes from %p (%s)\n", i, (unsigned)alloc.size,
+           alloc.caller, alloc.task);
+  }
+}
+
+static void setUp() {
+  static bool sealed = false;
+  if (!sealed) {
+    host::setConsoleOutput(false);
+    client.connect();
+    heapMonitor.seal();
+    sealed = true;
+  }
+  client.link.setOpen(true);
+  drainCommands();
+  drainOutput();
+}
+
+TEST_CASE(textCommandsAllocateNothing) {
+  setUp();
+  const char* commands[] = {
+    "F20", "B5", "L90", "R45", "WL20", "CORRIDOR", "AUTO_OFF", "MCL_OFF",
+    "HOLD_OFF", "CLOOP_OFF", "  F10 \r\n", "NOT_A_COMMAND", "STOP",
+    "SUB:distance=20,heading=100", "SUB_DEFAULT", "TLM_JSON",
+    "ROUTE:0,0;50,0;50,50", "WP:20,20", "ROUTE_CLEAR",
+    "BOOT", "DIAG", "PARAMS"
+  };
+
+  int before = heapMonitor.getLateAllocCount();
+  int replies = 0;
+  for (int round = 0; round < 50; round++) {
+    for (const char* command : commands) {
+      client.link.sendText(command);
+      runQueued();
+      replies += drainOutput();
+    }
+  }
+  CHECK_EQ(heapMonitor.getLateAllocCount() - before, 0);
+  CHECK(replies > 50 * 20);
+  reportLateAllocs(before);
+}
+
+TEST_CASE(framesAllocateNothing) {
+  setUp();
+  const uint8_t route[] = {0, 0, 0, 0, 50, 0, 0, 0, 50, 0, 50, 0};
+  uint8_t periods[TLM_CHANNEL_COUNT * 2] = {};
+  periods[0] = 20;
+
+  int before = heapMonitor.getLateAllocCount();
+  for (int round = 0; round < 200; round++) {
+    uint16_t seq = round * 8;
+    client.sendFrame(OP_FORWARD, seq, 20);
+    client.sendFrame(OP_LEFT, seq + 1, 90);
+    client.sendFrame(OP_STOP, seq + 2, 0);
+    client.sendFrame(OP_ROUTE, seq + 3, 0, route, sizeof(route));
+    client.sendFrame(OP_SUBSCRIBE, seq + 4, 0, periods, sizeof(periods));
+    client.sendFrame(OP_TELEMETRY, seq + 5, TELEMETRY_JSON);
+    client.sendFrame(0x7F, seq + 6, 0);                 // unknown: rejected
+    uint8_t corrupt[FRAME_MAX_SIZE];
+    Frame frame = {OP_FORWARD, (uint16_t)(seq + 7), 1, 0, nullptr};
+    size_t length = encodeFrame(frame, corrupt, sizeof(corrupt));
+    corrupt[length - 1] ^= 1;
+    client.link.sendFrame(corrupt, length);             // bad CRC: rejected
+    runQueued();
+    drainOutput();
+  }
+  navigator.clearRoute();
+  CHECK_EQ(heapMonitor.getLateAllocCount() - before, 0);
+  reportLateAllocs(before);
+}
+
+TEST_CASE(telemetryAllocatesNothing) {
+  setUp();
+  TelemetrySample sample = {};
+  sample.channels = 0xFF;
+  sample.distance = 42.5;
+
+  int before = heapMonitor.getLateAllocCount();
+  const TelemetryFormat formats[] = {TELEMETRY_JSON, TELEMETRY_BINARY, TELEMETRY_BINARY_DELTA};
+  for (TelemetryFormat format : formats) {
+    linkManager.setTelemetryFormat(format);
+    for (int i = 0; i < 500; i++) {
+      sample.timestamp = i * 20;
+      sample.heading = i % 360;
+      linkManager.publishTelemetry(sample);
+      drainOutput();
+    }
+    linkManager.flushTelemetry();
+    drainOutput();
+  }
+  linkManager.setTelemetryFormat(TELEMETRY_JSON);
+  CHECK_EQ(heapMonitor.getLateAllocCount() - before, 0);
+  reportLateAllocs(before);
+}
+
+// The check itself works: an allocation after seal() is counted
+TEST_CASE(guardCountsAllocations) {
+  setUp();
+  int before = heapMonitor.getLateAllocCount();
+  std::string* late = new std::string(100, 'x');
+  asm volatile("" : : "g"(late) : "memory");    // keep the pair from being elided
+  CHECK_EQ(heapMonitor.getLateAllocCount() - before, 2);
+  delete late;
+}
@@ -0,0 +1,372 @@
+// Conformance of the program VM: every opcode, the load-time checks and
+// the runtime faults.
+
+#include "check.h"
+#include "bytecode_vm.h"
+#include <limits.h>
+
+// Builds bytecode by hand; jump targets are byte offsets, as uploaded
+class Assembler {
+public:
+  uint8_t bytes[PROGRAM_MAX_SIZE];
+  size_t length = 0;
+
+  size_t here() const { return length; }
+
+  Assembler& op(uint8_t opcode) {
+    bytes[length++] = opcode;
+    return *this;
+  }
+  Assembler& u8(uint8_t value) {
+    bytes[length++] = value;
+    return *this;
+  }
+  Assembler& u16(uint16_t value) {
+    bytes[length++] = value & 0xFF;
+    bytes[length++] = value >> 8;
+    return *this;
+  }
+  Assembler& push(int32_t value) {
+    op(VM_PUSH);
+    uint32_t u = (uint32_t)value;
+    for (int i = 0; i < 4; i++) u8((u >> (8 * i)) & 0xFF);
+    return *this;
+  }
+  Assembler& var(uint8_t opcode, uint8_t index) { return op(opcode).u8(index); }
+  Assembler& jump(uint8_t opcode, uint16_t target) { return op(opcode).u16(target); }
+  Assembler& loop(uint8_t index, uint16_t target) { return op(VM_LOOP).u8(index).u16(target); }
+  Assembler& cmd(char type) { return op(VM_CMD).u8((uint8_t)type); }
+};
+
+struct Outcome {
+  VMResult result;
+  char type;
+  int32_t value;
+};
+
+static BytecodeVM vm;
+
+// Runs until the program produces something other than a yield
+static Outcome run(int32_t distance = 0) {
+  Outcome out = {VM_YIELD, 0, 0};
+  for (int i = 0; i < 1000 && out.result == VM_YIELD; i++) {
+    out.result = vm.run(PROGRAM_STEP_BUDGET, distance, out.type, out.value);
+  }
+  return out;
+}
+
+static bool load(const Assembler& program) {
+  return vm.load(program.bytes, program.length);
+}
+
+// Loads a program that must end with a command, and returns its value
+static int32_t valueOf(Assembler program) {
+  program.cmd('A');
+  if (!load(program)) return INT32_MIN + 1;
+  Outcome out = run();
+  if (out.result != VM_COMMAND || out.type != 'A') return INT32_MIN + 2;
+  return out.value;
+}
+
+TEST_CASE(emptyProgramHalts) {
+  REQUIRE(vm.load(nullptr, 0));
+  CHECK_EQ(vm.getInstructionCount(), 0);
+  CHECK_EQ(run().result, VM_HALTED);
+}
+
+TEST_CASE(haltStops) {
+  Assembler program;
+  program.op(VM_HALT).push(1).cmd('A');
+  REQUIRE(load(program));
+  CHECK_EQ(run().result, VM_HALTED);
+  CHECK_EQ(vm.getExecutedCount(), 1u);
+  CHECK_EQ(run().result, VM_HALTED);    // and stays halted
+}
+
+TEST_CASE(pushAndCmd) {
+  Assembler program;
+  program.push(-123456789).cmd('W');
+  REQUIRE(load(program));
+  Outcome out = run();
+  CHECK_EQ(out.result, VM_COMMAND);
+  CHECK_EQ(out.type, 'W');
+  CHECK_EQ(out.value, -123456789);
+  CHECK_EQ(run().result, VM_HALTED);    // runs off the end
+}
+
+TEST_CASE(loadAndStore) {
+  Assembler program;
+  program.push(5).var(VM_STORE, 7).var(VM_LOAD, 7).var(VM_LOAD, 7).op(VM_ADD);
+  CHECK_EQ(valueOf(program), 10);
+
+  Assembler unset;
+  unset.var(VM_LOAD, 3);
+  CHECK_EQ(valueOf(unset), 0);          // variables start at 0
+}
+
+TEST_CASE(dupAndPop) {
+  Assembler dup;
+  dup.push(4).op(VM_DUP).op(VM_MUL);
+  CHECK_EQ(valueOf(dup), 16);
+
+  Assembler pop;
+  pop.push(1).push(2).op(VM_POP);
+  CHECK_EQ(valueOf(pop), 1);
+}
+
+TEST_CASE(arithmeticTakesOperandsInOrder) {
+  Assembler add, sub, mul;
+  add.push(10).push(-3).op(VM_ADD);
+  sub.push(10).push(3).op(VM_SUB);
+  mul.push(-6).push(7).op(VM_MUL);
+  CHECK_EQ(valueOf(add), 7);
+  CHECK_EQ(valueOf(sub), 7);
+  CHECK_EQ(valueOf(mul), -42);
+}
+
+TEST_CASE(arithmeticWraps) {
+  Assembler add, sub, mul;
+  add.push(INT32_MAX).push(1).op(VM_ADD);
+  sub.push(INT32_MIN).push(1).op(VM_SUB);
+  mul.push(0x10000).push(0x10000).op(VM_MUL);
+  CHECK_EQ(valueOf(add), INT32_MIN);
+  CHECK_EQ(valueOf(sub), INT32_MAX);
+  CHECK_EQ(valueOf(mul), 0);
+}
+
+TEST_CASE(comparisons) {
+  struct Case { uint8_t op; int32_t a, b, expected; };
+  const Case cases[] = {
+    {VM_LT, 1, 2, 1}, {VM_LT, 2, 1, 0}, {VM_LT, 2, 2, 0}, {VM_LT, -5, 0, 1},
+    {VM_GT, 2, 1, 1}, {VM_GT, 1, 2, 0}, {VM_GT, 2, 2, 0}, {VM_GT, 0, -5, 1},
+    {VM_EQ, 3, 3, 1}, {VM_EQ, 3, 4, 0}, {VM_EQ, INT32_MIN, INT32_MIN, 1}
+  };
+  for (const Case& c : cases) {
+    Assembler program;
+    program.push(c.a).push(c.b).op(c.op);
+    CHECK_EQ(valueOf(program), c.expected);
+  }
+}
+
+TEST_CASE(jmpSkipsForward) {
+  Assembler program;
+  program.push(1);
+  program.jump(VM_JMP, program.here() + 3 + 5);     // over the next PUSH
+  program.push(2);
+  CHECK_EQ(valueOf(program), 1);
+}
+
+TEST_CASE(jzPopsAndJumpsOnZero) {
+  for (int32_t condition : {0, 1, -1}) {
+    Assembler program;
+    program.push(100).push(condition);
+    program.jump(VM_JZ, program.here() + 3 + 5 + 1 + 2);   // over PUSH, ADD, CMD
+    program.push(1).op(VM_ADD).cmd('A');
+    program.cmd('Z');
+    REQUIRE(load(program));
+    Outcome out = run();
+    REQUIRE_EQ(out.result, VM_COMMAND);
+    CHECK_EQ(out.type, condition == 0 ? 'Z' : 'A');
+    CHECK_EQ(out.value, condition == 0 ? 100 : 101);
+  }
+}
+
+// var 0 = count; do { var 1 += 1 } while (--var 0 > 0); result = var 1
+static Assembler countingLoop(int32_t count) {
+  Assembler program;
+  program.push(count).var(VM_STORE, 0);
+  uint16_t body = program.here();
+  program.var(VM_LOAD, 1).push(1).op(VM_ADD).var(VM_STORE, 1);
+  program.loop(0, body);
+  program.var(VM_LOAD, 1).cmd('A');
+  program.var(VM_LOAD, 0).cmd('A');
+  return program;
+}
+
+TEST_CASE(loopRunsItsCount) {
+  for (int32_t count : {1, 2, 10, 1000}) {
+    Assembler program = countingLoop(count);
+    REQUIRE(load(program));
+    Outcome out = run();
+    REQUIRE_EQ(out.result, VM_COMMAND);
+    CHECK_EQ(out.value, count);
+    CHECK_EQ(valueOf(program), count);
+  }
+}
+
+// A counter below 1 ends the loop after one pass and is left at 0; at
+// INT32_MIN the old decrement-first code overflowed
+TEST_CASE(loopCounterNeverGoesBelowZero) {
+  for (int32_t count : {0, -1, INT32_MIN, INT32_MIN + 1}) {
+    Assembler program = countingLoop(count);
+    REQUIRE(load(program));
+    Outcome body = run();
+    REQUIRE_EQ(body.result, VM_COMMAND);
+    CHECK_EQ(body.value, 1);
+    Outcome counter = run();
+    REQUIRE_EQ(counter.result, VM_COMMAND);
+    CHECK_EQ(counter.value, 0);
+  }
+}
+
+TEST_CASE(distPushesTheFrontDistance) {
+  Assembler program;
+  program.op(VM_DIST).cmd('A');
+  REQUIRE(load(program));
+  Outcome out = run(37);
+  CHECK_EQ(out.result, VM_COMMAND);
+  CHECK_EQ(out.value, 37);
+}
+
+TEST_CASE(moveAndTurnPickDirectionFromSign) {
+  struct Case { uint8_t op; int32_t value; char type; int32_t magnitude; };
+  const Case cases[] = {
+    {VM_MOVE, 30, 'F', 30}, {VM_MOVE, -30, 'B', 30}, {VM_MOVE, 0, 'F', 0},
+    {VM_TURN, 90, 'R', 90}, {VM_TURN, -90, 'L', 90}, {VM_TURN, 0, 'R', 0}
+  };
+  for (const Case& c : cases) {
+    Assembler program;
+    program.push(c.value).op(c.op);
+    REQUIRE(load(program));
+    Outcome out = run();
+    REQUIRE_EQ(out.result, VM_COMMAND);
+    CHECK_EQ(out.type, c.type);
+    CHECK_EQ(out.value, c.magnitude);
+  }
+}
+
+TEST_CASE(waitSleeps) {
+  Assembler program;
+  program.push(1500).op(VM_WAIT).push(2).op(VM_MOVE);
+  REQUIRE(load(program));
+  Outcome wait = run();
+  CHECK_EQ(wait.result, VM_SLEEP);
+  CHECK_EQ(wait.value, 1500);
+  Outcome move = run();                 // resumes after the wait
+  CHECK_EQ(move.result, VM_COMMAND);
+  CHECK_EQ(move.type, 'F');
+  CHECK_EQ(move.value, 2);
+}
+
+TEST_CASE(budgetBoundsEachRun) {
+  Assembler program;
+  program.jump(VM_JMP, 0);              // spins forever
+  REQUIRE(load(program));
+  char type;
+  int32_t value;
+  CHECK_EQ(vm.run(50, 0, type, value), VM_YIELD);
+  CHECK_EQ(vm.getExecutedCount(), 50u);
+  CHECK_EQ(vm.run(0, 0, type, value), VM_YIELD);
+  CHECK_EQ(vm.getExecutedCount(), 50u);
+}
+
+TEST_CASE(resetRestartsWithClearedState) {
+  Assembler program;
+  program.var(VM_LOAD, 2).push(1).op(VM_ADD).op(VM_DUP).var(VM_STORE, 2).cmd('A');
+  REQUIRE(load(program));
+  CHECK_EQ(run().value, 1);
+  vm.reset();
+  CHECK_EQ(vm.getProgramCounter(), 0);
+  CHECK_EQ(vm.getExecutedCount(), 0u);
+  CHECK_EQ(run().value, 1);             // not 2: variables were cleared
+}
+
+TEST_CASE(loadRejectsUnknownOpcodes) {
+  for (int opcode = VM_CMD + 1; opcode < 256; opcode++) {
+    Assembler program;
+    program.push(1).op((uint8_t)opcode);
+    CHECK(!load(program));
+    CHECK(vm.getError() != nullptr);
+  }
+}
+
+TEST_CASE(loadRejectsTruncatedInstructions) {
+  const uint8_t withOperands[] = {VM_PUSH, VM_LOAD, VM_STORE, VM_CMD, VM_JMP, VM_JZ, VM_LOOP};
+  for (uint8_t opcode : withOperands) {
+    Assembler program;
+    program.op(opcode);
+    CHECK(!load(program));
+
+    Assembler almost;
+    almost.op(opcode).u8(0);
+    if (opcode == VM_PUSH || opcode == VM_JMP || opcode == VM_JZ || opcode == VM_LOOP) {
+      CHECK(!load(almost));
+    }
+  }
+}
+
+TEST_CASE(loadRejectsBadVariables) {
+  for (uint8_t opcode : {(uint8_t)VM_LOAD, (uint8_t)VM_STORE}) {
+    Assembler ok, bad;
+    ok.var(opcode, VM_VARIABLES - 1);
+    bad.var(opcode, VM_VARIABLES);
+    CHECK(load(ok));
+    CHECK(!load(bad));
+  }
+  Assembler loop;
+  loop.loop(VM_VARIABLES, 0);
+  CHECK(!load(loop));
+}
+
+TEST_CASE(loadChecksJumpTargets) {
+  Assembler middle;
+  middle.push(1).jump(VM_JMP, 2);       // inside the PUSH operand
+  CHECK(!load(middle));
+
+  Assembler beyond;
+  beyond.push(1).jump(VM_JZ, 100);
+  CHECK(!load(beyond));
+
+  Assembler toEnd;
+  toEnd.jump(VM_JMP, 3);                // the end of the program: halts
+  REQUIRE(load(toEnd));
+  CHECK_EQ(run().result, VM_HALTED);
+}
+
+TEST_CASE(loadLimitsInstructionCount) {
+  Assembler full;
+  for (int i = 0; i < PROGRAM_MAX_INSTRUCTIONS; i++) full.op(VM_DIST);
+  CHECK(load(full));
+  full.op(VM_HALT);
+  CHECK(!load(full));
+  CHECK_EQ(vm.getInstructionCount(), 0);
+}
+
+TEST_CASE(emptyStackFaults) {
+  const uint8_t popping[] = {
+    VM_STORE, VM_DUP, VM_POP, VM_ADD, VM_SUB, VM_MUL, VM_LT, VM_GT, VM_EQ,
+    VM_JZ, VM_MOVE, VM_TURN, VM_WAIT, VM_CMD
+  };
+  for (uint8_t opcode : popping) {
+    Assembler program;
+    program.op(opcode);
+    if (opcode == VM_STORE || opcode == VM_CMD) program.u8(0);
+    if (opcode == VM_JZ) program.u16(0);
+    REQUIRE(load(program));
+    CHECK_EQ(run().result, VM_FAULT);
+    CHECK(vm.getError() != nullptr);
+    CHECK_EQ(run().result, VM_HALTED);  // a fault ends the program
+  }
+
+  Assembler oneOperand;
+  oneOperand.push(1).op(VM_ADD);
+  REQUIRE(load(oneOperand));
+  CHECK_EQ(run().result, VM_FAULT);
+}
+
+TEST_CASE(fullStackFaults) {
+  const uint8_t pushing[] = {VM_PUSH, VM_LOAD, VM_DUP, VM_DIST};
+  for (uint8_t opcode : pushing) {
+    Assembler program;
+    for (int i = 0; i < VM_STACK_DEPTH; i++) program.push(i);
+    program.op(opcode);
+    if (opcode == VM_PUSH) program.u16(0).u16(0);
+    if (opcode == VM_LOAD) program.u8(0);
+    REQUIRE(load(program));
+    CHECK_EQ(run().result, VM_FAULT);
+  }
+
+  Assembler exact;
+  for (int i = 0; i < VM_STACK_DEPTH; i++) exact.push(i);
+  CHECK_EQ(valueOf(exact), VM_STACK_DEPTH - 1);
+}
@@ -0,0 +1,129 @@
+// The reported pose stays in one frame: odometry until localization has
+// converged once, then odometry carried into the arena frame through the
+// last converged estimate, across loss of convergence and odometry resets.
+
+#include <Arduino.h>
+#include <cmath>
+#include "check.h"
+#include "host_hw.h"
+#include "localization.h"
+#include "motor_control.h"
+#include "navigation.h"
+#include "telemetry_codec.h"
+
+static void setUp() {
+  static bool started = false;
+  if (!started) {
+    host::setConsoleOutput(false);
+    localizer.begin();
+    started = true;
+  }
+}
+
+static bool near(const Pose& a, const Pose& b, float cm) {
+  float turn = fabs(a.heading - b.heading);
+  return fabs(a.x - b.x) < cm && fabs(a.y - b.y) < cm && fmin(turn, 360 - turn) < 2.0;
+}
+
+// Converge from the start pose and drive a little so the anchor is not
+// trivially the start pose
+static Pose convergeAt(Pose odometry) {
+  localizer.requestEnable(true);
+  localizer.update(odometry, 80.0);
+  for (int i = 0; i < 5; i++) {
+    odometry.x += 5.0;
+    localizer.update(odometry, 80.0 - 5 * i);
+  }
+  return odometry;
+}
+
+TEST_CASE(poseIsOdometryUntilConverged) {
+  setUp();
+  PoseFrame frame = FRAME_ARENA;
+  Pose pose = navigator.getPose(&frame);
+  CHECK_EQ(frame, FRAME_ODOMETRY);
+  CHECK(near(pose, motorController.getPose(), 0.01));
+}
+
+TEST_CASE(anchorMapsOdometryOntoTheEstimate) {
+  setUp();
+  Pose odometry = convergeAt({30.0, -20.0, 90.0});
+  REQUIRE(localizer.isConverged());
+
+  Pose arena;
+  REQUIRE(localizer.toArena(odometry, arena));
+  CHECK(near(arena, localizer.getPose(), 0.01));
+
+  // Further odometry is carried along rigidly: 10 cm ahead in odometry is
+  // 10 cm ahead along the arena heading
+  float rad = odometry.heading * PI / 180.0;
+  Pose ahead = {odometry.x + 10 * (float)cos(rad), odometry.y + 10 * (float)sin(rad),
+                odometry.heading};
+  Pose moved;
+  REQUIRE(localizer.toArena(ahead, moved));
+  float arenaRad = arena.heading * PI / 180.0;
+  CHECK(near(moved, {arena.x + 10 * (float)cos(arenaRad), arena.y + 10 * (float)sin(arenaRad),
+                     arena.heading}, 0.01));
+  localizer.requestDisable();
+  localizer.update(odometry, 0.0);
+}
+
+TEST_CASE(losingConvergenceKeepsTheArenaFrame) {
+  setUp();
+  Pose odometry = convergeAt({0.0, 0.0, 0.0});
+  Pose before;
+  REQUIRE(localizer.toArena(odometry, before));
+
+  localizer.requestDisable();
+  localizer.update(odometry, 0.0);
+  CHECK(!localizer.isConverged());
+
+  Pose after;
+  REQUIRE(localizer.toArena(odometry, after));
+  CHECK(near(before, after, 0.01));
+  PoseFrame frame = FRAME_ODOMETRY;
+  navigator.getPose(&frame);
+  CHECK_EQ(frame, FRAME_ARENA);
+}
+
+TEST_CASE(odometryResetKeepsTheArenaPose) {
+  setUp();
+  Pose odometry = convergeAt({40.0, 25.0, 30.0});
+  Pose before;
+  REQUIRE(localizer.toArena(odometry, before));
+  Pose estimate = localizer.getPose();
+
+  // As Navigation does on EXPLORE or a start-relative ROUTE_GO
+  localizer.rebaseOdometry(odometry);
+  Pose after;
+  REQUIRE(localizer.toArena({0.0, 0.0, 0.0}, after));
+  CHECK(near(before, after, 0.01));
+
+  // The filter sees no motion across the reset, only its own noise
+  localizer.update({0.0, 0.0, 0.0}, 80.0);
+  CHECK(near(localizer.getPose(), estimate, 2.0));
+  localizer.requestDisable();
+  localizer.update({0.0, 0.0, 0.0}, 0.0);
+}
+
+TEST_CASE(telemetryBatchesCarryOneFrame) {
+  TelemetryEncoder encoder;
+  encoder.begin(false);
+  TelemetrySample sample = {};
+  sample.channels = 1 << TLM_CH_POSE;
+  sample.poseFrame = FRAME_ARENA;
+  CHECK(encoder.add(sample, TELEMETRY_MAX_FRAME));
+  sample.timestamp = 20;
+  CHECK(encoder.add(sample, TELEMETRY_MAX_FRAME));
+  sample.poseFrame = FRAME_ODOMETRY;
+  CHECK(!encoder.add(sample, TELEMETRY_MAX_FRAME));   // a new batch starts here
+
+  TelemetrySample decoded[4];
+  REQUIRE_EQ(decodeTelemetryBatch(encoder.data(), encoder.size(), decoded, 4), 2);
+  CHECK_EQ(decoded[1].poseFrame, FRAME_ARENA);
+
+  encoder.begin(false);
+  CHECK(encoder.add(sample, TELEMETRY_MAX_FRAME));
+  REQUIRE_EQ(decodeTelemetryBatch(encoder.data(), encoder.size(), decoded, 4), 1);
+  CHECK_EQ(decoded[0].poseFrame, FRAME_ODOMETRY);
+}
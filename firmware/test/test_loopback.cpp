@@ -0,0 +1,209 @@
+// Commands in through a registered LoopbackTransport, acks and telemetry
+// back out, with the test playing the motor task.
+
+#include "check.h"
+#include "loopback_client.h"
+#include "host_hw.h"
+#include "parameters.h"
+
+static LoopbackClient client;
+
+// Each case starts with an open link, empty queues and JSON telemetry
+static void setUp() {
+  static bool connected = false;
+  if (!connected) {
+    host::setConsoleOutput(false);
+    client.connect();
+    connected = true;
+  }
+  client.link.setOpen(true);
+  drainCommands();
+  linkManager.setTelemetryFormat(TELEMETRY_JSON);
+  client.clear();
+}
+
+TEST_CASE(textCommandIsQueuedAndAcked) {
+  setUp();
+  client.link.sendText("  F20\r\n");
+  client.poll();
+
+  REQUIRE_EQ(client.acks.size(), 1u);
+  CHECK_EQ(client.acks[0].event, ACK_QUEUED);
+  CHECK_EQ(client.acks[0].type, 'F');
+  CHECK_EQ(client.acks[0].seq, 0);
+  CHECK_EQ(client.acks[0].credits, COMMAND_QUEUE_SIZE - 1);
+
+  REQUIRE(linkManager.hasCommand());
+  Command command = linkManager.getNextCommand();
+  CHECK_EQ(command.type, 'F');
+  CHECK_EQ(command.value, 20);
+  CHECK(command.source != 0);
+
+  linkManager.sendAck(ACK_STARTED, command);
+  linkManager.sendAck(ACK_COMPLETED, command);
+  client.poll();
+  REQUIRE_EQ(client.acks.size(), 3u);
+  CHECK_EQ(client.acks[1].event, ACK_STARTED);
+  CHECK_EQ(client.acks[2].event, ACK_COMPLETED);
+  CHECK_EQ(client.acks[2].credits, COMMAND_QUEUE_SIZE);
+}
+
+TEST_CASE(frameEchoesSequenceNumber) {
+  setUp();
+  client.sendFrame(OP_LEFT, 4711, 90);
+  client.poll();
+
+  REQUIRE_EQ(client.acks.size(), 1u);
+  CHECK_EQ(client.acks[0].event, ACK_QUEUED);
+  CHECK_EQ(client.acks[0].type, 'L');
+  CHECK_EQ(client.acks[0].seq, 4711);
+
+  Command command = linkManager.getNextCommand();
+  CHECK_EQ(command.type, 'L');
+  CHECK_EQ(command.value, 90);
+  CHECK_EQ(command.seq, 4711);
+}
+
+TEST_CASE(corruptFrameIsRejected) {
+  setUp();
+  Frame frame = {OP_FORWARD, 99, 10, 0, nullptr};
+  uint8_t out[FRAME_MAX_SIZE];
+  size_t length = encodeFrame(frame, out, sizeof(out));
+  out[length - 1] ^= 0xFF;
+  client.link.sendFrame(out, length);
+  client.poll();
+
+  REQUIRE_EQ(client.acks.size(), 1u);
+  CHECK_EQ(client.acks[0].event, ACK_REJECTED);
+  CHECK_EQ(client.acks[0].seq, 99);
+  CHECK(!linkManager.hasCommand());
+}
+
+TEST_CASE(outOfRangeMoveIsClamped) {
+  setUp();
+  client.link.sendText("F99999");
+  Command command = linkManager.getNextCommand();
+  CHECK_EQ(command.value, MAX_MOVE_DISTANCE_CM);
+}
+
+TEST_CASE(statusRepliesGoToTheAskingLink) {
+  setUp();
+  client.link.sendText("BOOT");
+  client.poll();
+
+  REQUIRE_EQ(client.telemetry.size(), 2u);
+  CHECK(client.telemetry[0].find("\"status\":\"boot\"") != std::string::npos);
+  CHECK(client.telemetry[1].find("\"status\":\"bootPhases\"") != std::string::npos);
+  CHECK(client.acks.empty());
+}
+
+TEST_CASE(jsonTelemetryCarriesSubscribedChannels) {
+  setUp();
+  TelemetrySample sample = {};
+  sample.timestamp = 1234;
+  sample.channels = (1 << TLM_CH_DISTANCE) | (1 << TLM_CH_HEADING);
+  sample.distance = 42.5;
+  sample.heading = 90;
+  linkManager.publishTelemetry(sample);
+  client.poll();
+
+  REQUIRE_EQ(client.telemetry.size(), 1u);
+  const std::string& json = client.telemetry[0];
+  CHECK_EQ(json.front(), '{');
+  CHECK(json.find("\"timestamp\":1234") != std::string::npos);
+  CHECK(json.find("\"distance\":42.5") != std::string::npos);
+  CHECK(json.find("\"heading\":90") != std::string::npos);
+  CHECK(json.find("battery") == std::string::npos);
+}
+
+TEST_CASE(binaryTelemetryIsBatched) {
+  setUp();
+  client.link.sendText("TLM_BIN");
+  client.link.sendText("SUB:distance=20,heading=0,battery=0,pose=0");
+
+  TelemetrySample sample = {};
+  sample.channels = 1 << TLM_CH_DISTANCE;
+  for (int i = 0; i < 3; i++) {
+    sample.timestamp = 1000 + 20 * i;
+    sample.distance = 30 + i;
+    linkManager.publishTelemetry(sample);
+  }
+  client.poll();
+  CHECK(client.telemetry.empty());      // still batching
+
+  linkManager.flushTelemetry();
+  client.poll();
+  REQUIRE_EQ(client.telemetry.size(), 1u);
+  CHECK_EQ((uint8_t)client.telemetry[0][0], TELEMETRY_MAGIC);
+
+  client.link.sendText("SUB_DEFAULT");
+}
+
+// The default stream runs at sensorMs, including after it changes
+TEST_CASE(defaultTelemetryFollowsSensorPeriod) {
+  setUp();
+  client.link.sendText("SUB_DEFAULT");
+  CHECK_EQ(linkManager.getTelemetryPeriod(), (unsigned long)SENSOR_UPDATE_RATE);
+
+  REQUIRE(parameters.setInt(PARAM_SENSOR_MS, 250));
+  CHECK_EQ(linkManager.getTelemetryPeriod(), 250ul);
+  client.link.sendText("SUB:distance=100");
+  CHECK_EQ(linkManager.getTelemetryPeriod(), 100ul);
+
+  client.link.sendText("SUB_DEFAULT");
+  parameters.setInt(PARAM_SENSOR_MS, SENSOR_UPDATE_RATE);
+}
+
+// A link that wakes up when something arrives, as BLE's auto mode does
+class WakingLink : public LoopbackTransport {
+public:
+  uint8_t profile = 1;                  // idle
+  uint8_t startedOn = 0xFF;
+
+  uint8_t noteActivity() override {
+    uint8_t arrivedOn = profile;
+    profile = 0;
+    return arrivedOn;
+  }
+  void commandStarted(const Command& command) override {
+    startedOn = command.profile;
+  }
+};
+
+// Latency is binned by the profile a command came in on, not the one the
+// link has switched to by the time it starts
+TEST_CASE(commandKeepsTheProfileItArrivedOn) {
+  setUp();
+  static WakingLink waking;
+  static bool added = false;
+  if (!added) {
+    waking.begin();
+    REQUIRE(linkManager.addTransport(&waking));
+    added = true;
+  }
+
+  for (bool frame : {false, true}) {
+    waking.profile = 1;
+    if (frame) {
+      Frame forward = {OP_FORWARD, 7, 10, 0, nullptr};
+      uint8_t out[FRAME_MAX_SIZE];
+      waking.sendFrame(out, encodeFrame(forward, out, sizeof(out)));
+    } else {
+      waking.sendText("F10");
+    }
+    CHECK_EQ(waking.profile, 0);
+    REQUIRE(linkManager.hasCommand());
+    CHECK_EQ(linkManager.getNextCommand().profile, 1);
+    CHECK_EQ(waking.startedOn, 1);
+  }
+  drainCommands();
+}
+
+TEST_CASE(closedLinkReceivesNothing) {
+  setUp();
+  client.link.setOpen(false);
+  client.link.sendText("B5");
+  client.poll();
+  CHECK(client.acks.empty());
+  CHECK(linkManager.hasCommand());      // queued all the same
+}
@@ -0,0 +1,299 @@
+// Flow control under load: a client floods framed moves within its credit
+// and sprinkles STOPs, while a motor thread runs them, and every ack is
+// checked against the command it belongs to. Route uploads race route
+// starts the same way.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "loopback_client.h"
+#include "host_hw.h"
+#include "navigation.h"
+
+static LoopbackClient client;
+
+static void setUp() {
+  static bool connected = false;
+  if (!connected) {
+    host::setConsoleOutput(false);
+    client.connect();
+    connected = true;
+  }
+  drainCommands();
+  client.clear();
+}
+
+static unsigned long elapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - since).count();
+}
+
+// Stands in for motorTask/executeCommand: moves take a few tens of
+// microseconds and end early, as aborted, when a stop is pending
+class MotorThread {
+  std::atomic<bool> running{true};
+  std::thread thread;
+
+  void loop() {
+    uint32_t seed = 1;
+    while (running) {
+      taskEvents.wait(EVENT_COMMAND, pdMS_TO_TICKS(1));
+      while (linkManager.hasCommand()) {
+        Command cmd = linkManager.getNextCommand();
+        linkManager.sendAck(ACK_STARTED, cmd);
+        bool move = cmd.type != 'S';
+        if (move) {
+          motorController.clearStop();
+          seed = seed * 1103515245 + 12345;
+          unsigned long until = micros() + 10 + (seed >> 16) % 60;
+          while ((long)(micros() - until) < 0 && !motorController.isStopPending()) {}
+        }
+        bool aborted = move && motorController.isStopPending();
+        linkManager.sendAck(aborted ? ACK_ABORTED : ACK_COMPLETED, cmd);
+      }
+    }
+  }
+
+public:
+  MotorThread() : thread(&MotorThread::loop, this) {}
+  ~MotorThread() {
+    running = false;
+    thread.join();
+  }
+};
+
+TEST_CASE(floodWithinCreditLosesNothing) {
+  setUp();
+  const int commands = 6000;
+  const int stopEvery = 97;
+
+  std::vector<bool> isStop(commands + 1, false);
+  size_t sent = 0;
+  uint8_t credits = COMMAND_QUEUE_SIZE;
+  int violations = 0;
+
+  {
+    MotorThread motor;
+    auto start = std::chrono::steady_clock::now();
+    for (int seq = 1; seq <= commands; seq++) {
+      bool stop = seq % stopEvery == 0;
+      // Moves wait for credit; STOP is exempt
+      while (!stop) {
+        size_t before = client.acks.size();
+        client.poll();
+        for (size_t i = before; i < client.acks.size(); i++) credits = client.acks[i].credits;
+        if (credits > 0) break;
+        REQUIRE(elapsedMs(start) < 20000);
+        std::this_thread::yield();
+      }
+      isStop[seq] = stop;
+      client.sendFrame(stop ? OP_STOP : OP_FORWARD, (uint16_t)seq, 1);
+      if (!stop) credits--;
+      sent++;
+    }
+
+    // Wait for every final ack
+    auto finals = [&]() {
+      int count = 0;
+      for (const Ack& ack : client.acks) {
+        count += ack.event == ACK_COMPLETED || ack.event == ACK_ABORTED ||
+                 ack.event == ACK_REJECTED;
+      }
+      return count;
+    };
+    while (finals() < commands) {
+      client.poll();
+      REQUIRE(elapsedMs(start) < 20000);
+      std::this_thread::yield();
+    }
+  }
+  client.poll();
+  CHECK_EQ(client.link.getDropped(), 0u);
+
+  // Per command: QUEUED first, at most one STARTED, exactly one final
+  // COMPLETED or ABORTED, last; never REJECTED
+  std::vector<int> queuedAt(commands + 1, -1), startedAt(commands + 1, -1),
+                   finalAt(commands + 1, -1);
+  for (size_t i = 0; i < client.acks.size(); i++) {
+    const Ack& ack = client.acks[i];
+    REQUIRE(ack.seq >= 1 && ack.seq <= commands);
+    switch (ack.event) {
+      case ACK_QUEUED:
+        if (queuedAt[ack.seq] >= 0) violations++;
+        queuedAt[ack.seq] = (int)i;
+        break;
+      case ACK_STARTED:
+        if (startedAt[ack.seq] >= 0 || queuedAt[ack.seq] < 0) violations++;
+        startedAt[ack.seq] = (int)i;
+        break;
+      case ACK_COMPLETED:
+      case ACK_ABORTED:
+        if (finalAt[ack.seq] >= 0 || queuedAt[ack.seq] < 0) violations++;
+        finalAt[ack.seq] = (int)i;
+        break;
+      case ACK_REJECTED:
+        violations++;
+        break;
+    }
+  }
+  CHECK_EQ(violations, 0);
+  int missing = 0;
+  for (int seq = 1; seq <= commands; seq++) {
+    if (queuedAt[seq] < 0 || finalAt[seq] < 0 || finalAt[seq] < startedAt[seq]) missing++;
+  }
+  CHECK_EQ(missing, 0);
+
+  // Credits never go backwards: each ack carries the free slots as of the
+  // moment it was sent, so it must agree with the moves queued and taken
+  // by every ack before it. Between a queue operation and its ack, one
+  // push (client) and two takes (motor, and the client's stop draining
+  // the queue) may be in flight.
+  int occupancy = 0;
+  int stale = 0;
+  for (const Ack& ack : client.acks) {
+    if (isStop[ack.seq]) continue;
+    if (ack.event == ACK_QUEUED) occupancy++;
+    if (ack.event == ACK_STARTED ||
+        (ack.event == ACK_ABORTED && startedAt[ack.seq] < 0)) occupancy--;
+    int expected = COMMAND_QUEUE_SIZE - occupancy;
+    if (ack.credits < expected - 1 || ack.credits > expected + 2) stale++;
+  }
+  CHECK_EQ(stale, 0);
+  CHECK_EQ(occupancy, 0);
+
+  // A stop overtakes the queue: of the moves sent before it, at most the
+  // one the motor thread was already taking may start after it is queued
+  int overtaken = 0;
+  unsigned long worstStopMs = 0;
+  for (int seq = stopEvery; seq <= commands; seq += stopEvery) {
+    int lateStarts = 0;
+    for (int before = seq - 1; before > seq - stopEvery; before--) {
+      if (startedAt[before] > queuedAt[seq]) lateStarts++;
+    }
+    if (lateStarts > 1) overtaken++;
+    if (startedAt[seq] >= 0) {
+      const Ack& queued = client.acks[queuedAt[seq]];
+      const Ack& started = client.acks[startedAt[seq]];
+      worstStopMs = std::max(worstStopMs, (unsigned long)(started.time - queued.time));
+    }
+  }
+  CHECK_EQ(overtaken, 0);
+  printf("  %zu commands, %zu acks, slowest stop queued->started %lu ms\n",
+         sent, client.acks.size(), worstStopMs);
+  CHECK(worstStopMs < 200);
+}
+
+// One side at a time the credit is exact: down by one per queued move,
+// up by one per started move
+TEST_CASE(creditsCountDownAndBackUp) {
+  setUp();
+  for (int seq = 1; seq <= COMMAND_QUEUE_SIZE; seq++) {
+    client.sendFrame(OP_FORWARD, seq, 10);
+  }
+  while (linkManager.hasCommand()) {
+    linkManager.sendAck(ACK_STARTED, linkManager.getNextCommand());
+  }
+  client.poll();
+  REQUIRE_EQ(client.acks.size(), (size_t)(2 * COMMAND_QUEUE_SIZE));
+  for (int i = 0; i < COMMAND_QUEUE_SIZE; i++) {
+    CHECK_EQ(client.acks[i].event, ACK_QUEUED);
+    CHECK_EQ(client.acks[i].credits, COMMAND_QUEUE_SIZE - 1 - i);
+    CHECK_EQ(client.acks[COMMAND_QUEUE_SIZE + i].event, ACK_STARTED);
+    CHECK_EQ(client.acks[COMMAND_QUEUE_SIZE + i].credits, i + 1);
+  }
+}
+
+// With nobody taking commands: a full queue still takes a STOP, which
+// aborts every queued move and is the next command out
+TEST_CASE(stopOvertakesAFullQueue) {
+  setUp();
+  for (int seq = 1; seq <= COMMAND_QUEUE_SIZE; seq++) {
+    client.sendFrame(OP_FORWARD, seq, 10);
+  }
+  client.poll();
+  REQUIRE_EQ(client.acks.size(), (size_t)COMMAND_QUEUE_SIZE);
+  CHECK_EQ(client.acks.back().credits, 0);
+
+  // One more move is over the credit and is refused, not dropped silently
+  client.sendFrame(OP_FORWARD, 99, 10);
+  client.sendFrame(OP_STOP, 100, 0);
+  client.poll();
+  REQUIRE_EQ(client.acks.size(), (size_t)(COMMAND_QUEUE_SIZE + 1 + COMMAND_QUEUE_SIZE + 1));
+  CHECK_EQ(client.acks[COMMAND_QUEUE_SIZE].event, ACK_REJECTED);
+  CHECK_EQ(client.acks[COMMAND_QUEUE_SIZE].seq, 99);
+  for (int i = 0; i < COMMAND_QUEUE_SIZE; i++) {
+    const Ack& ack = client.acks[COMMAND_QUEUE_SIZE + 1 + i];
+    CHECK_EQ(ack.event, ACK_ABORTED);
+    CHECK_EQ(ack.seq, i + 1);
+  }
+  const Ack& stop = client.acks.back();
+  CHECK_EQ(stop.event, ACK_QUEUED);
+  CHECK_EQ(stop.seq, 100);
+  CHECK_EQ(stop.credits, COMMAND_QUEUE_SIZE);
+  CHECK(motorController.isStopPending());
+
+  // A move sent after the stop queues behind it
+  client.sendFrame(OP_FORWARD, 101, 10);
+  Command next = linkManager.getNextCommand();
+  CHECK_EQ(next.type, 'S');
+  CHECK_EQ(next.seq, 100);
+  CHECK_EQ(linkManager.getNextCommand().seq, 101);
+}
+
+TEST_CASE(stopsBeyondThePriorityLaneMerge) {
+  setUp();
+  for (int seq = 1; seq <= PRIORITY_QUEUE_SIZE + 1; seq++) {
+    client.sendFrame(OP_STOP, seq, 0);
+  }
+  client.poll();
+  REQUIRE_EQ(client.acks.size(), (size_t)(PRIORITY_QUEUE_SIZE + 2));
+  for (int i = 0; i < PRIORITY_QUEUE_SIZE; i++) {
+    CHECK_EQ(client.acks[i].event, ACK_QUEUED);
+  }
+  // The extra stop is answered in full right away: the queued ones cover it
+  CHECK_EQ(client.acks[PRIORITY_QUEUE_SIZE].event, ACK_QUEUED);
+  CHECK_EQ(client.acks[PRIORITY_QUEUE_SIZE + 1].event, ACK_COMPLETED);
+  CHECK_EQ(client.acks[PRIORITY_QUEUE_SIZE + 1].seq, PRIORITY_QUEUE_SIZE + 1);
+}
+
+// A route started while the client keeps replacing it is always one whole
+// upload, and stays as it was started until the route ends
+TEST_CASE(routeStartsSeeWholeUploads) {
+  setUp();
+  const char* const uploads[] = {"ROUTE:10,0;20,0;30,0", "ROUTE:10,0;20,0;30,0;40,0;50,0"};
+  client.link.sendText(uploads[0]);
+
+  std::atomic<bool> running{true};
+  std::thread uploader([&] {
+    for (int i = 0; running; i++) {
+      client.link.sendText(uploads[i % 2]);
+    }
+  });
+
+  int starts = 0, torn = 0, changed = 0;
+  auto begin = std::chrono::steady_clock::now();
+  while (elapsedMs(begin) < 1000) {
+    starts++;
+    if (!navigator.startRoute()) {
+      torn++;                           // found it cleared and not yet refilled
+      continue;
+    }
+    int length = navigator.getRouteLength();
+    if (length != 3 && length != 5) torn++;
+    std::this_thread::yield();
+    if (navigator.getRouteLength() != length) changed++;
+    navigator.disableAutonomousMode();
+  }
+  running = false;
+  uploader.join();
+
+  printf("  %d route starts during uploads\n", starts);
+  CHECK(starts > 10);
+  CHECK_EQ(torn, 0);
+  CHECK_EQ(changed, 0);
+  navigator.clearRoute();
+  client.clear();
+}
@@ -0,0 +1,46 @@
+// Runs every TEST_CASE in the program, or those named on the command line.
+// The exit status is the number of failed test cases.
+
+#include "check.h"
+#include <string.h>
+
+namespace check {
+
+static int failures;
+
+TestCase*& registry() {
+  static TestCase* first = nullptr;
+  return first;
+}
+
+void fail(const char* file, int line, const std::string& message) {
+  printf("  %s:%d: FAILED %s\n", file, line, message.c_str());
+  failures++;
+}
+
+}  // namespace check
+
+static bool selected(const char* name, int argc, char** argv) {
+  if (argc < 2) return true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], name) == 0) return true;
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  int run = 0;
+  int failed = 0;
+  for (check::TestCase* test = check::registry(); test != nullptr; test = test->next) {
+    if (!selected(test->name, argc, argv)) continue;
+    int before = check::failures;
+    test->function();
+    bool passed = check::failures == before;
+    printf("%s %s\n", passed ? "[ pass ]" : "[ FAIL ]", test->name);
+    fflush(stdout);
+    run++;
+    if (!passed) failed++;
+  }
+  printf("%d of %d test cases passed\n", run - failed, run);
+  return failed;
+}
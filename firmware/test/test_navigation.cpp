@@ -0,0 +1,230 @@
+// Navigation steps against a simulated robot on simulated time: the
+// ultrasonic sensors see whatever distances the test sets, or walls along
+// the odometry x axis, and the wheels are the real step loop, so odometry
+// shows where each slice drove. Where the wheels really went, slip and
+// all, is the host's wheel pose, which the gyro can follow.
+
+#include <Arduino.h>
+#include <cmath>
+#include "check.h"
+#include "host_hw.h"
+#include "motor_control.h"
+#include "navigation.h"
+#include "sensor_manager.h"
+
+class SimRobot : public host::Hardware {
+public:
+  float frontCM = 0;            // 0 = no echo
+  float leftCM = 0;
+  float rightCM = 0;
+  bool walls = false;           // sides from the walls below instead
+  float leftWallY = -30;        // walls parallel to x, in odometry cm
+  float rightWallY = 30;
+  bool gyro = false;            // gyro z from the host's wheel pose
+
+  void motion(int16_t raw[6]) override {
+    host::Hardware::motion(raw);
+    if (gyro) raw[5] = host::wheelYawRate();
+  }
+
+  unsigned long echo(uint8_t pin, unsigned long timeoutUs) override {
+    float cm = pin == ECHO_PIN ? frontCM
+             : pin == SIDE_ECHO_LEFT_PIN ? (walls ? wall(leftWallY, -1) : leftCM)
+             : pin == SIDE_ECHO_RIGHT_PIN ? (walls ? wall(rightWallY, 1) : rightCM) : 0;
+    unsigned long width = (unsigned long)(cm * 2.0 / 0.0346);   // 25 C
+    return cm > 0 && width < timeoutUs ? width : 0;
+  }
+
+  // Range from the side sensor (side -1 = left) to the wall at y; none if
+  // the sensor faces away from it by more than 60 degrees
+  float wall(float y, int side) {
+    Pose pose = motorController.getPose();
+    float facing = cos(pose.heading * PI / 180.0);
+    if (facing < 0.5) return 0;
+    return (y - pose.y) * side / facing;
+  }
+};
+
+static SimRobot robot;
+
+static void setUp() {
+  host::setConsoleOutput(false);
+  host::setHardware(&robot);
+  host::setSimulatedTime(true);
+  robot = SimRobot();
+  sensorManager.updateSensorData(false);    // 25 C for the speed of sound
+  navigator.disableAutonomousMode();
+  navigator.clearRoute();
+  motorController.clearStop();
+  motorController.resetPose();
+}
+
+static void tearDown() {
+  navigator.disableAutonomousMode();
+  navigator.clearRoute();
+  motorController.setHeadingHold(HEADING_HOLD_DEFAULT);
+  host::setWheelSlip(0, 0);
+  host::setSimulatedTime(false);
+  host::setHardware(nullptr);
+}
+
+// The obstacle check reads the sensor each slice, not the sensor task's
+// cached distance, which can be a telemetry period old
+TEST_CASE(routePausesForAnObstacleThatJustAppeared) {
+  setUp();
+  REQUIRE(navigator.addWaypoint(200, 0));
+  REQUIRE(navigator.startRoute());
+
+  navigator.executeAutonomousStep();
+  float clear = motorController.getPose().x;
+  CHECK(clear > 0);
+
+  robot.frontCM = 10;
+  navigator.executeAutonomousStep();
+  CHECK_EQ(motorController.getPose().x, clear);
+
+  robot.frontCM = 0;
+  navigator.executeAutonomousStep();
+  CHECK(motorController.getPose().x > clear);
+  tearDown();
+}
+
+// Stands in for the sensor task's pass: scanRanges() takes the pings
+static void sensorPass() {
+  uint8_t sides = navigator.getSideSensors();
+  if (sides != 0) sensorManager.scanRanges(sides);
+}
+
+// Alternates sensor passes and motor steps for seconds of simulated time;
+// returns the motor task's mean microseconds per step that drove
+static double follow(float seconds) {
+  unsigned long stepMicros = 0;
+  int slices = 0;
+  unsigned long end = millis() + (unsigned long)(seconds * 1000);
+  while ((long)(millis() - end) < 0) {
+    sensorPass();
+    float x = motorController.getPose().x;
+    unsigned long start = micros();
+    navigator.executeAutonomousStep();
+    if (motorController.getPose().x != x) {
+      stepMicros += micros() - start;
+      slices++;
+    }
+  }
+  return slices > 0 ? (double)stepMicros / slices : 0;
+}
+
+// Prints the navigator's steering metrics and checks that the robot settled
+// within settleMs, held the band afterwards and kept most of its speed
+static void checkFollowMetrics(const char* name, unsigned long settleMs) {
+  FollowMetrics metrics = navigator.getFollowMetrics();
+  float straight = motorController.getBaseStepRate() * PI * WHEEL_DIAMETER / STEPS_PER_REV / 10.0;
+  printf("  %s: settled after %lu ms, RMS error %.1f cm, speed %.1f cm/s of %.1f straight\n",
+         name, metrics.settleMs, metrics.rmsError, metrics.speed, straight);
+  CHECK(metrics.settleMs > 0);
+  CHECK(metrics.settleMs < settleMs);
+  CHECK(metrics.rmsError < 4);
+  CHECK(metrics.speed > straight * 0.7);
+}
+
+// The slice holds the last scan's steer instead of pinging, so the motor
+// task spends its time stepping, and the robot still settles on the wall
+// from 15 cm off the target
+TEST_CASE(wallFollowSteersWithoutWaitingOnEchoes) {
+  setUp();
+  robot.walls = true;
+  robot.rightWallY = 35;
+  navigator.enableWallFollow(20);
+
+  double stepUs = follow(15);
+  Pose pose = motorController.getPose();
+  printf("  right wall: %.0f us per %d ms slice, y %.1f cm (target 15), x %.0f cm\n",
+         stepUs, WALL_CONTROL_PERIOD_MS, pose.y, pose.x);
+  CHECK(stepUs < WALL_CONTROL_PERIOD_MS * 1000 * 1.02);
+  CHECK(fabs(pose.y - 15) < WALL_SETTLE_BAND_CM);
+  CHECK(pose.x > 100);
+  checkFollowMetrics("right wall", 2000);
+  tearDown();
+}
+
+TEST_CASE(corridorCentersFromBothSides) {
+  setUp();
+  robot.walls = true;
+  robot.leftWallY = -20;
+  robot.rightWallY = 40;
+  navigator.enableCorridorCentering();
+
+  double stepUs = follow(15);
+  Pose pose = motorController.getPose();
+  printf("  corridor: %.0f us per %d ms slice, y %.1f cm (center 10)\n",
+         stepUs, WALL_CONTROL_PERIOD_MS, pose.y);
+  CHECK(stepUs < WALL_CONTROL_PERIOD_MS * 1000 * 1.02);
+  CHECK(fabs(pose.y - 10) < WALL_SETTLE_BAND_CM);
+  checkFollowMetrics("corridor", 2000);
+  tearDown();
+}
+
+// An obstacle ahead turns the robot once per scan, not once per slice, and
+// the scans from before the turn are not steered from
+TEST_CASE(followTurnsOnceForAnInsideCorner) {
+  setUp();
+  robot.rightCM = 20;
+  navigator.enableWallFollow(20);
+  robot.frontCM = 10;
+  sensorPass();
+  navigator.executeAutonomousStep();
+  float heading = motorController.getPose().heading;
+  CHECK(fabs(heading - 270) < 1);           // turned left, away from the wall
+
+  robot.frontCM = 0;
+  navigator.executeAutonomousStep();        // the old scan: no second turn, no drive
+  CHECK_EQ(motorController.getPose().heading, heading);
+  CHECK_EQ(motorController.getPose().x, 0.0f);
+
+  sensorPass();
+  navigator.executeAutonomousStep();
+  CHECK(motorController.getPose().y != 0.0f || motorController.getPose().x != 0.0f);
+  tearDown();
+}
+
+// No scans (the sensor task stalled) means no driving blind
+TEST_CASE(followStopsWhenScansStop) {
+  setUp();
+  robot.rightCM = 20;
+  navigator.enableWallFollow(20);
+  sensorPass();
+  navigator.executeAutonomousStep();
+  Pose moved = motorController.getPose();
+  CHECK(moved.x > 0);
+
+  host::advanceMicros(WALL_SCAN_TIMEOUT_MS * 1000UL);
+  navigator.executeAutonomousStep();
+  CHECK_EQ(motorController.getPose().x, moved.x);
+  tearDown();
+}
+
+// F100 with the right wheel losing 5% of its steps; returns where the
+// robot really ended up sideways (odometry counts the lost steps as driven)
+static float slipLateralError(bool hold) {
+  setUp();
+  robot.gyro = true;
+  robot.frontCM = 300;
+  sensorManager.readDistanceCM();           // clear of the critical distance
+  host::resetWheels();
+  host::setWheelSlip(0, 0.05);
+  motorController.setHeadingHold(hold);
+  motorController.moveForward(100);
+  float y = host::wheelPose().y;
+  tearDown();
+  return y;
+}
+
+// Uneven slip curves an open-loop move; heading hold steers it straight
+TEST_CASE(headingHoldCorrectsWheelSlip) {
+  float unheld = slipLateralError(false);
+  float held = slipLateralError(true);
+  printf("  5%% right-wheel slip, F100: lateral error %.1f cm without hold, %.1f cm with\n",
+         unheld, held);
+  CHECK(fabs(unheld) > 10);
+  CHECK(fabs(held) < fabs(unheld) * 0.1);
+}
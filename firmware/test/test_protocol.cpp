@@ -0,0 +1,254 @@
+// Binary command frames: CRC, encode/decode round trips, every decode
+// error, opcode mapping, and text and binary commands that must queue the
+// same Command.
+
+#include <string.h>
+#include "check.h"
+#include "loopback_client.h"
+#include "program_runner.h"
+#include "host_hw.h"
+
+static size_t encode(uint8_t opcode, uint16_t seq, int32_t param, uint8_t* out,
+                     const uint8_t* payload = nullptr, uint8_t payloadLength = 0) {
+  Frame frame = {opcode, seq, param, payloadLength, payload};
+  return encodeFrame(frame, out, FRAME_MAX_SIZE);
+}
+
+TEST_CASE(crcMatchesCcittFalseCheckValue) {
+  const char* check = "123456789";
+  CHECK_EQ(crc16((const uint8_t*)check, strlen(check)), 0x29B1);
+  CHECK_EQ(crc16(nullptr, 0), 0xFFFF);
+  const uint8_t zero = 0;
+  CHECK_EQ(crc16(&zero, 1), 0xE1F0);
+}
+
+TEST_CASE(fieldsAreLittleEndian) {
+  const uint8_t bytes[] = {0x34, 0x12, 0xFE, 0xFF};
+  CHECK_EQ(readU16(bytes), 0x1234);
+  CHECK_EQ(readI32(bytes), (int32_t)0xFFFE1234);
+
+  uint8_t out[FRAME_MAX_SIZE];
+  encode(OP_FORWARD, 0xBEEF, -2, out);
+  CHECK_EQ(out[0], PROTOCOL_MAGIC);
+  CHECK_EQ(out[1], PROTOCOL_VERSION);
+  CHECK_EQ(out[2], OP_FORWARD);
+  CHECK_EQ(out[3], 0xEF);
+  CHECK_EQ(out[4], 0xBE);
+  CHECK_EQ(out[5], 0xFE);
+  CHECK_EQ(out[8], 0xFF);
+  CHECK_EQ(out[9], 0);
+}
+
+TEST_CASE(plainFrameRoundTrips) {
+  const int32_t params[] = {0, 1, -1, 12345, INT32_MAX, INT32_MIN};
+  for (int32_t param : params) {
+    uint8_t out[FRAME_MAX_SIZE];
+    size_t length = encode(OP_RIGHT, 65535, param, out);
+    REQUIRE_EQ(length, (size_t)(FRAME_HEADER_SIZE + FRAME_CRC_SIZE));
+
+    Frame frame;
+    REQUIRE_EQ(decodeFrame(out, length, frame), FRAME_OK);
+    CHECK_EQ(frame.opcode, OP_RIGHT);
+    CHECK_EQ(frame.seq, 65535);
+    CHECK_EQ(frame.param, param);
+    CHECK_EQ(frame.payloadLength, 0);
+    CHECK(frame.payload == nullptr);
+  }
+}
+
+TEST_CASE(payloadFrameRoundTripsInPlace) {
+  uint8_t payload[FRAME_MAX_PAYLOAD];
+  for (int i = 0; i < FRAME_MAX_PAYLOAD; i++) payload[i] = (uint8_t)(i * 7);
+
+  uint8_t out[FRAME_MAX_SIZE];
+  size_t length = encode(OP_PROG_DATA, 9, 512, out, payload, FRAME_MAX_PAYLOAD);
+  REQUIRE_EQ(length, (size_t)FRAME_MAX_SIZE);
+
+  Frame frame;
+  REQUIRE_EQ(decodeFrame(out, length, frame), FRAME_OK);
+  CHECK_EQ(frame.opcode, OP_PROG_DATA);
+  CHECK_EQ(frame.param, 512);
+  CHECK_EQ(frame.payloadLength, FRAME_MAX_PAYLOAD);
+  CHECK(frame.payload == out + FRAME_HEADER_SIZE);    // not copied
+  CHECK(memcmp(frame.payload, payload, FRAME_MAX_PAYLOAD) == 0);
+}
+
+TEST_CASE(encodeRefusesSmallBuffer) {
+  Frame frame = {OP_FORWARD, 1, 10, 0, nullptr};
+  uint8_t out[FRAME_MAX_SIZE];
+  CHECK_EQ(encodeFrame(frame, out, FRAME_HEADER_SIZE + FRAME_CRC_SIZE - 1), 0u);
+  CHECK_EQ(encodeFrame(frame, out, FRAME_HEADER_SIZE + FRAME_CRC_SIZE),
+           (size_t)(FRAME_HEADER_SIZE + FRAME_CRC_SIZE));
+}
+
+TEST_CASE(decodeReportsEachError) {
+  uint8_t good[FRAME_MAX_SIZE];
+  const uint8_t payload[] = {1, 2, 3, 4};
+  size_t length = encode(OP_ROUTE, 3, 0, good, payload, sizeof(payload));
+  Frame frame;
+  uint8_t bad[FRAME_MAX_SIZE + 1];
+
+  CHECK_EQ(decodeFrame(good, FRAME_HEADER_SIZE + FRAME_CRC_SIZE - 1, frame), FRAME_TOO_SHORT);
+  CHECK_EQ(decodeFrame(good, 0, frame), FRAME_TOO_SHORT);
+
+  memcpy(bad, good, length);
+  bad[0] = 'F';
+  CHECK_EQ(decodeFrame(bad, length, frame), FRAME_BAD_MAGIC);
+
+  memcpy(bad, good, length);
+  bad[1] = PROTOCOL_VERSION + 1;
+  CHECK_EQ(decodeFrame(bad, length, frame), FRAME_BAD_VERSION);
+
+  CHECK_EQ(decodeFrame(good, length - 1, frame), FRAME_BAD_LENGTH);
+  memcpy(bad, good, length);
+  bad[length] = 0;
+  CHECK_EQ(decodeFrame(bad, length + 1, frame), FRAME_BAD_LENGTH);
+
+  memcpy(bad, good, length);
+  bad[9] = sizeof(payload) + 1;
+  CHECK_EQ(decodeFrame(bad, length, frame), FRAME_BAD_LENGTH);
+}
+
+TEST_CASE(anySingleBitFlipIsCaught) {
+  uint8_t good[FRAME_MAX_SIZE];
+  const uint8_t payload[] = {10, 0, 246, 255};
+  size_t length = encode(OP_ROUTE, 77, 1, good, payload, sizeof(payload));
+
+  int accepted = 0;
+  for (size_t i = 0; i < length; i++) {
+    for (int bit = 0; bit < 8; bit++) {
+      uint8_t bad[FRAME_MAX_SIZE];
+      memcpy(bad, good, length);
+      bad[i] ^= 1 << bit;
+      Frame frame;
+      if (decodeFrame(bad, length, frame) == FRAME_OK) accepted++;
+    }
+  }
+  CHECK_EQ(accepted, 0);
+}
+
+TEST_CASE(commandOpcodesMapOntoCommands) {
+  const uint8_t opcodes[] = {
+    OP_FORWARD, OP_BACKWARD, OP_LEFT, OP_RIGHT, OP_STOP, OP_AUTO, OP_CALIBRATE,
+    OP_CLOSED_LOOP, OP_HEADING_HOLD, OP_LOCALIZE, OP_WALL, OP_ROUTE_GO, OP_PROGRAM
+  };
+  for (uint8_t opcode : opcodes) {
+    Frame frame = {opcode, 42, -7, 0, nullptr};
+    Command command;
+    REQUIRE(frameToCommand(frame, command));
+    CHECK_EQ(command.type, (char)opcode);
+    CHECK_EQ(command.value, -7);
+    CHECK_EQ(command.seq, 42);
+  }
+
+  const uint8_t receiverOpcodes[] = {
+    OP_ROUTE, OP_PROG_BEGIN, OP_PROG_DATA, OP_PROG_END, OP_TELEMETRY,
+    OP_SUBSCRIBE, OP_CONN_PROFILE, 'Z', 0
+  };
+  for (uint8_t opcode : receiverOpcodes) {
+    Frame frame = {opcode, 0, 0, 0, nullptr};
+    Command command;
+    CHECK(!frameToCommand(frame, command));
+  }
+}
+
+TEST_CASE(waypointsAreSigned) {
+  const uint8_t payload[] = {0x2C, 0x01, 0x9C, 0xFF, 0x00, 0x80, 0xFF, 0x7F};
+  Frame frame = {OP_ROUTE, 0, 0, sizeof(payload), payload};
+  REQUIRE_EQ(frameWaypointCount(frame), 2);
+  int x, y;
+  frameWaypoint(frame, 0, x, y);
+  CHECK_EQ(x, 300);
+  CHECK_EQ(y, -100);
+  frameWaypoint(frame, 1, x, y);
+  CHECK_EQ(x, -32768);
+  CHECK_EQ(y, 32767);
+}
+
+TEST_CASE(ackLayout) {
+  Command command = {'R', 90, 0x0102, 0x0A0B0C0D, 0, 1};
+  uint8_t out[ACK_SIZE];
+  REQUIRE_EQ(encodeAck(ACK_COMPLETED, command, 0xDEADBEEF, 3, out), (size_t)ACK_SIZE);
+  CHECK_EQ(out[0], ACK_MAGIC);
+  CHECK_EQ(out[1], PROTOCOL_VERSION);
+
+  Ack ack = decodeAck(out);
+  CHECK_EQ(ack.event, ACK_COMPLETED);
+  CHECK_EQ(ack.type, 'R');
+  CHECK_EQ(ack.seq, 0x0102);
+  CHECK_EQ(ack.receivedAt, 0x0A0B0C0Du);
+  CHECK_EQ(ack.time, 0xDEADBEEFu);
+  CHECK_EQ(ack.credits, 3);
+}
+
+// Both formats through the link: the text command and the frame must queue
+// the same Command, apart from the sequence number only frames carry.
+TEST_CASE(textAndFrameQueueTheSameCommand) {
+  static LoopbackClient client;
+  host::setConsoleOutput(false);
+  client.connect();
+  drainCommands();
+
+  struct Pair { const char* text; uint8_t opcode; int32_t param; };
+  const Pair pairs[] = {
+    {"F20", OP_FORWARD, 20},       {"B35", OP_BACKWARD, 35},
+    {"L90", OP_LEFT, 90},          {"R45", OP_RIGHT, 45},
+    {"WL15", OP_WALL, -15},        {"WR", OP_WALL, WALL_DEFAULT_DIST_CM},
+    {"CORRIDOR", OP_WALL, 0},      {"AUTO_NAV", OP_AUTO, 1},
+    {"EXPLORE", OP_AUTO, 2},       {"AUTO_OFF", OP_AUTO, 0},
+    {"ROUTE_GO", OP_ROUTE_GO, 1},  {"PROG_RUN", OP_PROGRAM, 1},
+    {"PROG_ABORT", OP_PROGRAM, 0}, {"CALIBRATE", OP_CALIBRATE, 0},
+    {"MCL_ON", OP_LOCALIZE, 1},    {"MCL_HOME", OP_LOCALIZE, 2},
+    {"MCL_OFF", OP_LOCALIZE, 0},   {"HOLD_ON", OP_HEADING_HOLD, 1},
+    {"HOLD_OFF", OP_HEADING_HOLD, 0}, {"CLOOP_ON", OP_CLOSED_LOOP, 1},
+    {"CLOOP_OFF", OP_CLOSED_LOOP, 0}
+  };
+
+  for (const Pair& pair : pairs) {
+    client.link.sendText(pair.text);
+    REQUIRE(linkManager.hasCommand());
+    Command text = linkManager.getNextCommand();
+
+    client.sendFrame(pair.opcode, 500, pair.param);
+    REQUIRE(linkManager.hasCommand());
+    Command binary = linkManager.getNextCommand();
+
+    CHECK_EQ(text.type, (char)pair.opcode);
+    CHECK_EQ(text.value, pair.param);
+    CHECK_EQ(text.seq, 0);
+    CHECK_EQ(binary.type, text.type);
+    CHECK_EQ(binary.value, text.value);
+    CHECK_EQ(binary.seq, 500);
+    CHECK_EQ(binary.source, text.source);
+  }
+  client.clear();
+}
+
+// Uploads one program in PROG_BEGIN/DATA/END frames; true if the end frame
+// was acknowledged as completed
+static bool uploadProgram(LoopbackClient& client, const uint8_t* program, uint8_t length) {
+  client.clear();
+  client.sendFrame(OP_PROG_BEGIN, 1, length);
+  client.sendFrame(OP_PROG_DATA, 2, 0, program, length);
+  client.sendFrame(OP_PROG_END, 3, crc16(program, length));
+  client.poll();
+  return client.acks.size() == 3 && client.acks[2].event == ACK_COMPLETED;
+}
+
+// Programs are bytecode only; the earlier [type][i32 value] step list is
+// not a format the robot accepts any more.
+TEST_CASE(programUploadTakesBytecodeOnly) {
+  static LoopbackClient client;
+  host::setConsoleOutput(false);
+  client.connect();
+
+  const uint8_t bytecode[] = {0x01, 20, 0, 0, 0, 0x10, 0x00};   // PUSH 20, MOVE, HALT
+  CHECK(uploadProgram(client, bytecode, sizeof(bytecode)));
+  CHECK(programRunner.isReady());
+  CHECK_EQ(programRunner.getInstructionCount(), 3);
+
+  const uint8_t steps[] = {'F', 20, 0, 0, 0, 'L', 90, 0, 0, 0};
+  CHECK(!uploadProgram(client, steps, sizeof(steps)));
+  CHECK(!programRunner.isReady());
+  client.clear();
+}
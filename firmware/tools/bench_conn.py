@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Measure command latency over BLE under each connection profile.
+
+    pip install bleak
+    bench_conn.py
+    bench_conn.py --commands 100 --auto 5 --address 24:0A:C4:12:34:56
+
+Connects as the controller, turns telemetry off and, for CONN_FAST and
+then CONN_IDLE, sends --commands STOPs spaced out so each finds the robot
+idle. For each one it reports three times:
+
+  send to start   from this machine writing the command to the robot's
+                  motor task starting it. The "started" ack carries the
+                  robot's clock; it is put on this machine's clock with
+                  the smallest (arrival - robot time) seen over every ack,
+                  so the figure runs high by at least the fastest
+                  notification's air time.
+  on robot        receipt to start, from the ack alone (what the status
+                  print bins per profile)
+  round trip      writing the command to the "started" ack arriving here
+
+--auto N then sends N commands in CONN_AUTO, each after waiting for the
+link to drop to the idle profile (CONN_IDLE_AFTER_MS, 30 s): the first
+command of a session, which arrives on the slow link and wakes it.
+
+A STOP on an idle robot does nothing, so the robot stays where it is.
+"""
+
+import argparse
+import asyncio
+import json
+import statistics
+import struct
+import sys
+import time
+
+DEVICE_NAME = "E-Bug ESP32"
+COMMAND_CHAR_UUID = "12345678-1234-1234-1234-123456789abd"
+SENSOR_CHAR_UUID = "12345678-1234-1234-1234-123456789abe"
+STATUS_CHAR_UUID = "12345678-1234-1234-1234-123456789abf"
+
+ACK_MAGIC = 0xEA
+ACK_SIZE = 15
+ACK_STARTED = 1
+CONN_IDLE_AFTER_S = 30.0
+
+
+class Robot:
+    """The command, sensor and status characteristics, through bleak."""
+
+    def __init__(self, address):
+        self.address = address
+        self.client = None
+        self.acks = asyncio.Queue()     # (arrival ms, event, type, received, time)
+        self.offset = None              # min(arrival - robot time) over every ack
+
+    async def open(self):
+        from bleak import BleakClient, BleakScanner
+
+        target = self.address
+        if target is None:
+            print(f"Scanning for {DEVICE_NAME}...")
+            target = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=10.0)
+            if target is None:
+                raise SystemExit(f"{DEVICE_NAME} not found")
+        self.client = BleakClient(target)
+        await self.client.connect()
+        await self.client.start_notify(STATUS_CHAR_UUID, self._ack)
+        await self.client.start_notify(SENSOR_CHAR_UUID, self._sensor)
+
+    def _ack(self, _, data):
+        now = time.monotonic() * 1000
+        data = bytes(data)
+        if len(data) < ACK_SIZE or data[0] != ACK_MAGIC:
+            return
+        received, robot_time = struct.unpack_from("<II", data, 6)
+        offset = now - robot_time
+        self.offset = offset if self.offset is None else min(self.offset, offset)
+        self.acks.put_nowait((now, data[2], chr(data[3]), received, robot_time))
+
+    def _sensor(self, _, data):
+        try:
+            message = json.loads(bytes(data))
+        except ValueError:
+            return
+        if message.get("status") == "conn":
+            print(f"  link: {message['profile']} profile, interval {message['interval']} ms, "
+                  f"latency {message['latency']}")
+
+    async def send(self, text):
+        await self.client.write_gatt_char(COMMAND_CHAR_UUID, text.encode(), response=False)
+
+    async def started(self, timeout):
+        """The next "started" ack, or None."""
+        end = time.monotonic() + timeout
+        while (left := end - time.monotonic()) > 0:
+            try:
+                ack = await asyncio.wait_for(self.acks.get(), left)
+            except asyncio.TimeoutError:
+                return None
+            if ack[1] == ACK_STARTED:
+                return ack
+        return None
+
+    async def close(self):
+        if self.client is not None and self.client.is_connected:
+            await self.client.disconnect()
+
+
+async def measure(robot, count, spacing, wait=0.0):
+    """(send ms, started ack) per STOP"""
+    samples = []
+    for _ in range(count):
+        await asyncio.sleep(wait)
+        while not robot.acks.empty():
+            robot.acks.get_nowait()
+        sent = time.monotonic() * 1000
+        await robot.send("STOP")
+        ack = await robot.started(2.0)
+        if ack is not None:
+            samples.append((sent, ack))
+        await asyncio.sleep(spacing)
+    return samples
+
+
+def summary(values):
+    values = sorted(values)
+    p95 = values[min(len(values) - 1, int(len(values) * 0.95))]
+    return f"mean {statistics.mean(values):7.1f}  p95 {p95:7.1f}  max {values[-1]:7.1f}"
+
+
+def report(name, samples, offset):
+    if not samples:
+        print(f"{name}: no acks received")
+        return
+    to_start = [ack[4] + offset - sent for sent, ack in samples]
+    on_robot = [ack[4] - ack[3] for _, ack in samples]
+    round_trip = [ack[0] - sent for sent, ack in samples]
+    print(f"{name} ({len(samples)} commands), ms")
+    print(f"  send to start  {summary(to_start)}")
+    print(f"  on robot       {summary(on_robot)}")
+    print(f"  round trip     {summary(round_trip)}")
+
+
+async def run(options):
+    robot = Robot(options.address)
+    await robot.open()
+    try:
+        await robot.send("SUB_OFF")
+        results = []
+        for mode in ("CONN_FAST", "CONN_IDLE"):
+            print(f"{mode}...")
+            await robot.send(mode)
+            await asyncio.sleep(options.settle)
+            results.append((mode, await measure(robot, options.commands, options.spacing)))
+        if options.auto > 0:
+            print(f"CONN_AUTO, {options.auto} commands {CONN_IDLE_AFTER_S + 5:.0f} s apart...")
+            await robot.send("CONN_AUTO")
+            results.append(("CONN_AUTO, first command after idle",
+                            await measure(robot, options.auto, 0, CONN_IDLE_AFTER_S + 5)))
+        for name, samples in results:
+            report(name, samples, robot.offset)
+        await robot.send("SUB_DEFAULT")
+    finally:
+        await robot.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--address", help="robot address (default: scan by name)")
+    parser.add_argument("--commands", type=int, default=50, help="commands per profile")
+    parser.add_argument("--spacing", type=float, default=0.5, help="seconds between commands")
+    parser.add_argument("--settle", type=float, default=3.0,
+                        help="seconds to let the central apply a profile")
+    parser.add_argument("--auto", type=int, default=0,
+                        help="commands in CONN_AUTO, each after the link went idle")
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Measure how often an idle robot wakes up and how fast it picks up commands.
+
+    pip install pyserial
+    bench_idle.py /dev/ttyUSB0
+    bench_idle.py --idle 120 --commands 100 /dev/ttyUSB0
+
+Runs over the serial transport (SERIAL_TRANSPORT_ENABLED), with nothing
+connected over BLE, in two phases:
+
+  1. idle: telemetry off, counters reset, then nothing for --idle seconds.
+     DIAG then gives each task's wake-ups per second and load. Every
+     wake-up costs CPU time and keeps the chip out of light sleep, so
+     this is the figure to watch for idle power.
+  2. latency: --commands STOPs, spaced out so each finds the robot
+     idle. For each one the "started" ack gives the time from queueing
+     the command to the motor task starting it, in robot milliseconds.
+
+Run it on two builds to compare them. The robot stays where it is: a STOP
+on an idle robot does nothing. test/bench_wakeups.cpp (host build) gives
+the same two figures for the task loops' waits alone, without a robot.
+"""
+
+import argparse
+import json
+import statistics
+import struct
+import sys
+import time
+
+ACK_MAGIC = 0xEA
+ACK_STARTED = 1
+
+
+class Robot:
+    def __init__(self, port, baud):
+        import serial
+        self.port = serial.Serial(port, baud, timeout=0.1)
+        self.buffer = b""
+
+    def send(self, line):
+        self.port.write(line.encode() + b"\n")
+
+    def lines(self, duration):
+        """Protocol lines ("@X ...") received within duration seconds."""
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            self.buffer += self.port.read(4096)
+            while b"\n" in self.buffer:
+                line, self.buffer = self.buffer.split(b"\n", 1)
+                line = line.strip().decode(errors="replace")
+                if line.startswith("@"):
+                    yield line
+
+    def drain(self, duration):
+        for _ in self.lines(duration):
+            pass
+
+
+def idle_phase(robot, seconds):
+    robot.send("SUB_OFF")
+    robot.drain(1.0)
+    robot.send("DIAG_RESET")
+    print(f"Idle for {seconds} s...")
+    robot.drain(seconds)
+    robot.send("DIAG")
+
+    tasks = []
+    queues = None
+    for line in robot.lines(2.0):
+        if not line.startswith("@T "):
+            continue
+        message = json.loads(line[3:])
+        if message.get("status") != "diag":
+            continue
+        if "task" in message:
+            tasks.append(message)
+        elif "queues" in message:
+            queues = message["queues"]
+            break
+
+    if not tasks:
+        raise SystemExit("No DIAG reply: is the serial transport enabled?")
+
+    print(f"{'task':8} {'wake-ups/s':>10} {'load %':>7} {'longest us':>10} {'stack used':>10}")
+    total = 0.0
+    for task in tasks:
+        rate = task["passes"] / seconds
+        total += rate
+        used = task["stack"] - task["stackFree"]
+        print(f"{task['task']:8} {rate:10.2f} {task['load']:7.2f} {task['busyMax']:10} "
+              f"{used:5}/{task['stack']}")
+    print(f"{'total':8} {total:10.2f}")
+    if queues:
+        print("queue peaks: " + ", ".join(f"{name} {q[1]}/{q[2]}" for name, q in queues.items()))
+
+
+def latency_phase(robot, count, spacing):
+    print(f"Sending {count} commands...")
+    latencies = []
+    for _ in range(count):
+        robot.send("STOP")
+        for line in robot.lines(spacing):
+            if not line.startswith("@A "):
+                continue
+            ack = bytes.fromhex(line[3:])
+            if len(ack) < 15 or ack[0] != ACK_MAGIC or ack[2] != ACK_STARTED:
+                continue
+            received, started = struct.unpack_from("<II", ack, 6)
+            latencies.append(started - received)
+
+    if not latencies:
+        raise SystemExit("No acks received")
+    latencies.sort()
+    p95 = latencies[min(len(latencies) - 1, int(len(latencies) * 0.95))]
+    print(f"queue to start: mean {statistics.mean(latencies):.2f} ms, "
+          f"p95 {p95} ms, max {latencies[-1]} ms ({len(latencies)} commands)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port of the robot")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--idle", type=float, default=60.0, help="idle phase length, s")
+    parser.add_argument("--commands", type=int, default=50, help="commands in the latency phase")
+    parser.add_argument("--spacing", type=float, default=0.2, help="seconds between commands")
+    options = parser.parse_args()
+
+    robot = Robot(options.port, options.baud)
+    idle_phase(robot, options.idle)
+    latency_phase(robot, options.commands, options.spacing)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
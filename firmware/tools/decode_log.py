@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Turn the robot's binary log records back into text.
+
+Records carry the address of their format string instead of the string
+itself; this tool reads the strings out of the firmware image that was
+running (.pio/build/esp32dev/firmware.elf) and formats the arguments the
+way the robot would have.
+
+    # a serial capture with LOG_SERIAL_BINARY=1 ("@L <hex>" lines); other
+    # lines are passed through unchanged
+    decode_log.py firmware.elf capture.txt
+
+    # raw records, e.g. log characteristic notifications saved back to back
+    decode_log.py --raw firmware.elf notifications.bin
+
+Use "-" to read from stdin. Only the standard library is needed.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LOG_MAGIC = 0xE7
+LOG_HEADER_SIZE = 12
+LEVEL_TAGS = "-EWID"
+
+ARG_INT, ARG_UINT, ARG_FLOAT, ARG_TEXT = range(4)
+
+SHF_ALLOC = 0x2
+SHT_PROGBITS = 1
+
+SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|L|q|j|z|t)?([diouxXeEfFgGaAcsp%])")
+
+
+class Elf:
+    """Just enough of ELF32 to read constant data by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            raise ValueError(f"{path}: not a 32-bit ELF file")
+        endian = "<" if self.data[5] == 1 else ">"
+        shoff, = struct.unpack_from(endian + "I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from(endian + "HH", self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from(
+                endian + "IIIIII", self.data, shoff + i * shentsize)
+            if sh_type == SHT_PROGBITS and flags & SHF_ALLOC and size > 0:
+                self.sections.append((addr, size, offset))
+
+    def string_at(self, address):
+        for addr, size, offset in self.sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.find(b"\0", start, offset + size)
+                if end < 0:
+                    end = offset + size
+                return self.data[start:end].decode("utf-8", "replace")
+        return None
+
+
+def parse_record(data):
+    """Decode one record; returns (record, length) or (None, 0)."""
+    if len(data) < LOG_HEADER_SIZE + 1 or data[0] != LOG_MAGIC:
+        return None, 0
+    level, argc = data[1] >> 4, data[1] & 0x0F
+    types, timestamp, fmt = struct.unpack_from("<HII", data, 2)
+    pos = LOG_HEADER_SIZE
+    if len(data) < pos + 4 * argc + 1:
+        return None, 0
+    raw = struct.unpack_from(f"<{argc}I", data, pos)
+    pos += 4 * argc
+    text_length = data[pos]
+    pos += 1
+    if len(data) < pos + text_length:
+        return None, 0
+    texts = data[pos:pos + text_length].split(b"\0")
+    pos += text_length
+
+    args = []
+    for i, value in enumerate(raw):
+        kind = (types >> (2 * i)) & 0x03
+        if kind == ARG_INT:
+            args.append(value - (1 << 32) if value & 0x80000000 else value)
+        elif kind == ARG_UINT:
+            args.append(value)
+        elif kind == ARG_FLOAT:
+            args.append(struct.unpack("<f", struct.pack("<I", value))[0])
+        else:
+            args.append(texts.pop(0).decode("utf-8", "replace") if texts else "")
+    return (timestamp, level, fmt, args), pos
+
+
+def render(fmt, args):
+    """printf-style formatting of recorded arguments."""
+    args = list(args)
+
+    def convert(match):
+        flags, conversion = match.group(1), match.group(2)
+        if conversion == "%":
+            return "%"
+        if not args:
+            return "?"
+        value = args.pop(0)
+        if conversion == "s":
+            return ("%" + flags + "s") % (value if isinstance(value, str) else "")
+        if isinstance(value, str):
+            return value
+        if conversion == "p":
+            return "0x%08x" % value
+        if conversion == "c":
+            return chr(int(value) & 0xFF)
+        if conversion in "eEfFgGaA":
+            return ("%" + flags + ("f" if conversion in "aA" else conversion)) % value
+        if conversion == "u":
+            conversion = "d"
+        return ("%" + flags + conversion) % int(value)
+
+    return SPEC.sub(convert, fmt)
+
+
+def format_record(elf, record):
+    timestamp, level, fmt_address, args = record
+    fmt = elf.string_at(fmt_address)
+    if fmt is None:
+        text = "<unknown format 0x%08x> %s" % (fmt_address, args)
+    else:
+        text = render(fmt, args)
+    tag = LEVEL_TAGS[level] if level < len(LEVEL_TAGS) else "?"
+    return "%d %s %s" % (timestamp, tag, text)
+
+
+def decode_capture(elf, stream, out):
+    for line in stream:
+        line = line.rstrip("\r\n")
+        if not line.startswith("@L "):
+            out.write(line + "\n")
+            continue
+        try:
+            data = bytes.fromhex(line[3:])
+        except ValueError:
+            out.write(line + "\n")
+            continue
+        record, _ = parse_record(data)
+        out.write((format_record(elf, record) if record else line) + "\n")
+
+
+def decode_raw(elf, data, out):
+    pos = 0
+    while pos < len(data):
+        record, length = parse_record(data[pos:])
+        if record is None:
+            # Resynchronise on the next magic byte
+            next_magic = data.find(bytes([LOG_MAGIC]), pos + 1)
+            if next_magic < 0:
+                break
+            pos = next_magic
+            continue
+        out.write(format_record(elf, record) + "\n")
+        pos += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware.elf of the build that produced the log")
+    parser.add_argument("log", help="capture file, or - for stdin")
+    parser.add_argument("--raw", action="store_true",
+                        help="input is binary records rather than @L lines")
+    options = parser.parse_args()
+
+    elf = Elf(options.elf)
+    if options.raw:
+        if options.log == "-":
+            data = sys.stdin.buffer.read()
+        else:
+            with open(options.log, "rb") as f:
+                data = f.read()
+        decode_raw(elf, data, sys.stdout)
+    else:
+        if options.log == "-":
+            decode_capture(elf, sys.stdin, sys.stdout)
+        else:
+            with open(options.log, encoding="utf-8", errors="replace") as f:
+                decode_capture(elf, f, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+"""Send a firmware image to the robot over BLE (see src/ota_update.h).
+
+    pip install bleak
+    ota_send.py .pio/build/esp32dev/firmware.bin
+    ota_send.py --address 24:0A:C4:12:34:56 firmware.bin
+
+    # no robot needed: run the transfer against a simulated receiver that
+    # drops a share of the chunks, to exercise the window and resend logic
+    ota_send.py --simulate --loss 0.02 firmware.bin
+
+The robot stops, takes the image chunk by chunk straight into its spare
+app partition, checks the SHA-256 and restarts into the new firmware.
+"""
+
+import argparse
+import asyncio
+import hashlib
+import random
+import struct
+import sys
+import time
+
+DEVICE_NAME = "E-Bug ESP32"
+OTA_CHAR_UUID = "12345678-1234-1234-1234-123456789ac1"
+
+OTA_MAGIC = 0xED
+OTA_BEGIN, OTA_DATA, OTA_END, OTA_ABORT = 0x01, 0x02, 0x03, 0x04
+OTA_READY, OTA_ACK, OTA_NACK, OTA_DONE, OTA_ERROR = range(5)
+OTA_DATA_HEADER = 5
+
+ERRORS = ["none", "malformed packet", "no transfer in progress", "flash error",
+          "image incomplete", "hash mismatch", "timed out", "aborted"]
+
+ACK_TIMEOUT = 2.0       # resend the window after this long without progress
+REPLY_TIMEOUT = 15.0    # BEGIN and END (flash setup and image validation)
+
+
+class OtaError(Exception):
+    pass
+
+
+class BleLink:
+    """The OTA characteristic of a robot, through bleak."""
+
+    def __init__(self, address):
+        self.address = address
+        self.client = None
+        self.replies = asyncio.Queue()
+
+    async def open(self):
+        from bleak import BleakClient, BleakScanner
+
+        target = self.address
+        if target is None:
+            print(f"Scanning for {DEVICE_NAME}...")
+            target = await BleakScanner.find_device_by_name(DEVICE_NAME, timeout=10.0)
+            if target is None:
+                raise OtaError(f"{DEVICE_NAME} not found")
+        self.client = BleakClient(target)
+        await self.client.connect()
+        await self.client.start_notify(OTA_CHAR_UUID, self._notified)
+
+    def _notified(self, _, data):
+        self.replies.put_nowait(bytes(data))
+
+    def max_write(self):
+        return self.client.mtu_size - 3
+
+    async def write(self, data, response):
+        await self.client.write_gatt_char(OTA_CHAR_UUID, data, response=response)
+
+    async def close(self):
+        if self.client is not None and self.client.is_connected:
+            await self.client.disconnect()
+
+
+class SimulatedLink:
+    """The robot's side of the protocol, in process. It keeps the firmware's
+    window queue, ack cadence and NACK rule, spends erase time per 4 KB
+    sector and loses chunks with the given probability."""
+
+    def __init__(self, loss, window=8, chunk_max=239, ack_every=4, erase_ms=45, mtu=247):
+        self.loss = loss
+        self.window = window
+        self.chunk_max = chunk_max
+        self.ack_every = ack_every
+        self.erase_ms = erase_ms
+        self.mtu = mtu
+        self.replies = asyncio.Queue()
+        self.pending = asyncio.Queue(maxsize=window)
+        self.worker = None
+        self.lost = 0
+
+    async def open(self):
+        self.worker = asyncio.create_task(self._run())
+
+    def max_write(self):
+        return self.mtu - 3
+
+    async def write(self, data, response):
+        if data[0] == OTA_DATA and random.random() < self.loss:
+            self.lost += 1
+            return
+        try:
+            self.pending.put_nowait(bytes(data))
+        except asyncio.QueueFull:
+            pass            # an overrun, like the firmware's full queue
+        await asyncio.sleep(0)
+
+    def _reply(self, event, value=0, extra=0):
+        self.replies.put_nowait(struct.pack("<BBII", OTA_MAGIC, event, value, extra))
+
+    async def _run(self):
+        size = received = erased = since_ack = 0
+        last_nack = None
+        sha = expected = None
+        start = 0.0
+        while True:
+            packet = await self.pending.get()
+            op = packet[0]
+            if op == OTA_BEGIN:
+                size = struct.unpack_from("<I", packet, 1)[0]
+                expected = packet[5:37]
+                sha = hashlib.sha256()
+                received = erased = since_ack = 0
+                last_nack = None
+                start = time.monotonic()
+                self._reply(OTA_READY, self.window, self.chunk_max)
+            elif op == OTA_DATA:
+                offset = struct.unpack_from("<I", packet, 1)[0]
+                chunk = packet[OTA_DATA_HEADER:]
+                if offset != received:
+                    if offset > received and last_nack != received:
+                        last_nack = received
+                        self._reply(OTA_NACK, received)
+                    continue
+                sectors = (received + len(chunk) + 4095) // 4096
+                if sectors > erased:
+                    await asyncio.sleep((sectors - erased) * self.erase_ms / 1000)
+                    erased = sectors
+                sha.update(chunk)
+                received += len(chunk)
+                since_ack += 1
+                if since_ack >= self.ack_every or received == size:
+                    since_ack = 0
+                    self._reply(OTA_ACK, received)
+            elif op == OTA_END:
+                if received != size:
+                    self._reply(OTA_ERROR, 4, received)
+                elif sha.digest() != expected:
+                    self._reply(OTA_ERROR, 5, received)
+                else:
+                    elapsed = max(time.monotonic() - start, 1e-3)
+                    self._reply(OTA_DONE, size, int(size / elapsed))
+
+    async def close(self):
+        if self.worker is not None:
+            self.worker.cancel()
+
+
+async def next_reply(link, timeout):
+    data = await asyncio.wait_for(link.replies.get(), timeout)
+    if len(data) < 10 or data[0] != OTA_MAGIC:
+        raise OtaError(f"unexpected reply {data.hex()}")
+    _, event, value, extra = struct.unpack_from("<BBII", data)
+    if event == OTA_ERROR:
+        name = ERRORS[value] if value < len(ERRORS) else f"error {value}"
+        raise OtaError(f"robot reported {name} at byte {extra}")
+    return event, value, extra
+
+
+async def send_image(link, image):
+    size = len(image)
+    digest = hashlib.sha256(image).digest()
+
+    await link.write(struct.pack("<BI", OTA_BEGIN, size) + digest, True)
+    event, window, chunk_max = await next_reply(link, REPLY_TIMEOUT)
+    if event != OTA_READY:
+        raise OtaError("robot did not accept the transfer")
+
+    chunk = min(chunk_max, link.max_write() - OTA_DATA_HEADER)
+    if chunk <= 0:
+        raise OtaError("MTU too small for the transfer")
+    print(f"Sending {size} bytes, {chunk}-byte chunks, window {window}")
+
+    start = time.monotonic()
+    acked = sent = resends = 0
+    while acked < size:
+        # Fill the window
+        while sent < size and sent - acked < window * chunk:
+            piece = image[sent:sent + chunk]
+            await link.write(struct.pack("<BI", OTA_DATA, sent) + piece, False)
+            sent += len(piece)
+
+        try:
+            event, value, _ = await next_reply(link, ACK_TIMEOUT)
+        except asyncio.TimeoutError:
+            # The tail of the window was lost and nothing after it could
+            # trigger a NACK: go back to the last acknowledged byte
+            resends += 1
+            sent = acked
+            continue
+
+        if event == OTA_ACK:
+            acked = max(acked, value)
+        elif event == OTA_NACK:
+            resends += 1
+            acked = max(acked, value)
+            sent = value
+        percent = 100 * acked // size
+        print(f"\r{acked}/{size} bytes ({percent}%)", end="", flush=True)
+    print()
+
+    await link.write(bytes([OTA_END]), True)
+    event, _, robot_rate = await next_reply(link, REPLY_TIMEOUT)
+    if event != OTA_DONE:
+        raise OtaError("robot did not confirm the image")
+
+    elapsed = time.monotonic() - start
+    print(f"Done: {size} bytes in {elapsed:.1f} s, {size / elapsed / 1024:.1f} KiB/s here, "
+          f"{robot_rate / 1024:.1f} KiB/s on the robot, {resends} resends")
+
+
+async def run(options):
+    with open(options.image, "rb") as f:
+        image = f.read()
+
+    if options.simulate:
+        link = SimulatedLink(options.loss)
+    else:
+        link = BleLink(options.address)
+
+    await link.open()
+    try:
+        await send_image(link, image)
+        if options.simulate:
+            print(f"Simulated link lost {link.lost} chunks")
+    except BaseException:
+        try:
+            await link.write(bytes([OTA_ABORT]), True)
+        except Exception:
+            pass
+        raise
+    finally:
+        await link.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="firmware.bin from the PlatformIO build")
+    parser.add_argument("--address", help="robot address (default: scan by name)")
+    parser.add_argument("--simulate", action="store_true",
+                        help="send to an in-process simulated robot")
+    parser.add_argument("--loss", type=float, default=0.0,
+                        help="chunk loss probability for --simulate")
+    options = parser.parse_args()
+
+    try:
+        asyncio.run(run(options))
+    except OtaError as e:
+        print(f"\nUpdate failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Convert a robot trace dump (TRACE_DUMP) into a Chrome trace / Perfetto timeline.
+
+    # a serial capture: "@R <hex>" lines, everything else is skipped
+    trace_to_perfetto.py capture.txt -o trace.json
+
+    # BLE telemetry notifications saved as hex, one per line
+    trace_to_perfetto.py notifications.txt -o trace.json
+
+Open the result in https://ui.perfetto.dev or chrome://tracing. Each
+registered task is a thread: its loop passes are slices, with mutex
+waits nested inside. Commands are async tracks from receipt to their
+last ack, sensor readings are counters and step bursts are instants.
+
+If the capture holds several dumps the last complete one is used. Use
+"-" to read from stdin. Only the standard library is needed.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0xEE
+CHUNK_START, CHUNK_TASK, CHUNK_EVENTS, CHUNK_END = range(4)
+TASK_OTHER = 0x7F
+EVENT = struct.Struct("<IBBHI")
+
+(CLOCK, TASK_WAKE, TASK_SLEEP, CMD_RECEIVED, CMD_QUEUED, CMD_STARTED, CMD_COMPLETED,
+ CMD_ABORTED, CMD_REJECTED, STEPS, SENSOR, MUTEX_WAIT, MUTEX_TAKEN, MARK) = range(14)
+
+COMMAND_STAGES = {
+    CMD_RECEIVED: "received", CMD_QUEUED: "queued", CMD_STARTED: "started",
+    CMD_COMPLETED: "completed", CMD_ABORTED: "aborted", CMD_REJECTED: "rejected",
+}
+DIAG_TASKS = ["motor", "sensor", "comm", "loop"]
+SENSORS = [("distance", "mm"), ("side left", "mm"), ("side right", "mm"), ("yaw", "cdeg")]
+MUTEXES = ["pose", "ultrasonic", "imu", "status", "notify", "serial", "estimate"]
+PID = 1
+
+
+def read_chunks(lines):
+    for line in lines:
+        line = line.strip()
+        if line.startswith("@R "):
+            line = line[3:]
+        elif line.startswith("@"):
+            continue
+        try:
+            chunk = bytes.fromhex(line)
+        except ValueError:
+            continue
+        if len(chunk) >= 4 and chunk[0] == TRACE_MAGIC:
+            yield chunk[1], struct.unpack_from("<H", chunk, 2)[0], chunk[4:]
+
+
+def last_dump(chunks):
+    """Header, task names and raw events of the last dump that has an end."""
+    dump = None
+    complete = None
+    for kind, index, payload in chunks:
+        if kind == CHUNK_START:
+            version, mhz, size, count, overwritten = struct.unpack_from("<BHBII", payload)
+            if version != 1 or size != EVENT.size:
+                raise SystemExit(f"Unsupported trace format {version} (event size {size})")
+            dump = {"mhz": mhz, "count": count, "overwritten": overwritten,
+                    "tasks": {}, "chunks": {}, "next": 1}
+        elif dump is None:
+            continue
+        elif kind == CHUNK_TASK:
+            dump["tasks"][payload[0]] = payload[1:].decode(errors="replace")
+        elif kind == CHUNK_EVENTS:
+            dump["chunks"][index] = payload
+        elif kind == CHUNK_END:
+            dump["sent"] = struct.unpack_from("<I", payload)[0]
+            complete = dump
+            dump = None
+
+    if complete is None:
+        raise SystemExit("No complete trace dump found")
+    data = b"".join(complete["chunks"][i] for i in sorted(complete["chunks"]))
+    if len(data) // EVENT.size < complete["sent"]:
+        print(f"warning: {complete['sent'] - len(data) // EVENT.size} events missing "
+              "(lost chunks)", file=sys.stderr)
+    complete["events"] = [EVENT.unpack_from(data, i) for i in range(0, len(data) - EVENT.size + 1, EVENT.size)]
+    return complete
+
+
+def convert(dump):
+    mhz = dump["mhz"]
+    tasks = dump["tasks"]
+    out = []
+    anchors = {}            # core -> (cycles, us, MHz)
+    wraps = {}              # core -> micros() wrap offset
+    open_slices = {}        # tid -> depth of B events without an E
+    dropped = 0
+
+    def tid_of(task):
+        index = task & 0x7F
+        return 100 + (task >> 7) if index == TASK_OTHER else index
+
+    for cycles, kind, task, arg16, arg in dump["events"]:
+        core = task >> 7
+        if kind == CLOCK:
+            # micros() wraps every 71 minutes; keep the timeline monotonic
+            offset = wraps.get(core, 0)
+            last = anchors.get(core)
+            if last is not None and arg + offset < last[1] - (1 << 31):
+                offset += 1 << 32
+            wraps[core] = offset
+            anchors[core] = (cycles, arg + offset, arg16 or mhz)
+            continue
+
+        anchor = anchors.get(core)
+        if anchor is None:
+            # Recorded before the oldest surviving reference of its core
+            dropped += 1
+            continue
+        ts = anchor[1] + ((cycles - anchor[0]) & 0xFFFFFFFF) / anchor[2]
+        tid = tid_of(task)
+        base = {"pid": PID, "tid": tid, "ts": ts}
+
+        if kind == TASK_WAKE:
+            name = DIAG_TASKS[arg16] if arg16 < len(DIAG_TASKS) else f"task {arg16}"
+            out.append(dict(base, ph="B", name=f"{name} pass", cat="task"))
+            open_slices[tid] = open_slices.get(tid, 0) + 1
+        elif kind in (TASK_SLEEP, MUTEX_TAKEN):
+            # The matching begin may have been overwritten
+            if open_slices.get(tid, 0) > 0:
+                args = {"sleep_ms": "event" if arg == 0xFFFFFFFF else arg} if kind == TASK_SLEEP else {}
+                out.append(dict(base, ph="E", args=args))
+                open_slices[tid] -= 1
+        elif kind == MUTEX_WAIT:
+            name = MUTEXES[arg16] if arg16 < len(MUTEXES) else f"mutex {arg16}"
+            out.append(dict(base, ph="B", name=f"wait {name}", cat="mutex"))
+            open_slices[tid] = open_slices.get(tid, 0) + 1
+        elif kind in COMMAND_STAGES:
+            command = f"{chr(arg >> 24)}{arg & 0xFFFFFF}"
+            ident = f"{arg16}:{command}"
+            stage = COMMAND_STAGES[kind]
+            ph = "b" if kind == CMD_RECEIVED else "e" if kind >= CMD_COMPLETED else "n"
+            out.append(dict(base, ph=ph, cat="command", id=ident, name=command,
+                            args={"seq": arg16, "stage": stage}))
+        elif kind == STEPS:
+            out.append(dict(base, ph="i", s="t", name="steps", cat="motor",
+                            args={"left": arg16, "right": arg}))
+        elif kind == SENSOR:
+            name, unit = SENSORS[arg16] if arg16 < len(SENSORS) else (f"sensor {arg16}", "")
+            out.append(dict(base, ph="C", name=name, args={unit or "value": arg}))
+        else:
+            out.append(dict(base, ph="i", s="t", name=f"mark {arg16}", args={"value": arg}))
+
+    names = {tid: name for tid, name in tasks.items()}
+    for tid in {event["tid"] for event in out}:
+        name = names.get(tid, f"other (core {tid - 100})" if tid >= 100 else f"task {tid}")
+        out.append({"pid": PID, "tid": tid, "ph": "M", "name": "thread_name", "args": {"name": name}})
+    out.append({"pid": PID, "ph": "M", "name": "process_name", "args": {"name": "robot"}})
+
+    if dropped:
+        print(f"{dropped} events before the first clock reference of their core skipped",
+              file=sys.stderr)
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="serial capture or hex chunks, - for stdin")
+    parser.add_argument("-o", "--output", default="-", help="trace JSON, default stdout")
+    options = parser.parse_args()
+
+    if options.capture == "-":
+        dump = last_dump(read_chunks(sys.stdin))
+    else:
+        with open(options.capture, errors="replace") as f:
+            dump = last_dump(read_chunks(f))
+    print(f"{len(dump['events'])} events at {dump['mhz']} MHz, "
+          f"{dump['overwritten']} overwritten before the dump", file=sys.stderr)
+
+    trace = {"traceEvents": convert(dump), "displayTimeUnit": "ms"}
+    if options.output == "-":
+        json.dump(trace, sys.stdout)
+    else:
+        with open(options.output, "w") as f:
+            json.dump(trace, f)
+
+
+if __name__ == "__main__":
+    sys.exit(main())